@@ -1,4 +1,4 @@
-QT += core gui widgets svg svgwidgets xml concurrent printsupport
+QT += core gui widgets svg svgwidgets xml concurrent printsupport network sql
 
 TARGET = FoxProbe
 TEMPLATE = app
@@ -7,6 +7,7 @@ SOURCES += \
     devices/devices.cpp \
     filter/filter.cpp \
     packets/sniffing.cpp \
+    packets/tcpreassembly.cpp \
     packets/packet_geolocation/geolocation.cpp \
     packets/packet_geolocation/GeoMap.cpp \
     src/main.cpp \
@@ -23,6 +24,9 @@ SOURCES += \
     src/gui/mainwindow_packets.cpp \
     src/gui/payloadformatter.cpp \
     src/gui/followstreamdialog.cpp \
+    src/gui/streamlistmodel.cpp \
+    src/gui/streampayloadview.cpp \
+    src/gui/streamtextformatter.cpp \
     src/gui/selectionannotationdialog.cpp \
     src/gui/preferencesdialog.cpp \
     src/gui/reportbuilderwindow.cpp \
@@ -30,11 +34,30 @@ SOURCES += \
     src/statistics/statsdialog.cpp \
     src/statistics/sessionmanagerdialog.cpp \
     src/statistics/sessionstorage.cpp \
+    src/statistics/sessionwarehouse.cpp \
     src/statistics/charts/barChart.cpp \
     src/statistics/charts/lineChart.cpp \
     src/statistics/charts/pieChart.cpp \
     src/statistics/statistics.cpp \
+    src/statistics/statisticsaggregator.cpp \
+    src/statistics/metricsserver.cpp \
+    src/statistics/rowrangeset.cpp \
+    src/statistics/statisticsrollup.cpp \
+    src/statistics/sketches/countminsketch.cpp \
+    src/statistics/sketches/heavyhitters.cpp \
+    src/statistics/sketches/hyperloglog.cpp \
+    src/statistics/sketches/quantilehistogram.cpp \
+    src/statistics/toptalkers.cpp \
+    src/statistics/toptalkersdialog.cpp \
     src/statistics/anomalydetector.cpp \
+    src/statistics/anomalyrules.cpp \
+    src/statistics/beacondetector.cpp \
+    src/statistics/dnsanalytics.cpp \
+    src/statistics/entitybaselines.cpp \
+    src/statistics/incidentcoalescer.cpp \
+    src/statistics/incidentrecorder.cpp \
+    src/statistics/seasonalbaselines.cpp \
+    src/statistics/tcpflagdetectors.cpp \
     src/statistics/anomalyinspectordialog.cpp \
     packets/packet_geolocation/CountryMapping/CountryMap.cpp \
     src/PacketTableModel.cpp \
@@ -44,6 +67,9 @@ HEADERS += \
     devices/devices.h \
     filter/filter.h \
     packets/sniffing.h \
+    packets/tcpreassembly.h \
+    packets/flowkey.h \
+    packets/flowtable.h \
     packets/packet_geolocation/geolocation.h \
     protocols/proto_struct.h \
     src/mainwindow.h \
@@ -61,6 +87,9 @@ HEADERS += \
     src/gui/mainwindow_packets.h \
     src/gui/payloadformatter.h \
     src/gui/followstreamdialog.h \
+    src/gui/streamlistmodel.h \
+    src/gui/streampayloadview.h \
+    src/gui/streamtextformatter.h \
     src/gui/selectionannotationdialog.h \
     src/gui/preferencesdialog.h \
     src/gui/reportbuilderwindow.h \
@@ -69,11 +98,32 @@ HEADERS += \
     src/statistics/statsdialog.h \
     src/statistics/sessionmanagerdialog.h \
     src/statistics/sessionstorage.h \
+    src/statistics/sessionwarehouse.h \
     src/statistics/charts/barChart.h \
     src/statistics/charts/lineChart.h \
     src/statistics/charts/pieChart.h \
     src/statistics/statistics.h \
+    src/statistics/statisticsaggregator.h \
+    src/statistics/metricsserver.h \
+    src/statistics/rowrangeset.h \
+    src/statistics/statisticsrollup.h \
+    src/statistics/spscqueue.h \
+    src/statistics/sketches/countminsketch.h \
+    src/statistics/sketches/heavyhitters.h \
+    src/statistics/sketches/hyperloglog.h \
+    src/statistics/sketches/quantilehistogram.h \
+    src/statistics/sketches/sketchhash.h \
+    src/statistics/toptalkers.h \
+    src/statistics/toptalkersdialog.h \
     src/statistics/anomalydetector.h \
+    src/statistics/anomalyrules.h \
+    src/statistics/beacondetector.h \
+    src/statistics/dnsanalytics.h \
+    src/statistics/entitybaselines.h \
+    src/statistics/incidentcoalescer.h \
+    src/statistics/incidentrecorder.h \
+    src/statistics/seasonalbaselines.h \
+    src/statistics/tcpflagdetectors.h \
     src/statistics/anomalyinspectordialog.h \
     src/statistics/charts/ChartConfig.h \
     packets/packet_geolocation/GeoMap.h \
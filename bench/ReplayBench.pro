@@ -0,0 +1,37 @@
+QT += core gui widgets sql
+CONFIG += console c++17
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = ReplayBench
+
+SOURCES += replaybench.cpp \
+           ../packets/sniffing.cpp \
+           ../packets/tcpreassembly.cpp \
+           ../src/appsettings.cpp \
+           ../src/statistics/statistics.cpp \
+           ../src/statistics/sessionwarehouse.cpp \
+           ../src/statistics/rowrangeset.cpp \
+           ../src/statistics/statisticsrollup.cpp \
+           ../src/statistics/sketches/countminsketch.cpp \
+           ../src/statistics/sketches/heavyhitters.cpp \
+           ../src/statistics/sketches/hyperloglog.cpp \
+           ../src/statistics/sketches/quantilehistogram.cpp \
+           ../src/statistics/toptalkers.cpp \
+           ../src/statistics/anomalydetector.cpp \
+           ../src/statistics/anomalyrules.cpp \
+           ../src/statistics/beacondetector.cpp \
+           ../src/statistics/dnsanalytics.cpp \
+           ../src/statistics/entitybaselines.cpp \
+           ../src/statistics/incidentcoalescer.cpp \
+           ../src/statistics/seasonalbaselines.cpp \
+           ../src/statistics/tcpflagdetectors.cpp
+
+HEADERS += ../src/statistics/statistics.h \
+           ../src/statistics/anomalydetector.h
+
+INCLUDEPATH += .. \
+               ../protocols \
+               ../packets \
+               ../src
+
+LIBS += -lpcap
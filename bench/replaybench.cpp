@@ -0,0 +1,355 @@
+// Replays a pcap through the capture path's decoding, Statistics and the
+// anomaly detector as fast as the CPU allows, without a GUI:
+//
+//   ReplayBench capture.pcap [--labels incidents.json] [--rules rules.json]
+//               [--baselines seasonal.baselines] [--cooldown seconds] [--json]
+//
+// Reports decode and detector throughput, how long closing each second
+// took, and, given labels, the precision and recall of the incidents
+// raised. Labels are seconds since the first packet; an incident without
+// tags is matched by any event overlapping it:
+//
+//   {"incidents": [{"start": 30, "end": 95, "tags": ["syn-flood"]}]}
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QTimeZone>
+
+#include <pcap.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "packets/packethelpers.h"
+#include "packets/sniffing.h"
+#include "src/statistics/anomalyrules.h"
+#include "src/statistics/statistics.h"
+
+namespace {
+// Events this many seconds after an incident still count as detecting it.
+constexpr int kDefaultSlackSeconds = 2;
+
+struct DecodedPacket {
+    QDateTime timestamp;
+    QString protocol;
+    QString source;
+    QString destination;
+    quint64 size = 0;
+    Statistics::PacketDetail detail;
+};
+
+struct Incident {
+    int start = 0;
+    int end = 0;
+    QStringList tags;
+    int firstEvent = -1;   // second of the first matching event
+};
+
+bool readPackets(const QString &path, QVector<CapturedPacket> &packets, QString *error)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *handle = pcap_open_offline(path.toUtf8().constData(), errbuf);
+    if (!handle) {
+        *error = QString::fromLocal8Bit(errbuf);
+        return false;
+    }
+    const int linkType = pcap_datalink(handle);
+    const u_char *raw = nullptr;
+    pcap_pkthdr *header = nullptr;
+    int res = 0;
+    while ((res = pcap_next_ex(handle, &header, &raw)) == 1) {
+        packets.append(CapturedPacket{QByteArray(reinterpret_cast<const char *>(raw), int(header->caplen)),
+                                      linkType, header->ts.tv_sec, header->ts.tv_usec});
+    }
+    if (res == -1) {
+        *error = QString::fromLocal8Bit(pcap_geterr(handle));
+    }
+    pcap_close(handle);
+    return res != -1;
+}
+
+bool readIncidents(const QString &path, QVector<Incident> &incidents, QString *error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        *error = parseError.errorString();
+        return false;
+    }
+    for (const QJsonValue &value : document.object().value(QStringLiteral("incidents")).toArray()) {
+        const QJsonObject object = value.toObject();
+        Incident incident;
+        incident.start = object.value(QStringLiteral("start")).toInt();
+        incident.end = object.value(QStringLiteral("end")).toInt(incident.start);
+        for (const QJsonValue &tag : object.value(QStringLiteral("tags")).toArray()) {
+            incident.tags.append(tag.toString());
+        }
+        if (incident.end < incident.start) {
+            *error = QStringLiteral("incident %1 ends before it starts").arg(incidents.size() + 1);
+            return false;
+        }
+        incidents.append(incident);
+    }
+    return true;
+}
+
+bool matches(const Incident &incident, const AnomalyDetector::Event &event, int slack)
+{
+    if (event.endSecond < incident.start || event.second > incident.end + slack) {
+        return false;
+    }
+    if (incident.tags.isEmpty()) {
+        return true;
+    }
+    return std::any_of(event.tags.cbegin(), event.tags.cend(), [&incident](const QString &tag) {
+        return incident.tags.contains(tag);
+    });
+}
+
+// Nearest-rank percentile of sorted samples.
+qint64 percentile(const QVector<qint64> &sorted, double q)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    const int rank = int(std::ceil(q * sorted.size()));
+    return sorted.at(std::clamp(rank - 1, 0, int(sorted.size()) - 1));
+}
+
+double perSecond(qint64 count, qint64 nsecs)
+{
+    return nsecs > 0 ? count * 1e9 / nsecs : 0.0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("ReplayBench"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Replays a pcap through Statistics and the anomaly detector."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("pcap"), QStringLiteral("Capture to replay."));
+    const QCommandLineOption labelsOption(QStringLiteral("labels"),
+                                          QStringLiteral("Incident labels to score events against."),
+                                          QStringLiteral("file"));
+    const QCommandLineOption rulesOption(QStringLiteral("rules"),
+                                         QStringLiteral("Anomaly rules instead of the built-in ones."),
+                                         QStringLiteral("file"));
+    const QCommandLineOption baselinesOption(QStringLiteral("baselines"),
+                                             QStringLiteral("Seasonal baselines to start from instead of none."),
+                                             QStringLiteral("file"));
+    const QCommandLineOption slackOption(QStringLiteral("slack"),
+                                         QStringLiteral("Seconds after an incident an event still detects it."),
+                                         QStringLiteral("seconds"),
+                                         QString::number(kDefaultSlackSeconds));
+    const QCommandLineOption cooldownOption(QStringLiteral("cooldown"),
+                                            QStringLiteral("Quiet seconds that close an incident; 0 keeps seconds apart."),
+                                            QStringLiteral("seconds"),
+                                            QString::number(IncidentCoalescer::kDefaultCooldownSeconds));
+    const QCommandLineOption jsonOption(QStringLiteral("json"), QStringLiteral("Print the report as JSON."));
+    parser.addOptions({labelsOption, rulesOption, baselinesOption, slackOption, cooldownOption, jsonOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+    const QString pcapPath = parser.positionalArguments().first();
+    const int slack = std::max(0, parser.value(slackOption).toInt());
+
+    QString error;
+    QVector<Incident> incidents;
+    if (parser.isSet(labelsOption) && !readIncidents(parser.value(labelsOption), incidents, &error)) {
+        err << "Cannot read labels " << parser.value(labelsOption) << ": " << error << Qt::endl;
+        return 1;
+    }
+    // The detector only warns about a broken rules file; a benchmark should not
+    // quietly fall back to the defaults.
+    const QString rulesPath = parser.value(rulesOption);
+    if (!rulesPath.isEmpty()) {
+        QFile file(rulesPath);
+        AnomalyRules rules;
+        if (!file.open(QIODevice::ReadOnly) || !rules.load(file.readAll(), &error)) {
+            err << "Cannot use rules " << rulesPath << ": "
+                << (error.isEmpty() ? file.errorString() : error) << Qt::endl;
+            return 1;
+        }
+    }
+
+    QVector<CapturedPacket> packets;
+    if (!readPackets(pcapPath, packets, &error)) {
+        err << "Cannot read " << pcapPath << ": " << error << Qt::endl;
+        return 1;
+    }
+    if (packets.isEmpty()) {
+        err << pcapPath << " holds no packets" << Qt::endl;
+        return 1;
+    }
+
+    // Decoding and the detector path are timed apart, so a change to either
+    // shows up on its own.
+    Sniffing sniffing;
+    QVector<DecodedPacket> decoded;
+    decoded.reserve(packets.size());
+    QElapsedTimer timer;
+    timer.start();
+    for (const CapturedPacket &packet : packets) {
+        const u_char *raw = reinterpret_cast<const u_char *>(packet.data.constData());
+        const QStringList parts = sniffing.packetSummary(raw, packet.data.size(), packet.linkType);
+        const TransportPorts ports = transportPorts(raw, packet.linkType);
+        DecodedPacket record;
+        record.timestamp = QDateTime::fromMSecsSinceEpoch(
+            packet.timestampSec * 1000 + packet.timestampUsec / 1000, QTimeZone::UTC);
+        record.protocol = parts.value(2);
+        record.source = parts.value(0);
+        record.destination = parts.value(1);
+        record.size = quint64(packet.data.size());
+        record.detail.srcPort = ports.srcPort;
+        record.detail.dstPort = ports.dstPort;
+        record.detail.tcpFlags = ports.tcpFlags;
+        record.detail.dns = DnsAnalytics::message(sniffing.parseDns(raw, packet.linkType));
+        record.detail.microseconds = quint16(packet.timestampUsec % 1000);
+        decoded.append(record);
+    }
+    const qint64 decodeNs = timer.nsecsElapsed();
+    packets.clear();
+    packets.squeeze();
+
+    const QDateTime sessionStart = decoded.first().timestamp;
+    const qint64 startMs = sessionStart.toMSecsSinceEpoch();
+    Statistics statistics(sessionStart);
+    statistics.setAnomalyRulesPath(rulesPath);
+    statistics.setIncidentCooldown(parser.value(cooldownOption).toInt());
+    if (!statistics.loadSeasonalBaselines(parser.value(baselinesOption))) {
+        err << "Cannot read baselines " << parser.value(baselinesOption) << Qt::endl;
+        return 1;
+    }
+
+    // A second is finalized by the first packet of a later one; those calls
+    // are timed on their own.
+    QVector<qint64> finalizeNs;
+    int activeSecond = -1;
+    QElapsedTimer packetTimer;
+    timer.restart();
+    for (int row = 0; row < decoded.size(); ++row) {
+        const DecodedPacket &packet = decoded.at(row);
+        const int second = int((packet.timestamp.toMSecsSinceEpoch() - startMs) / 1000);
+        if (second > activeSecond && activeSecond >= 0) {
+            packetTimer.start();
+            statistics.recordPacket(packet.timestamp, packet.protocol, packet.source,
+                                    packet.destination, packet.size, row, packet.detail);
+            finalizeNs.append(packetTimer.nsecsElapsed());
+        } else {
+            statistics.recordPacket(packet.timestamp, packet.protocol, packet.source,
+                                    packet.destination, packet.size, row, packet.detail);
+        }
+        activeSecond = std::max(activeSecond, second);
+    }
+    packetTimer.start();
+    statistics.finalizePendingData();
+    finalizeNs.append(packetTimer.nsecsElapsed());
+    const qint64 detectorNs = timer.nsecsElapsed();
+    std::sort(finalizeNs.begin(), finalizeNs.end());
+
+    const QVector<AnomalyDetector::Event> &events = statistics.anomalies();
+    int truePositives = 0;
+    for (const AnomalyDetector::Event &event : events) {
+        bool matched = false;
+        for (Incident &incident : incidents) {
+            if (matches(incident, event, slack)) {
+                matched = true;
+                if (incident.firstEvent < 0) {
+                    incident.firstEvent = std::max(event.second, incident.start);
+                }
+            }
+        }
+        truePositives += matched ? 1 : 0;
+    }
+    int detected = 0;
+    double delaySum = 0.0;
+    for (const Incident &incident : incidents) {
+        if (incident.firstEvent >= 0) {
+            ++detected;
+            delaySum += incident.firstEvent - incident.start;
+        }
+    }
+    const double precision = events.isEmpty() ? 0.0 : double(truePositives) / events.size();
+    const double recall = incidents.isEmpty() ? 0.0 : double(detected) / incidents.size();
+    const double meanDelay = detected > 0 ? delaySum / detected : 0.0;
+    const qint64 packetCount = decoded.size();
+
+    QTextStream out(stdout);
+    if (parser.isSet(jsonOption)) {
+        QJsonObject report;
+        report.insert(QStringLiteral("pcap"), pcapPath);
+        report.insert(QStringLiteral("packets"), packetCount);
+        report.insert(QStringLiteral("seconds"), activeSecond + 1);
+        report.insert(QStringLiteral("decodePps"), perSecond(packetCount, decodeNs));
+        report.insert(QStringLiteral("detectorPps"), perSecond(packetCount, detectorNs));
+        report.insert(QStringLiteral("endToEndPps"), perSecond(packetCount, decodeNs + detectorNs));
+        QJsonObject finalize;
+        finalize.insert(QStringLiteral("p50Us"), percentile(finalizeNs, 0.5) / 1000.0);
+        finalize.insert(QStringLiteral("p90Us"), percentile(finalizeNs, 0.9) / 1000.0);
+        finalize.insert(QStringLiteral("p99Us"), percentile(finalizeNs, 0.99) / 1000.0);
+        finalize.insert(QStringLiteral("maxUs"), finalizeNs.last() / 1000.0);
+        report.insert(QStringLiteral("finalize"), finalize);
+        report.insert(QStringLiteral("events"), int(events.size()));
+        if (!incidents.isEmpty()) {
+            report.insert(QStringLiteral("truePositives"), truePositives);
+            report.insert(QStringLiteral("incidents"), int(incidents.size()));
+            report.insert(QStringLiteral("detected"), detected);
+            report.insert(QStringLiteral("precision"), precision);
+            report.insert(QStringLiteral("recall"), recall);
+            report.insert(QStringLiteral("meanDelaySeconds"), meanDelay);
+        }
+        out << QJsonDocument(report).toJson();
+        return 0;
+    }
+
+    out << pcapPath << ": " << packetCount << " packets over " << activeSecond + 1 << " s" << Qt::endl;
+    out << QStringLiteral("decode      %1 s  %2 pps")
+               .arg(decodeNs / 1e9, 0, 'f', 3)
+               .arg(perSecond(packetCount, decodeNs), 0, 'f', 0)
+        << Qt::endl;
+    out << QStringLiteral("detector    %1 s  %2 pps")
+               .arg(detectorNs / 1e9, 0, 'f', 3)
+               .arg(perSecond(packetCount, detectorNs), 0, 'f', 0)
+        << Qt::endl;
+    out << QStringLiteral("end to end  %1 pps").arg(perSecond(packetCount, decodeNs + detectorNs), 0, 'f', 0)
+        << Qt::endl;
+    out << QStringLiteral("finalize    p50 %1 µs  p90 %2 µs  p99 %3 µs  max %4 µs")
+               .arg(percentile(finalizeNs, 0.5) / 1000.0, 0, 'f', 1)
+               .arg(percentile(finalizeNs, 0.9) / 1000.0, 0, 'f', 1)
+               .arg(percentile(finalizeNs, 0.99) / 1000.0, 0, 'f', 1)
+               .arg(finalizeNs.last() / 1000.0, 0, 'f', 1)
+        << Qt::endl;
+    out << "events      " << events.size() << Qt::endl;
+    if (!incidents.isEmpty()) {
+        out << QStringLiteral("precision   %1 (%2/%3)")
+                   .arg(precision, 0, 'f', 2)
+                   .arg(truePositives)
+                   .arg(events.size())
+            << Qt::endl;
+        out << QStringLiteral("recall      %1 (%2/%3), first event after %4 s on average")
+                   .arg(recall, 0, 'f', 2)
+                   .arg(detected)
+                   .arg(incidents.size())
+                   .arg(meanDelay, 0, 'f', 1)
+            << Qt::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef FLOWKEY_H
+#define FLOWKEY_H
+
+#include <QtGlobal>
+#include <cstring>
+
+// Fixed-size, direction-normalised 5-tuple. Both directions of a conversation
+// produce the same key: endpoint A is the numerically smaller address (port as
+// tie-breaker). The hash is computed once when the key is built so table
+// lookups and capture sharding never rehash the tuple.
+struct FlowKey {
+    quint8 addressA[16] = {};
+    quint8 addressB[16] = {};
+    quint16 portA = 0;
+    quint16 portB = 0;
+    quint8 protocol = 0;
+    quint8 ipVersion = 0;
+    quint16 padding = 0;
+    quint32 hash = 0;
+
+    // addressLength is 4 for IPv4 and 16 for IPv6. srcIsA (optional) reports
+    // whether the source endpoint became endpoint A.
+    static FlowKey make(int ipVersion,
+                        quint8 protocol,
+                        const quint8 *src,
+                        quint16 srcPort,
+                        const quint8 *dst,
+                        quint16 dstPort,
+                        int addressLength,
+                        bool *srcIsA = nullptr)
+    {
+        FlowKey key;
+        const int len = qBound(0, addressLength, 16);
+        const int order = std::memcmp(src, dst, size_t(len));
+        const bool srcFirst = order < 0 || (order == 0 && srcPort <= dstPort);
+
+        std::memcpy(key.addressA, srcFirst ? src : dst, size_t(len));
+        std::memcpy(key.addressB, srcFirst ? dst : src, size_t(len));
+        key.portA = srcFirst ? srcPort : dstPort;
+        key.portB = srcFirst ? dstPort : srcPort;
+        key.protocol = protocol;
+        key.ipVersion = quint8(ipVersion);
+        key.hash = computeHash(key);
+        if (srcIsA)
+            *srcIsA = srcFirst;
+        return key;
+    }
+
+    int addressLength() const { return ipVersion == 6 ? 16 : 4; }
+
+    // Stable shard assignment for fanning flows out over worker queues; both
+    // directions of a flow always land on the same shard.
+    int shardIndex(int shardCount) const
+    {
+        return shardCount > 1 ? int(hash % quint32(shardCount)) : 0;
+    }
+
+    bool operator==(const FlowKey &other) const
+    {
+        return hash == other.hash
+            && std::memcmp(this, &other, kTupleBytes) == 0;
+    }
+    bool operator!=(const FlowKey &other) const { return !(*this == other); }
+
+private:
+    static constexpr size_t kTupleBytes = 40; // everything before the hash
+
+    static quint64 mix(quint64 value)
+    {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    static quint32 computeHash(const FlowKey &key)
+    {
+        quint64 words[kTupleBytes / sizeof(quint64)];
+        std::memcpy(words, &key, kTupleBytes);
+        quint64 h = 0x9e3779b97f4a7c15ULL;
+        for (quint64 word : words)
+            h = mix(h ^ word) + 0x9e3779b97f4a7c15ULL;
+        return quint32(h ^ (h >> 32));
+    }
+};
+
+static_assert(sizeof(FlowKey) == 44, "FlowKey must stay a packed 44-byte tuple");
+
+#endif // FLOWKEY_H
@@ -0,0 +1,230 @@
+#ifndef FLOWTABLE_H
+#define FLOWTABLE_H
+
+#include "flowkey.h"
+
+#include <QVector>
+#include <QtGlobal>
+#include <utility>
+
+// Open-addressing hash table keyed by FlowKey. Values live densely in one
+// vector (cheap iteration, no per-node allocation); the probe array only holds
+// the precomputed hash and an index, so a lookup touches one small slot array
+// and a single entry. Linear probing with backward-shift deletion keeps probe
+// chains short without tombstones. Entries are also threaded on an intrusive
+// recency list so the least recently used flow can be found in O(1).
+template <typename T>
+class FlowTable {
+public:
+    struct Entry {
+        FlowKey key;
+        T value;
+    };
+
+    FlowTable() { resizeSlots(kInitialCapacity); }
+
+    int size() const { return m_entries.size(); }
+    bool isEmpty() const { return m_entries.isEmpty(); }
+
+    int indexOf(const FlowKey &key) const
+    {
+        quint32 pos = key.hash & m_mask;
+        while (true) {
+            const Slot &slot = m_slots.at(int(pos));
+            if (slot.index < 0)
+                return -1;
+            if (slot.hash == key.hash && m_entries.at(slot.index).key == key)
+                return slot.index;
+            pos = (pos + 1) & m_mask;
+        }
+    }
+
+    T *find(const FlowKey &key)
+    {
+        const int index = indexOf(key);
+        return index < 0 ? nullptr : &m_entries[index].value;
+    }
+
+    const T *find(const FlowKey &key) const
+    {
+        const int index = indexOf(key);
+        return index < 0 ? nullptr : &m_entries.at(index).value;
+    }
+
+    // Returns the value for key, default-constructing it when missing, and marks
+    // it most recently used. The reference stays valid until the next insertion
+    // or removal.
+    T &findOrInsert(const FlowKey &key, bool *inserted = nullptr)
+    {
+        if ((m_entries.size() + 1) * 10 > m_slots.size() * 7)
+            resizeSlots(m_slots.size() * 2);
+
+        quint32 pos = key.hash & m_mask;
+        while (true) {
+            Slot &slot = m_slots[int(pos)];
+            if (slot.index < 0) {
+                slot.hash = key.hash;
+                slot.index = m_entries.size();
+                m_entries.append(Entry{key, T()});
+                m_links.append(Link());
+                linkNewest(slot.index);
+                if (inserted)
+                    *inserted = true;
+                return m_entries.last().value;
+            }
+            if (slot.hash == key.hash && m_entries.at(slot.index).key == key) {
+                if (inserted)
+                    *inserted = false;
+                touch(slot.index);
+                return m_entries[slot.index].value;
+            }
+            pos = (pos + 1) & m_mask;
+        }
+    }
+
+    bool remove(const FlowKey &key)
+    {
+        const int index = indexOf(key);
+        if (index < 0)
+            return false;
+        removeAt(index);
+        return true;
+    }
+
+    // Removes the entry at a dense index. The last entry is moved into the
+    // gap, so indices of other entries may change.
+    void removeAt(int index)
+    {
+        if (index < 0 || index >= m_entries.size())
+            return;
+
+        eraseSlot(slotFor(index));
+        unlink(index);
+
+        const int last = m_entries.size() - 1;
+        if (index != last) {
+            m_slots[int(slotFor(last))].index = index;
+            m_entries[index] = std::move(m_entries[last]);
+
+            const Link moved = m_links.at(last);
+            m_links[index] = moved;
+            if (moved.older >= 0)
+                m_links[moved.older].newer = index;
+            else
+                m_oldest = index;
+            if (moved.newer >= 0)
+                m_links[moved.newer].older = index;
+            else
+                m_newest = index;
+        }
+        m_entries.removeLast();
+        m_links.removeLast();
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_links.clear();
+        m_oldest = -1;
+        m_newest = -1;
+        resizeSlots(kInitialCapacity);
+    }
+
+    void touch(int index)
+    {
+        if (index < 0 || index >= m_entries.size() || index == m_newest)
+            return;
+        unlink(index);
+        linkNewest(index);
+    }
+
+    // Dense index of the least recently used entry, -1 when empty.
+    int leastRecentIndex() const { return m_oldest; }
+
+    Entry &entryAt(int index) { return m_entries[index]; }
+    const Entry &entryAt(int index) const { return m_entries.at(index); }
+
+    typename QVector<Entry>::iterator begin() { return m_entries.begin(); }
+    typename QVector<Entry>::iterator end() { return m_entries.end(); }
+    typename QVector<Entry>::const_iterator begin() const { return m_entries.cbegin(); }
+    typename QVector<Entry>::const_iterator end() const { return m_entries.cend(); }
+
+private:
+    struct Slot {
+        quint32 hash = 0;
+        qint32 index = -1;
+    };
+
+    struct Link {
+        qint32 older = -1;
+        qint32 newer = -1;
+    };
+
+    static constexpr int kInitialCapacity = 64;
+
+    void unlink(int index)
+    {
+        const Link link = m_links.at(index);
+        if (link.older >= 0)
+            m_links[link.older].newer = link.newer;
+        else
+            m_oldest = link.newer;
+        if (link.newer >= 0)
+            m_links[link.newer].older = link.older;
+        else
+            m_newest = link.older;
+    }
+
+    void linkNewest(int index)
+    {
+        m_links[index] = Link{m_newest, -1};
+        if (m_newest >= 0)
+            m_links[m_newest].newer = index;
+        else
+            m_oldest = index;
+        m_newest = index;
+    }
+
+    quint32 slotFor(int entryIndex) const
+    {
+        quint32 pos = m_entries.at(entryIndex).key.hash & m_mask;
+        while (m_slots.at(int(pos)).index != entryIndex)
+            pos = (pos + 1) & m_mask;
+        return pos;
+    }
+
+    void eraseSlot(quint32 hole)
+    {
+        quint32 next = (hole + 1) & m_mask;
+        while (m_slots.at(int(next)).index >= 0) {
+            const quint32 ideal = m_slots.at(int(next)).hash & m_mask;
+            if (((next - ideal) & m_mask) >= ((next - hole) & m_mask)) {
+                m_slots[int(hole)] = m_slots.at(int(next));
+                hole = next;
+            }
+            next = (next + 1) & m_mask;
+        }
+        m_slots[int(hole)] = Slot();
+    }
+
+    void resizeSlots(int capacity)
+    {
+        m_slots.fill(Slot(), capacity);
+        m_mask = quint32(capacity - 1);
+        for (int i = 0; i < m_entries.size(); ++i) {
+            quint32 pos = m_entries.at(i).key.hash & m_mask;
+            while (m_slots.at(int(pos)).index >= 0)
+                pos = (pos + 1) & m_mask;
+            m_slots[int(pos)] = Slot{m_entries.at(i).key.hash, qint32(i)};
+        }
+    }
+
+    QVector<Slot> m_slots;
+    QVector<Entry> m_entries;
+    QVector<Link> m_links;
+    qint32 m_oldest = -1;
+    qint32 m_newest = -1;
+    quint32 m_mask = 0;
+};
+
+#endif // FLOWTABLE_H
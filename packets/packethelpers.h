@@ -185,6 +185,44 @@ inline UdpDatagramView udpDatagramView(const u_char* pkt, int linkType) {
     return view;
 }
 
+// Ports of a TCP or UDP packet plus the TCP flags; all zero for anything
+// else.
+struct TransportPorts {
+    uint16_t srcPort = 0;
+    uint16_t dstPort = 0;
+    uint8_t tcpFlags = 0;
+};
+
+inline TransportPorts transportPorts(const u_char* pkt, int linkType) {
+    TransportPorts ports;
+    const sniff_tcp *tcp = nullptr;
+    const sniff_udp *udp = nullptr;
+    uint16_t type = ethType(pkt, linkType);
+    if (type == ETHERTYPE_IP) {
+        auto ip = ipv4Hdr(pkt, linkType);
+        if (ip->ip_p == IPPROTO_TCP)
+            tcp = tcpHdr(pkt, linkType);
+        else if (ip->ip_p == IPPROTO_UDP)
+            udp = udpHdr(pkt, linkType);
+    }
+    else if (type == ETHERTYPE_IPV6) {
+        auto ip6 = ipv6Hdr(pkt, linkType);
+        if (ip6->ip6_nxt == IPPROTO_TCP)
+            tcp = tcp6Hdr(pkt, linkType);
+        else if (ip6->ip6_nxt == IPPROTO_UDP)
+            udp = udp6Hdr(pkt, linkType);
+    }
+    if (tcp) {
+        ports.srcPort = ntohs(tcp->th_sport);
+        ports.dstPort = ntohs(tcp->th_dport);
+        ports.tcpFlags = tcp->th_flags;
+    } else if (udp) {
+        ports.srcPort = ntohs(udp->uh_sport);
+        ports.dstPort = ntohs(udp->uh_dport);
+    }
+    return ports;
+}
+
 // MAC → QString
 inline QString macToStr(const u_char *a) {
     return QString("%1:%2:%3:%4:%5:%6")
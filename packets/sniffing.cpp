@@ -6,6 +6,9 @@
 #include <QBitArray>
 #include <linux/if_packet.h>
 #include <QSet>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <algorithm>
 #include <netinet/in.h>
 
@@ -235,56 +238,299 @@ QString decodeDnsName(const uint8_t *data, int length, int offset, int &nextOffs
     return labels.join(QLatin1Char('.'));
 }
 
-QString makeStreamKey(int ipVersion,
-                      quint8 protocol,
-                      const QByteArray &addrA,
-                      quint16 portA,
-                      const QByteArray &addrB,
-                      quint16 portB)
+QString ipBytesToString(const quint8 *addr, int ipVersion)
 {
-    return QStringLiteral("%1|%2|%3|%4|%5|%6")
-        .arg(protocol)
-        .arg(ipVersion)
-        .arg(QString::fromLatin1(addrA.toHex().toUpper()))
-        .arg(portA)
-        .arg(QString::fromLatin1(addrB.toHex().toUpper()))
-        .arg(portB);
+    if (!addr)
+        return QStringLiteral("-");
+
+    char buffer[INET6_ADDRSTRLEN] = {0};
+    const int family = ipVersion == 6 ? AF_INET6 : AF_INET;
+    if (inet_ntop(family, addr, buffer, sizeof(buffer)))
+        return QString::fromLatin1(buffer);
+    return QStringLiteral("-");
 }
 
-QString ipBytesToString(const QByteArray &addr, int ipVersion)
+constexpr qint64 kDefaultReassemblyBudget = 64LL * 1024 * 1024;
+// Largest part of a stream buffer that an append after a copy duplicates.
+constexpr int kStreamChunkBytes = 64 * 1024;
+
+TcpReassembler::DataSink makeStreamSink(Sniffing::StreamConversation &conversation, bool fromAtoB)
 {
-    if (addr.isEmpty())
-        return QStringLiteral("-");
+    return [&conversation, fromAtoB](const QByteArray &data, quint64 offset) {
+        if (fromAtoB)
+            conversation.aggregatedAToB.append(data);
+        else
+            conversation.aggregatedBToA.append(data);
+        for (const auto &handler : Sniffing::streamDataHandlers)
+            handler(conversation, fromAtoB, data, offset);
+    };
+}
 
-    char buffer[INET6_ADDRSTRLEN] = {0};
-    switch (ipVersion) {
-        case 6:
-            if (addr.size() >= int(sizeof(in6_addr))) {
-                if (inet_ntop(AF_INET6,
-                              reinterpret_cast<const void*>(addr.constData()),
-                              buffer,
-                              sizeof(buffer)))
-                    return QString::fromLatin1(buffer);
-            }
-            break;
-        default:
-            if (addr.size() >= int(sizeof(in_addr))) {
-                if (inet_ntop(AF_INET,
-                              reinterpret_cast<const void*>(addr.constData()),
-                              buffer,
-                              sizeof(buffer)))
-                    return QString::fromLatin1(buffer);
-            }
-            break;
+qint64 reassemblyBuffered(const Sniffing::StreamConversation &conversation)
+{
+    return conversation.reassemblyAToB.bufferedBytes()
+         + conversation.reassemblyBToA.bufferedBytes();
+}
+
+void flushReassembly(Sniffing::StreamConversation &conversation)
+{
+    conversation.reassemblyAToB.flush(makeStreamSink(conversation, true));
+    conversation.reassemblyBToA.flush(makeStreamSink(conversation, false));
+}
+
+// Brings the global total and the index up to date with the flow's queues.
+// Called after every change to them, so neither ever needs a table scan.
+void refreshReassemblyBytes(Sniffing::StreamConversation &conversation)
+{
+    const qint64 buffered = reassemblyBuffered(conversation);
+    if (buffered == conversation.reassemblyBytes)
+        return;
+    auto &index = Sniffing::reassemblyIndex;
+    if (conversation.reassemblyBytes > 0)
+        index.erase({conversation.reassemblyBytes, conversation.id});
+    if (buffered > 0)
+        index.insert({buffered, conversation.id});
+    Sniffing::reassemblyBytesInUse += buffered - conversation.reassemblyBytes;
+    conversation.reassemblyBytes = buffered;
+}
+
+// Heap bytes held by one flow. The per-direction totals equal the payload
+// copies kept in the segment list.
+qint64 conversationFootprint(const Sniffing::StreamConversation &conversation)
+{
+    return qint64(sizeof(Sniffing::StreamConversation))
+         + qint64(conversation.segments.size()) * qint64(sizeof(Sniffing::StreamSegment))
+         + conversation.totalBytesAToB + conversation.totalBytesBToA
+         + conversation.aggregatedAToB.size() + conversation.aggregatedBToA.size()
+         + reassemblyBuffered(conversation);
+}
+
+void refreshFootprint(Sniffing::StreamConversation &conversation)
+{
+    const qint64 footprint = conversationFootprint(conversation);
+    Sniffing::streamStats.bytesInUse += footprint - conversation.memoryBytes;
+    conversation.memoryBytes = footprint;
+}
+
+// Keeps only the newest change-log entry of every live flow. Entries stay in
+// revision order, so streamChangesSince() can still binary-search the log.
+void compactStreamChangeLog()
+{
+    auto &log = Sniffing::streamChangeLog;
+    int kept = 0;
+    for (int i = 0; i < log.size(); ++i) {
+        const auto key = Sniffing::streamIdIndex.constFind(log.at(i).id);
+        if (key == Sniffing::streamIdIndex.cend())
+            continue;
+        const auto *conversation = Sniffing::streamConversations.find(key.value());
+        if (!conversation || conversation->loggedRevision != log.at(i).revision)
+            continue;
+        log[kept++] = log.at(i);
     }
-    return QStringLiteral("-");
+    log.resize(kept);
+}
+
+// A flow is logged at most once between two streamChangesSince() calls: an
+// entry newer than the last served revision is already newer than any cursor
+// a consumer can hold.
+void markStreamChanged(Sniffing::StreamConversation &conversation)
+{
+    conversation.revision = ++Sniffing::streamRevision;
+    if (conversation.loggedRevision > Sniffing::streamServedRevision)
+        return;
+
+    conversation.loggedRevision = conversation.revision;
+    Sniffing::streamChangeLog.append({conversation.revision, conversation.id});
+    if (Sniffing::streamChangeLog.size() > 2 * Sniffing::streamConversations.size() + 1024)
+        compactStreamChangeLog();
+}
+
+constexpr int kMaxStreamRemovals = 64 * 1024;
+
+void markStreamRemoved(const Sniffing::StreamConversation &conversation)
+{
+    Sniffing::streamIdIndex.remove(conversation.id);
+    auto &removals = Sniffing::streamRemovalLog;
+    removals.append({++Sniffing::streamRevision, conversation.id});
+    if (removals.size() > kMaxStreamRemovals) {
+        // Consumers older than the dropped entries have to resynchronise.
+        const int dropped = removals.size() / 2;
+        Sniffing::streamRemovalFloor = removals.at(dropped - 1).revision;
+        removals.remove(0, dropped);
+    }
+}
+
+// Out-of-order data is the only unbounded part of reassembly. When the global
+// budget is exceeded, the flows holding the most queued bytes drop them and
+// carry on past their holes, so every eviction frees what it counts.
+void enforceReassemblyBudget()
+{
+    auto &index = Sniffing::reassemblyIndex;
+    while (Sniffing::reassemblyBytesInUse > Sniffing::reassemblyBudgetBytes && !index.empty()) {
+        const quint64 id = index.rbegin()->second;
+        const auto key = Sniffing::streamIdIndex.constFind(id);
+        auto *largest = key != Sniffing::streamIdIndex.cend()
+                            ? Sniffing::streamConversations.find(key.value())
+                            : nullptr;
+        if (!largest) {
+            Sniffing::reassemblyBytesInUse -= index.rbegin()->first;
+            index.erase(std::prev(index.end()));
+            continue;
+        }
+        largest->reassemblyAToB.discard();
+        largest->reassemblyBToA.discard();
+        refreshReassemblyBytes(*largest);
+        ++Sniffing::reassemblyEvictions;
+        refreshFootprint(*largest);
+        markStreamChanged(*largest);
+    }
+}
+
+enum class StreamExpiry {
+    Closed,
+    IdleTimeout,
+    ActiveTimeout,
+    MemoryBudget
+};
+
+QString expiryName(StreamExpiry reason)
+{
+    switch (reason) {
+        case StreamExpiry::Closed:        return QStringLiteral("closed");
+        case StreamExpiry::IdleTimeout:   return QStringLiteral("idle");
+        case StreamExpiry::ActiveTimeout: return QStringLiteral("active");
+        case StreamExpiry::MemoryBudget:  return QStringLiteral("budget");
+    }
+    return QString();
+}
+
+QByteArray spillRecord(const Sniffing::StreamConversation &conversation, StreamExpiry reason)
+{
+    QJsonObject endpointA;
+    endpointA.insert("address", conversation.endpointA.address);
+    endpointA.insert("port", conversation.endpointA.port);
+    QJsonObject endpointB;
+    endpointB.insert("address", conversation.endpointB.address);
+    endpointB.insert("port", conversation.endpointB.port);
+
+    QJsonObject obj;
+    obj.insert("protocol", conversation.protocolName());
+    obj.insert("ipVersion", conversation.ipVersion);
+    obj.insert("endpointA", endpointA);
+    obj.insert("endpointB", endpointB);
+    obj.insert("initiatorIsA", conversation.initiatorIsA);
+    obj.insert("firstTimestamp", double(conversation.firstTimestampSec)
+                                 + double(conversation.firstTimestampUsec) / 1'000'000.0);
+    obj.insert("lastTimestamp", double(conversation.lastTimestampSec)
+                                + double(conversation.lastTimestampUsec) / 1'000'000.0);
+    obj.insert("packets", conversation.packetCount);
+    obj.insert("bytesAToB", double(conversation.totalBytesAToB));
+    obj.insert("bytesBToA", double(conversation.totalBytesBToA));
+    obj.insert("reason", expiryName(reason));
+    obj.insert("closed", conversation.isClosed());
+    obj.insert("dataAToB", QString::fromLatin1(conversation.aggregatedAToB.toByteArray().toBase64()));
+    obj.insert("dataBToA", QString::fromLatin1(conversation.aggregatedBToA.toByteArray().toBase64()));
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n';
+}
+
+// Removes the flow at a dense table index. Queued out-of-order data is
+// delivered first so stream handlers and the spill file see every byte.
+void dropConversation(int index, StreamExpiry reason, QByteArray *spill)
+{
+    auto &conversation = Sniffing::streamConversations.entryAt(index).value;
+    flushReassembly(conversation);
+    refreshReassemblyBytes(conversation);
+
+    if (spill && !Sniffing::streamSpillFile.isEmpty()) {
+        spill->append(spillRecord(conversation, reason));
+        ++Sniffing::streamStats.spilledFlows;
+    }
+
+    auto &stats = Sniffing::streamStats;
+    stats.bytesInUse -= conversation.memoryBytes;
+    if (reason == StreamExpiry::MemoryBudget) {
+        ++stats.evictedFlows;
+        stats.evictedBytes += quint64(conversation.memoryBytes);
+    } else {
+        ++stats.expiredFlows;
+        stats.expiredBytes += quint64(conversation.memoryBytes);
+    }
+    markStreamRemoved(conversation);
+    Sniffing::streamConversations.removeAt(index);
+}
+
+// Walks the table from the back so removeAt() only ever moves entries that
+// were already checked into the freed slot.
+void expireStreams(qint64 now, QByteArray *spill)
+{
+    const auto &limits = Sniffing::streamLimitsConfig;
+    for (int i = Sniffing::streamConversations.size() - 1; i >= 0; --i) {
+        const auto &conversation = Sniffing::streamConversations.entryAt(i).value;
+        const qint64 idle = now - conversation.lastTimestampSec;
+        const qint64 age = now - conversation.firstTimestampSec;
+        if (conversation.isClosed() && limits.closedTimeoutSec > 0
+            && idle >= limits.closedTimeoutSec)
+            dropConversation(i, StreamExpiry::Closed, spill);
+        else if (limits.idleTimeoutSec > 0 && idle >= limits.idleTimeoutSec)
+            dropConversation(i, StreamExpiry::IdleTimeout, spill);
+        else if (limits.activeTimeoutSec > 0 && age >= limits.activeTimeoutSec)
+            dropConversation(i, StreamExpiry::ActiveTimeout, spill);
+    }
+}
+
+void enforceStreamBudget(QByteArray *spill)
+{
+    const qint64 budget = Sniffing::streamLimitsConfig.memoryBudgetBytes;
+    if (budget <= 0)
+        return;
+    while (Sniffing::streamStats.bytesInUse > budget && !Sniffing::streamConversations.isEmpty())
+        dropConversation(Sniffing::streamConversations.leastRecentIndex(),
+                         StreamExpiry::MemoryBudget,
+                         spill);
+}
+
+void appendSpill(const QString &path, const QByteArray &records)
+{
+    if (path.isEmpty() || records.isEmpty())
+        return;
+
+    QMutexLocker locker(&Sniffing::streamSpillMutex);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning("Failed to open stream spill file: %s", qPrintable(path));
+        return;
+    }
+    if (file.write(records) != records.size())
+        qWarning("Short write to stream spill file: %s", qPrintable(path));
 }
 }
 
 Sniffing::Sniffing() {}
 Sniffing::~Sniffing() {}
 
-QString Sniffing::StreamConversation::protocolName() const
+void Sniffing::StreamBuffer::append(const QByteArray &data)
+{
+    m_tail.append(data);
+    m_size += data.size();
+    if (m_tail.size() >= kStreamChunkBytes) {
+        m_chunks.append(m_tail);
+        m_tail = QByteArray();
+    }
+}
+
+QByteArray Sniffing::StreamBuffer::toByteArray() const
+{
+    if (m_chunks.isEmpty())
+        return m_tail;
+    QByteArray result;
+    result.reserve(m_size);
+    for (const QByteArray &chunk : m_chunks)
+        result.append(chunk);
+    result.append(m_tail);
+    return result;
+}
+
+QString Sniffing::StreamSummary::protocolName() const
 {
     switch (protocol) {
         case IPPROTO_TCP:
@@ -300,7 +546,7 @@ QString Sniffing::StreamConversation::protocolName() const
     }
 }
 
-QString Sniffing::StreamConversation::label() const
+QString Sniffing::StreamSummary::label() const
 {
     return QStringLiteral("%1 %2:%3 ⇄ %4:%5")
         .arg(protocolName())
@@ -317,12 +563,15 @@ void Sniffing::packet_callback(u_char *args,
     auto *worker = reinterpret_cast<PacketWorker*>(args);
     QByteArray raw(reinterpret_cast<const char*>(packet),
                    header->caplen);
+    capturedPackets.fetch_add(1, std::memory_order_relaxed);
+    capturedBytes.fetch_add(header->len, std::memory_order_relaxed);
 
     CapturedPacket captured{raw,
                             worker ? worker->linkType() : DLT_EN10MB,
                             header->ts.tv_sec,
                             header->ts.tv_usec};
-    Sniffing::appendPacket(captured);
+    if (retainPackets.load(std::memory_order_relaxed))
+        Sniffing::appendPacket(captured);
     Sniffing::recordStreamSegment(raw,
                                   captured.linkType,
                                   header->ts.tv_sec,
@@ -330,7 +579,8 @@ void Sniffing::packet_callback(u_char *args,
 
     QStringList infos;
     infos << QString::number(header->ts.tv_sec)
-          << QString::number(header->caplen);
+          << QString::number(header->caplen)
+          << QString::number(header->ts.tv_usec);
 
     emit worker->newPacket(raw, infos, captured.linkType);
 }
@@ -2581,8 +2831,9 @@ void Sniffing::recordStreamSegment(const QByteArray &packet,
     uint16_t ethertype = ethType(pkt, linkType);
 
     int ipVersion = 0;
-    QByteArray srcAddr;
-    QByteArray dstAddr;
+    const quint8 *srcAddr = nullptr;
+    const quint8 *dstAddr = nullptr;
+    int addrLen = 0;
     quint16 srcPort = 0;
     quint16 dstPort = 0;
     quint8 protocol = 0;
@@ -2600,8 +2851,9 @@ void Sniffing::recordStreamSegment(const QByteArray &packet,
         if (!ip)
             return;
         protocol = ip->ip_p;
-        srcAddr = QByteArray(reinterpret_cast<const char*>(&ip->ip_src), sizeof(ip->ip_src));
-        dstAddr = QByteArray(reinterpret_cast<const char*>(&ip->ip_dst), sizeof(ip->ip_dst));
+        srcAddr = reinterpret_cast<const quint8*>(&ip->ip_src);
+        dstAddr = reinterpret_cast<const quint8*>(&ip->ip_dst);
+        addrLen = int(sizeof(ip->ip_src));
     }
     else if (ethertype == ETHERTYPE_IPV6) {
         ipVersion = 6;
@@ -2609,8 +2861,9 @@ void Sniffing::recordStreamSegment(const QByteArray &packet,
         if (!ip6)
             return;
         protocol = ip6->ip6_nxt;
-        srcAddr = QByteArray(reinterpret_cast<const char*>(&ip6->ip6_src), sizeof(ip6->ip6_src));
-        dstAddr = QByteArray(reinterpret_cast<const char*>(&ip6->ip6_dst), sizeof(ip6->ip6_dst));
+        srcAddr = reinterpret_cast<const quint8*>(&ip6->ip6_src);
+        dstAddr = reinterpret_cast<const quint8*>(&ip6->ip6_dst);
+        addrLen = int(sizeof(ip6->ip6_src));
     }
     else {
         return;
@@ -2648,23 +2901,11 @@ void Sniffing::recordStreamSegment(const QByteArray &packet,
             return;
     }
 
-    bool srcFirst = false;
-    if (srcAddr < dstAddr) {
-        srcFirst = true;
-    }
-    else if (srcAddr > dstAddr) {
-        srcFirst = false;
-    }
-    else {
-        srcFirst = srcPort <= dstPort;
-    }
-
-    QByteArray addrA = srcFirst ? srcAddr : dstAddr;
-    QByteArray addrB = srcFirst ? dstAddr : srcAddr;
-    quint16 portA = srcFirst ? srcPort : dstPort;
-    quint16 portB = srcFirst ? dstPort : srcPort;
-    bool fromAtoB = srcFirst;
-    QString key = makeStreamKey(ipVersion, protocol, addrA, portA, addrB, portB);
+    bool fromAtoB = true;
+    const FlowKey key = FlowKey::make(ipVersion, protocol,
+                                      srcAddr, srcPort,
+                                      dstAddr, dstPort,
+                                      addrLen, &fromAtoB);
 
     if (payloadLen < 0)
         payloadLen = 0;
@@ -2684,24 +2925,21 @@ void Sniffing::recordStreamSegment(const QByteArray &packet,
         segment.payload = QByteArray(reinterpret_cast<const char*>(payloadPtr), payloadLen);
 
     QMutexLocker locker(&streamMutex);
-    StreamConversation &conversation = streamConversations[key];
-    const bool isNewConversation = conversation.segments.isEmpty() && conversation.packetCount == 0;
-    conversation.protocol = protocol;
-    conversation.ipVersion = ipVersion;
+    bool isNewConversation = false;
+    StreamConversation &conversation = streamConversations.findOrInsert(key, &isNewConversation);
 
     if (isNewConversation) {
-        conversation.endpointA.address = ipBytesToString(addrA, ipVersion);
-        conversation.endpointA.port = portA;
-        conversation.endpointB.address = ipBytesToString(addrB, ipVersion);
-        conversation.endpointB.port = portB;
+        conversation.id = ++streamNextId;
+        streamIdIndex.insert(conversation.id, key);
+        conversation.protocol = protocol;
+        conversation.ipVersion = ipVersion;
+        conversation.endpointA.address = ipBytesToString(key.addressA, ipVersion);
+        conversation.endpointA.port = key.portA;
+        conversation.endpointB.address = ipBytesToString(key.addressB, ipVersion);
+        conversation.endpointB.port = key.portB;
         conversation.initiatorIsA = fromAtoB;
         conversation.firstTimestampSec = tsSec;
         conversation.firstTimestampUsec = tsUsec;
-    } else {
-        if (conversation.endpointA.address.isEmpty())
-            conversation.endpointA.address = ipBytesToString(addrA, ipVersion);
-        if (conversation.endpointB.address.isEmpty())
-            conversation.endpointB.address = ipBytesToString(addrB, ipVersion);
     }
 
     if (conversation.packetCount == 0 ||
@@ -2720,18 +2958,62 @@ void Sniffing::recordStreamSegment(const QByteArray &packet,
     if (conversation.packetCount == 0)
         conversation.initiatorIsA = fromAtoB;
 
-    if (fromAtoB) {
+    if (fromAtoB)
         conversation.totalBytesAToB += segment.payload.size();
-        if (!segment.payload.isEmpty())
-            conversation.aggregatedAToB.append(segment.payload);
-    } else {
+    else
         conversation.totalBytesBToA += segment.payload.size();
-        if (!segment.payload.isEmpty())
-            conversation.aggregatedBToA.append(segment.payload);
+
+    if (isTcp) {
+        TcpReassembler &reassembler = fromAtoB ? conversation.reassemblyAToB
+                                               : conversation.reassemblyBToA;
+        const auto result = reassembler.addSegment(sequenceNumber,
+                                                   tcpFlags,
+                                                   segment.payload,
+                                                   makeStreamSink(conversation, fromAtoB));
+        segment.retransmission = result == TcpReassembler::SegmentResult::Retransmission;
+        segment.outOfOrder = result == TcpReassembler::SegmentResult::OutOfOrder;
+        if (tcpFlags & TH_FIN) {
+            if (fromAtoB)
+                conversation.finAToB = true;
+            else
+                conversation.finBToA = true;
+        }
+        if (tcpFlags & TH_RST) {
+            conversation.resetSeen = true;
+            flushReassembly(conversation);
+        }
+        refreshReassemblyBytes(conversation);
+    } else if (!segment.payload.isEmpty()) {
+        StreamBuffer &aggregated = fromAtoB ? conversation.aggregatedAToB
+                                            : conversation.aggregatedBToA;
+        const quint64 offset = quint64(aggregated.size());
+        aggregated.append(segment.payload);
+        for (const auto &handler : streamDataHandlers)
+            handler(conversation, fromAtoB, segment.payload, offset);
     }
 
     conversation.segments.append(segment);
     ++conversation.packetCount;
+    refreshFootprint(conversation);
+    markStreamChanged(conversation);
+
+    if (reassemblyBytesInUse > reassemblyBudgetBytes)
+        enforceReassemblyBudget();
+
+    QByteArray spill;
+    if (tsSec > streamClockSec)
+        streamClockSec = tsSec;
+    if (streamClockSec != lastStreamSweepSec) {
+        lastStreamSweepSec = streamClockSec;
+        expireStreams(streamClockSec, &spill);
+    }
+    enforceStreamBudget(&spill);
+    liveFlows.store(streamConversations.size(), std::memory_order_relaxed);
+    liveReassemblyBytes.store(reassemblyBytesInUse, std::memory_order_relaxed);
+
+    const QString spillPath = streamSpillFile;
+    locker.unlock();
+    appendSpill(spillPath, spill);
 }
 
 QVector<Sniffing::StreamConversation> Sniffing::getStreamConversations() const
@@ -2739,8 +3021,8 @@ QVector<Sniffing::StreamConversation> Sniffing::getStreamConversations() const
     QMutexLocker locker(&streamMutex);
     QVector<StreamConversation> result;
     result.reserve(streamConversations.size());
-    for (auto it = streamConversations.constBegin(); it != streamConversations.constEnd(); ++it)
-        result.append(it.value());
+    for (const auto &entry : streamConversations)
+        result.append(entry.value);
 
     std::sort(result.begin(), result.end(), [](const StreamConversation &lhs,
                                                const StreamConversation &rhs) {
@@ -2758,6 +3040,160 @@ void Sniffing::resetStreams()
 {
     QMutexLocker locker(&streamMutex);
     streamConversations.clear();
+    reassemblyBytesInUse = 0;
+    reassemblyIndex.clear();
+    streamStats = StreamTableStats();
+    streamClockSec = 0;
+    lastStreamSweepSec = 0;
+    streamIdIndex.clear();
+    streamChangeLog.clear();
+    streamRemovalLog.clear();
+    streamRemovalFloor = ++streamRevision;
+    liveFlows.store(0, std::memory_order_relaxed);
+    liveReassemblyBytes.store(0, std::memory_order_relaxed);
+}
+
+Sniffing::StreamDelta Sniffing::streamChangesSince(quint64 revision)
+{
+    QMutexLocker locker(&streamMutex);
+    StreamDelta delta;
+    delta.revision = streamRevision;
+    streamServedRevision = streamRevision;
+
+    if (revision < streamRemovalFloor) {
+        delta.reset = true;
+        revision = 0;
+    }
+
+    auto it = std::upper_bound(streamChangeLog.cbegin(), streamChangeLog.cend(), revision,
+                               [](quint64 value, const StreamLogEntry &entry) {
+                                   return value < entry.revision;
+                               });
+    for (; it != streamChangeLog.cend(); ++it) {
+        const auto key = streamIdIndex.constFind(it->id);
+        if (key == streamIdIndex.cend())
+            continue;
+        const StreamConversation *conversation = streamConversations.find(key.value());
+        if (!conversation || conversation->loggedRevision != it->revision)
+            continue;
+        delta.changed.append(*static_cast<const StreamSummary*>(conversation));
+    }
+
+    if (!delta.reset) {
+        auto removed = std::upper_bound(streamRemovalLog.cbegin(), streamRemovalLog.cend(), revision,
+                                        [](quint64 value, const StreamLogEntry &entry) {
+                                            return value < entry.revision;
+                                        });
+        for (; removed != streamRemovalLog.cend(); ++removed)
+            delta.removed.append(removed->id);
+    }
+    return delta;
+}
+
+bool Sniffing::streamConversation(quint64 id, StreamConversation *conversation)
+{
+    QMutexLocker locker(&streamMutex);
+    const auto key = streamIdIndex.constFind(id);
+    if (key == streamIdIndex.cend())
+        return false;
+    const StreamConversation *found = streamConversations.find(key.value());
+    if (!found)
+        return false;
+    if (conversation)
+        *conversation = *found;
+    return true;
+}
+
+void Sniffing::addStreamDataHandler(const StreamDataHandler &handler)
+{
+    QMutexLocker locker(&streamMutex);
+    streamDataHandlers.append(handler);
+}
+
+void Sniffing::clearStreamDataHandlers()
+{
+    QMutexLocker locker(&streamMutex);
+    streamDataHandlers.clear();
+}
+
+void Sniffing::setReassemblyMemoryBudget(qint64 bytes)
+{
+    QMutexLocker locker(&streamMutex);
+    reassemblyBudgetBytes = qMax<qint64>(bytes, 0);
+    enforceReassemblyBudget();
+}
+
+qint64 Sniffing::reassemblyMemoryBudget()
+{
+    QMutexLocker locker(&streamMutex);
+    return reassemblyBudgetBytes;
+}
+
+qint64 Sniffing::reassemblyBufferedBytes()
+{
+    QMutexLocker locker(&streamMutex);
+    return reassemblyBytesInUse;
+}
+
+quint64 Sniffing::reassemblyEvictedFlows()
+{
+    QMutexLocker locker(&streamMutex);
+    return reassemblyEvictions;
+}
+
+void Sniffing::setStreamLimits(const StreamLimits &limits)
+{
+    QMutexLocker locker(&streamMutex);
+    streamLimitsConfig = limits;
+}
+
+Sniffing::StreamLimits Sniffing::streamLimits()
+{
+    QMutexLocker locker(&streamMutex);
+    return streamLimitsConfig;
+}
+
+Sniffing::StreamTableStats Sniffing::streamTableStats()
+{
+    QMutexLocker locker(&streamMutex);
+    StreamTableStats stats = streamStats;
+    stats.activeFlows = streamConversations.size();
+    return stats;
+}
+
+Sniffing::CaptureCounters Sniffing::captureCounters()
+{
+    CaptureCounters counters;
+    counters.packets = capturedPackets.load(std::memory_order_relaxed);
+    counters.bytes = capturedBytes.load(std::memory_order_relaxed);
+    counters.kernelDrops = kernelDrops.load(std::memory_order_relaxed);
+    counters.interfaceDrops = interfaceDrops.load(std::memory_order_relaxed);
+    counters.activeFlows = liveFlows.load(std::memory_order_relaxed);
+    counters.reassemblyBytes = liveReassemblyBytes.load(std::memory_order_relaxed);
+    return counters;
+}
+
+void Sniffing::addCaptureDrops(quint64 kernel, quint64 device)
+{
+    kernelDrops.fetch_add(kernel, std::memory_order_relaxed);
+    interfaceDrops.fetch_add(device, std::memory_order_relaxed);
+}
+
+void Sniffing::setStreamSpillPath(const QString &path)
+{
+    QMutexLocker locker(&streamMutex);
+    streamSpillFile = path;
+}
+
+QString Sniffing::streamSpillPath()
+{
+    QMutexLocker locker(&streamMutex);
+    return streamSpillFile;
+}
+
+void Sniffing::setRetainPackets(bool retain)
+{
+    retainPackets.store(retain, std::memory_order_relaxed);
 }
 
 void Sniffing::saveToPcap(const QString &filePath) {
@@ -2847,8 +3283,33 @@ void Sniffing::openFromPcap(const QString &filePath) {
 // here are my sniffing infos
 QVector<CapturedPacket> Sniffing::packetBuffer;
 QMutex Sniffing::packetMutex;
-QHash<QString, Sniffing::StreamConversation> Sniffing::streamConversations;
+FlowTable<Sniffing::StreamConversation> Sniffing::streamConversations;
 QMutex Sniffing::streamMutex;
+QVector<Sniffing::StreamDataHandler> Sniffing::streamDataHandlers;
+qint64 Sniffing::reassemblyBudgetBytes = kDefaultReassemblyBudget;
+qint64 Sniffing::reassemblyBytesInUse = 0;
+std::set<std::pair<qint64, quint64>> Sniffing::reassemblyIndex;
+quint64 Sniffing::reassemblyEvictions = 0;
+Sniffing::StreamLimits Sniffing::streamLimitsConfig;
+Sniffing::StreamTableStats Sniffing::streamStats;
+qint64 Sniffing::streamClockSec = 0;
+qint64 Sniffing::lastStreamSweepSec = 0;
+QString Sniffing::streamSpillFile;
+QMutex Sniffing::streamSpillMutex;
+QHash<quint64, FlowKey> Sniffing::streamIdIndex;
+QVector<Sniffing::StreamLogEntry> Sniffing::streamChangeLog;
+QVector<Sniffing::StreamLogEntry> Sniffing::streamRemovalLog;
+quint64 Sniffing::streamNextId = 0;
+quint64 Sniffing::streamRevision = 0;
+quint64 Sniffing::streamServedRevision = 0;
+quint64 Sniffing::streamRemovalFloor = 0;
+std::atomic<quint64> Sniffing::capturedPackets{0};
+std::atomic<quint64> Sniffing::capturedBytes{0};
+std::atomic<quint64> Sniffing::kernelDrops{0};
+std::atomic<quint64> Sniffing::interfaceDrops{0};
+std::atomic<int> Sniffing::liveFlows{0};
+std::atomic<qint64> Sniffing::liveReassemblyBytes{0};
+std::atomic<bool> Sniffing::retainPackets{true};
 
 void Sniffing::appendPacket(const CapturedPacket &packet) {
     QMutexLocker locker(&packetMutex);
@@ -3,6 +3,8 @@
 
 #include <QString>
 #include "protocols/proto_struct.h"
+#include "tcpreassembly.h"
+#include "flowtable.h"
 #include <arpa/inet.h>
 #include <netinet/if_ether.h>
 #include <QByteArray>
@@ -11,6 +13,10 @@
 #include <QMutex>
 #include <QHash>
 #include <QtGlobal>
+#include <atomic>
+#include <functional>
+#include <set>
+#include <utility>
 
 #ifndef DLT_EN10MB
 #define DLT_EN10MB 1
@@ -124,17 +130,20 @@ public:
         quint32 sequenceNumber = 0;
         quint32 acknowledgementNumber = 0;
         quint16 windowSize = 0;
+        bool retransmission = false;
+        bool outOfOrder = false;
     };
 
-    struct StreamConversation {
+    // Everything about a flow except its payload. Cheap to copy, so listing
+    // flows never touches segment or reassembly buffers.
+    struct StreamSummary {
+        quint64 id = 0;        // stable for the lifetime of the flow
+        quint64 revision = 0;  // bumped whenever the flow changes
         StreamEndpoint endpointA;
         StreamEndpoint endpointB;
         quint8 protocol = 0;
         int ipVersion = 4;
         bool initiatorIsA = true;
-        QVector<StreamSegment> segments;
-        QByteArray aggregatedAToB;
-        QByteArray aggregatedBToA;
         qint64 totalBytesAToB = 0;
         qint64 totalBytesBToA = 0;
         int packetCount = 0;
@@ -142,11 +151,92 @@ public:
         qint64 firstTimestampUsec = 0;
         qint64 lastTimestampSec = 0;
         qint64 lastTimestampUsec = 0;
+        bool finAToB = false;
+        bool finBToA = false;
+        bool resetSeen = false;
 
         QString protocolName() const;
         QString label() const;
+        bool isClosed() const { return resetSeen || (finAToB && finBToA); }
+    };
+
+    // Reassembled bytes of one direction, as sealed chunks plus an open
+    // tail. Copies share the chunks, and appends after a copy detach at most
+    // the tail, so handing out a flow never makes the capture thread copy
+    // the whole stream.
+    class StreamBuffer {
+    public:
+        void append(const QByteArray &data);
+        qint64 size() const { return m_size; }
+        bool isEmpty() const { return m_size == 0; }
+        QByteArray toByteArray() const;
+
+    private:
+        QVector<QByteArray> m_chunks;
+        QByteArray m_tail;
+        qint64 m_size = 0;
+    };
+
+    struct StreamConversation : StreamSummary {
+        QVector<StreamSegment> segments;
+        StreamBuffer aggregatedAToB;
+        StreamBuffer aggregatedBToA;
+        TcpReassembler reassemblyAToB;
+        TcpReassembler reassemblyBToA;
+        qint64 memoryBytes = 0;
+        qint64 reassemblyBytes = 0;   // as last entered in reassemblyIndex
+        quint64 loggedRevision = 0;
+    };
+
+    // Result of streamChangesSince(). Pass revision back as the next cursor.
+    // When reset is set the consumer must drop everything it holds; changed
+    // then lists every live flow.
+    struct StreamDelta {
+        quint64 revision = 0;
+        bool reset = false;
+        QVector<StreamSummary> changed;
+        QVector<quint64> removed;
+    };
+
+    // Lifecycle limits of the stream table. Timeouts are measured in capture
+    // time so offline files expire flows exactly like a live capture; a value
+    // of 0 disables the corresponding check.
+    struct StreamLimits {
+        qint64 idleTimeoutSec = 300;
+        qint64 activeTimeoutSec = 3600;
+        qint64 closedTimeoutSec = 30;
+        qint64 memoryBudgetBytes = 512LL * 1024 * 1024;
+    };
+
+    struct StreamTableStats {
+        int activeFlows = 0;
+        qint64 bytesInUse = 0;
+        quint64 expiredFlows = 0;   // closed, idle or active timeout
+        quint64 expiredBytes = 0;
+        quint64 evictedFlows = 0;   // dropped to stay within the memory budget
+        quint64 evictedBytes = 0;
+        quint64 spilledFlows = 0;
+    };
+
+    // Live capture counters. Reading them takes no lock, so they may lag
+    // the capture thread by a packet.
+    struct CaptureCounters {
+        quint64 packets = 0;
+        quint64 bytes = 0;
+        quint64 kernelDrops = 0;      // pcap ps_drop, summed over captures
+        quint64 interfaceDrops = 0;   // pcap ps_ifdrop
+        int activeFlows = 0;
+        qint64 reassemblyBytes = 0;
     };
 
+    // Receives reassembled, in-order stream bytes as soon as they become
+    // contiguous. Handlers run on the capture thread with streamMutex held and
+    // must not call back into the stream API.
+    using StreamDataHandler = std::function<void(const StreamConversation &conversation,
+                                                 bool fromAtoB,
+                                                 const QByteArray &data,
+                                                 quint64 offset)>;
+
     static void packet_callback(u_char *args,
                                 const struct pcap_pkthdr *header,
                                 const u_char *packet);
@@ -186,6 +276,33 @@ public:
     QVector<StreamConversation> getStreamConversations() const;
     void resetStreams();
 
+    // Flows created, updated or removed since the given revision (0 = all).
+    // Cost is proportional to the number of changes, not the table size.
+    static StreamDelta streamChangesSince(quint64 revision);
+    // Copies a single flow, payload included. Returns false once it expired.
+    // The copy shares the flow's buffers; join them with toByteArray()
+    // after this returns, not under a lock.
+    static bool streamConversation(quint64 id, StreamConversation *conversation);
+
+    static void addStreamDataHandler(const StreamDataHandler &handler);
+    static void clearStreamDataHandlers();
+    static void setReassemblyMemoryBudget(qint64 bytes);
+    static qint64 reassemblyMemoryBudget();
+    static qint64 reassemblyBufferedBytes();
+    static quint64 reassemblyEvictedFlows();
+    static void setStreamLimits(const StreamLimits &limits);
+    static StreamLimits streamLimits();
+    static StreamTableStats streamTableStats();
+    static CaptureCounters captureCounters();
+    static void addCaptureDrops(quint64 kernel, quint64 device);
+    // Flows leaving the table are appended as JSON lines to this file; an
+    // empty path disables spilling.
+    static void setStreamSpillPath(const QString &path);
+    static QString streamSpillPath();
+    // Whether live packets are kept for saving the session; off when only
+    // the packets around incidents are kept.
+    static void setRetainPackets(bool retain);
+
     //These are for saving and opening my pcap files
     void saveToPcap(const QString &filePath);
     void openFromPcap(const QString &filePath);
@@ -193,8 +310,40 @@ public:
     //I will use this to save my packet sniffing session later
     static QVector<CapturedPacket> packetBuffer;
     static QMutex packetMutex;
-    static QHash<QString, StreamConversation> streamConversations;
+    static FlowTable<StreamConversation> streamConversations;
     static QMutex streamMutex;
+    static QVector<StreamDataHandler> streamDataHandlers;
+    static qint64 reassemblyBudgetBytes;
+    static qint64 reassemblyBytesInUse;
+    // Flows with queued out-of-order bytes, by (bytes, id); the largest last.
+    static std::set<std::pair<qint64, quint64>> reassemblyIndex;
+    static quint64 reassemblyEvictions;
+    static StreamLimits streamLimitsConfig;
+    static StreamTableStats streamStats;
+    static qint64 streamClockSec;
+    static qint64 lastStreamSweepSec;
+    static QString streamSpillFile;
+    static QMutex streamSpillMutex;
+    // Written by the capture thread only; see captureCounters().
+    static std::atomic<quint64> capturedPackets;
+    static std::atomic<quint64> capturedBytes;
+    static std::atomic<quint64> kernelDrops;
+    static std::atomic<quint64> interfaceDrops;
+    static std::atomic<int> liveFlows;
+    static std::atomic<qint64> liveReassemblyBytes;
+    static std::atomic<bool> retainPackets;
+
+    struct StreamLogEntry {
+        quint64 revision = 0;
+        quint64 id = 0;
+    };
+    static QHash<quint64, FlowKey> streamIdIndex;
+    static QVector<StreamLogEntry> streamChangeLog;
+    static QVector<StreamLogEntry> streamRemovalLog;
+    static quint64 streamNextId;
+    static quint64 streamRevision;
+    static quint64 streamServedRevision;
+    static quint64 streamRemovalFloor;
     static void recordStreamSegment(const QByteArray &packet,
                                     int linkType,
                                     qint64 tsSec,
@@ -0,0 +1,208 @@
+#include "tcpreassembly.h"
+
+#include "protocols/proto_struct.h"
+
+#include <iterator>
+#include <utility>
+
+TcpReassembler::SegmentResult TcpReassembler::addSegment(quint32 sequenceNumber,
+                                                         quint8 tcpFlags,
+                                                         const QByteArray &payload,
+                                                         const DataSink &sink)
+{
+    quint32 sequence = sequenceNumber;
+    if (tcpFlags & TH_SYN) {
+        // The SYN occupies one sequence number; any data (TFO) follows it.
+        sequence += 1;
+        if (!m_synchronized) {
+            m_synchronized = true;
+            m_nextSequence = sequence;
+        }
+    }
+
+    if (payload.isEmpty())
+        return SegmentResult::Empty;
+
+    if (!m_synchronized) {
+        // Capture started mid-connection: the first segment defines offset 0.
+        m_synchronized = true;
+        m_nextSequence = sequence;
+    }
+
+    qint32 distance = qint32(sequence - m_nextSequence);
+    if (distance > 0 && quint32(distance) > kMaxSequenceJump) {
+        flush(sink);
+        const quint32 gap = sequence - m_nextSequence;
+        m_skippedBytes += gap;
+        m_nextOffset += gap;
+        m_nextSequence = sequence;
+        distance = 0;
+    } else if (distance < 0 && quint32(-qint64(distance)) > kMaxSequenceJump) {
+        m_retransmittedBytes += quint64(payload.size());
+        return SegmentResult::Retransmission;
+    }
+
+    const qint64 expected = qint64(m_nextOffset);
+    qint64 start = expected + distance;
+    const qint64 end = start + payload.size();
+    if (end <= expected) {
+        m_retransmittedBytes += quint64(payload.size());
+        return SegmentResult::Retransmission;
+    }
+
+    QByteArray data = payload;
+    SegmentResult result = SegmentResult::InOrder;
+    if (start < expected) {
+        const int duplicate = int(expected - start);
+        m_overlapBytes += quint64(duplicate);
+        data.remove(0, duplicate);
+        start = expected;
+        result = SegmentResult::Overlap;
+    }
+
+    if (start == expected) {
+        deliver(data, sink);
+        drainQueue(sink);
+        return result;
+    }
+
+    if (!enqueue(quint64(start), data)) {
+        m_retransmittedBytes += quint64(payload.size());
+        return SegmentResult::Retransmission;
+    }
+    ++m_outOfOrderSegments;
+    return SegmentResult::OutOfOrder;
+}
+
+quint64 TcpReassembler::flush(const DataSink &sink)
+{
+    quint64 skipped = 0;
+    while (!m_queue.empty()) {
+        const quint64 front = m_queue.begin()->first;
+        if (front > m_nextOffset) {
+            const quint64 gap = front - m_nextOffset;
+            skipped += gap;
+            m_nextOffset += gap;
+            m_nextSequence += quint32(gap);
+        }
+        drainQueue(sink);
+    }
+    m_skippedBytes += skipped;
+    return skipped;
+}
+
+qint64 TcpReassembler::discard()
+{
+    if (m_queue.empty())
+        return 0;
+    // Queued segments never overlap, so the last one ends furthest.
+    const auto &last = *m_queue.rbegin();
+    const quint64 gap = last.first + quint64(last.second.size()) - m_nextOffset;
+    m_skippedBytes += gap;
+    m_nextOffset += gap;
+    m_nextSequence += quint32(gap);
+    const qint64 freed = m_bufferedBytes;
+    m_queue.clear();
+    m_bufferedBytes = 0;
+    return freed;
+}
+
+void TcpReassembler::reset()
+{
+    *this = TcpReassembler();
+}
+
+QVector<TcpReassembler::Hole> TcpReassembler::holes() const
+{
+    QVector<Hole> result;
+    quint64 cursor = m_nextOffset;
+    for (const auto &entry : m_queue) {
+        if (entry.first > cursor)
+            result.append(Hole{cursor, entry.first});
+        cursor = qMax(cursor, entry.first + quint64(entry.second.size()));
+    }
+    return result;
+}
+
+void TcpReassembler::deliver(const QByteArray &data, const DataSink &sink)
+{
+    if (data.isEmpty())
+        return;
+    const quint64 offset = m_nextOffset;
+    m_nextOffset += quint64(data.size());
+    m_nextSequence += quint32(data.size());
+    if (sink)
+        sink(data, offset);
+}
+
+void TcpReassembler::drainQueue(const DataSink &sink)
+{
+    while (!m_queue.empty()) {
+        auto it = m_queue.begin();
+        if (it->first > m_nextOffset)
+            break;
+
+        const quint64 start = it->first;
+        QByteArray data = std::move(it->second);
+        m_queue.erase(it);
+        m_bufferedBytes -= data.size();
+
+        const quint64 end = start + quint64(data.size());
+        if (end <= m_nextOffset) {
+            m_overlapBytes += quint64(data.size());
+            continue;
+        }
+        if (start < m_nextOffset) {
+            const int duplicate = int(m_nextOffset - start);
+            m_overlapBytes += quint64(duplicate);
+            data.remove(0, duplicate);
+        }
+        deliver(data, sink);
+    }
+}
+
+bool TcpReassembler::enqueue(quint64 start, QByteArray data)
+{
+    quint64 end = start + quint64(data.size());
+
+    // Bytes that are already queued win over a later copy of the same range.
+    auto next = m_queue.lower_bound(start);
+    if (next != m_queue.begin()) {
+        auto prev = std::prev(next);
+        const quint64 prevEnd = prev->first + quint64(prev->second.size());
+        if (prevEnd >= end) {
+            m_overlapBytes += quint64(data.size());
+            return false;
+        }
+        if (prevEnd > start) {
+            const int duplicate = int(prevEnd - start);
+            m_overlapBytes += quint64(duplicate);
+            data.remove(0, duplicate);
+            start = prevEnd;
+        }
+    }
+
+    // Queued segments the new one covers completely are replaced by it; a
+    // partially covered successor trims the tail of the new segment instead.
+    while (next != m_queue.end() && next->first < end) {
+        const quint64 nextEnd = next->first + quint64(next->second.size());
+        if (nextEnd <= end) {
+            m_overlapBytes += quint64(next->second.size());
+            m_bufferedBytes -= next->second.size();
+            next = m_queue.erase(next);
+            continue;
+        }
+        const int duplicate = int(end - next->first);
+        m_overlapBytes += quint64(duplicate);
+        data.truncate(data.size() - duplicate);
+        end = next->first;
+        break;
+    }
+
+    if (data.isEmpty())
+        return false;
+
+    m_bufferedBytes += data.size();
+    m_queue.emplace(start, std::move(data));
+    return true;
+}
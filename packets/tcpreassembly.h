@@ -0,0 +1,78 @@
+#ifndef TCPREASSEMBLY_H
+#define TCPREASSEMBLY_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+#include <functional>
+#include <map>
+
+// Reassembles one direction of a TCP connection. Segments are placed by
+// sequence number instead of arrival order; bytes that become contiguous are
+// handed to the sink straight away, everything past a hole waits in an
+// out-of-order queue until the hole is filled or the queue is flushed.
+//
+// Offsets are 64-bit positions inside the byte stream (0 = first payload byte
+// after the SYN), so sequence number wrap-around is handled transparently.
+class TcpReassembler {
+public:
+    struct Hole {
+        quint64 start = 0;  // stream offset of the first missing byte
+        quint64 end = 0;    // one past the last missing byte
+    };
+
+    enum class SegmentResult {
+        Empty,          // no payload (pure ACK, SYN, FIN…)
+        InOrder,        // delivered immediately
+        OutOfOrder,     // queued behind a hole
+        Retransmission, // every byte was already seen
+        Overlap         // partially new, overlapping bytes were dropped
+    };
+
+    using DataSink = std::function<void(const QByteArray &data, quint64 offset)>;
+
+    // Segments starting further than this past the expected sequence number
+    // are treated as a resynchronisation (missed handshake, keep-alive junk…)
+    static constexpr quint32 kMaxSequenceJump = 16u * 1024u * 1024u;
+
+    SegmentResult addSegment(quint32 sequenceNumber,
+                             quint8 tcpFlags,
+                             const QByteArray &payload,
+                             const DataSink &sink);
+
+    // Delivers every queued segment in order, skipping holes. Returns the
+    // number of missing bytes that were skipped.
+    quint64 flush(const DataSink &sink);
+    // Drops every queued segment and resumes after the last of them, as if
+    // they had been lost with the hole before them. Returns the bytes freed.
+    qint64 discard();
+    void reset();
+
+    bool isSynchronized() const { return m_synchronized; }
+    quint64 deliveredBytes() const { return m_nextOffset; }
+    qint64 bufferedBytes() const { return m_bufferedBytes; }
+    int queuedSegments() const { return int(m_queue.size()); }
+    QVector<Hole> holes() const;
+
+    quint64 retransmittedBytes() const { return m_retransmittedBytes; }
+    quint64 overlapBytes() const { return m_overlapBytes; }
+    quint64 skippedBytes() const { return m_skippedBytes; }
+    quint64 outOfOrderSegments() const { return m_outOfOrderSegments; }
+
+private:
+    void deliver(const QByteArray &data, const DataSink &sink);
+    void drainQueue(const DataSink &sink);
+    bool enqueue(quint64 start, QByteArray data);
+
+    bool m_synchronized = false;
+    quint32 m_nextSequence = 0;
+    quint64 m_nextOffset = 0;
+    std::map<quint64, QByteArray> m_queue;
+    qint64 m_bufferedBytes = 0;
+    quint64 m_retransmittedBytes = 0;
+    quint64 m_overlapBytes = 0;
+    quint64 m_skippedBytes = 0;
+    quint64 m_outOfOrderSegments = 0;
+};
+
+#endif // TCPREASSEMBLY_H
@@ -3,16 +3,37 @@
 #include "../packets/sniffing.h"
 #include "../packets/packethelpers.h"
 
+#include <algorithm>
+#include <limits>
+
+namespace {
+const QString kEmptyText;
+const QByteArray kEmptyData;
+
+template <typename Id>
+Id intern(const QString &value, QVector<QString> &values, QHash<QString, Id> &ids)
+{
+    const auto it = ids.constFind(value);
+    if (it != ids.constEnd())
+        return it.value();
+    const Id id = Id(values.size());
+    values.append(value);
+    ids.insert(value, id);
+    return id;
+}
+}
+
 PacketTableModel::PacketTableModel(QObject *parent)
     : QAbstractTableModel(parent)
 {
+    m_colors.append(QColor());
 }
 
 int PacketTableModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.isValid())
         return 0;
-    return m_rows.size();
+    return m_timeMs.size();
 }
 
 int PacketTableModel::columnCount(const QModelIndex &parent) const
@@ -24,19 +45,18 @@ int PacketTableModel::columnCount(const QModelIndex &parent) const
 
 QVariant PacketTableModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() < 0 || index.row() >= m_rows.size())
+    if (!index.isValid() || !inRange(index.row()))
         return {};
 
-    const PacketTableRow &r = m_rows.at(index.row());
-
+    const int row = index.row();
     if (role == Qt::DisplayRole) {
-        return r.columns.value(index.column());
+        return text(row, index.column());
     }
     if (role == Qt::UserRole && index.column() == ColumnInfo) {
-        return r.rawData;
+        return m_rawData.at(row);
     }
-    if (role == Qt::BackgroundRole && r.background.isValid()) {
-        return r.background;
+    if (role == Qt::BackgroundRole && m_color.at(row) != 0) {
+        return m_colors.at(m_color.at(row));
     }
 
     return {};
@@ -52,35 +72,172 @@ QVariant PacketTableModel::headerData(int section, Qt::Orientation orientation,
 
 void PacketTableModel::addPacket(const PacketTableRow &row)
 {
-    beginInsertRows(QModelIndex(), m_rows.size(), m_rows.size());
-    m_rows.append(row);
+    const int index = m_timeMs.size();
+    beginInsertRows(QModelIndex(), index, index);
+    m_timeMs.append(row.timeMs);
+    m_source.append(addressId(row.source));
+    m_destination.append(addressId(row.destination));
+    m_protocol.append(protocolId(row.protocol));
+    m_linkType.append(quint16(row.linkType));
+    m_length.append(row.length);
+    m_infoOffset.append(m_info.size());
+    m_info.append(row.info);
+    m_color.append(colorId(row.background));
+    m_rawData.append(row.rawData);
     endInsertRows();
+
+    // Dropping an eighth of the limit at a time keeps the cost of moving
+    // the columns down to a few rows' worth per packet.
+    if (m_rowLimit > 0 && m_timeMs.size() >= m_rowLimit + std::max(1, m_rowLimit / 8))
+        dropOldestRows(m_timeMs.size() - m_rowLimit);
+}
+
+void PacketTableModel::setRowLimit(int rows)
+{
+    m_rowLimit = std::max(0, rows);
+    if (m_rowLimit > 0 && m_timeMs.size() > m_rowLimit)
+        dropOldestRows(m_timeMs.size() - m_rowLimit);
+}
+
+void PacketTableModel::dropOldestRows(int count)
+{
+    beginRemoveRows(QModelIndex(), 0, count - 1);
+    const qint64 infoCut = count < m_infoOffset.size() ? m_infoOffset.at(count) : m_info.size();
+    m_timeMs.remove(0, count);
+    m_source.remove(0, count);
+    m_destination.remove(0, count);
+    m_protocol.remove(0, count);
+    m_linkType.remove(0, count);
+    m_length.remove(0, count);
+    m_infoOffset.remove(0, count);
+    for (qint64 &offset : m_infoOffset)
+        offset -= infoCut;
+    m_info.remove(0, infoCut);
+    m_color.remove(0, count);
+    m_rawData.remove(0, count);
+    m_firstPacket += count;
+    compactAddresses();
+    endRemoveRows();
+}
+
+void PacketTableModel::compactAddresses()
+{
+    // A row names two addresses, so once most entries are unused the table
+    // is rebuilt from the rows left; otherwise it would grow with traffic.
+    if (m_addresses.size() <= 2 * m_timeMs.size() + 1024)
+        return;
+    const QVector<QString> addresses = std::move(m_addresses);
+    m_addresses.clear();
+    m_addressIds.clear();
+    for (quint32 &id : m_source)
+        id = addressId(addresses.at(id));
+    for (quint32 &id : m_destination)
+        id = addressId(addresses.at(id));
+}
+
+QString PacketTableModel::text(int index, int column) const
+{
+    if (!inRange(index))
+        return {};
+
+    switch (column) {
+    case ColumnNumber:
+        return QString::number(m_firstPacket + index + 1);
+    case ColumnTime:
+        return QString::number(m_timeMs.at(index) / 1000.0, 'f', 3);
+    case ColumnSource:
+        return source(index);
+    case ColumnDestination:
+        return destination(index);
+    case ColumnProtocol:
+        return protocol(index);
+    case ColumnLength:
+        return QString::number(m_length.at(index));
+    case ColumnInfo:
+        return info(index).toString();
+    default:
+        return {};
+    }
 }
 
-PacketTableRow PacketTableModel::row(int index) const
+qint64 PacketTableModel::timeMs(int index) const
 {
-    return m_rows.value(index);
+    return inRange(index) ? m_timeMs.at(index) : 0;
+}
+
+const QString &PacketTableModel::source(int index) const
+{
+    return inRange(index) ? m_addresses.at(m_source.at(index)) : kEmptyText;
+}
+
+const QString &PacketTableModel::destination(int index) const
+{
+    return inRange(index) ? m_addresses.at(m_destination.at(index)) : kEmptyText;
+}
+
+quint32 PacketTableModel::sourceId(int index) const
+{
+    return inRange(index) ? m_source.at(index) : 0;
+}
+
+quint32 PacketTableModel::destinationId(int index) const
+{
+    return inRange(index) ? m_destination.at(index) : 0;
+}
+
+const QString &PacketTableModel::protocol(int index) const
+{
+    return inRange(index) ? m_protocols.at(m_protocol.at(index)) : kEmptyText;
+}
+
+int PacketTableModel::length(int index) const
+{
+    return inRange(index) ? m_length.at(index) : 0;
+}
+
+QStringView PacketTableModel::info(int index) const
+{
+    if (!inRange(index))
+        return {};
+    const qint64 start = m_infoOffset.at(index);
+    const qint64 end = index + 1 < m_infoOffset.size() ? m_infoOffset.at(index + 1) : m_info.size();
+    return QStringView(m_info).mid(start, end - start);
+}
+
+const QByteArray &PacketTableModel::rawData(int index) const
+{
+    return inRange(index) ? m_rawData.at(index) : kEmptyData;
+}
+
+int PacketTableModel::linkType(int index) const
+{
+    return inRange(index) ? m_linkType.at(index) : DLT_EN10MB;
+}
+
+QColor PacketTableModel::background(int index) const
+{
+    return inRange(index) ? m_colors.at(m_color.at(index)) : QColor();
 }
 
 QByteArray PacketTableModel::payloadForRow(int index) const
 {
-    if (index < 0 || index >= m_rows.size())
+    if (!inRange(index))
         return {};
 
-    const PacketTableRow &r = m_rows.at(index);
-    if (r.rawData.isEmpty())
+    const QByteArray &raw = m_rawData.at(index);
+    if (raw.isEmpty())
         return {};
 
-    const QByteArray &raw = r.rawData;
+    const int linkType = m_linkType.at(index);
     const u_char *pkt = reinterpret_cast<const u_char*>(raw.constData());
 
-    int offset = linkHdrLen(r.linkType);
+    int offset = linkHdrLen(linkType);
     if (offset >= raw.size())
         return {};
 
-    const uint16_t type = ethType(pkt, r.linkType);
+    const uint16_t type = ethType(pkt, linkType);
     if (type == ETHERTYPE_IP) {
-        offset += ipv4HdrLen(pkt, r.linkType);
+        offset += ipv4HdrLen(pkt, linkType);
     } else if (type == ETHERTYPE_IPV6) {
         offset += sizeof(sniff_ipv6);
     }
@@ -91,23 +248,115 @@ QByteArray PacketTableModel::payloadForRow(int index) const
     return raw.mid(offset);
 }
 
+int PacketTableModel::findRow(const QString &needle, int from) const
+{
+    const int count = m_timeMs.size();
+    if (count == 0 || needle.isEmpty())
+        return -1;
+
+    // Distinct addresses and protocols are matched once, not per row.
+    QVector<bool> addressMatches(m_addresses.size());
+    for (int i = 0; i < m_addresses.size(); ++i)
+        addressMatches[i] = m_addresses.at(i).contains(needle, Qt::CaseInsensitive);
+    QVector<bool> protocolMatches(m_protocols.size());
+    for (int i = 0; i < m_protocols.size(); ++i)
+        protocolMatches[i] = m_protocols.at(i).contains(needle, Qt::CaseInsensitive);
+
+    // Numbers are compared as values. A time matches the seconds it
+    // shows: "1.5" finds 1.500 to 1.599.
+    bool isInteger = false;
+    const qint64 number = needle.toLongLong(&isInteger);
+    bool isTime = false;
+    const double seconds = needle.toDouble(&isTime);
+    qint64 timeFrom = 0;
+    qint64 timeTo = 0;
+    const int dot = needle.indexOf(QLatin1Char('.'));
+    const int decimals = dot < 0 ? 0 : int(needle.size()) - dot - 1;
+    if (isTime && seconds >= 0 && decimals <= 3) {
+        qint64 step = 1000;
+        for (int i = 0; i < decimals; ++i)
+            step /= 10;
+        timeFrom = qRound64(seconds * 1000);
+        timeTo = timeFrom + step;
+    }
+
+    from = (from % count + count) % count;
+    for (int offset = 0; offset < count; ++offset) {
+        const int row = (from + offset) % count;
+        if (addressMatches.at(m_source.at(row))
+            || addressMatches.at(m_destination.at(row))
+            || protocolMatches.at(m_protocol.at(row))
+            || info(row).contains(needle, Qt::CaseInsensitive)
+            || (isInteger && (m_firstPacket + row + 1 == number || m_length.at(row) == number))
+            || (m_timeMs.at(row) >= timeFrom && m_timeMs.at(row) < timeTo)) {
+            return row;
+        }
+    }
+    return -1;
+}
+
 void PacketTableModel::clear()
 {
     beginResetModel();
-    m_rows.clear();
+    m_timeMs.clear();
+    m_source.clear();
+    m_destination.clear();
+    m_protocol.clear();
+    m_linkType.clear();
+    m_length.clear();
+    m_infoOffset.clear();
+    m_color.clear();
+    m_rawData.clear();
+    m_info.clear();
+    m_addresses.clear();
+    m_addressIds.clear();
+    m_protocols.clear();
+    m_protocolIds.clear();
+    m_colors.resize(1);
+    m_colorIds.clear();
+    m_firstPacket = 0;
     endResetModel();
 }
 
 void PacketTableModel::setRowBackground(int index, const QColor &color)
 {
-    if (index < 0 || index >= m_rows.size())
+    if (!inRange(index))
         return;
 
-    if (m_rows[index].background == color)
+    const quint16 id = colorId(color);
+    if (m_color.at(index) == id)
         return;
 
-    m_rows[index].background = color;
+    m_color[index] = id;
     const QModelIndex left = createIndex(index, 0);
     const QModelIndex right = createIndex(index, ColumnCount - 1);
     emit dataChanged(left, right, {Qt::BackgroundRole});
 }
+
+quint32 PacketTableModel::addressId(const QString &address)
+{
+    return intern(address, m_addresses, m_addressIds);
+}
+
+quint16 PacketTableModel::protocolId(const QString &protocol)
+{
+    return intern(protocol, m_protocols, m_protocolIds);
+}
+
+quint16 PacketTableModel::colorId(const QColor &color)
+{
+    if (!color.isValid())
+        return 0;
+    const QRgb rgba = color.rgba();
+    const auto it = m_colorIds.constFind(rgba);
+    if (it != m_colorIds.constEnd())
+        return it.value();
+    // Colours come from rules and annotations, so the palette stays small;
+    // should it ever fill up, further colours are not drawn.
+    if (m_colors.size() > std::numeric_limits<quint16>::max())
+        return 0;
+    const quint16 id = quint16(m_colors.size());
+    m_colors.append(color);
+    m_colorIds.insert(rgba, id);
+    return id;
+}
@@ -4,17 +4,26 @@
 #include <QAbstractTableModel>
 #include <QColor>
 #include <QByteArray>
+#include <QHash>
+#include <QString>
 #include <QStringList>
+#include <QStringView>
 #include <QVector>
 
 #ifndef DLT_EN10MB
 #define DLT_EN10MB 1
 #endif
 
+// One packet as handed to the model; the number column is the row.
 struct PacketTableRow {
-    QStringList columns; // column texts: No., Time, Source, Destination, Protocol, Length, Info
-    QByteArray rawData;  // packet raw bytes
-    QColor background;   // background color
+    qint64 timeMs = 0;       // since the session started
+    QString source;
+    QString destination;
+    QString protocol;
+    int length = 0;
+    QString info;
+    QByteArray rawData;      // packet raw bytes
+    QColor background;       // background color
     int linkType = DLT_EN10MB;
 };
 
@@ -30,6 +39,13 @@ enum PacketColumns {
     ColumnCount
 };
 
+// Stores packets column by column: times and lengths as integers,
+// addresses, protocols and colours as indices into tables of the distinct
+// values, and the info texts back to back in one buffer. Cell text is only
+// formatted when data() is asked for it, so a row costs tens of bytes
+// besides its raw packet. With a row limit the oldest rows scroll out; the
+// number column keeps counting packets, so packet numbers and rows differ
+// by firstPacket().
 class PacketTableModel : public QAbstractTableModel
 {
     Q_OBJECT
@@ -42,13 +58,64 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
     void addPacket(const PacketTableRow &row);
-    PacketTableRow row(int index) const;
-    QByteArray payloadForRow(int index) const;
     void clear();
+    // 0 keeps every row. Rows past the limit are dropped in batches.
+    void setRowLimit(int rows);
+    int rowLimit() const { return m_rowLimit; }
+    // Packet number, from 0, of the first row still held.
+    int firstPacket() const { return m_firstPacket; }
     void setRowBackground(int index, const QColor &color);
 
+    // Single fields of a row, without copying the others. Rows out of range
+    // read as empty.
+    QString text(int index, int column) const;
+    qint64 timeMs(int index) const;
+    const QString &source(int index) const;
+    const QString &destination(int index) const;
+    // Interned, so equal ids mean equal addresses.
+    quint32 sourceId(int index) const;
+    quint32 destinationId(int index) const;
+    const QString &protocol(int index) const;
+    int length(int index) const;
+    QStringView info(int index) const;
+    const QByteArray &rawData(int index) const;
+    int linkType(int index) const;
+    QColor background(int index) const;
+    QByteArray payloadForRow(int index) const;
+
+    // First row at or after from, wrapping around, with needle in a text
+    // column or equal to a number, time or length; -1 if none.
+    int findRow(const QString &needle, int from) const;
+
 private:
-    QVector<PacketTableRow> m_rows;
+    bool inRange(int index) const { return index >= 0 && index < m_timeMs.size(); }
+    quint32 addressId(const QString &address);
+    quint16 protocolId(const QString &protocol);
+    quint16 colorId(const QColor &color);
+    void dropOldestRows(int count);
+    void compactAddresses();
+
+    QVector<qint64> m_timeMs;
+    QVector<quint32> m_source;
+    QVector<quint32> m_destination;
+    QVector<quint16> m_protocol;
+    QVector<quint16> m_linkType;
+    QVector<qint32> m_length;
+    QVector<qint64> m_infoOffset;        // into m_info; a row ends where the next starts
+    QVector<quint16> m_color;            // into m_colors
+    QVector<QByteArray> m_rawData;
+    QString m_info;
+
+    QVector<QString> m_addresses;
+    QHash<QString, quint32> m_addressIds;
+    QVector<QString> m_protocols;
+    QHash<QString, quint16> m_protocolIds;
+    QVector<QColor> m_colors;            // 0 is no colour
+    QHash<QRgb, quint16> m_colorIds;
+
+    int m_rowLimit = 0;
+    int m_firstPacket = 0;
+
     const QStringList m_headers = {"No.", "Time", "Source", "Destination", "Protocol", "Length", "Info"};
 };
 
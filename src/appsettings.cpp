@@ -3,6 +3,7 @@
 #include <QtGlobal>
 #include <QCoreApplication>
 #include <QDir>
+#include <QStandardPaths>
 
 namespace {
 constexpr const char *kOrganization = "Engineering";
@@ -16,6 +17,22 @@ constexpr const char *kPromiscuousKey      = "Preferences/Promiscuous";
 constexpr const char *kDefaultFilterKey    = "Preferences/DefaultFilter";
 constexpr const char *kAnomaliesDirKey     = "Preferences/AnomaliesDirectory";
 constexpr const char *kSessionsDirKey      = "Preferences/SessionsDirectory";
+constexpr const char *kStreamIdleKey       = "Streams/IdleTimeout";
+constexpr const char *kStreamActiveKey     = "Streams/ActiveTimeout";
+constexpr const char *kStreamClosedKey     = "Streams/ClosedTimeout";
+constexpr const char *kStreamBudgetKey     = "Streams/MemoryBudgetMb";
+constexpr const char *kStreamSpillKey      = "Streams/SpillExpired";
+constexpr const char *kBurstBucketKey      = "Statistics/BurstBucketMs";
+constexpr const char *kTopTalkersCountKey  = "Statistics/TopTalkersK";
+constexpr const char *kTopTalkersWindowKey = "Statistics/TopTalkersWindow";
+constexpr const char *kMetricsEnabledKey   = "Metrics/Enabled";
+constexpr const char *kMetricsAddressKey   = "Metrics/Address";
+constexpr const char *kMetricsPortKey      = "Metrics/Port";
+constexpr const char *kAnomalyRulesKey     = "Statistics/AnomalyRules";
+constexpr const char *kAnomalyCooldownKey  = "Statistics/AnomalyCooldown";
+constexpr const char *kRetentionKey        = "Capture/IncidentRetention";
+constexpr const char *kRetentionBeforeKey  = "Capture/RetentionBefore";
+constexpr const char *kRetentionAfterKey   = "Capture/RetentionAfter";
 }
 
 AppSettings::AppSettings()
@@ -109,6 +126,137 @@ void AppSettings::setDefaultFilter(const QString &filter) {
     settings().setValue(kDefaultFilterKey, filter);
 }
 
+int AppSettings::streamIdleTimeout() const {
+    return settings().value(kStreamIdleKey, 300).toInt();
+}
+
+void AppSettings::setStreamIdleTimeout(int seconds) {
+    settings().setValue(kStreamIdleKey, seconds);
+}
+
+int AppSettings::streamActiveTimeout() const {
+    return settings().value(kStreamActiveKey, 3600).toInt();
+}
+
+void AppSettings::setStreamActiveTimeout(int seconds) {
+    settings().setValue(kStreamActiveKey, seconds);
+}
+
+int AppSettings::streamClosedTimeout() const {
+    return settings().value(kStreamClosedKey, 30).toInt();
+}
+
+void AppSettings::setStreamClosedTimeout(int seconds) {
+    settings().setValue(kStreamClosedKey, seconds);
+}
+
+int AppSettings::streamMemoryBudgetMb() const {
+    return settings().value(kStreamBudgetKey, 512).toInt();
+}
+
+void AppSettings::setStreamMemoryBudgetMb(int megabytes) {
+    settings().setValue(kStreamBudgetKey, megabytes);
+}
+
+bool AppSettings::spillExpiredStreams() const {
+    return settings().value(kStreamSpillKey, false).toBool();
+}
+
+void AppSettings::setSpillExpiredStreams(bool enabled) {
+    settings().setValue(kStreamSpillKey, enabled);
+}
+
+int AppSettings::burstBucketMs() const {
+    return settings().value(kBurstBucketKey, 10).toInt();
+}
+
+void AppSettings::setBurstBucketMs(int milliseconds) {
+    settings().setValue(kBurstBucketKey, milliseconds);
+}
+
+int AppSettings::topTalkersCount() const {
+    return settings().value(kTopTalkersCountKey, 10).toInt();
+}
+
+void AppSettings::setTopTalkersCount(int count) {
+    settings().setValue(kTopTalkersCountKey, count);
+}
+
+int AppSettings::topTalkersWindow() const {
+    return settings().value(kTopTalkersWindowKey, 10).toInt();
+}
+
+void AppSettings::setTopTalkersWindow(int seconds) {
+    settings().setValue(kTopTalkersWindowKey, seconds);
+}
+
+bool AppSettings::metricsEnabled() const {
+    return settings().value(kMetricsEnabledKey, false).toBool();
+}
+
+void AppSettings::setMetricsEnabled(bool enabled) {
+    settings().setValue(kMetricsEnabledKey, enabled);
+}
+
+QString AppSettings::metricsAddress() const {
+    return settings().value(kMetricsAddressKey, QStringLiteral("127.0.0.1")).toString();
+}
+
+void AppSettings::setMetricsAddress(const QString &address) {
+    settings().setValue(kMetricsAddressKey, address);
+}
+
+int AppSettings::metricsPort() const {
+    return settings().value(kMetricsPortKey, 9464).toInt();
+}
+
+void AppSettings::setMetricsPort(int port) {
+    settings().setValue(kMetricsPortKey, port);
+}
+
+QString AppSettings::anomalyRulesPath() const {
+    const QString fallback = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)
+                             + QStringLiteral("/anomaly-rules.json");
+    const QString configured = settings().value(kAnomalyRulesKey).toString();
+    return configured.isEmpty() ? fallback : configured;
+}
+
+void AppSettings::setAnomalyRulesPath(const QString &path) {
+    settings().setValue(kAnomalyRulesKey, path);
+}
+
+int AppSettings::anomalyCooldownSeconds() const {
+    return settings().value(kAnomalyCooldownKey, 30).toInt();
+}
+
+void AppSettings::setAnomalyCooldownSeconds(int seconds) {
+    settings().setValue(kAnomalyCooldownKey, seconds);
+}
+
+bool AppSettings::incidentRetention() const {
+    return settings().value(kRetentionKey, false).toBool();
+}
+
+void AppSettings::setIncidentRetention(bool enabled) {
+    settings().setValue(kRetentionKey, enabled);
+}
+
+int AppSettings::retentionBeforeSeconds() const {
+    return settings().value(kRetentionBeforeKey, 30).toInt();
+}
+
+void AppSettings::setRetentionBeforeSeconds(int seconds) {
+    settings().setValue(kRetentionBeforeKey, seconds);
+}
+
+int AppSettings::retentionAfterSeconds() const {
+    return settings().value(kRetentionAfterKey, 30).toInt();
+}
+
+void AppSettings::setRetentionAfterSeconds(int seconds) {
+    settings().setValue(kRetentionAfterKey, seconds);
+}
+
 QSettings &AppSettings::settings() const {
     Q_ASSERT(settingsPtr);
     return *settingsPtr;
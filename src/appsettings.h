@@ -37,6 +37,57 @@ public:
     QString defaultFilter() const;
     void setDefaultFilter(const QString &filter);
 
+    int streamIdleTimeout() const;
+    void setStreamIdleTimeout(int seconds);
+
+    int streamActiveTimeout() const;
+    void setStreamActiveTimeout(int seconds);
+
+    int streamClosedTimeout() const;
+    void setStreamClosedTimeout(int seconds);
+
+    int streamMemoryBudgetMb() const;
+    void setStreamMemoryBudgetMb(int megabytes);
+
+    bool spillExpiredStreams() const;
+    void setSpillExpiredStreams(bool enabled);
+
+    int burstBucketMs() const;
+    void setBurstBucketMs(int milliseconds);
+
+    int topTalkersCount() const;
+    void setTopTalkersCount(int count);
+
+    int topTalkersWindow() const;
+    void setTopTalkersWindow(int seconds);
+
+    bool metricsEnabled() const;
+    void setMetricsEnabled(bool enabled);
+
+    QString metricsAddress() const;
+    void setMetricsAddress(const QString &address);
+
+    int metricsPort() const;
+    void setMetricsPort(int port);
+
+    // JSON anomaly rules, reloaded by running captures when it changes.
+    QString anomalyRulesPath() const;
+    void setAnomalyRulesPath(const QString &path);
+
+    // Quiet seconds after which an anomaly incident is closed.
+    int anomalyCooldownSeconds() const;
+    void setAnomalyCooldownSeconds(int seconds);
+
+    // Keep packets only around anomaly incidents, written per incident.
+    bool incidentRetention() const;
+    void setIncidentRetention(bool enabled);
+
+    int retentionBeforeSeconds() const;
+    void setRetentionBeforeSeconds(int seconds);
+
+    int retentionAfterSeconds() const;
+    void setRetentionAfterSeconds(int seconds);
+
 private:
     QSettings &settings() const;
 
@@ -1,6 +1,7 @@
 #include "followstreamdialog.h"
 
-#include "payloadformatter.h"
+#include "streamlistmodel.h"
+#include "streampayloadview.h"
 #include "protocols/proto_struct.h"
 
 #include <QApplication>
@@ -8,28 +9,26 @@
 #include <QCheckBox>
 #include <QClipboard>
 #include <QComboBox>
-#include <QDateTime>
-#include <QTimeZone>
 #include <QDialogButtonBox>
 #include <QFileDialog>
 #include <QFile>
 #include <QFontDatabase>
 #include <QGridLayout>
 #include <QHBoxLayout>
+#include <QItemSelectionModel>
 #include <QLabel>
 #include <QLineEdit>
-#include <QListWidget>
-#include <QListWidgetItem>
+#include <QListView>
 #include <QLocale>
-#include <QPlainTextEdit>
 #include <QPushButton>
-#include <QTextCursor>
-#include <QTextDocument>
-#include <QTextStream>
+#include <QSortFilterProxyModel>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QStringList>
 
 namespace {
+constexpr int kStreamPollIntervalMs = 1000;
+
 QString formatEndpoint(const Sniffing::StreamEndpoint &endpoint)
 {
     return QStringLiteral("%1:%2").arg(endpoint.address, QString::number(endpoint.port));
@@ -45,6 +44,13 @@ FollowStreamDialog::FollowStreamDialog(Sniffing *sniffer, QWidget *parent)
     initializeUI();
     ensurePayloadFont();
     updateSearchControls();
+    reloadStreams();
+
+    // Deltas are proportional to what changed, so the list can follow a live
+    // capture without stalling it.
+    streamPollTimer = new QTimer(this);
+    connect(streamPollTimer, &QTimer::timeout, this, &FollowStreamDialog::pollStreamChanges);
+    streamPollTimer->start(kStreamPollIntervalMs);
 }
 
 void FollowStreamDialog::initializeUI()
@@ -59,9 +65,17 @@ void FollowStreamDialog::initializeUI()
     connect(filterEdit, &QLineEdit::textChanged, this, &FollowStreamDialog::onFilterTextChanged);
     leftLayout->addWidget(filterEdit);
 
-    streamList = new QListWidget(this);
+    streamModel = new StreamListModel(this);
+    streamProxy = new QSortFilterProxyModel(this);
+    streamProxy->setSourceModel(streamModel);
+    streamProxy->setFilterRole(StreamListModel::SearchTextRole);
+    streamProxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
+
+    streamList = new QListView(this);
+    streamList->setModel(streamProxy);
     streamList->setSelectionMode(QAbstractItemView::SingleSelection);
-    connect(streamList, &QListWidget::currentRowChanged,
+    streamList->setUniformItemSizes(true);
+    connect(streamList->selectionModel(), &QItemSelectionModel::currentChanged,
             this, &FollowStreamDialog::onStreamSelectionChanged);
     leftLayout->addWidget(streamList, 1);
 
@@ -149,9 +163,9 @@ void FollowStreamDialog::initializeUI()
 
     rightLayout->addLayout(searchLayout);
 
-    payloadView = new QPlainTextEdit(this);
-    payloadView->setReadOnly(true);
-    payloadView->setLineWrapMode(QPlainTextEdit::NoWrap);
+    payloadView = new StreamPayloadView(this);
+    connect(payloadView, &StreamPayloadView::contentChanged,
+            this, &FollowStreamDialog::updateActionButtons);
     rightLayout->addWidget(payloadView, 1);
 
     auto *actionsLayout = new QHBoxLayout;
@@ -182,87 +196,90 @@ void FollowStreamDialog::ensurePayloadFont()
     payloadView->setFont(font);
 }
 
-void FollowStreamDialog::setStreams(const QVector<Sniffing::StreamConversation> &streams)
-{
-    m_streams = streams;
-    populateStreamList();
-    selectDefaultStream();
-    updatePayload();
-}
-
-void FollowStreamDialog::populateStreamList()
+void FollowStreamDialog::pollStreamChanges()
 {
-    if (!streamList)
+    const Sniffing::StreamDelta delta = Sniffing::streamChangesSince(m_streamRevision);
+    m_streamRevision = delta.revision;
+    if (!delta.reset && delta.changed.isEmpty() && delta.removed.isEmpty())
         return;
 
-    const QString filter = filterEdit ? filterEdit->text().trimmed() : QString();
-    streamList->clear();
-    m_filteredIndices.clear();
-
-    Qt::CaseSensitivity cs = Qt::CaseInsensitive;
-    QLocale locale;
-
-    for (int i = 0; i < m_streams.size(); ++i) {
-        const auto &conv = m_streams.at(i);
-        QString label = conv.label();
-        QString endpoints = QStringLiteral("%1 ⇄ %2")
-            .arg(formatEndpoint(conv.endpointA), formatEndpoint(conv.endpointB));
-        QString meta = QStringLiteral("%1 packets | %2 → %3: %4 B | %3 → %2: %5 B")
-            .arg(locale.toString(conv.packetCount))
-            .arg(formatEndpoint(conv.endpointA))
-            .arg(formatEndpoint(conv.endpointB))
-            .arg(locale.toString(conv.totalBytesAToB))
-            .arg(locale.toString(conv.totalBytesBToA));
-
-        QString searchable = label + ' ' + endpoints + ' ' + meta;
-        if (!filter.isEmpty() && !searchable.contains(filter, cs))
-            continue;
-
-        auto *item = new QListWidgetItem(QStringLiteral("%1\n%2\n%3")
-                                              .arg(label, endpoints, meta), streamList);
-        item->setData(Qt::UserRole, i);
-        m_filteredIndices.append(i);
-    }
+    m_applyingDelta = true;
+    streamModel->applyDelta(delta);
+    restoreSelection();
+    m_applyingDelta = false;
 
-    if (streamList->count() == 0) {
+    if (streamProxy->rowCount() == 0) {
         statsLabel->setText(tr("No streams available."));
         directionLabel->clear();
+    } else if (m_selectedId == 0) {
+        selectDefaultStream();
     }
 }
 
+void FollowStreamDialog::restoreSelection()
+{
+    if (m_selectedId == 0)
+        return;
+    const int row = streamModel->rowForId(m_selectedId);
+    if (row < 0)
+        return;
+    const QModelIndex index = streamProxy->mapFromSource(streamModel->index(row));
+    if (index.isValid() && streamList->currentIndex() != index)
+        streamList->setCurrentIndex(index);
+}
+
 void FollowStreamDialog::selectDefaultStream()
 {
     if (!streamList)
         return;
-    if (streamList->count() > 0) {
-        if (streamList->currentRow() < 0)
-            streamList->setCurrentRow(0);
+    if (streamProxy->rowCount() > 0) {
+        if (!streamList->currentIndex().isValid())
+            streamList->setCurrentIndex(streamProxy->index(0, 0));
     }
     else {
-        streamList->setCurrentRow(-1);
+        streamList->setCurrentIndex(QModelIndex());
     }
 }
 
-int FollowStreamDialog::currentStreamIndex() const
+quint64 FollowStreamDialog::currentStreamId() const
 {
     if (!streamList)
-        return -1;
-    if (auto *item = streamList->currentItem())
-        return item->data(Qt::UserRole).toInt();
-    return -1;
+        return 0;
+    const QModelIndex index = streamList->currentIndex();
+    return index.isValid() ? index.data(StreamListModel::StreamIdRole).toULongLong() : 0;
+}
+
+void FollowStreamDialog::loadCurrentStream()
+{
+    m_current.reset();
+    if (m_selectedId == 0)
+        return;
+    auto conversation = std::make_shared<Sniffing::StreamConversation>();
+    if (Sniffing::streamConversation(m_selectedId, conversation.get()))
+        m_current = std::move(conversation);
 }
 
 void FollowStreamDialog::onStreamSelectionChanged()
 {
-    const int index = currentStreamIndex();
-    if (index < 0 || index >= m_streams.size()) {
+    // Model resets briefly drop the current index; the selection is restored
+    // right after, so keep showing the flow that was loaded.
+    if (m_applyingDelta)
+        return;
+
+    const quint64 id = currentStreamId();
+    if (id == m_selectedId && m_current)
+        return;
+
+    m_selectedId = id;
+    loadCurrentStream();
+    if (!m_current) {
         payloadView->clear();
         statsLabel->setText(tr("No streams available."));
         directionCombo->clear();
         return;
     }
 
-    updateDirectionCombo(m_streams.at(index));
+    updateDirectionCombo(*m_current);
     updatePayload();
 }
 
@@ -287,170 +304,6 @@ void FollowStreamDialog::updateDirectionCombo(const Sniffing::StreamConversation
                             .arg(conv.label(), initiator));
 }
 
-bool FollowStreamDialog::shouldIncludeSegment(const Sniffing::StreamSegment &segment) const
-{
-    return showEmptyCheck && showEmptyCheck->isChecked() ? true : !segment.payload.isEmpty();
-}
-
-QString FollowStreamDialog::currentDirectionString(const Sniffing::StreamConversation &conv, bool fromAtoB) const
-{
-    const QString a = formatEndpoint(conv.endpointA);
-    const QString b = formatEndpoint(conv.endpointB);
-    return fromAtoB ? QStringLiteral("%1 → %2").arg(a, b)
-                    : QStringLiteral("%1 → %2").arg(b, a);
-}
-
-QString FollowStreamDialog::tcpFlagsToString(quint8 flags) const
-{
-    QStringList parts;
-    if (flags & TH_FIN) parts << QStringLiteral("FIN");
-    if (flags & TH_SYN) parts << QStringLiteral("SYN");
-    if (flags & TH_RST) parts << QStringLiteral("RST");
-    if (flags & TH_PUSH) parts << QStringLiteral("PSH");
-    if (flags & TH_ACK) parts << QStringLiteral("ACK");
-    if (flags & TH_URG) parts << QStringLiteral("URG");
-#ifdef TH_ECE
-    if (flags & TH_ECE) parts << QStringLiteral("ECE");
-#endif
-#ifdef TH_CWR
-    if (flags & TH_CWR) parts << QStringLiteral("CWR");
-#endif
-    if (parts.isEmpty())
-        return QStringLiteral("0x%1").arg(flags, 2, 16, QLatin1Char('0')).toUpper();
-    return parts.join(QLatin1Char('|'));
-}
-
-QString FollowStreamDialog::buildSegmentBlock(const Sniffing::StreamConversation &conv,
-                                              const Sniffing::StreamSegment &segment,
-                                              qint64 baseSec,
-                                              qint64 baseUsec) const
-{
-    QStringList lines;
-    if (metadataCheck && metadataCheck->isChecked()) {
-        QString timestamp;
-        if (relativeTimeCheck && relativeTimeCheck->isChecked()) {
-            qint64 secDiff = segment.timestampSeconds - baseSec;
-            qint64 usecDiff = segment.timestampMicros - baseUsec;
-            double delta = double(secDiff) + double(usecDiff) / 1'000'000.0;
-            timestamp = QStringLiteral("+%1 s").arg(delta, 0, 'f', 6);
-        } else {
-            QDateTime dt = QDateTime::fromSecsSinceEpoch(segment.timestampSeconds, QTimeZone::UTC);
-            dt = dt.addMSecs(segment.timestampMicros / 1000.0);
-            timestamp = dt.toString(Qt::ISODateWithMs);
-        }
-        QString header = QStringLiteral("[%1] %2  payload=%3 B")
-            .arg(timestamp,
-                 currentDirectionString(conv, segment.fromAtoB))
-            .arg(segment.payloadLength);
-        if (segment.isTcp) {
-            header += QStringLiteral("  seq=%1 ack=%2 win=%3 flags=%4")
-                .arg(segment.sequenceNumber)
-                .arg(segment.acknowledgementNumber)
-                .arg(segment.windowSize)
-                .arg(tcpFlagsToString(segment.tcpFlags));
-        }
-        lines << header;
-    }
-
-    if (!segment.payload.isEmpty())
-        lines << formatPayload(segment.payload);
-
-    return lines.join(QLatin1Char('\n'));
-}
-
-QString FollowStreamDialog::formatPayload(const QByteArray &payload) const
-{
-    if (!formatCombo)
-        return QString();
-
-    switch (static_cast<FormatMode>(formatCombo->currentIndex())) {
-    case Ascii:
-        return PayloadFormatter::toAscii(payload);
-    case HexDump:
-        return formatHexDump(payload);
-    case AsciiHexTable:
-        return formatAsciiHexTable(payload);
-    case CEscaped:
-        return formatEscaped(payload);
-    case Base64:
-        return QString::fromLatin1(payload.toBase64());
-    }
-    return {};
-}
-
-QString FollowStreamDialog::formatHexDump(const QByteArray &payload) const
-{
-    if (payload.isEmpty())
-        return {};
-
-    QString output;
-    QTextStream stream(&output);
-    const int lineWidth = 16;
-    for (int offset = 0; offset < payload.size(); offset += lineWidth) {
-        QByteArray chunk = payload.mid(offset, lineWidth);
-        stream << QStringLiteral("%1  ").arg(offset, 6, 16, QLatin1Char('0')).toUpper();
-        for (int i = 0; i < chunk.size(); ++i) {
-            stream << QStringLiteral("%1 ").arg(static_cast<unsigned char>(chunk[i]), 2, 16, QLatin1Char('0')).toUpper();
-        }
-        stream << '\n';
-    }
-    return output.trimmed();
-}
-
-QString FollowStreamDialog::formatAsciiHexTable(const QByteArray &payload) const
-{
-    if (payload.isEmpty())
-        return {};
-
-    QString output;
-    QTextStream stream(&output);
-    const int lineWidth = 16;
-    for (int offset = 0; offset < payload.size(); offset += lineWidth) {
-        QByteArray chunk = payload.mid(offset, lineWidth);
-        stream << QStringLiteral("%1  ").arg(offset, 6, 16, QLatin1Char('0')).toUpper();
-        for (int i = 0; i < chunk.size(); ++i) {
-            stream << QStringLiteral("%1 ").arg(static_cast<unsigned char>(chunk[i]), 2, 16, QLatin1Char('0')).toUpper();
-            if (i == 7)
-                stream << ' ';
-        }
-        if (chunk.size() < lineWidth) {
-            const int missing = lineWidth - chunk.size();
-            for (int i = 0; i < missing; ++i) {
-                stream << "   ";
-                if (chunk.size() + i == 7)
-                    stream << ' ';
-            }
-        }
-        stream << " |" << PayloadFormatter::toAscii(chunk) << "|\n";
-    }
-    return output.trimmed();
-}
-
-QString FollowStreamDialog::formatEscaped(const QByteArray &payload) const
-{
-    if (payload.isEmpty())
-        return {};
-
-    QString output;
-    output.reserve(payload.size() * 4);
-    for (unsigned char ch : payload) {
-        switch (ch) {
-        case '\\': output += QLatin1String("\\\\"); break;
-        case '\n': output += QLatin1String("\\n"); break;
-        case '\r': output += QLatin1String("\\r"); break;
-        case '\t': output += QLatin1String("\\t"); break;
-        case '\"': output += QLatin1String("\\\""); break;
-        default:
-            if (ch >= 0x20 && ch <= 0x7E) {
-                output.append(QChar::fromLatin1(static_cast<char>(ch)));
-            } else {
-                output += QStringLiteral("\\x%1").arg(ch, 2, 16, QLatin1Char('0')).toUpper();
-            }
-        }
-    }
-    return output;
-}
-
 void FollowStreamDialog::updateStats(const Sniffing::StreamConversation &conv)
 {
     if (!statsLabel)
@@ -484,6 +337,24 @@ void FollowStreamDialog::updateStats(const Sniffing::StreamConversation &conv)
         .arg(locale.toString(conv.totalBytesAToB))
         .arg(locale.toString(conv.totalBytesBToA))
         .arg(locale.toString(duration, 'f', 6));
+    if (conv.protocol == IPPROTO_TCP) {
+        const auto &ab = conv.reassemblyAToB;
+        const auto &ba = conv.reassemblyBToA;
+        summary += tr("\nRetransmitted %1 B | Out-of-order %2 | Missing %3 B | Pending %4 B")
+            .arg(locale.toString(ab.retransmittedBytes() + ba.retransmittedBytes()))
+            .arg(locale.toString(ab.outOfOrderSegments() + ba.outOfOrderSegments()))
+            .arg(locale.toString(ab.skippedBytes() + ba.skippedBytes()))
+            .arg(locale.toString(ab.bufferedBytes() + ba.bufferedBytes()));
+    }
+    const auto table = Sniffing::streamTableStats();
+    if (table.expiredFlows > 0 || table.evictedFlows > 0) {
+        summary += tr("\nStream table: %1 flows, %2 | Expired %3 | Evicted %4 (%5)")
+            .arg(locale.toString(table.activeFlows))
+            .arg(locale.formattedDataSize(table.bytesInUse))
+            .arg(locale.toString(table.expiredFlows))
+            .arg(locale.toString(table.evictedFlows))
+            .arg(locale.formattedDataSize(qint64(table.evictedBytes)));
+    }
     statsLabel->setText(summary);
 }
 
@@ -492,76 +363,62 @@ void FollowStreamDialog::updatePayload()
     if (!payloadView)
         return;
 
-    payloadView->setLineWrapMode(wrapCheck && wrapCheck->isChecked()
-                                 ? QPlainTextEdit::WidgetWidth
-                                 : QPlainTextEdit::NoWrap);
+    payloadView->setWrapEnabled(wrapCheck && wrapCheck->isChecked());
 
-    const int index = currentStreamIndex();
-    if (index < 0 || index >= m_streams.size()) {
-        payloadView->setPlainText(tr("No streams available."));
-        copyButton->setEnabled(false);
-        saveButton->setEnabled(false);
+    if (!m_current) {
+        payloadView->setPlaceholderText(tr("No streams available."));
+        payloadView->clear();
         return;
     }
 
-    const auto &conv = m_streams.at(index);
+    const auto &conv = *m_current;
     updateStats(conv);
 
-    qint64 baseSec = conv.segments.isEmpty() ? 0 : conv.segments.first().timestampSeconds;
-    qint64 baseUsec = conv.segments.isEmpty() ? 0 : conv.segments.first().timestampMicros;
-    const int directionMode = directionCombo ? directionCombo->currentIndex() : 0;
-
-    QStringList blocks;
-    blocks.reserve(conv.segments.size());
-    for (const auto &segment : conv.segments) {
-        if (directionMode == 1 && !segment.fromAtoB)
-            continue;
-        if (directionMode == 2 && segment.fromAtoB)
-            continue;
-        if (!shouldIncludeSegment(segment))
-            continue;
-        QString block = buildSegmentBlock(conv, segment, baseSec, baseUsec);
-        if (!block.isEmpty())
-            blocks << block;
+    StreamTextFormatter::Options options;
+    options.format = static_cast<StreamTextFormatter::Format>(formatCombo ? formatCombo->currentIndex() : 0);
+    options.direction = static_cast<StreamTextFormatter::Direction>(directionCombo ? qMax(0, directionCombo->currentIndex()) : 0);
+    options.metadata = metadataCheck && metadataCheck->isChecked();
+    options.relativeTime = relativeTimeCheck && relativeTimeCheck->isChecked();
+    options.includeEmpty = showEmptyCheck && showEmptyCheck->isChecked();
+    if (!conv.segments.isEmpty()) {
+        options.baseSec = conv.segments.first().timestampSeconds;
+        options.baseUsec = conv.segments.first().timestampMicros;
     }
 
-    if (blocks.isEmpty()) {
-        payloadView->setPlainText(tr("No payload data available for the selected options."));
-    } else {
-        QString text;
-        for (int i = 0; i < blocks.size(); ++i) {
-            if (i != 0)
-                text += QLatin1String("\n\n");
-            text += blocks.at(i);
-        }
-        payloadView->setPlainText(text);
-    }
+    payloadView->setPlaceholderText(tr("No payload data available for the selected options."));
+    payloadView->setStream(m_current, options);
+    updateSearchControls();
+}
 
-    const bool hasContent = !payloadView->document()->isEmpty();
+void FollowStreamDialog::updateActionButtons()
+{
+    const bool hasContent = payloadView && !payloadView->isEmpty() && !payloadView->isIndexing();
     if (copyButton)
         copyButton->setEnabled(hasContent);
     if (saveButton)
         saveButton->setEnabled(hasContent);
-    updateSearchControls();
 }
 
-void FollowStreamDialog::onFilterTextChanged(const QString &)
+void FollowStreamDialog::onFilterTextChanged(const QString &text)
 {
-    populateStreamList();
+    streamProxy->setFilterFixedString(text.trimmed());
     selectDefaultStream();
-    updatePayload();
+    if (streamProxy->rowCount() == 0) {
+        statsLabel->setText(tr("No streams available."));
+        directionLabel->clear();
+    }
 }
 
 void FollowStreamDialog::copyToClipboard()
 {
-    if (!payloadView || payloadView->document()->isEmpty())
+    if (!payloadView || payloadView->isEmpty())
         return;
     QApplication::clipboard()->setText(payloadView->toPlainText());
 }
 
 void FollowStreamDialog::saveToFile()
 {
-    if (!payloadView || payloadView->document()->isEmpty())
+    if (!payloadView || payloadView->isEmpty())
         return;
 
     const QString fileName = QFileDialog::getSaveFileName(
@@ -573,8 +430,7 @@ void FollowStreamDialog::saveToFile()
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
         return;
 
-    QTextStream stream(&file);
-    stream << payloadView->toPlainText();
+    payloadView->writeTo(&file);
 }
 
 void FollowStreamDialog::findNext()
@@ -585,16 +441,9 @@ void FollowStreamDialog::findNext()
     if (needle.isEmpty())
         return;
 
-    QTextDocument::FindFlags flags;
-    if (caseSensitiveCheck && caseSensitiveCheck->isChecked())
-        flags |= QTextDocument::FindCaseSensitively;
-
-    if (!payloadView->find(needle, flags)) {
-        QTextCursor cursor = payloadView->textCursor();
-        cursor.movePosition(QTextCursor::Start);
-        payloadView->setTextCursor(cursor);
-        payloadView->find(needle, flags);
-    }
+    const Qt::CaseSensitivity cs = caseSensitiveCheck && caseSensitiveCheck->isChecked()
+        ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    payloadView->find(needle, cs, false);
 }
 
 void FollowStreamDialog::findPrevious()
@@ -605,30 +454,32 @@ void FollowStreamDialog::findPrevious()
     if (needle.isEmpty())
         return;
 
-    QTextDocument::FindFlags flags = QTextDocument::FindBackward;
-    if (caseSensitiveCheck && caseSensitiveCheck->isChecked())
-        flags |= QTextDocument::FindCaseSensitively;
-
-    if (!payloadView->find(needle, flags)) {
-        QTextCursor cursor = payloadView->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        payloadView->setTextCursor(cursor);
-        payloadView->find(needle, flags);
-    }
+    const Qt::CaseSensitivity cs = caseSensitiveCheck && caseSensitiveCheck->isChecked()
+        ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    payloadView->find(needle, cs, true);
 }
 
 void FollowStreamDialog::reloadStreams()
 {
-    if (!m_sniffer)
+    pollStreamChanges();
+    if (m_selectedId == 0)
         return;
-    setStreams(m_sniffer->getStreamConversations());
+
+    loadCurrentStream();
+    if (m_current) {
+        updateDirectionCombo(*m_current);
+        updatePayload();
+    }
 }
 
 void FollowStreamDialog::clearStreams()
 {
     if (m_sniffer)
         m_sniffer->resetStreams();
-    setStreams(m_sniffer ? m_sniffer->getStreamConversations() : QVector<Sniffing::StreamConversation>());
+    m_selectedId = 0;
+    m_current.reset();
+    pollStreamChanges();
+    updatePayload();
 }
 
 void FollowStreamDialog::updateSearchControls()
@@ -3,10 +3,14 @@
 
 #include <QDialog>
 #include <QVector>
+#include <memory>
 #include "packets/sniffing.h"
 
-class QListWidget;
-class QPlainTextEdit;
+class QListView;
+class QSortFilterProxyModel;
+class QTimer;
+class StreamListModel;
+class StreamPayloadView;
 class QComboBox;
 class QCheckBox;
 class QLineEdit;
@@ -20,8 +24,6 @@ class FollowStreamDialog : public QDialog
 public:
     explicit FollowStreamDialog(Sniffing *sniffer, QWidget *parent = nullptr);
 
-    void setStreams(const QVector<Sniffing::StreamConversation> &streams);
-
 private slots:
     void onStreamSelectionChanged();
     void updatePayload();
@@ -31,24 +33,23 @@ private slots:
     void findNext();
     void findPrevious();
     void reloadStreams();
+    void pollStreamChanges();
     void clearStreams();
     void updateSearchControls();
+    void updateActionButtons();
 
 private:
-    enum FormatMode {
-        Ascii = 0,
-        HexDump,
-        AsciiHexTable,
-        CEscaped,
-        Base64
-    };
-
     Sniffing *m_sniffer = nullptr;
-    QVector<Sniffing::StreamConversation> m_streams;
-    QVector<int> m_filteredIndices;
+    quint64 m_streamRevision = 0;
+    quint64 m_selectedId = 0;
+    bool m_applyingDelta = false;
+    std::shared_ptr<const Sniffing::StreamConversation> m_current;
 
-    QListWidget *streamList = nullptr;
-    QPlainTextEdit *payloadView = nullptr;
+    StreamListModel *streamModel = nullptr;
+    QSortFilterProxyModel *streamProxy = nullptr;
+    QListView *streamList = nullptr;
+    QTimer *streamPollTimer = nullptr;
+    StreamPayloadView *payloadView = nullptr;
     QComboBox *directionCombo = nullptr;
     QComboBox *formatCombo = nullptr;
     QCheckBox *metadataCheck = nullptr;
@@ -68,20 +69,10 @@ private:
     QPushButton *resetButton = nullptr;
 
     void initializeUI();
-    void populateStreamList();
     void selectDefaultStream();
-    int currentStreamIndex() const;
-    bool shouldIncludeSegment(const Sniffing::StreamSegment &segment) const;
-    QString buildSegmentBlock(const Sniffing::StreamConversation &conv,
-                              const Sniffing::StreamSegment &segment,
-                              qint64 baseSec,
-                              qint64 baseUsec) const;
-    QString formatPayload(const QByteArray &payload) const;
-    QString formatHexDump(const QByteArray &payload) const;
-    QString formatAsciiHexTable(const QByteArray &payload) const;
-    QString formatEscaped(const QByteArray &payload) const;
-    QString currentDirectionString(const Sniffing::StreamConversation &conv, bool fromAtoB) const;
-    QString tcpFlagsToString(quint8 flags) const;
+    void restoreSelection();
+    void loadCurrentStream();
+    quint64 currentStreamId() const;
     void updateDirectionCombo(const Sniffing::StreamConversation &conv);
     void updateStats(const Sniffing::StreamConversation &conv);
     void ensurePayloadFont();
@@ -23,11 +23,19 @@ void MainWindow::onPacketClicked(const QModelIndex &index) {
     // const QByteArray raw = packetTable->item(row, 6)
     //                             ->data(Qt::UserRole)
     //                             .toByteArray(); //QTableWidget before QTableView
-    PacketTableRow r = packetModel->row(row);
-    const QString srcIp = r.columns.value(2);
-    const QString dstIp = r.columns.value(3);
-    const QByteArray raw = r.rawData;
-    const int linkType = r.linkType;
+    const QString srcIp = packetModel->source(row);
+    const QString dstIp = packetModel->destination(row);
+    const QByteArray raw = packetModel->rawData(row);
+    const int linkType = packetModel->linkType(row);
+    if (raw.isEmpty()) {
+        // Incident retention keeps bytes only in its capture files.
+        new QTreeWidgetItem(detailsTree, QStringList{tr("Packet bytes were not kept")});
+        detailsTree->setUpdatesEnabled(true);
+        hexEdit->clear();
+        currentPayload.clear();
+        updatePayloadView();
+        return;
+    }
 
     const u_char *pkt = reinterpret_cast<const u_char*>(raw.constData());
 
@@ -96,7 +104,8 @@ void MainWindow::showColorizeCustomizer() {
 
 
 
-QStringList MainWindow::infoColumn(const QStringList &parts, const u_char *pkt, int linkType)
+QStringList MainWindow::infoColumn(const QStringList &parts, const u_char *pkt, int linkType,
+                                    ParsedDns *parsedDns)
 {
     QStringList infoValues;
 
@@ -140,6 +149,8 @@ QStringList MainWindow::infoColumn(const QStringList &parts, const u_char *pkt,
                 ParsedDns dns = parser.parseDns(pkt, linkType);
                 if (dns.valid) {
                     handled = true;
+                    if (parsedDns)
+                        *parsedDns = dns;
                     QString mode = dns.isResponse ? tr("Response") : tr("Query");
                     if (!dns.questions.isEmpty()) {
                         const auto &q = dns.questions.first();
@@ -161,6 +172,8 @@ QStringList MainWindow::infoColumn(const QStringList &parts, const u_char *pkt,
         ParsedDns dns = parser.parseDns(pkt, linkType);
         if (dns.valid) {
             handled = true;
+            if (parsedDns)
+                *parsedDns = dns;
             QString mode = dns.isResponse ? tr("Response") : tr("Query");
             if (!dns.questions.isEmpty()) {
                 const auto &q = dns.questions.first();
@@ -317,13 +330,12 @@ void MainWindow::saveAnnotationToFile(const PacketAnnotation &annotation)
         if (item.color.isValid())
             packetObject.insert(QStringLiteral("color"), item.color.name(QColor::HexArgb));
 
-        PacketTableRow rowData = packetModel->row(item.row);
-        packetObject.insert(QStringLiteral("number"), rowData.columns.value(PacketColumns::ColumnNumber));
-        packetObject.insert(QStringLiteral("time"), rowData.columns.value(PacketColumns::ColumnTime));
-        packetObject.insert(QStringLiteral("source"), rowData.columns.value(PacketColumns::ColumnSource));
-        packetObject.insert(QStringLiteral("destination"), rowData.columns.value(PacketColumns::ColumnDestination));
-        packetObject.insert(QStringLiteral("protocol"), rowData.columns.value(PacketColumns::ColumnProtocol));
-        packetObject.insert(QStringLiteral("info"), rowData.columns.value(PacketColumns::ColumnInfo));
+        packetObject.insert(QStringLiteral("number"), packetModel->text(item.row, PacketColumns::ColumnNumber));
+        packetObject.insert(QStringLiteral("time"), packetModel->text(item.row, PacketColumns::ColumnTime));
+        packetObject.insert(QStringLiteral("source"), packetModel->source(item.row));
+        packetObject.insert(QStringLiteral("destination"), packetModel->destination(item.row));
+        packetObject.insert(QStringLiteral("protocol"), packetModel->protocol(item.row));
+        packetObject.insert(QStringLiteral("info"), packetModel->info(item.row).toString());
 
         packetArray.append(packetObject);
     }
@@ -371,10 +383,9 @@ void MainWindow::onPacketTableContextMenu(const QPoint &pos)
 
     QStringList srcList, dstList, protoList;
     for (int r : rows) {
-        PacketTableRow rowData = packetModel->row(r);
-        srcList  << rowData.columns.value(2);
-        dstList  << rowData.columns.value(3);
-        protoList << rowData.columns.value(4).toLower();
+        srcList  << packetModel->source(r);
+        dstList  << packetModel->destination(r);
+        protoList << packetModel->protocol(r).toLower();
     }
     srcList.removeDuplicates();
     dstList.removeDuplicates();
@@ -394,15 +405,14 @@ void MainWindow::onPacketTableContextMenu(const QPoint &pos)
         QVector<SelectionAnnotationDialog::PacketSummary> packetSummaries;
         packetSummaries.reserve(rows.size());
         for (int r : rows) {
-            PacketTableRow rowData = packetModel->row(r);
             SelectionAnnotationDialog::PacketSummary summary;
             summary.row = r;
-            summary.number = rowData.columns.value(PacketColumns::ColumnNumber);
-            summary.time = rowData.columns.value(PacketColumns::ColumnTime);
-            summary.source = rowData.columns.value(PacketColumns::ColumnSource);
-            summary.destination = rowData.columns.value(PacketColumns::ColumnDestination);
-            summary.protocol = rowData.columns.value(PacketColumns::ColumnProtocol);
-            summary.info = rowData.columns.value(PacketColumns::ColumnInfo);
+            summary.number = packetModel->text(r, PacketColumns::ColumnNumber);
+            summary.time = packetModel->text(r, PacketColumns::ColumnTime);
+            summary.source = packetModel->source(r);
+            summary.destination = packetModel->destination(r);
+            summary.protocol = packetModel->protocol(r);
+            summary.info = packetModel->info(r).toString();
             packetSummaries.append(summary);
         }
 
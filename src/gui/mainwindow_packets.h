@@ -4,7 +4,7 @@
 
 // void onPacketClicked(int row, int col); //QTableWidget before QTableView
 void onPacketClicked(const QModelIndex &index);
-QStringList infoColumn(const QStringList &parts, const u_char *pkt, int linkType);
+QStringList infoColumn(const QStringList &parts, const u_char *pkt, int linkType, ParsedDns *dns = nullptr);
 void onPacketTableContextMenu(const QPoint &pos);
 void addLayerToTree(QTreeWidget *tree, const PacketLayer &lay);
 void startNewSession();
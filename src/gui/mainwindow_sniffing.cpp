@@ -1,11 +1,19 @@
 #include "mainwindow_sniffing.h"
 #include "../PacketTableModel.h"
+#include "../statistics/toptalkersdialog.h"
 
 #include <QDebug>
+#include <QDir>
 #include <QStatusBar>
 #include <QTimeZone>
 #include <pcap.h>
 
+namespace {
+// Rows the packet list keeps while only incidents keep packets; about
+// 20 MB, however long the capture runs.
+constexpr int kRetentionListRows = 100000;
+}
+
 void MainWindow::startSniffing() {
     startBtn->setEnabled(false);
     stopBtn->setEnabled(true);
@@ -21,6 +29,34 @@ void MainWindow::startSniffing() {
     sessionStartTime = QDateTime::currentDateTime();
     initializeStatistics(sessionStartTime);
 
+    QString spillPath;
+    if (appSettings.spillExpiredStreams()) {
+        QString startStr = sessionStartTime.toString(Qt::ISODate);
+        startStr.replace(QLatin1Char(':'), QLatin1Char('-'));
+        spillPath = QDir(Statistics::defaultSessionsDir())
+                        .filePath(startStr + QStringLiteral(".streams.jsonl"));
+    }
+    Sniffing::setStreamSpillPath(spillPath);
+
+    const bool retention = appSettings.incidentRetention();
+    Sniffing::setRetainPackets(!retention);
+    packetModel->setRowLimit(retention ? kRetentionListRows : 0);
+    incidentRecorder.reset();
+    if (retention) {
+        incidentRecorder = std::make_unique<IncidentRecorder>(
+            sessionStartTime,
+            QDir(Statistics::defaultSessionsDir()).filePath(QStringLiteral("incidents")),
+            appSettings.retentionBeforeSeconds(),
+            appSettings.retentionAfterSeconds());
+        connect(incidentRecorder.get(), &IncidentRecorder::captureWritten,
+                this, [this](quint64 id, const QString &path, int packets) {
+                    if (QStatusBar *bar = statusBar()) {
+                        bar->showMessage(tr("Incident %1: %2 packets written to %3")
+                                             .arg(id).arg(packets).arg(path), 5000);
+                    }
+                });
+    }
+
     sessionTimer->start(1000);
     updateSessionTime();
 
@@ -34,8 +70,21 @@ void MainWindow::startSniffing() {
     statsTimer = new QTimer(this);
     connect(statsTimer, &QTimer::timeout, this, [this]() {
         if (stats) {
-            const bool saved = stats->SaveStatsToJson(Statistics::defaultSessionsDir());
-            if (!saved) {
+            // The save runs on the aggregation thread; its outcome arrives
+            // with the snapshot read on the next tick.
+            const auto snapshot = stats->latestSnapshot();
+            stats->requestSave(Statistics::defaultSessionsDir());
+            if (snapshot->lastSecond.second >= 0) {
+                packetCountLabel->setToolTip(
+                    tr("Last second: %1 packets, %2 bytes, %3 connections")
+                        .arg(snapshot->lastSecond.packets)
+                        .arg(snapshot->lastSecond.bytes)
+                        .arg(snapshot->lastSecond.connections));
+            }
+            if (topTalkersDialog && topTalkersDialog->isVisible()) {
+                topTalkersDialog->setReport(snapshot->topTalkers);
+            }
+            if (!snapshot->saveOk) {
                 if (!statsSaveWarningShown) {
                     if (QStatusBar *bar = statusBar()) {
                         bar->showMessage(tr("Failed to write statistics snapshot."), 5000);
@@ -99,6 +148,8 @@ void MainWindow::stopSniffing() {
         persistCurrentSession();
         stats.reset();
     }
+    // After the save, which may still raise incidents.
+    incidentRecorder.reset();
 }
 
 void MainWindow::handlePacket(const QByteArray &raw,
@@ -110,16 +161,17 @@ void MainWindow::handlePacket(const QByteArray &raw,
     }
     // == TIME ==
     QDateTime pktTime = QDateTime::currentDateTime();
+    Statistics::PacketDetail detail;
     bool timestampOk = false;
     if (!infos.isEmpty()) {
         const qint64 seconds = infos[0].toLongLong(&timestampOk);
         if (timestampOk) {
-            pktTime = QDateTime::fromSecsSinceEpoch(seconds, QTimeZone::UTC);
+            const qint64 micros = infos.value(2).toLongLong();
+            pktTime = QDateTime::fromMSecsSinceEpoch(seconds * 1000 + micros / 1000, QTimeZone::UTC);
+            detail.microseconds = quint16(micros % 1000);
         }
     }
     qint64 elapsedMs = sessionStartTime.msecsTo(pktTime);
-    double elapsedSec = elapsedMs / 1000.0;
-    QString time = QString::number(elapsedSec, 'f', 3);
     // ==========
 
     // int row = packetTable->rowCount();
@@ -129,10 +181,11 @@ void MainWindow::handlePacket(const QByteArray &raw,
     //     new QTableWidgetItem(QString::number(row+1)));
     // packetTable->setItem(row, 1,
     //     new QTableWidgetItem(time));  //QTableWidget before QTableView
-    int row = packetModel->rowCount();
+    // Statistics and incidents refer to packet numbers, which stay valid
+    // after old rows scroll out of a limited list.
+    const int packetNumber = packetModel->firstPacket() + packetModel->rowCount();
     PacketTableRow tableRow;
-    tableRow.columns << QString::number(row + 1)
-                     << time;
+    tableRow.timeMs = elapsedMs;
 
     const u_char *pkt = reinterpret_cast<const u_char*>(raw.constData());
     auto parts = parser.packetSummary(pkt, raw.size(), linkType);
@@ -142,18 +195,26 @@ void MainWindow::handlePacket(const QByteArray &raw,
     //         new QTableWidgetItem(parts.value(c-2)));  //QTableWidget before QTableView
     // }
 
-    tableRow.columns << parts.value(0)
-                 << parts.value(1)
-                 << parts.value(2)
-                 << parts.value(3);
+    tableRow.source = parts.value(0);
+    tableRow.destination = parts.value(1);
+    tableRow.protocol = parts.value(2);
+    tableRow.length = raw.size();
 
-    QStringList infoValues = infoColumn(parts, pkt, linkType);
+    ParsedDns dns;
+    QStringList infoValues = infoColumn(parts, pkt, linkType, &dns);
 
     // auto *infoItem = new QTableWidgetItem(infoValues.join("  "));
     // infoItem->setData(Qt::UserRole, raw);
     // packetTable->setItem(row, 6, infoItem);  //QTableWidget before QTableView
-    tableRow.columns << infoValues.join("  ");
-    tableRow.rawData = raw;
+    tableRow.info = infoValues.join("  ");
+    if (incidentRecorder) {
+        // Only the recorder's window keeps packet bytes.
+        incidentRecorder->addPacket(CapturedPacket{raw, linkType,
+                                                   infos.value(0).toLongLong(),
+                                                   infos.value(2).toLongLong()});
+    } else {
+        tableRow.rawData = raw;
+    }
     tableRow.linkType = linkType;
 
     pcap_pkthdr hdr{{ infos[0].toLongLong(), 0 },
@@ -191,7 +252,12 @@ void MainWindow::handlePacket(const QByteArray &raw,
     quint64 pktSize   = static_cast<quint64>(raw.size());
 
     if (stats) {
-        stats->recordPacket(pktTime, proto, src, dst, pktSize, row);
+        const TransportPorts ports = transportPorts(pkt, linkType);
+        detail.srcPort = ports.srcPort;
+        detail.dstPort = ports.dstPort;
+        detail.tcpFlags = ports.tcpFlags;
+        detail.dns = DnsAnalytics::message(dns);
+        stats->recordPacket(pktTime, proto, src, dst, pktSize, packetNumber, detail);
     }
 
     updateProtocolCombo();
@@ -321,6 +321,7 @@ void MainWindow::setupUI() {
         GeoOverviewDialog dlg(&geo, this);
         dlg.exec();
     });
+    statsMenu->addAction(tr("Top Talkers…"), this, &MainWindow::openTopTalkers);
     statsMenu->addAction("Session Manager...", this, &MainWindow::openSessionManager);
 
 
@@ -446,6 +447,13 @@ void MainWindow::openPreferences() {
         }
         Theme::applyTheme(appSettings.theme());
         themeToggleAction->setText(Theme::toggleActionText());
+        applyStreamSettings();
+        applyMetricsSettings();
+        if (stats) {
+            stats->setTopTalkers(appSettings.topTalkersCount(), appSettings.topTalkersWindow());
+            stats->setAnomalyRulesPath(appSettings.anomalyRulesPath());
+            stats->setIncidentCooldown(appSettings.anomalyCooldownSeconds());
+        }
 
         if (appSettings.autoStartCapture() && startBtn->isEnabled() && ifaceBox->count() > 0) {
             QTimer::singleShot(0, startBtn, &QPushButton::click);
@@ -476,7 +484,6 @@ void MainWindow::openReportBuilder()
 
 void MainWindow::openFollowStreamDialog() {
     FollowStreamDialog dlg(&parser, this);
-    dlg.setStreams(parser.getStreamConversations());
     dlg.exec();
 }
 
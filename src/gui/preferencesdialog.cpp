@@ -8,6 +8,7 @@
 #include <QHBoxLayout>
 #include <QLineEdit>
 #include <QPushButton>
+#include <QSpinBox>
 #include <QWidget>
 #include <QVBoxLayout>
 
@@ -77,6 +78,116 @@ PreferencesDialog::PreferencesDialog(AppSettings &settings,
     connect(sessionsBrowse, &QPushButton::clicked,
             this, &PreferencesDialog::chooseSessionsDirectory);
 
+    anomalyRulesEdit = new QLineEdit(settings.anomalyRulesPath(), this);
+    anomalyRulesEdit->setToolTip(tr("Edits are picked up by running captures. "
+                                    "Without the file the built-in rules apply."));
+    auto *anomalyRulesBrowse = new QPushButton(tr("Browse…"), this);
+    auto *anomalyRulesLayout = new QHBoxLayout;
+    anomalyRulesLayout->setContentsMargins(0, 0, 0, 0);
+    anomalyRulesLayout->addWidget(anomalyRulesEdit);
+    anomalyRulesLayout->addWidget(anomalyRulesBrowse);
+
+    auto *anomalyRulesWidget = new QWidget(this);
+    anomalyRulesWidget->setLayout(anomalyRulesLayout);
+    formLayout->addRow(tr("Anomaly rules"), anomalyRulesWidget);
+
+    connect(anomalyRulesBrowse, &QPushButton::clicked,
+            this, &PreferencesDialog::chooseAnomalyRulesFile);
+
+    anomalyCooldownSpin = new QSpinBox(this);
+    anomalyCooldownSpin->setRange(0, 3600);
+    anomalyCooldownSpin->setSuffix(tr(" s"));
+    anomalyCooldownSpin->setSpecialValueText(tr("Never merge"));
+    anomalyCooldownSpin->setToolTip(tr("Events sharing a tag and host within this many seconds "
+                                       "are merged into one incident. Applies to new captures."));
+    anomalyCooldownSpin->setValue(settings.anomalyCooldownSeconds());
+    formLayout->addRow(tr("Anomaly cooldown"), anomalyCooldownSpin);
+
+    retentionCheck = new QCheckBox(tr("Keep packets only around anomaly incidents"), this);
+    retentionCheck->setToolTip(tr("Holds a rolling window in memory and writes it, with the "
+                                  "seconds after, to one pcap per incident in the sessions "
+                                  "directory. The packet list keeps the newest 100,000 packets, "
+                                  "without their bytes. Applies to new captures."));
+    retentionCheck->setChecked(settings.incidentRetention());
+    formLayout->addRow(QString(), retentionCheck);
+
+    retentionBeforeSpin = new QSpinBox(this);
+    retentionBeforeSpin->setRange(0, 600);
+    retentionBeforeSpin->setSuffix(tr(" s"));
+    retentionBeforeSpin->setValue(settings.retentionBeforeSeconds());
+    formLayout->addRow(tr("Keep before incident"), retentionBeforeSpin);
+
+    retentionAfterSpin = new QSpinBox(this);
+    retentionAfterSpin->setRange(0, 600);
+    retentionAfterSpin->setSuffix(tr(" s"));
+    retentionAfterSpin->setValue(settings.retentionAfterSeconds());
+    formLayout->addRow(tr("Keep after incident"), retentionAfterSpin);
+
+    streamIdleSpin = new QSpinBox(this);
+    streamIdleSpin->setRange(0, 86400);
+    streamIdleSpin->setSuffix(tr(" s"));
+    streamIdleSpin->setSpecialValueText(tr("Never"));
+    streamIdleSpin->setValue(settings.streamIdleTimeout());
+    formLayout->addRow(tr("Stream idle timeout"), streamIdleSpin);
+
+    streamActiveSpin = new QSpinBox(this);
+    streamActiveSpin->setRange(0, 7 * 86400);
+    streamActiveSpin->setSuffix(tr(" s"));
+    streamActiveSpin->setSpecialValueText(tr("Never"));
+    streamActiveSpin->setValue(settings.streamActiveTimeout());
+    formLayout->addRow(tr("Stream active timeout"), streamActiveSpin);
+
+    streamClosedSpin = new QSpinBox(this);
+    streamClosedSpin->setRange(0, 86400);
+    streamClosedSpin->setSuffix(tr(" s"));
+    streamClosedSpin->setSpecialValueText(tr("Never"));
+    streamClosedSpin->setToolTip(tr("How long a stream closed by FIN in both directions or by RST stays in the table."));
+    streamClosedSpin->setValue(settings.streamClosedTimeout());
+    formLayout->addRow(tr("Closed stream timeout"), streamClosedSpin);
+
+    streamBudgetSpin = new QSpinBox(this);
+    streamBudgetSpin->setRange(0, 65536);
+    streamBudgetSpin->setSuffix(tr(" MB"));
+    streamBudgetSpin->setSpecialValueText(tr("Unlimited"));
+    streamBudgetSpin->setValue(settings.streamMemoryBudgetMb());
+    formLayout->addRow(tr("Stream memory budget"), streamBudgetSpin);
+
+    streamSpillCheck = new QCheckBox(tr("Write expired streams to the session directory"), this);
+    streamSpillCheck->setChecked(settings.spillExpiredStreams());
+    formLayout->addRow(QString(), streamSpillCheck);
+
+    burstBucketCombo = new QComboBox(this);
+    for (int ms : {1, 10, 100, 1000}) {
+        burstBucketCombo->addItem(tr("%1 ms").arg(ms), ms);
+    }
+    const int burstIndex = burstBucketCombo->findData(settings.burstBucketMs());
+    burstBucketCombo->setCurrentIndex(burstIndex >= 0 ? burstIndex : 1);
+    formLayout->addRow(tr("Burst bucket width"), burstBucketCombo);
+
+    topTalkersCountSpin = new QSpinBox(this);
+    topTalkersCountSpin->setRange(1, 100);
+    topTalkersCountSpin->setValue(settings.topTalkersCount());
+    formLayout->addRow(tr("Top talkers shown"), topTalkersCountSpin);
+
+    topTalkersWindowSpin = new QSpinBox(this);
+    topTalkersWindowSpin->setRange(1, 3600);
+    topTalkersWindowSpin->setSuffix(tr(" s"));
+    topTalkersWindowSpin->setValue(settings.topTalkersWindow());
+    formLayout->addRow(tr("Top talkers window"), topTalkersWindowSpin);
+
+    metricsEnabledCheck = new QCheckBox(tr("Serve OpenMetrics at /metrics"), this);
+    metricsEnabledCheck->setChecked(settings.metricsEnabled());
+    formLayout->addRow(QString(), metricsEnabledCheck);
+
+    metricsAddressEdit = new QLineEdit(settings.metricsAddress(), this);
+    metricsAddressEdit->setPlaceholderText(QStringLiteral("127.0.0.1"));
+    formLayout->addRow(tr("Metrics address"), metricsAddressEdit);
+
+    metricsPortSpin = new QSpinBox(this);
+    metricsPortSpin->setRange(1, 65535);
+    metricsPortSpin->setValue(settings.metricsPort());
+    formLayout->addRow(tr("Metrics port"), metricsPortSpin);
+
     mainLayout->addLayout(formLayout);
 
     auto *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel,
@@ -97,6 +208,22 @@ void PreferencesDialog::accept() {
     settings.setReportsDirectory(reportsDirEdit->text());
     settings.setAnomaliesDirectory(anomaliesDirEdit->text());
     settings.setSessionsDirectory(sessionsDirEdit->text());
+    settings.setAnomalyRulesPath(anomalyRulesEdit->text().trimmed());
+    settings.setAnomalyCooldownSeconds(anomalyCooldownSpin->value());
+    settings.setIncidentRetention(retentionCheck->isChecked());
+    settings.setRetentionBeforeSeconds(retentionBeforeSpin->value());
+    settings.setRetentionAfterSeconds(retentionAfterSpin->value());
+    settings.setStreamIdleTimeout(streamIdleSpin->value());
+    settings.setStreamActiveTimeout(streamActiveSpin->value());
+    settings.setStreamClosedTimeout(streamClosedSpin->value());
+    settings.setStreamMemoryBudgetMb(streamBudgetSpin->value());
+    settings.setSpillExpiredStreams(streamSpillCheck->isChecked());
+    settings.setBurstBucketMs(burstBucketCombo->currentData().toInt());
+    settings.setTopTalkersCount(topTalkersCountSpin->value());
+    settings.setTopTalkersWindow(topTalkersWindowSpin->value());
+    settings.setMetricsEnabled(metricsEnabledCheck->isChecked());
+    settings.setMetricsAddress(metricsAddressEdit->text().trimmed());
+    settings.setMetricsPort(metricsPortSpin->value());
 
     QDialog::accept();
 }
@@ -134,6 +261,21 @@ void PreferencesDialog::chooseSessionsDirectory() {
     }
 }
 
+void PreferencesDialog::chooseAnomalyRulesFile() {
+    // The file need not exist yet; the built-in rules apply until it does.
+    const QString path = QFileDialog::getSaveFileName(
+        this,
+        tr("Select anomaly rules file"),
+        anomalyRulesEdit->text().isEmpty() ? settings.anomalyRulesPath()
+                                           : anomalyRulesEdit->text(),
+        tr("JSON files (*.json)"),
+        nullptr,
+        QFileDialog::DontConfirmOverwrite);
+    if (!path.isEmpty()) {
+        anomalyRulesEdit->setText(path);
+    }
+}
+
 void PreferencesDialog::populateInterfaces(const QStringList &interfaces) {
     interfaceCombo->addItems(interfaces);
 
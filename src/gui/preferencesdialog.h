@@ -10,6 +10,7 @@
 class QCheckBox;
 class QComboBox;
 class QLineEdit;
+class QSpinBox;
 
 class PreferencesDialog : public QDialog {
     Q_OBJECT
@@ -25,6 +26,7 @@ private slots:
     void chooseReportsDirectory();
     void chooseAnomaliesDirectory();
     void chooseSessionsDirectory();
+    void chooseAnomalyRulesFile();
 
 private:
     void populateInterfaces(const QStringList &interfaces);
@@ -37,6 +39,22 @@ private:
     QLineEdit *reportsDirEdit = nullptr;
     QLineEdit *anomaliesDirEdit = nullptr;
     QLineEdit *sessionsDirEdit = nullptr;
+    QLineEdit *anomalyRulesEdit = nullptr;
+    QSpinBox *anomalyCooldownSpin = nullptr;
+    QCheckBox *retentionCheck = nullptr;
+    QSpinBox *retentionBeforeSpin = nullptr;
+    QSpinBox *retentionAfterSpin = nullptr;
+    QSpinBox *streamIdleSpin = nullptr;
+    QSpinBox *streamActiveSpin = nullptr;
+    QSpinBox *streamClosedSpin = nullptr;
+    QSpinBox *streamBudgetSpin = nullptr;
+    QCheckBox *streamSpillCheck = nullptr;
+    QComboBox *burstBucketCombo = nullptr;
+    QSpinBox *topTalkersCountSpin = nullptr;
+    QSpinBox *topTalkersWindowSpin = nullptr;
+    QCheckBox *metricsEnabledCheck = nullptr;
+    QLineEdit *metricsAddressEdit = nullptr;
+    QSpinBox *metricsPortSpin = nullptr;
 };
 
 #endif // PREFERENCESDIALOG_H
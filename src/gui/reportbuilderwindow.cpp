@@ -1,7 +1,9 @@
 #include "reportbuilderwindow.h"
 
 #include "../mainwindow.h"
-#include "../statistics/statistics.h"
+#include "../statistics/statisticsaggregator.h"
+#include "../statistics/sessionwarehouse.h"
+#include "../statistics/statisticsrollup.h"
 #include "../statistics/anomalydetector.h"
 #include "../appsettings.h"
 #include "../../packets/packet_geolocation/geolocation.h"
@@ -52,6 +54,9 @@
 #include <limits>
 
 namespace {
+// Windows at least this long are summarised from minute rollups.
+constexpr int kRollupReportSeconds = 3600;
+
 QString sectionKindLabel(ReportBuilderWindow::ReportSection::Kind kind)
 {
     switch (kind) {
@@ -87,7 +92,7 @@ QString anomalyEventId(const AnomalyDetector::Event &event)
 }
 
 ReportBuilderWindow::ReportBuilderWindow(const QVector<PacketAnnotation> &annotations,
-                                         Statistics *statistics,
+                                         StatisticsAggregator *statistics,
                                          GeoLocation *geo,
                                          AppSettings *settings,
                                          QWidget *parent)
@@ -1201,35 +1206,19 @@ void ReportBuilderWindow::sortStoredAnomalies()
 void ReportBuilderWindow::loadStatisticsSessions()
 {
     m_statisticsSessions.clear();
-    QDir dir(Statistics::defaultSessionsDir());
-    if (!dir.exists())
-        dir.mkpath(QStringLiteral("."));
-    const QStringList files = dir.entryList({QStringLiteral("*.json")}, QDir::Files, QDir::Time);
+    SessionWarehouse warehouse;
+    warehouse.sync();
+    const QVector<SessionWarehouse::Session> sessions = warehouse.sessions();
     QLocale locale;
-    for (const QString &fileName : files) {
-        QFile file(dir.filePath(fileName));
-        if (!file.open(QIODevice::ReadOnly))
-            continue;
-        const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-        file.close();
-        if (!doc.isObject())
-            continue;
-        const QJsonObject obj = doc.object();
-        const QDateTime start = QDateTime::fromString(obj.value(QStringLiteral("sessionStart")).toString(), Qt::ISODate);
-        const QDateTime end = QDateTime::fromString(obj.value(QStringLiteral("sessionEnd")).toString(), Qt::ISODate);
-        const QJsonArray perSecond = obj.value(QStringLiteral("perSecond")).toArray();
-        int maxSecond = 0;
-        for (const QJsonValue &value : perSecond)
-            maxSecond = std::max(maxSecond, value.toObject().value(QStringLiteral("second")).toInt());
-
+    for (const SessionWarehouse::Session &session : sessions) {
         StatisticsSessionInfo info;
-        info.filePath = dir.filePath(fileName);
-        info.startTime = start;
-        info.endTime = end.isValid() ? end : start;
-        info.maxSecond = maxSecond;
+        info.filePath = session.path;
+        info.startTime = session.start;
+        info.endTime = session.end;
+        info.maxSecond = session.maxSecond;
         const QString timeLabel = locale.toString(info.startTime.toLocalTime(), QLocale::ShortFormat);
         const QString endLabel = locale.toString(info.endTime.toLocalTime(), QLocale::ShortFormat);
-        info.displayLabel = QStringLiteral("%1 → %2 (%3 s)").arg(timeLabel, endLabel).arg(maxSecond);
+        info.displayLabel = QStringLiteral("%1 → %2 (%3 s)").arg(timeLabel, endLabel).arg(info.maxSecond);
         m_statisticsSessions.append(info);
     }
 
@@ -1414,7 +1403,45 @@ ReportBuilderWindow::AggregatedStats ReportBuilderWindow::aggregateStatistics(co
     int maxSecond = -1;
     bool hadSamples = false;
 
+    const bool minuteAligned = result.requestedStart % StatisticsRollup::Minutes == 0
+        && (result.requestedEnd < 0 || (result.requestedEnd + 1) % StatisticsRollup::Minutes == 0);
+
     for (const QString &filePath : files) {
+        StatisticsRollup rollup;
+        if (minuteAligned && StatisticsRollup::loadFor(filePath, &rollup)) {
+            const QVector<StatisticsRollup::Bucket> minutes
+                = rollup.query(StatisticsRollup::Minutes, result.requestedStart, result.requestedEnd);
+            const int spanEnd = result.requestedEnd >= 0 || minutes.isEmpty()
+                ? result.requestedEnd
+                : minutes.last().lastSecond;
+            if (spanEnd - result.requestedStart + 1 >= kRollupReportSeconds) {
+                // Connection counts only keep each minute's busiest pairs,
+                // which is what the top-N lists below need.
+                hadSamples = hadSamples || !minutes.isEmpty();
+                result.sessionsUsed.append(filePath);
+                for (const StatisticsRollup::Bucket &bucket : minutes) {
+                    packetsBySecond[bucket.start] += bucket.avgPackets();
+                    bytesBySecond[bucket.start] += bucket.avgBytes();
+                    result.totalPackets += double(bucket.packets);
+                    result.totalBytes += double(bucket.bytes);
+                    minSecond = std::min(minSecond, bucket.firstSecond);
+                    maxSecond = std::max(maxSecond, bucket.lastSecond);
+                    for (auto it = bucket.protocols.cbegin(); it != bucket.protocols.cend(); ++it)
+                        result.protocolTotals[it.key()] += it.value();
+                    for (auto it = bucket.connections.cbegin(); it != bucket.connections.cend(); ++it) {
+                        result.connectionCounts[it.key()] += it.value();
+                        const QString src = it.key().section(QStringLiteral(" -> "), 0, 0);
+                        const QString dst = it.key().section(QStringLiteral(" -> "), 1);
+                        if (!src.isEmpty())
+                            result.sourceCounts[src] += it.value();
+                        if (!dst.isEmpty())
+                            result.destinationCounts[dst] += it.value();
+                    }
+                }
+                continue;
+            }
+        }
+
         QFile file(filePath);
         if (!file.open(QIODevice::ReadOnly)) {
             result.error = tr("Unable to read statistics file %1").arg(filePath);
@@ -2468,8 +2495,11 @@ QString ReportBuilderWindow::anomaliesSummaryText(const ReportSection &section)
 
     lines << tr("Live anomalies detected during this session:");
     for (const auto &event : events) {
+        const QString time = event.endSecond > event.second
+            ? QStringLiteral("%1–%2").arg(event.second).arg(event.endSecond)
+            : QString::number(event.second);
         lines << tr("• [t=%1 s] Score %2 — %3")
-                   .arg(event.second)
+                   .arg(time)
                    .arg(locale.toString(event.score, 'f', 2))
                    .arg(event.summary);
         if (!event.tags.isEmpty())
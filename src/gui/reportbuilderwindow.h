@@ -29,7 +29,7 @@ class QDateEdit;
 class QVBoxLayout;
 
 class GeoLocation;
-class Statistics;
+class StatisticsAggregator;
 struct PacketAnnotation;
 class AppSettings;
 
@@ -112,7 +112,7 @@ public:
     };
 
     explicit ReportBuilderWindow(const QVector<PacketAnnotation> &annotations,
-                                 Statistics *statistics,
+                                 StatisticsAggregator *statistics,
                                  GeoLocation *geo,
                                  AppSettings *settings,
                                  QWidget *parent = nullptr);
@@ -278,7 +278,7 @@ private:
     mutable QString m_cachedLogoDataUrl;
     mutable QString m_cachedLogoPath;
 
-    Statistics *m_statistics = nullptr;
+    StatisticsAggregator *m_statistics = nullptr;
     GeoLocation *m_geo = nullptr;
     AppSettings *m_settings = nullptr;
 };
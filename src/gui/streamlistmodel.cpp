@@ -0,0 +1,183 @@
+#include "streamlistmodel.h"
+
+#include <QLocale>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+// Beyond this many structural changes a single model reset is cheaper than
+// one insert/remove notification per row.
+constexpr int kIncrementalLimit = 256;
+
+QString formatEndpoint(const Sniffing::StreamEndpoint &endpoint)
+{
+    return QStringLiteral("%1:%2").arg(endpoint.address, QString::number(endpoint.port));
+}
+}
+
+StreamListModel::StreamListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+bool StreamListModel::SortKey::operator<(const SortKey &other) const
+{
+    if (sec != other.sec)
+        return sec < other.sec;
+    if (usec != other.usec)
+        return usec < other.usec;
+    return id < other.id;
+}
+
+bool StreamListModel::SortKey::operator!=(const SortKey &other) const
+{
+    return sec != other.sec || usec != other.usec || id != other.id;
+}
+
+StreamListModel::SortKey StreamListModel::sortKeyFor(const Sniffing::StreamSummary &summary)
+{
+    return SortKey{summary.firstTimestampSec, summary.firstTimestampUsec, summary.id};
+}
+
+int StreamListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_rows.size();
+}
+
+QVariant StreamListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_rows.size())
+        return {};
+
+    const auto &summary = m_rows.at(index.row());
+    if (role == StreamIdRole)
+        return summary.id;
+    if (role != Qt::DisplayRole && role != SearchTextRole)
+        return {};
+
+    QLocale locale;
+    const QString a = formatEndpoint(summary.endpointA);
+    const QString b = formatEndpoint(summary.endpointB);
+    const QString endpoints = QStringLiteral("%1 ⇄ %2").arg(a, b);
+    const QString meta = QStringLiteral("%1 packets | %2 → %3: %4 B | %3 → %2: %5 B")
+        .arg(locale.toString(summary.packetCount))
+        .arg(a)
+        .arg(b)
+        .arg(locale.toString(summary.totalBytesAToB))
+        .arg(locale.toString(summary.totalBytesBToA));
+
+    if (role == SearchTextRole)
+        return summary.label() + QLatin1Char(' ') + endpoints + QLatin1Char(' ') + meta;
+    return QStringLiteral("%1\n%2\n%3").arg(summary.label(), endpoints, meta);
+}
+
+int StreamListModel::lowerBound(const SortKey &key) const
+{
+    const auto it = std::lower_bound(m_rows.cbegin(), m_rows.cend(), key,
+                                     [](const Sniffing::StreamSummary &row, const SortKey &value) {
+                                         return sortKeyFor(row) < value;
+                                     });
+    return int(it - m_rows.cbegin());
+}
+
+int StreamListModel::rowForId(quint64 id) const
+{
+    const auto key = m_keys.constFind(id);
+    if (key == m_keys.cend())
+        return -1;
+    const int row = lowerBound(key.value());
+    return row < m_rows.size() && m_rows.at(row).id == id ? row : -1;
+}
+
+quint64 StreamListModel::idAt(int row) const
+{
+    return row >= 0 && row < m_rows.size() ? m_rows.at(row).id : 0;
+}
+
+void StreamListModel::clear()
+{
+    beginResetModel();
+    m_rows.clear();
+    m_keys.clear();
+    endResetModel();
+}
+
+void StreamListModel::applyDelta(const Sniffing::StreamDelta &delta)
+{
+    int structural = delta.removed.size();
+    for (const auto &summary : delta.changed) {
+        const auto key = m_keys.constFind(summary.id);
+        if (key == m_keys.cend() || key.value() != sortKeyFor(summary))
+            ++structural;
+    }
+    if (delta.reset || structural > kIncrementalLimit) {
+        rebuild(delta);
+        return;
+    }
+
+    for (quint64 id : delta.removed) {
+        const int row = rowForId(id);
+        if (row < 0)
+            continue;
+        beginRemoveRows(QModelIndex(), row, row);
+        m_rows.remove(row);
+        m_keys.remove(id);
+        endRemoveRows();
+    }
+
+    for (const auto &summary : delta.changed) {
+        const SortKey key = sortKeyFor(summary);
+        int row = rowForId(summary.id);
+        if (row >= 0 && m_keys.value(summary.id) != key) {
+            beginRemoveRows(QModelIndex(), row, row);
+            m_rows.remove(row);
+            endRemoveRows();
+            row = -1;
+        }
+        if (row >= 0) {
+            m_rows[row] = summary;
+            emit dataChanged(index(row), index(row));
+            continue;
+        }
+        row = lowerBound(key);
+        beginInsertRows(QModelIndex(), row, row);
+        m_rows.insert(row, summary);
+        m_keys.insert(summary.id, key);
+        endInsertRows();
+    }
+}
+
+void StreamListModel::rebuild(const Sniffing::StreamDelta &delta)
+{
+    QVector<Sniffing::StreamSummary> rows;
+    if (!delta.reset) {
+        QSet<quint64> dropped(delta.removed.cbegin(), delta.removed.cend());
+        for (const auto &summary : delta.changed)
+            dropped.insert(summary.id);
+        rows.reserve(m_rows.size() + delta.changed.size());
+        for (const auto &row : std::as_const(m_rows)) {
+            if (!dropped.contains(row.id))
+                rows.append(row);
+        }
+    }
+    const int kept = rows.size();
+    rows.append(delta.changed);
+    std::sort(rows.begin() + kept, rows.end(),
+              [](const Sniffing::StreamSummary &lhs, const Sniffing::StreamSummary &rhs) {
+                  return sortKeyFor(lhs) < sortKeyFor(rhs);
+              });
+    std::inplace_merge(rows.begin(), rows.begin() + kept, rows.end(),
+                       [](const Sniffing::StreamSummary &lhs, const Sniffing::StreamSummary &rhs) {
+                           return sortKeyFor(lhs) < sortKeyFor(rhs);
+                       });
+
+    beginResetModel();
+    m_rows = std::move(rows);
+    m_keys.clear();
+    m_keys.reserve(m_rows.size());
+    for (const auto &row : std::as_const(m_rows))
+        m_keys.insert(row.id, sortKeyFor(row));
+    endResetModel();
+}
@@ -0,0 +1,50 @@
+#ifndef STREAMLISTMODEL_H
+#define STREAMLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QVector>
+
+#include "packets/sniffing.h"
+
+// Flow summaries ordered by first timestamp. Deltas from
+// Sniffing::streamChangesSince() are merged in place, so a refresh only costs
+// as much as the number of flows that changed.
+class StreamListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles {
+        StreamIdRole = Qt::UserRole,
+        SearchTextRole
+    };
+
+    explicit StreamListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void applyDelta(const Sniffing::StreamDelta &delta);
+    void clear();
+
+    int rowForId(quint64 id) const;
+    quint64 idAt(int row) const;
+
+private:
+    struct SortKey {
+        qint64 sec = 0;
+        qint64 usec = 0;
+        quint64 id = 0;
+        bool operator<(const SortKey &other) const;
+        bool operator!=(const SortKey &other) const;
+    };
+
+    static SortKey sortKeyFor(const Sniffing::StreamSummary &summary);
+    int lowerBound(const SortKey &key) const;
+    void rebuild(const Sniffing::StreamDelta &delta);
+
+    QVector<Sniffing::StreamSummary> m_rows;
+    QHash<quint64, SortKey> m_keys;
+};
+
+#endif // STREAMLISTMODEL_H
@@ -0,0 +1,416 @@
+#include "streampayloadview.h"
+
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTextStream>
+#include <QTimer>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
+
+namespace {
+constexpr int kPublishIntervalMs = 50;
+constexpr int kBlockCacheLines = 20000;
+constexpr int kRelayoutDelayMs = 150;
+}
+
+StreamPayloadView::StreamPayloadView(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , m_blockCache(kBlockCacheLines)
+{
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    viewport()->setBackgroundRole(QPalette::Base);
+    viewport()->setAutoFillBackground(true);
+
+    m_relayoutTimer = new QTimer(this);
+    m_relayoutTimer->setSingleShot(true);
+    m_relayoutTimer->setInterval(kRelayoutDelayMs);
+    connect(m_relayoutTimer, &QTimer::timeout, this, &StreamPayloadView::startIndexing);
+}
+
+StreamPayloadView::~StreamPayloadView()
+{
+    // Workers post results back to this object, so they must be gone first.
+    cancelJobs();
+    m_jobs.waitForFinished();
+}
+
+void StreamPayloadView::setStream(std::shared_ptr<const Sniffing::StreamConversation> conversation,
+                                  const StreamTextFormatter::Options &options)
+{
+    m_conversation = std::move(conversation);
+    m_options = options;
+    startIndexing();
+}
+
+void StreamPayloadView::clear()
+{
+    m_conversation.reset();
+    startIndexing();
+}
+
+void StreamPayloadView::setPlaceholderText(const QString &text)
+{
+    m_placeholder = text;
+    viewport()->update();
+}
+
+void StreamPayloadView::setWrapEnabled(bool enabled)
+{
+    m_wrap = enabled;
+}
+
+void StreamPayloadView::cancelJobs()
+{
+    if (m_indexCancel)
+        m_indexCancel->store(true);
+    if (m_searchCancel)
+        m_searchCancel->store(true);
+}
+
+void StreamPayloadView::trackJob(const QFuture<void> &job)
+{
+    const QList<QFuture<void>> running = m_jobs.futures();
+    m_jobs.clearFutures();
+    for (const QFuture<void> &future : running) {
+        if (!future.isFinished())
+            m_jobs.addFuture(future);
+    }
+    m_jobs.addFuture(job);
+}
+
+int StreamPayloadView::wrapColumns() const
+{
+    if (!m_wrap)
+        return 0;
+    const int charWidth = qMax(1, fontMetrics().horizontalAdvance(QLatin1Char('M')));
+    return qMax(16, viewport()->width() / charWidth);
+}
+
+int StreamPayloadView::visibleLines() const
+{
+    return qMax(1, viewport()->height() / qMax(1, fontMetrics().height()));
+}
+
+void StreamPayloadView::startIndexing()
+{
+    cancelJobs();
+    ++m_generation;
+    m_blocks.clear();
+    m_blockCache.clear();
+    m_lineCount = 0;
+    m_maxColumns = 0;
+    m_match = Hit();
+    m_matchLength = 0;
+    m_options.wrapColumns = wrapColumns();
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+
+    m_indexing = bool(m_conversation);
+    updateScrollBars();
+    viewport()->update();
+    emit contentChanged();
+    if (!m_conversation)
+        return;
+
+    auto cancel = std::make_shared<std::atomic_bool>(false);
+    m_indexCancel = cancel;
+    const quint64 generation = m_generation;
+    const auto conversation = m_conversation;
+    const auto options = m_options;
+
+    trackJob(QtConcurrent::run([this, cancel, generation, conversation, options]() {
+        QVector<Block> batch;
+        int maxColumns = 0;
+        qint64 nextLine = 0;
+        QElapsedTimer sinceLastPublish;
+        sinceLastPublish.start();
+
+        auto publish = [&](bool finished) {
+            QMetaObject::invokeMethod(this, [this, generation, batch, maxColumns, finished]() {
+                appendBlocks(generation, batch, maxColumns, finished);
+            }, Qt::QueuedConnection);
+            batch.clear();
+            sinceLastPublish.restart();
+        };
+
+        const auto &segments = conversation->segments;
+        for (int i = 0; i < segments.size(); ++i) {
+            if (cancel->load())
+                return;
+            const auto &segment = segments.at(i);
+            if (!StreamTextFormatter::includesSegment(segment, options))
+                continue;
+            const QStringList lines = StreamTextFormatter::segmentLines(*conversation, segment, options);
+            if (lines.isEmpty())
+                continue;
+            for (const QString &line : lines)
+                maxColumns = qMax(maxColumns, int(line.size()));
+            const int lineCount = int(lines.size()) + 1;
+            batch.append(Block{i, nextLine, lineCount});
+            nextLine += lineCount;
+            if (sinceLastPublish.elapsed() >= kPublishIntervalMs)
+                publish(false);
+        }
+        publish(true);
+    }));
+}
+
+void StreamPayloadView::appendBlocks(quint64 generation,
+                                     const QVector<Block> &blocks,
+                                     int maxColumns,
+                                     bool finished)
+{
+    if (generation != m_generation)
+        return;
+
+    m_blocks += blocks;
+    if (!m_blocks.isEmpty())
+        m_lineCount = m_blocks.last().firstLine + m_blocks.last().lineCount;
+    m_maxColumns = qMax(m_maxColumns, maxColumns);
+    if (finished)
+        m_indexing = false;
+
+    updateScrollBars();
+    viewport()->update();
+    emit contentChanged();
+}
+
+void StreamPayloadView::updateScrollBars()
+{
+    const int pageLines = visibleLines();
+    const qint64 maxLine = qMax<qint64>(0, m_lineCount - pageLines);
+    verticalScrollBar()->setRange(0, int(qMin<qint64>(maxLine, std::numeric_limits<int>::max())));
+    verticalScrollBar()->setPageStep(pageLines);
+    verticalScrollBar()->setSingleStep(1);
+
+    const int charWidth = fontMetrics().horizontalAdvance(QLatin1Char('M'));
+    const int contentWidth = m_options.wrapColumns > 0 ? 0 : m_maxColumns * charWidth;
+    horizontalScrollBar()->setRange(0, qMax(0, contentWidth - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setSingleStep(charWidth);
+}
+
+int StreamPayloadView::blockForLine(qint64 line) const
+{
+    const auto it = std::upper_bound(m_blocks.cbegin(), m_blocks.cend(), line,
+                                     [](qint64 value, const Block &block) {
+                                         return value < block.firstLine;
+                                     });
+    return qMax(0, int(it - m_blocks.cbegin()) - 1);
+}
+
+QStringList StreamPayloadView::linesForBlock(int block) const
+{
+    if (const QStringList *cached = m_blockCache.object(block))
+        return *cached;
+    if (!m_conversation || block < 0 || block >= m_blocks.size())
+        return {};
+
+    const auto &segment = m_conversation->segments.at(m_blocks.at(block).segment);
+    auto *lines = new QStringList(StreamTextFormatter::segmentLines(*m_conversation, segment, m_options));
+    const QStringList result = *lines;
+    m_blockCache.insert(block, lines, qMax(1, int(lines->size())));
+    return result;
+}
+
+void StreamPayloadView::paintEvent(QPaintEvent *)
+{
+    QPainter painter(viewport());
+    const QFontMetrics metrics(font());
+    const int lineHeight = metrics.height();
+    const int charWidth = metrics.horizontalAdvance(QLatin1Char('M'));
+
+    if (m_blocks.isEmpty()) {
+        const QString text = m_indexing ? tr("Indexing stream…") : m_placeholder;
+        painter.setPen(palette().color(QPalette::PlaceholderText));
+        painter.drawText(viewport()->rect().adjusted(4, 4, -4, -4),
+                         Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, text);
+        return;
+    }
+
+    const int x = 4 - horizontalScrollBar()->value();
+    const int height = viewport()->height();
+    qint64 line = verticalScrollBar()->value();
+    int y = 0;
+    painter.setPen(palette().color(QPalette::Text));
+
+    for (int block = blockForLine(line); block < m_blocks.size() && y < height; ++block) {
+        const Block &info = m_blocks.at(block);
+        const QStringList lines = linesForBlock(block);
+        for (qint64 local = line - info.firstLine;
+             local < info.lineCount && y < height;
+             ++local, ++line, y += lineHeight) {
+            if (local >= lines.size())
+                continue;
+            if (line == m_match.line && m_matchLength > 0) {
+                painter.fillRect(x + m_match.column * charWidth, y,
+                                 m_matchLength * charWidth, lineHeight,
+                                 palette().highlight());
+            }
+            painter.drawText(x, y + metrics.ascent(), lines.at(int(local)));
+        }
+    }
+}
+
+void StreamPayloadView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+    if (m_wrap && m_conversation && wrapColumns() != m_options.wrapColumns)
+        m_relayoutTimer->start();
+}
+
+void StreamPayloadView::scrollContentsBy(int, int)
+{
+    viewport()->update();
+}
+
+void StreamPayloadView::find(const QString &needle, Qt::CaseSensitivity sensitivity, bool backward)
+{
+    if (m_searchCancel)
+        m_searchCancel->store(true);
+    if (needle.isEmpty() || m_blocks.isEmpty() || !m_conversation) {
+        emit searchFinished(false);
+        return;
+    }
+
+    Hit from = m_match;
+    if (from.line < 0) {
+        from.line = backward ? m_lineCount - 1 : verticalScrollBar()->value();
+        from.column = backward ? std::numeric_limits<int>::max() : 0;
+    } else if (!backward) {
+        from.column += 1;
+    }
+
+    auto cancel = std::make_shared<std::atomic_bool>(false);
+    m_searchCancel = cancel;
+    const quint64 generation = m_generation;
+    const auto conversation = m_conversation;
+    const auto options = m_options;
+    const auto blocks = m_blocks;
+    const int length = int(needle.size());
+
+    trackJob(QtConcurrent::run([this, cancel, generation, conversation, options, blocks,
+                                needle, sensitivity, from, backward, length]() {
+        const Hit hit = search(*conversation, options, blocks, needle, sensitivity, from, backward, *cancel);
+        if (cancel->load())
+            return;
+        QMetaObject::invokeMethod(this, [this, generation, hit, length]() {
+            applySearchResult(generation, hit, length);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+StreamPayloadView::Hit StreamPayloadView::search(const Sniffing::StreamConversation &conversation,
+                                                 const StreamTextFormatter::Options &options,
+                                                 const QVector<Block> &blocks,
+                                                 const QString &needle,
+                                                 Qt::CaseSensitivity sensitivity,
+                                                 Hit from,
+                                                 bool backward,
+                                                 const std::atomic_bool &cancel)
+{
+    const int count = blocks.size();
+    auto blockOf = [&blocks](qint64 line) {
+        const auto it = std::upper_bound(blocks.cbegin(), blocks.cend(), line,
+                                         [](qint64 value, const Block &block) {
+                                             return value < block.firstLine;
+                                         });
+        return qMax(0, int(it - blocks.cbegin()) - 1);
+    };
+
+    const int startBlock = blockOf(from.line);
+    // One extra step revisits the starting block so matches before the
+    // starting point are found after wrapping around.
+    for (int step = 0; step <= count; ++step) {
+        if (cancel.load())
+            return {};
+        const int block = backward ? (startBlock - step + count) % count
+                                   : (startBlock + step) % count;
+        const Block &info = blocks.at(block);
+        const QStringList lines = StreamTextFormatter::segmentLines(
+            conversation, conversation.segments.at(info.segment), options);
+
+        const bool first = step == 0;
+        if (!backward) {
+            const int startLine = first ? int(qMax<qint64>(0, from.line - info.firstLine)) : 0;
+            for (int i = startLine; i < lines.size(); ++i) {
+                const int column = first && i == from.line - info.firstLine ? from.column : 0;
+                const qsizetype found = lines.at(i).indexOf(needle, column, sensitivity);
+                if (found >= 0)
+                    return Hit{info.firstLine + i, int(found)};
+            }
+        } else {
+            const int startLine = first ? int(qMin<qint64>(lines.size() - 1, from.line - info.firstLine))
+                                        : int(lines.size()) - 1;
+            for (int i = startLine; i >= 0; --i) {
+                const QString &text = lines.at(i);
+                qsizetype column = text.size();
+                if (first && i == from.line - info.firstLine)
+                    column = qMin<qsizetype>(text.size(), qsizetype(from.column) - 1);
+                if (column < 0)
+                    continue;
+                const qsizetype found = text.lastIndexOf(needle, column, sensitivity);
+                if (found >= 0)
+                    return Hit{info.firstLine + i, int(found)};
+            }
+        }
+    }
+    return {};
+}
+
+void StreamPayloadView::applySearchResult(quint64 generation, const Hit &hit, int length)
+{
+    if (generation != m_generation)
+        return;
+
+    if (hit.line >= 0) {
+        m_match = hit;
+        m_matchLength = length;
+        const int page = visibleLines();
+        const int top = verticalScrollBar()->value();
+        if (hit.line < top || hit.line >= top + page)
+            verticalScrollBar()->setValue(int(qMax<qint64>(0, hit.line - page / 3)));
+
+        const int charWidth = fontMetrics().horizontalAdvance(QLatin1Char('M'));
+        const int left = hit.column * charWidth;
+        const int scrollX = horizontalScrollBar()->value();
+        if (left < scrollX || left + length * charWidth > scrollX + viewport()->width())
+            horizontalScrollBar()->setValue(qMax(0, left - viewport()->width() / 3));
+        viewport()->update();
+    }
+    emit searchFinished(hit.line >= 0);
+}
+
+QString StreamPayloadView::toPlainText() const
+{
+    QString text;
+    QTextStream stream(&text);
+    for (int block = 0; block < m_blocks.size(); ++block) {
+        if (block != 0)
+            stream << '\n';
+        for (const QString &line : linesForBlock(block))
+            stream << line << '\n';
+    }
+    return text;
+}
+
+bool StreamPayloadView::writeTo(QIODevice *device) const
+{
+    if (!device || !device->isWritable())
+        return false;
+
+    QTextStream stream(device);
+    for (int block = 0; block < m_blocks.size(); ++block) {
+        if (block != 0)
+            stream << '\n';
+        for (const QString &line : linesForBlock(block))
+            stream << line << '\n';
+    }
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
+}
@@ -0,0 +1,106 @@
+#ifndef STREAMPAYLOADVIEW_H
+#define STREAMPAYLOADVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QCache>
+#include <QFuture>
+#include <QFutureSynchronizer>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+#include "streamtextformatter.h"
+
+class QIODevice;
+class QTimer;
+
+// Read-only text view over one stream that never materialises the whole
+// text. A worker thread indexes how many lines each segment renders to; the
+// view only formats the segments that are on screen. Indexing results arrive
+// in batches, so the first screen shows up before a large stream is done.
+class StreamPayloadView : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    explicit StreamPayloadView(QWidget *parent = nullptr);
+    ~StreamPayloadView() override;
+
+    void setStream(std::shared_ptr<const Sniffing::StreamConversation> conversation,
+                   const StreamTextFormatter::Options &options);
+    void clear();
+    void setPlaceholderText(const QString &text);
+    void setWrapEnabled(bool enabled);
+
+    bool isEmpty() const { return m_blocks.isEmpty(); }
+    bool isIndexing() const { return m_indexing; }
+    qint64 lineCount() const { return m_lineCount; }
+
+    // Searches on a worker thread from the current match; searchFinished()
+    // reports the outcome and the view scrolls to the hit.
+    void find(const QString &needle, Qt::CaseSensitivity sensitivity, bool backward);
+
+    QString toPlainText() const;
+    bool writeTo(QIODevice *device) const;
+
+signals:
+    void contentChanged();
+    void searchFinished(bool found);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    struct Block {
+        int segment = 0;
+        qint64 firstLine = 0;
+        int lineCount = 0;   // includes the blank separator line
+    };
+
+    struct Hit {
+        qint64 line = -1;
+        int column = 0;
+    };
+
+    void startIndexing();
+    void appendBlocks(quint64 generation, const QVector<Block> &blocks, int maxColumns, bool finished);
+    void applySearchResult(quint64 generation, const Hit &hit, int length);
+    void cancelJobs();
+    void trackJob(const QFuture<void> &job);
+    void updateScrollBars();
+    int wrapColumns() const;
+    int visibleLines() const;
+    int blockForLine(qint64 line) const;
+    QStringList linesForBlock(int block) const;
+
+    static Hit search(const Sniffing::StreamConversation &conversation,
+                      const StreamTextFormatter::Options &options,
+                      const QVector<Block> &blocks,
+                      const QString &needle,
+                      Qt::CaseSensitivity sensitivity,
+                      Hit from,
+                      bool backward,
+                      const std::atomic_bool &cancel);
+
+    std::shared_ptr<const Sniffing::StreamConversation> m_conversation;
+    StreamTextFormatter::Options m_options;
+    bool m_wrap = false;
+    QVector<Block> m_blocks;
+    qint64 m_lineCount = 0;
+    int m_maxColumns = 0;
+    bool m_indexing = false;
+    quint64 m_generation = 0;
+    std::shared_ptr<std::atomic_bool> m_indexCancel;
+    std::shared_ptr<std::atomic_bool> m_searchCancel;
+    // Every worker still running, including ones a newer job replaced.
+    QFutureSynchronizer<void> m_jobs;
+    mutable QCache<int, QStringList> m_blockCache;
+    QString m_placeholder;
+    Hit m_match;
+    int m_matchLength = 0;
+    QTimer *m_relayoutTimer = nullptr;
+};
+
+#endif // STREAMPAYLOADVIEW_H
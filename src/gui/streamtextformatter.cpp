@@ -0,0 +1,225 @@
+#include "streamtextformatter.h"
+
+#include "payloadformatter.h"
+#include "protocols/proto_struct.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QTimeZone>
+
+namespace StreamTextFormatter {
+
+namespace {
+constexpr int kBytesPerRow = 16;
+const char kHexDigits[] = "0123456789ABCDEF";
+
+void appendHexByte(QString &line, unsigned char byte)
+{
+    line.append(QLatin1Char(kHexDigits[byte >> 4]));
+    line.append(QLatin1Char(kHexDigits[byte & 0x0F]));
+}
+
+QString offsetColumn(int offset)
+{
+    return QStringLiteral("%1  ").arg(offset, 6, 16, QLatin1Char('0')).toUpper();
+}
+
+void appendHexDump(QStringList &lines, const QByteArray &payload)
+{
+    for (int offset = 0; offset < payload.size(); offset += kBytesPerRow) {
+        const int count = qMin(kBytesPerRow, int(payload.size()) - offset);
+        QString line = offsetColumn(offset);
+        line.reserve(line.size() + count * 3);
+        for (int i = 0; i < count; ++i) {
+            appendHexByte(line, static_cast<unsigned char>(payload.at(offset + i)));
+            line.append(QLatin1Char(' '));
+        }
+        lines << line;
+    }
+}
+
+void appendAsciiHexTable(QStringList &lines, const QByteArray &payload)
+{
+    for (int offset = 0; offset < payload.size(); offset += kBytesPerRow) {
+        const int count = qMin(kBytesPerRow, int(payload.size()) - offset);
+        QString line = offsetColumn(offset);
+        line.reserve(line.size() + kBytesPerRow * 3 + kBytesPerRow + 4);
+        for (int i = 0; i < kBytesPerRow; ++i) {
+            if (i < count) {
+                appendHexByte(line, static_cast<unsigned char>(payload.at(offset + i)));
+                line.append(QLatin1Char(' '));
+            } else {
+                line.append(QLatin1String("   "));
+            }
+            if (i == 7)
+                line.append(QLatin1Char(' '));
+        }
+        line.append(QLatin1String(" |"));
+        line.append(PayloadFormatter::toAscii(payload.mid(offset, count)));
+        line.append(QLatin1Char('|'));
+        lines << line;
+    }
+}
+
+QString escaped(const QByteArray &payload)
+{
+    QString output;
+    output.reserve(payload.size() * 4);
+    for (unsigned char ch : payload) {
+        switch (ch) {
+        case '\\': output += QLatin1String("\\\\"); break;
+        case '\n': output += QLatin1String("\\n"); break;
+        case '\r': output += QLatin1String("\\r"); break;
+        case '\t': output += QLatin1String("\\t"); break;
+        case '\"': output += QLatin1String("\\\""); break;
+        default:
+            if (ch >= 0x20 && ch <= 0x7E) {
+                output.append(QChar::fromLatin1(static_cast<char>(ch)));
+            } else {
+                output += QLatin1String("\\x");
+                appendHexByte(output, ch);
+            }
+        }
+    }
+    return output;
+}
+
+void appendAsciiLines(QStringList &lines, const QByteArray &payload)
+{
+    const QString text = PayloadFormatter::toAscii(payload);
+    qsizetype start = 0;
+    while (start <= text.size()) {
+        qsizetype end = text.indexOf(QLatin1Char('\n'), start);
+        if (end < 0)
+            end = text.size();
+        qsizetype length = end - start;
+        if (length > 0 && text.at(end - 1) == QLatin1Char('\r'))
+            --length;
+        lines << text.mid(start, length);
+        start = end + 1;
+    }
+}
+
+QString metadataHeader(const Sniffing::StreamConversation &conversation,
+                       const Sniffing::StreamSegment &segment,
+                       const Options &options)
+{
+    QString timestamp;
+    if (options.relativeTime) {
+        const qint64 secDiff = segment.timestampSeconds - options.baseSec;
+        const qint64 usecDiff = segment.timestampMicros - options.baseUsec;
+        const double delta = double(secDiff) + double(usecDiff) / 1'000'000.0;
+        timestamp = QStringLiteral("+%1 s").arg(delta, 0, 'f', 6);
+    } else {
+        QDateTime dt = QDateTime::fromSecsSinceEpoch(segment.timestampSeconds, QTimeZone::UTC);
+        dt = dt.addMSecs(segment.timestampMicros / 1000);
+        timestamp = dt.toString(Qt::ISODateWithMs);
+    }
+
+    QString header = QStringLiteral("[%1] %2  payload=%3 B")
+        .arg(timestamp, directionString(conversation, segment.fromAtoB))
+        .arg(segment.payloadLength);
+    if (segment.isTcp) {
+        header += QStringLiteral("  seq=%1 ack=%2 win=%3 flags=%4")
+            .arg(segment.sequenceNumber)
+            .arg(segment.acknowledgementNumber)
+            .arg(segment.windowSize)
+            .arg(tcpFlagsToString(segment.tcpFlags));
+        if (segment.retransmission)
+            header += QCoreApplication::translate("FollowStreamDialog", "  [retransmission]");
+        else if (segment.outOfOrder)
+            header += QCoreApplication::translate("FollowStreamDialog", "  [out-of-order]");
+    }
+    return header;
+}
+
+QStringList wrapped(const QStringList &lines, int columns)
+{
+    if (columns <= 0)
+        return lines;
+
+    QStringList result;
+    result.reserve(lines.size());
+    for (const QString &line : lines) {
+        if (line.size() <= columns) {
+            result << line;
+            continue;
+        }
+        for (qsizetype offset = 0; offset < line.size(); offset += columns)
+            result << line.mid(offset, columns);
+    }
+    return result;
+}
+}
+
+bool includesSegment(const Sniffing::StreamSegment &segment, const Options &options)
+{
+    if (options.direction == Direction::AToB && !segment.fromAtoB)
+        return false;
+    if (options.direction == Direction::BToA && segment.fromAtoB)
+        return false;
+    return options.includeEmpty || !segment.payload.isEmpty();
+}
+
+QStringList segmentLines(const Sniffing::StreamConversation &conversation,
+                         const Sniffing::StreamSegment &segment,
+                         const Options &options)
+{
+    QStringList lines;
+    if (options.metadata)
+        lines << metadataHeader(conversation, segment, options);
+
+    const QByteArray &payload = segment.payload;
+    if (!payload.isEmpty()) {
+        switch (options.format) {
+        case Format::Ascii:
+            appendAsciiLines(lines, payload);
+            break;
+        case Format::HexDump:
+            appendHexDump(lines, payload);
+            break;
+        case Format::AsciiHexTable:
+            appendAsciiHexTable(lines, payload);
+            break;
+        case Format::CEscaped:
+            lines << escaped(payload);
+            break;
+        case Format::Base64:
+            lines << QString::fromLatin1(payload.toBase64());
+            break;
+        }
+    }
+    return wrapped(lines, options.wrapColumns);
+}
+
+QString directionString(const Sniffing::StreamConversation &conversation, bool fromAtoB)
+{
+    const QString a = QStringLiteral("%1:%2").arg(conversation.endpointA.address)
+                                             .arg(conversation.endpointA.port);
+    const QString b = QStringLiteral("%1:%2").arg(conversation.endpointB.address)
+                                             .arg(conversation.endpointB.port);
+    return fromAtoB ? QStringLiteral("%1 → %2").arg(a, b)
+                    : QStringLiteral("%1 → %2").arg(b, a);
+}
+
+QString tcpFlagsToString(quint8 flags)
+{
+    QStringList parts;
+    if (flags & TH_FIN) parts << QStringLiteral("FIN");
+    if (flags & TH_SYN) parts << QStringLiteral("SYN");
+    if (flags & TH_RST) parts << QStringLiteral("RST");
+    if (flags & TH_PUSH) parts << QStringLiteral("PSH");
+    if (flags & TH_ACK) parts << QStringLiteral("ACK");
+    if (flags & TH_URG) parts << QStringLiteral("URG");
+#ifdef TH_ECE
+    if (flags & TH_ECE) parts << QStringLiteral("ECE");
+#endif
+#ifdef TH_CWR
+    if (flags & TH_CWR) parts << QStringLiteral("CWR");
+#endif
+    if (parts.isEmpty())
+        return QStringLiteral("0x%1").arg(flags, 2, 16, QLatin1Char('0')).toUpper();
+    return parts.join(QLatin1Char('|'));
+}
+
+}
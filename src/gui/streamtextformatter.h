@@ -0,0 +1,52 @@
+#ifndef STREAMTEXTFORMATTER_H
+#define STREAMTEXTFORMATTER_H
+
+#include <QString>
+#include <QStringList>
+
+#include "packets/sniffing.h"
+
+// Turns stream segments into display lines. Everything here is a pure
+// function of its arguments so the Follow Stream view can index and search
+// on worker threads.
+namespace StreamTextFormatter {
+
+enum class Format {
+    Ascii = 0,
+    HexDump,
+    AsciiHexTable,
+    CEscaped,
+    Base64
+};
+
+enum class Direction {
+    Both = 0,
+    AToB,
+    BToA
+};
+
+struct Options {
+    Format format = Format::Ascii;
+    Direction direction = Direction::Both;
+    bool metadata = true;
+    bool relativeTime = true;
+    bool includeEmpty = false;
+    int wrapColumns = 0;   // 0 disables wrapping
+    qint64 baseSec = 0;    // origin for relative timestamps
+    qint64 baseUsec = 0;
+};
+
+bool includesSegment(const Sniffing::StreamSegment &segment, const Options &options);
+
+// Lines of one segment block: the optional metadata header followed by the
+// formatted payload, wrapped to options.wrapColumns.
+QStringList segmentLines(const Sniffing::StreamConversation &conversation,
+                         const Sniffing::StreamSegment &segment,
+                         const Options &options);
+
+QString directionString(const Sniffing::StreamConversation &conversation, bool fromAtoB);
+QString tcpFlagsToString(quint8 flags);
+
+}
+
+#endif // STREAMTEXTFORMATTER_H
@@ -6,8 +6,11 @@
 #include "gui/followstreamdialog.h"
 #include "statistics/sessionmanagerdialog.h"
 #include "statistics/anomalyinspectordialog.h"
+#include "statistics/toptalkersdialog.h"
+#include "statistics/metricsserver.h"
 
 #include <QComboBox>
+#include <QFile>
 #include <QFileInfo>
 #include <QLineEdit>
 #include <QTimer>
@@ -63,6 +66,8 @@ MainWindow::MainWindow(QWidget *parent)
 
     listInterfaces();
     loadPreferences();
+    applyStreamSettings();
+    applyMetricsSettings();
     packetColorizer.loadRulesFromSettings();
 }
 
@@ -99,6 +104,34 @@ void MainWindow::loadPreferences() {
     }
 }
 
+void MainWindow::applyStreamSettings() {
+    Sniffing::StreamLimits limits = Sniffing::streamLimits();
+    limits.idleTimeoutSec = appSettings.streamIdleTimeout();
+    limits.activeTimeoutSec = appSettings.streamActiveTimeout();
+    limits.closedTimeoutSec = appSettings.streamClosedTimeout();
+    limits.memoryBudgetBytes = qint64(appSettings.streamMemoryBudgetMb()) * 1024 * 1024;
+    Sniffing::setStreamLimits(limits);
+}
+
+void MainWindow::applyMetricsSettings() {
+    if (!appSettings.metricsEnabled()) {
+        if (metricsServer)
+            metricsServer->close();
+        return;
+    }
+    if (!metricsServer)
+        metricsServer = new MetricsServer(this);
+    metricsServer->setAggregator(stats.get());
+
+    QHostAddress address(appSettings.metricsAddress());
+    if (address.isNull())
+        address = QHostAddress::LocalHost;
+    if (!metricsServer->listen(address, quint16(appSettings.metricsPort()))) {
+        statusBar()->showMessage(tr("Metrics endpoint unavailable: %1")
+                                     .arg(metricsServer->errorString()), 5000);
+    }
+}
+
 void MainWindow::openSessionManager()
 {
     SessionManagerDialog dlg(this);
@@ -133,7 +166,7 @@ void MainWindow::persistCurrentSession()
     }
 
     const QString statsDir = Statistics::defaultSessionsDir();
-    if (!stats->SaveStatsToJson(statsDir, true)) {
+    if (!stats->saveNow(statsDir, true)) {
         if (QStatusBar *bar = statusBar()) {
             bar->showMessage(tr("Failed to persist session statistics to %1").arg(statsDir), 5000);
         }
@@ -148,6 +181,17 @@ void MainWindow::persistCurrentSession()
                                + info.completeBaseName()
                                + QStringLiteral(".pcap");
         parser.saveToPcap(pcapPath);
+
+        const QString spillPath = Sniffing::streamSpillPath();
+        Sniffing::setStreamSpillPath(QString());
+        if (!spillPath.isEmpty() && QFile::exists(spillPath)) {
+            const QString streamsPath = info.absolutePath()
+                                      + QLatin1Char('/')
+                                      + info.completeBaseName()
+                                      + QStringLiteral(".streams.jsonl");
+            QFile::remove(streamsPath);
+            QFile::rename(spillPath, streamsPath);
+        }
     }
     refreshAnomalyInspector();
 }
@@ -192,6 +236,7 @@ void MainWindow::replayCapturedPackets(const QVector<CapturedPacket> &packets,
     sessionStartTime = sessionStart;
     updateSessionTime();
     initializeStatistics(sessionStartTime);
+    packetModel->setRowLimit(0);
 
     QDateTime packetTimestamp = sessionStartTime;
     for (const CapturedPacket &packet : packets) {
@@ -207,7 +252,8 @@ void MainWindow::replayCapturedPackets(const QVector<CapturedPacket> &packets,
         Sniffing::recordStreamSegment(packet.data, packet.linkType, tsSec, tsUsec);
         QStringList infos;
         infos << QString::number(tsSec)
-              << QString::number(packet.data.size());
+              << QString::number(packet.data.size())
+              << QString::number(tsUsec);
         handlePacket(packet.data, infos, packet.linkType);
     }
 
@@ -377,8 +423,8 @@ void MainWindow::goToPacketInConversation(bool forward)
     if (!current.isValid())
         return;
 
-    QString endpointA;
-    QString endpointB;
+    quint32 endpointA = 0;
+    quint32 endpointB = 0;
     if (!conversationKeyForRow(current.row(), endpointA, endpointB))
         return;
 
@@ -388,8 +434,8 @@ void MainWindow::goToPacketInConversation(bool forward)
 
     int index = current.row() + (forward ? 1 : -1);
     while (index >= 0 && index < count) {
-        QString otherA;
-        QString otherB;
+        quint32 otherA = 0;
+        quint32 otherB = 0;
         if (conversationKeyForRow(index, otherA, otherB)) {
             if (otherA == endpointA && otherB == endpointB) {
                 selectPacketRow(index);
@@ -400,22 +446,19 @@ void MainWindow::goToPacketInConversation(bool forward)
     }
 }
 
-bool MainWindow::conversationKeyForRow(int row, QString &endpointA, QString &endpointB) const
+bool MainWindow::conversationKeyForRow(int row, quint32 &endpointA, quint32 &endpointB) const
 {
     if (!packetModel)
         return false;
     if (row < 0 || row >= packetModel->rowCount())
         return false;
 
-    PacketTableRow tableRow = packetModel->row(row);
-    if (tableRow.columns.size() <= ColumnDestination)
+    if (packetModel->source(row).isEmpty() && packetModel->destination(row).isEmpty())
         return false;
 
-    const QString source = tableRow.columns.value(ColumnSource);
-    const QString destination = tableRow.columns.value(ColumnDestination);
-
-    if (source.isEmpty() && destination.isEmpty())
-        return false;
+    // Addresses are interned, so their ids identify the conversation.
+    const quint32 source = packetModel->sourceId(row);
+    const quint32 destination = packetModel->destinationId(row);
 
     if (source <= destination) {
         endpointA = source;
@@ -453,20 +496,10 @@ void MainWindow::findPacket()
             start = current.row();
     }
 
-    for (int offset = 1; offset <= count; ++offset) {
-        const int row = (start + offset) % count;
-        PacketTableRow r = packetModel->row(row);
-        bool match = false;
-        for (const QString &column : r.columns) {
-            if (column.contains(text, Qt::CaseInsensitive)) {
-                match = true;
-                break;
-            }
-        }
-        if (match) {
-            selectPacketRow(row);
-            return;
-        }
+    const int row = packetModel->findRow(text, start + 1);
+    if (row >= 0) {
+        selectPacketRow(row);
+        return;
     }
 
     QMessageBox::information(this,
@@ -506,13 +539,14 @@ void MainWindow::refreshPacketColoring()
     for (int row = 0; row < count; ++row) {
         QColor color;
         if (coloringEnabled) {
-            PacketTableRow r = packetModel->row(row);
-            if (!r.rawData.isEmpty()) {
-                if (packetColorizer.linkType() != r.linkType)
-                    packetColorizer.setLinkType(r.linkType, 0);
-                const u_char *pkt = reinterpret_cast<const u_char*>(r.rawData.constData());
+            const QByteArray &raw = packetModel->rawData(row);
+            if (!raw.isEmpty()) {
+                const int linkType = packetModel->linkType(row);
+                if (packetColorizer.linkType() != linkType)
+                    packetColorizer.setLinkType(linkType, 0);
+                const u_char *pkt = reinterpret_cast<const u_char*>(raw.constData());
                 pcap_pkthdr hdr{};
-                hdr.caplen = static_cast<bpf_u_int32>(r.rawData.size());
+                hdr.caplen = static_cast<bpf_u_int32>(raw.size());
                 hdr.len = hdr.caplen;
                 color = packetColorizer.colorFor(&hdr, pkt);
             }
@@ -543,8 +577,14 @@ void MainWindow::selectPacketRow(int row)
 void MainWindow::initializeStatistics(const QDateTime &sessionStart)
 {
     stats.reset();
-    stats = std::make_unique<Statistics>(sessionStart);
-    connect(stats.get(), &Statistics::anomalyDetected,
+    stats = std::make_unique<StatisticsAggregator>(sessionStart, appSettings.burstBucketMs());
+    stats->setTopTalkers(appSettings.topTalkersCount(), appSettings.topTalkersWindow());
+    stats->setAnomalyRulesPath(appSettings.anomalyRulesPath());
+    stats->setIncidentCooldown(appSettings.anomalyCooldownSeconds());
+    stats->loadSeasonalBaselines(Statistics::seasonalBaselinesPath(Statistics::defaultSessionsDir()));
+    if (metricsServer)
+        metricsServer->setAggregator(stats.get());
+    connect(stats.get(), &StatisticsAggregator::anomalyDetected,
             this, &MainWindow::onAnomalyDetected);
     anomalyEvents.clear();
     refreshAnomalyInspector();
@@ -578,7 +618,20 @@ void MainWindow::openAnomalyInspector()
     anomalyDialog->activateWindow();
 }
 
-void MainWindow::focusAnomalyPackets(const QVector<int> &rows)
+void MainWindow::openTopTalkers()
+{
+    if (!topTalkersDialog) {
+        topTalkersDialog = new TopTalkersDialog(this);
+    }
+    if (stats) {
+        topTalkersDialog->setReport(stats->latestSnapshot()->topTalkers);
+    }
+    topTalkersDialog->show();
+    topTalkersDialog->raise();
+    topTalkersDialog->activateWindow();
+}
+
+void MainWindow::focusAnomalyPackets(const RowRangeSet &rows)
 {
     if (!packetModel || !packetTable || rows.isEmpty()) {
         return;
@@ -589,23 +642,22 @@ void MainWindow::focusAnomalyPackets(const QVector<int> &rows)
         return;
     }
 
-    selection->clearSelection();
-    int firstValid = -1;
-    for (int row : rows) {
-        if (row < 0 || row >= packetModel->rowCount()) {
-            continue;
-        }
-        if (firstValid == -1) {
-            firstValid = row;
-        }
-        const QModelIndex left = packetModel->index(row, 0);
-        const QModelIndex right = packetModel->index(row, PacketColumns::ColumnCount - 1);
-        QItemSelection range(left, right);
-        selection->select(range, QItemSelectionModel::Select | QItemSelectionModel::Rows);
+    // The set holds packet numbers. Those of a cleared or reloaded table,
+    // or that scrolled out of a limited one, have no row any more.
+    const int firstPacket = packetModel->firstPacket();
+    const RowRangeSet visible = rows.intersected(
+        RowRangeSet(firstPacket, firstPacket + packetModel->rowCount() - 1));
+    QItemSelection ranges;
+    for (const RowRangeSet::Range &range : visible) {
+        ranges.select(packetModel->index(range.first - firstPacket, 0),
+                      packetModel->index(range.last - firstPacket, PacketColumns::ColumnCount - 1));
     }
+    selection->clearSelection();
+    selection->select(ranges, QItemSelectionModel::Select | QItemSelectionModel::Rows);
 
+    const int firstValid = visible.first();
     if (firstValid != -1) {
-        const QModelIndex index = packetModel->index(firstValid, 0);
+        const QModelIndex index = packetModel->index(firstValid - firstPacket, 0);
         packetTable->setCurrentIndex(index);
         packetTable->scrollTo(index);
         onPacketClicked(index);
@@ -614,7 +666,9 @@ void MainWindow::focusAnomalyPackets(const QVector<int> &rows)
 
 void MainWindow::onAnomalyDetected(const AnomalyDetector::Event &event)
 {
-    anomalyEvents.append(event);
+    IncidentCoalescer::upsert(anomalyEvents, event);
+    if (incidentRecorder)
+        incidentRecorder->trigger(event);
     refreshAnomalyInspector();
 }
 
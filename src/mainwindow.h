@@ -45,7 +45,9 @@
 #include "../packets/packethelpers.h"
 #include "statistics/statsdialog.h"
 #include "statistics/statistics.h"
+#include "statistics/statisticsaggregator.h"
 #include "statistics/sessionstorage.h"
+#include "statistics/incidentrecorder.h"
 #include "statistics/charts/pieChart.h"
 #include "packets/packet_geolocation/geolocation.h"
 #include "packets/packet_geolocation/GeoMap.h"
@@ -54,6 +56,8 @@
 #include "appsettings.h"
 
 class AnomalyInspectorDialog;
+class TopTalkersDialog;
+class MetricsServer;
 class ReportBuilderWindow;
 
 struct PacketAnnotationItem {
@@ -117,15 +121,20 @@ private slots:
     void findPacket();
     void onAnomalyDetected(const AnomalyDetector::Event &event);
     void openAnomalyInspector();
-    void focusAnomalyPackets(const QVector<int> &rows);
+    void openTopTalkers();
+    void focusAnomalyPackets(const RowRangeSet &rows);
 
 private:
     void setupUI();
     void listInterfaces();
-    QStringList infoColumn(const QStringList &summary, const u_char *pkt, int linkType);
+    // dns, if given, receives the DNS decode so callers need not parse again.
+    QStringList infoColumn(const QStringList &summary, const u_char *pkt, int linkType,
+                           ParsedDns *dns = nullptr);
     void addLayerToTree(QTreeWidget *tree, const PacketLayer &lay);
     void saveAnnotationToFile(const PacketAnnotation &annotation);
     void loadPreferences();
+    void applyStreamSettings();
+    void applyMetricsSettings();
     void persistCurrentSession();
     bool loadOfflineSession(const SessionStorage::LoadedSession &session);
     void replayCapturedPackets(const QVector<CapturedPacket> &packets,
@@ -143,7 +152,7 @@ private:
     void updateColoringToggle();
     void updateAutoScrollToggle();
     void goToPacketInConversation(bool forward);
-    bool conversationKeyForRow(int row, QString &endpointA, QString &endpointB) const;
+    bool conversationKeyForRow(int row, quint32 &endpointA, quint32 &endpointB) const;
 
     QComboBox   *ifaceBox;
     QLineEdit   *filterEdit;
@@ -186,9 +195,10 @@ private:
 
     //charts
     PieChart     *pieChart;
-    std::unique_ptr<Statistics> stats;
+    std::unique_ptr<StatisticsAggregator> stats;
     QTimer *statsTimer = nullptr;
     bool statsSaveWarningShown = false;
+    std::unique_ptr<IncidentRecorder> incidentRecorder;
 
     //geolocation
     GeoLocation geo;
@@ -214,6 +224,8 @@ private:
     AppSettings appSettings;
 
     class AnomalyInspectorDialog *anomalyDialog = nullptr;
+    TopTalkersDialog *topTalkersDialog = nullptr;
+    MetricsServer *metricsServer = nullptr;
     ReportBuilderWindow *reportWindow = nullptr;
     QVector<AnomalyDetector::Event> anomalyEvents;
 
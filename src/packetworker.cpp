@@ -48,10 +48,16 @@ void PacketWorker::process() {
     }
 
     emit linkTypeChanged(m_linkType.load(std::memory_order_relaxed), m_netmask);
+    m_lastPcapStats = pcap_stat{};
+    m_dropPoll.start();
 
     // 3) capture loop
     while (m_running.load(std::memory_order_relaxed)) {
         applyPendingFilter();
+        if (m_dropPoll.elapsed() >= 1000) {
+            pollDropCounters();
+            m_dropPoll.restart();
+        }
 
         int ret = pcap_dispatch(
             m_handle.get(),
@@ -70,6 +76,7 @@ void PacketWorker::process() {
             break;
         }
     }
+    pollDropCounters();
     m_handle.reset();
 }
 
@@ -84,6 +91,20 @@ void PacketWorker::updateFilter(const QString &filter) {
     }
 }
 
+void PacketWorker::pollDropCounters() {
+    // pcap_stats() counts from when the handle was opened; only the growth
+    // since the last poll is added to the process-wide totals.
+    pcap_stat current{};
+    if (!m_handle || pcap_stats(m_handle.get(), &current) != 0)
+        return;
+    const quint64 kernel = current.ps_drop >= m_lastPcapStats.ps_drop
+        ? current.ps_drop - m_lastPcapStats.ps_drop : current.ps_drop;
+    const quint64 device = current.ps_ifdrop >= m_lastPcapStats.ps_ifdrop
+        ? current.ps_ifdrop - m_lastPcapStats.ps_ifdrop : current.ps_ifdrop;
+    Sniffing::addCaptureDrops(kernel, device);
+    m_lastPcapStats = current;
+}
+
 bool PacketWorker::installFilter(const QString &filter) {
     if (!m_handle)
         return false;
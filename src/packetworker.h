@@ -13,6 +13,7 @@
 #include <memory>
 #include <pcap.h>
 #include <QMutex>
+#include <QElapsedTimer>
 
 class PacketWorker : public QObject {
     Q_OBJECT
@@ -44,6 +45,7 @@ signals:
 private:
     bool installFilter(const QString &filter);
     bool applyPendingFilter();
+    void pollDropCounters();
 
     QString           m_iface;
     QString           m_filter;
@@ -55,6 +57,8 @@ private:
     std::unique_ptr<pcap_t, decltype(&pcap_close)> m_handle{nullptr, &pcap_close};
     bpf_u_int32       m_netmask = 0;
     std::atomic<int>  m_linkType{DLT_EN10MB};
+    QElapsedTimer     m_dropPoll;
+    pcap_stat         m_lastPcapStats{};
 };
 
 #endif // PACKETWORKER_H
@@ -1,64 +1,116 @@
 #include "anomalydetector.h"
 
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QtMath>
-#include <QSet>
+
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace {
-constexpr double kMinVariance = 1e-4;
+// Below this a host's second is too small to call, whatever its baseline.
+constexpr double kMinEntityPackets = 20.0;
+// Per entity kind and second, strongest first.
+constexpr int kMaxEntityReasons = 3;
 }
 
-AnomalyDetector::AdaptiveMetric::AdaptiveMetric(double alpha)
-    : m_alpha(alpha) {}
+AnomalyDetector::AnomalyDetector(QObject *parent)
+    : QObject(parent),
+      m_threshold(m_rules.threshold()),
+      m_warmup(m_rules.warmup())
+{
+    qRegisterMetaType<AnomalyDetector::Event>("AnomalyDetector::Event");
+}
 
-double AnomalyDetector::AdaptiveMetric::updateAndScore(double value, int warmup)
+void AnomalyDetector::setRulesPath(const QString &path)
 {
-    if (!m_initialized) {
-        m_initialized = true;
-        m_mean = value;
-        m_variance = kMinVariance;
-        m_count = 1;
-        return 0.0;
+    if (m_rulesWatcher) {
+        delete m_rulesWatcher;
+        m_rulesWatcher = nullptr;
     }
-
-    const double stddev = qSqrt(qMax(m_variance, kMinVariance));
-    double score = 0.0;
-    if (stddev > 0.0) {
-        score = (value - m_mean) / stddev;
+    m_rulesPath = path;
+    if (!path.isEmpty()) {
+        // Editors often save by replacing the file, which drops a file watch;
+        // the directory watch also catches the file appearing later. A
+        // directory that does not exist yet is not created just to watch it.
+        m_rulesWatcher = new QFileSystemWatcher(this);
+        const QFileInfo info(path);
+        if (info.absoluteDir().exists()) {
+            m_rulesWatcher->addPath(info.absolutePath());
+        }
+        connect(m_rulesWatcher, &QFileSystemWatcher::directoryChanged, this, [this]() { reloadRules(); });
+        connect(m_rulesWatcher, &QFileSystemWatcher::fileChanged, this, [this]() { reloadRules(); });
     }
+    reloadRules();
+}
 
-    const double delta = value - m_mean;
-    m_mean += m_alpha * delta;
-    m_variance = (1.0 - m_alpha) * (m_variance + m_alpha * delta * delta);
-    ++m_count;
+QString AnomalyDetector::rulesPath() const
+{
+    return m_rulesPath;
+}
 
-    if (m_count <= warmup) {
-        return 0.0;
+bool AnomalyDetector::loadRules(const QByteArray &json, QString *error)
+{
+    if (!m_rules.load(json, error)) {
+        return false;
     }
+    m_rulesSource = json;
+    m_threshold = m_rules.threshold();
+    m_warmup = m_rules.warmup();
+    return true;
+}
 
-    return score;
+bool AnomalyDetector::loadSeasonalBaselines(const QString &path)
+{
+    m_seasonalDirty = false;
+    if (path.isEmpty() || !QFileInfo::exists(path)) {
+        m_seasonal.clear();
+        return true;
+    }
+    if (!m_seasonal.load(path)) {
+        qWarning() << "AnomalyDetector: ignoring unreadable seasonal baselines" << path;
+        return false;
+    }
+    return true;
 }
 
-void AnomalyDetector::AdaptiveMetric::reset()
+bool AnomalyDetector::saveSeasonalBaselines(const QString &path, bool force)
 {
-    m_initialized = false;
-    m_mean = 0.0;
-    m_variance = kMinVariance;
-    m_count = 0;
+    if ((!force && !m_seasonalDirty) || m_seasonal.isEmpty()) {
+        return true;
+    }
+    if (!m_seasonal.save(path)) {
+        return false;
+    }
+    m_seasonalDirty = false;
+    return true;
 }
 
-AnomalyDetector::AnomalyDetector(QObject *parent)
-    : QObject(parent),
-      m_packetMetric(0.15),
-      m_byteMetric(0.15),
-      m_connectionMetric(0.12),
-      m_newConnectionMetric(0.12),
-      m_entropyMetric(0.1),
-      m_avgPacketMetric(0.1),
-      m_threshold(2.8),
-      m_warmup(6)
+void AnomalyDetector::reloadRules()
 {
-    qRegisterMetaType<AnomalyDetector::Event>("AnomalyDetector::Event");
+    QByteArray json = AnomalyRules::defaultJson();
+    QFile file(m_rulesPath);
+    if (!m_rulesPath.isEmpty() && file.exists()) {
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "AnomalyDetector: cannot read rules" << m_rulesPath;
+            return;
+        }
+        json = file.readAll();
+        if (m_rulesWatcher && !m_rulesWatcher->files().contains(m_rulesPath)) {
+            m_rulesWatcher->addPath(m_rulesPath);
+        }
+    }
+    if (json == m_rulesSource) {
+        return;
+    }
+    QString error;
+    if (!loadRules(json, &error)) {
+        qWarning() << "AnomalyDetector: keeping the previous rules," << m_rulesPath << error;
+    }
 }
 
 void AnomalyDetector::observe(const FeatureSnapshot &snapshot)
@@ -71,6 +123,19 @@ void AnomalyDetector::observe(const FeatureSnapshot &snapshot)
     details.insert(QStringLiteral("newConnections"), snapshot.newConnections);
     details.insert(QStringLiteral("protocolEntropy"), snapshot.protocolEntropy);
     details.insert(QStringLiteral("protocolCount"), snapshot.protocolCount);
+    auto insertQuantiles = [&details](const QString &name, const Quantiles &quantiles) {
+        if (quantiles.samples == 0) {
+            return;
+        }
+        QVariantMap map;
+        map.insert(QStringLiteral("p50"), quantiles.p50);
+        map.insert(QStringLiteral("p90"), quantiles.p90);
+        map.insert(QStringLiteral("p99"), quantiles.p99);
+        details.insert(name, map);
+    };
+    insertQuantiles(QStringLiteral("packetSizeQuantiles"), snapshot.packetSize);
+    insertQuantiles(QStringLiteral("interArrivalUsQuantiles"), snapshot.interArrivalUs);
+    insertQuantiles(QStringLiteral("handshakeRttUsQuantiles"), snapshot.handshakeRttUs);
     if (!snapshot.newProtocols.isEmpty()) {
         details.insert(QStringLiteral("newProtocols"), snapshot.newProtocols);
     }
@@ -86,61 +151,93 @@ void AnomalyDetector::observe(const FeatureSnapshot &snapshot)
     QStringList reasons;
     QList<double> contributions;
     QStringList tags;
-    QVariantList ddosTargets;
-    QVariantList aggressiveSources;
-    QSet<int> uniqueRows;
-    QVector<int> collectedRows;
-
-    auto appendRows = [&](const QVector<int> &rows) {
-        for (int row : rows) {
-            if (!uniqueRows.contains(row)) {
-                uniqueRows.insert(row);
-                collectedRows.append(row);
-            }
-        }
-    };
+    QStringList entities;
+    RowRangeSet collectedRows;
 
     auto addReason = [&](const QString &text,
                          double contribution,
                          const QString &tag,
-                         const QVector<int> &rows) {
+                         const RowRangeSet &rows,
+                         const QString &entity = QString()) {
         reasons << text;
         contributions.append(contribution);
         if (!tag.isEmpty() && !tags.contains(tag)) {
             tags << tag;
         }
-        appendRows(rows);
+        if (!entity.isEmpty() && !entities.contains(entity)) {
+            entities << entity;
+        }
+        collectedRows.unite(rows);
     };
 
-    auto considerMetric = [&](AdaptiveMetric &metric,
-                              double value,
-                              const QString &label,
-                              const QString &tag) {
-        const double score = qAbs(metric.updateAndScore(value, m_warmup));
-        if (score > m_threshold) {
-            const QString reason = QStringLiteral("%1 (%2σ)").arg(label).arg(score, 0, 'f', 2);
-            addReason(reason, score, tag, snapshot.packetRows);
-        }
+    // Per-second metrics for the rules; NaN where a metric has no sample.
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    auto quantile = [nan](const Quantiles &quantiles, double value) {
+        return quantiles.samples > 0 ? value : nan;
     };
+    double metrics[AnomalyRules::SecondMetricCount];
+    metrics[AnomalyRules::Packets] = snapshot.packets;
+    metrics[AnomalyRules::Bytes] = snapshot.bytes;
+    metrics[AnomalyRules::AvgPacketSize] = snapshot.avgPacketSize;
+    metrics[AnomalyRules::UniqueConnections] = snapshot.uniqueConnections;
+    metrics[AnomalyRules::NewConnections] = snapshot.newConnections;
+    metrics[AnomalyRules::ConnectionChurn] = snapshot.uniqueConnections > 0
+        ? double(snapshot.newConnections) / double(snapshot.uniqueConnections)
+        : nan;
+    metrics[AnomalyRules::ProtocolEntropy] = snapshot.protocolEntropy;
+    metrics[AnomalyRules::ProtocolCount] = snapshot.protocolCount;
+    metrics[AnomalyRules::PacketSizeP50] = quantile(snapshot.packetSize, snapshot.packetSize.p50);
+    metrics[AnomalyRules::PacketSizeP90] = quantile(snapshot.packetSize, snapshot.packetSize.p90);
+    metrics[AnomalyRules::PacketSizeP99] = quantile(snapshot.packetSize, snapshot.packetSize.p99);
+    metrics[AnomalyRules::InterArrivalP50] = quantile(snapshot.interArrivalUs, snapshot.interArrivalUs.p50);
+    metrics[AnomalyRules::InterArrivalP90] = quantile(snapshot.interArrivalUs, snapshot.interArrivalUs.p90);
+    metrics[AnomalyRules::InterArrivalP99] = quantile(snapshot.interArrivalUs, snapshot.interArrivalUs.p99);
+    metrics[AnomalyRules::HandshakeRttP50] = quantile(snapshot.handshakeRttUs, snapshot.handshakeRttUs.p50);
+    metrics[AnomalyRules::HandshakeRttP90] = quantile(snapshot.handshakeRttUs, snapshot.handshakeRttUs.p90);
+    metrics[AnomalyRules::HandshakeRttP99] = quantile(snapshot.handshakeRttUs, snapshot.handshakeRttUs.p99);
+    metrics[AnomalyRules::TcpSegments] = snapshot.tcp.segments;
+    metrics[AnomalyRules::TcpSyn] = snapshot.tcp.syn;
+    metrics[AnomalyRules::TcpSynAck] = snapshot.tcp.synAck;
+    metrics[AnomalyRules::TcpRst] = snapshot.tcp.rst;
+    metrics[AnomalyRules::TcpFin] = snapshot.tcp.fin;
+    if (!std::isnan(metrics[AnomalyRules::ConnectionChurn])) {
+        details.insert(QStringLiteral("connectionChurn"), metrics[AnomalyRules::ConnectionChurn]);
+    }
+
+    // Score against this time slot's profile, then teach it the second.
+    double seasonal[AnomalyRules::SecondMetricCount];
+    std::fill(std::begin(seasonal), std::end(seasonal), nan);
+    if (snapshot.secondOfWeek >= 0) {
+        const int slot = SeasonalBaselines::slotOf(snapshot.secondOfWeek);
+        if (slot != m_seasonalSlot) {
+            m_seasonalDirty = m_seasonalDirty || m_seasonalSlot >= 0;
+            m_seasonalSlot = slot;
+        }
+        for (const quint8 metric : m_rules.seasonalMetrics()) {
+            seasonal[metric] = m_seasonal.score(metric, slot, metrics[metric]);
+            m_seasonal.update(metric, slot, metrics[metric]);
+        }
+    }
 
-    considerMetric(m_packetMetric, snapshot.packets, tr("Packet rate spike"), QStringLiteral("packet-rate"));
-    considerMetric(m_byteMetric, snapshot.bytes, tr("Byte throughput surge"), QStringLiteral("byte-throughput"));
-    considerMetric(m_connectionMetric,
-                   snapshot.uniqueConnections,
-                   tr("Connection fan-out"),
-                   QStringLiteral("connection-fanout"));
-    considerMetric(m_newConnectionMetric,
-                   snapshot.newConnections,
-                   tr("Burst of new connections"),
-                   QStringLiteral("new-connections"));
-    considerMetric(m_entropyMetric,
-                   snapshot.protocolEntropy,
-                   tr("Protocol mix shift"),
-                   QStringLiteral("protocol-entropy"));
-    considerMetric(m_avgPacketMetric,
-                   snapshot.avgPacketSize,
-                   tr("Packet size swing"),
-                   QStringLiteral("packet-size"));
+    QVariantList ruleHits;
+    auto applyRules = [&](AnomalyRules::Scope scope, const double *values, const QString &entity,
+                          const RowRangeSet *rows) {
+        m_hits.clear();
+        m_rules.evaluate(scope, values, entity, m_hits,
+                         scope == AnomalyRules::Scope::Second ? seasonal : nullptr);
+        for (const AnomalyRules::Hit &hit : std::as_const(m_hits)) {
+            const QString tag = m_rules.tag(hit.rule);
+            addReason(m_rules.describe(hit, values), hit.score, tag, rows ? *rows : RowRangeSet(), entity);
+            QVariantMap record;
+            record.insert(QStringLiteral("tag"), tag);
+            record.insert(QStringLiteral("statistic"), hit.statistic);
+            if (!entity.isEmpty()) {
+                record.insert(QStringLiteral("entity"), entity);
+            }
+            ruleHits.append(record);
+        }
+    };
+    applyRules(AnomalyRules::Scope::Second, metrics, QString(), &snapshot.packetRows);
 
     if (!snapshot.newProtocols.isEmpty()) {
         const QString label = tr("New protocol(s): %1").arg(snapshot.newProtocols.join(QStringLiteral(", ")));
@@ -150,8 +247,7 @@ void AnomalyDetector::observe(const FeatureSnapshot &snapshot)
                   snapshot.packetRows);
     }
 
-    const double totalPackets = snapshot.packets;
-    const QStringList dominant = describeDominantProtocols(snapshot.protocolCounts, totalPackets);
+    const QStringList dominant = describeDominantProtocols(snapshot.protocolCounts, snapshot.packets);
     if (!dominant.isEmpty()) {
         addReason(tr("Traffic dominated by %1").arg(dominant.join(QStringLiteral(", "))),
                   m_threshold + 0.2 * dominant.size(),
@@ -159,119 +255,229 @@ void AnomalyDetector::observe(const FeatureSnapshot &snapshot)
                   snapshot.packetRows);
     }
 
-    if (snapshot.uniqueConnections > 0) {
-        const double churn = snapshot.uniqueConnections == 0
-            ? 0.0
-            : static_cast<double>(snapshot.newConnections)
-              / static_cast<double>(snapshot.uniqueConnections);
-        details.insert(QStringLiteral("connectionChurn"), churn);
-        if (snapshot.newConnections > 5 && churn > 0.6) {
-            addReason(tr("High connection churn (%1 new/%2 total)")
-                          .arg(snapshot.newConnections)
-                          .arg(snapshot.uniqueConnections),
-                      m_threshold + churn,
-                      QStringLiteral("connection-churn"),
-                      snapshot.packetRows);
+    // Host rules see the heavy hitters and every host with a wide fan-in or
+    // fan-out.
+    const double totalPackets = qMax(snapshot.packets, 1.0);
+    auto rowsOf = [](const QMap<QString, RowRangeSet> &rows, const QString &host) {
+        const auto it = rows.constFind(host);
+        return it == rows.constEnd() ? nullptr : &it.value();
+    };
+    double entityMetrics[AnomalyRules::EntityMetricCount];
+    if (m_rules.hasRules(AnomalyRules::Scope::Destination)) {
+        for (auto it = snapshot.destinationPackets.constBegin(); it != snapshot.destinationPackets.constEnd(); ++it) {
+            entityMetrics[AnomalyRules::EntityPackets] = it.value();
+            entityMetrics[AnomalyRules::EntityShare] = it.value() / totalPackets;
+            entityMetrics[AnomalyRules::EntityPeers] = snapshot.destinationFanIn.value(it.key());
+            applyRules(AnomalyRules::Scope::Destination, entityMetrics, it.key(),
+                       rowsOf(snapshot.rowsByDestination, it.key()));
+        }
+    }
+    if (m_rules.hasRules(AnomalyRules::Scope::Source)) {
+        for (auto it = snapshot.sourcePackets.constBegin(); it != snapshot.sourcePackets.constEnd(); ++it) {
+            entityMetrics[AnomalyRules::EntityPackets] = it.value();
+            entityMetrics[AnomalyRules::EntityShare] = it.value() / totalPackets;
+            entityMetrics[AnomalyRules::EntityPeers] = snapshot.sourceFanOut.value(it.key());
+            applyRules(AnomalyRules::Scope::Source, entityMetrics, it.key(),
+                       rowsOf(snapshot.rowsBySource, it.key()));
         }
     }
 
-    // DDoS / flood heuristics
-    if (!snapshot.destinationFanIn.isEmpty() && totalPackets > 0.0) {
-        for (auto it = snapshot.destinationFanIn.constBegin(); it != snapshot.destinationFanIn.constEnd(); ++it) {
-            const QString &destination = it.key();
-            const int uniqueSources = it.value();
-            const int destPackets = snapshot.destinationPackets.value(destination);
-            if (destPackets <= 0) {
-                continue;
-            }
-            const double share = destPackets / qMax(totalPackets, 1.0);
-            if (uniqueSources >= 8 && destPackets >= 40 && share >= 0.35) {
-                const QString text = tr("Potential DDoS against %1 (%2 sources, %3 packets)")
-                                         .arg(destination)
-                                         .arg(uniqueSources)
-                                         .arg(destPackets);
-                addReason(text,
-                          m_threshold + share * 2.5,
-                          QStringLiteral("ddos-target"),
-                          snapshot.rowsByDestination.value(destination));
-                QVariantMap record;
-                record.insert(QStringLiteral("destination"), destination);
-                record.insert(QStringLiteral("uniqueSources"), uniqueSources);
-                record.insert(QStringLiteral("packets"), destPackets);
-                record.insert(QStringLiteral("share"), share);
-                ddosTargets.append(record);
+    // Each host and service port is judged against its own history, so a
+    // chatty server neither hides a quiet host's spike nor trips on itself.
+    QVariantList entityAnomalies;
+    auto considerEntities = [&](EntityBaselines &baselines,
+                                const EntityCounts &counts,
+                                const QString &kind,
+                                const QString &tag,
+                                auto rowsFor) {
+        baselines.update(counts.keys, counts.packets, m_warmup, m_entityScores, m_entityExpected);
+        QVector<int> flagged;
+        for (int i = 0; i < m_entityScores.size(); ++i) {
+            if (m_entityScores.at(i) > m_threshold && counts.packets.at(i) >= kMinEntityPackets) {
+                flagged.append(i);
             }
         }
-    }
+        std::sort(flagged.begin(), flagged.end(), [this](int a, int b) {
+            return m_entityScores.at(a) > m_entityScores.at(b);
+        });
+        if (flagged.size() > kMaxEntityReasons) {
+            flagged.resize(kMaxEntityReasons);
+        }
+        for (int i : std::as_const(flagged)) {
+            const QString name = counts.names.value(i);
+            const double score = m_entityScores.at(i);
+            addReason(tr("%1 %2: %3 packets against a baseline of %4 (%5σ)")
+                          .arg(kind, name)
+                          .arg(counts.packets.at(i), 0, 'f', 0)
+                          .arg(m_entityExpected.at(i), 0, 'f', 1)
+                          .arg(score, 0, 'f', 2),
+                      score,
+                      tag,
+                      rowsFor(i),
+                      name);
+            QVariantMap record;
+            record.insert(QStringLiteral("kind"), tag);
+            record.insert(QStringLiteral("entity"), name);
+            record.insert(QStringLiteral("packets"), counts.packets.at(i));
+            record.insert(QStringLiteral("expected"), m_entityExpected.at(i));
+            record.insert(QStringLiteral("score"), score);
+            entityAnomalies.append(record);
+        }
+    };
 
-    if (!snapshot.sourceFanOut.isEmpty() && totalPackets > 0.0) {
-        for (auto it = snapshot.sourceFanOut.constBegin(); it != snapshot.sourceFanOut.constEnd(); ++it) {
-            const QString &source = it.key();
-            const int uniqueDestinations = it.value();
-            const int srcPackets = snapshot.sourcePackets.value(source);
-            if (srcPackets <= 0) {
-                continue;
+    considerEntities(m_sourceBaselines, snapshot.sources, tr("Source"), QStringLiteral("host-source"),
+                     [&snapshot](int i) {
+                         return snapshot.rowsBySource.value(snapshot.sources.names.value(i));
+                     });
+    considerEntities(m_destinationBaselines, snapshot.destinations, tr("Destination"),
+                     QStringLiteral("host-destination"),
+                     [&snapshot](int i) {
+                         return snapshot.rowsByDestination.value(snapshot.destinations.names.value(i));
+                     });
+    considerEntities(m_serviceBaselines, snapshot.services, tr("Service port"),
+                     QStringLiteral("service-port"),
+                     [&snapshot](int i) {
+                         return snapshot.rowsByService.value(quint16(snapshot.services.keys.at(i)));
+                     });
+
+    QVariantList tcpFindings;
+    const QVector<TcpFlagDetectors::Finding> findings =
+        m_tcpDetectors.observe(snapshot.second, snapshot.tcp, m_threshold, m_warmup);
+    for (const TcpFlagDetectors::Finding &finding : findings) {
+        QString text;
+        QString tag;
+        RowRangeSet rows = snapshot.rowsBySource.value(finding.host);
+        switch (finding.kind) {
+        case TcpFlagDetectors::Kind::SynFlood:
+            tag = QStringLiteral("syn-flood");
+            if (finding.host.isEmpty()) {
+                text = tr("SYN flood: %1 SYNs, %2 answered").arg(finding.value).arg(finding.answered);
+                rows = snapshot.packetRows;
+            } else {
+                text = tr("SYN flood against %1: %2 SYNs, %3 answered")
+                           .arg(finding.host)
+                           .arg(finding.value)
+                           .arg(finding.answered);
+                rows = snapshot.rowsByDestination.value(finding.host);
             }
-            const double share = srcPackets / qMax(totalPackets, 1.0);
-            if (uniqueDestinations >= 15 && srcPackets >= 60 && share >= 0.25) {
-                const QString text = tr("Single-source flood from %1 (%2 destinations, %3 packets)")
-                                         .arg(source)
-                                         .arg(uniqueDestinations)
-                                         .arg(srcPackets);
-                addReason(text,
-                          m_threshold + share * 2.0,
-                          QStringLiteral("ddos-source"),
-                          snapshot.rowsBySource.value(source));
-                QVariantMap record;
-                record.insert(QStringLiteral("source"), source);
-                record.insert(QStringLiteral("uniqueDestinations"), uniqueDestinations);
-                record.insert(QStringLiteral("packets"), srcPackets);
-                record.insert(QStringLiteral("share"), share);
-                aggressiveSources.append(record);
-            } else if (uniqueDestinations >= 8 && srcPackets >= 40) {
-                const QString text = tr("Possible scan from %1 (%2 destinations)")
-                                         .arg(source)
-                                         .arg(uniqueDestinations);
-                addReason(text,
-                          m_threshold + uniqueDestinations / 10.0,
-                          QStringLiteral("scan"),
-                          snapshot.rowsBySource.value(source));
-                QVariantMap record;
-                record.insert(QStringLiteral("source"), source);
-                record.insert(QStringLiteral("uniqueDestinations"), uniqueDestinations);
-                record.insert(QStringLiteral("packets"), srcPackets);
-                record.insert(QStringLiteral("share"), share);
-                aggressiveSources.append(record);
+            break;
+        case TcpFlagDetectors::Kind::RstStorm:
+            tag = QStringLiteral("rst-storm");
+            text = tr("RST storm: %1 resets against a baseline of %2")
+                       .arg(finding.value)
+                       .arg(finding.expected, 0, 'f', 1);
+            if (finding.host.isEmpty()) {
+                rows = snapshot.packetRows;
+            } else {
+                text += tr(", most from %1").arg(finding.host);
             }
+            break;
+        case TcpFlagDetectors::Kind::HalfOpen:
+            tag = QStringLiteral("half-open");
+            text = tr("Half-open connections from %1 (%2 recent SYNs unanswered)")
+                       .arg(finding.host)
+                       .arg(finding.value, 0, 'f', 0);
+            break;
+        case TcpFlagDetectors::Kind::VerticalScan:
+            tag = QStringLiteral("port-scan-vertical");
+            text = tr("Vertical port scan from %1 against %2 (%3 recent unanswered probes)")
+                       .arg(finding.host, finding.peer)
+                       .arg(finding.value, 0, 'f', 0);
+            break;
+        case TcpFlagDetectors::Kind::HorizontalScan:
+            tag = QStringLiteral("port-scan-horizontal");
+            text = tr("Horizontal scan from %1 on port %2 (%3 recent unanswered probes)")
+                       .arg(finding.host, finding.peer)
+                       .arg(finding.value, 0, 'f', 0);
+            break;
         }
+        addReason(text, m_threshold + std::min(finding.severity, 3.0), tag, rows, finding.host);
+        QVariantMap record;
+        record.insert(QStringLiteral("kind"), tag);
+        record.insert(QStringLiteral("host"), finding.host);
+        record.insert(QStringLiteral("peer"), finding.peer);
+        record.insert(QStringLiteral("value"), finding.value);
+        record.insert(QStringLiteral("expected"), finding.expected);
+        record.insert(QStringLiteral("answered"), finding.answered);
+        tcpFindings.append(record);
     }
 
-    if (!snapshot.sourcePackets.isEmpty() && totalPackets > 0.0) {
-        QString heavySource;
-        int heavyPackets = 0;
-        for (auto it = snapshot.sourcePackets.constBegin(); it != snapshot.sourcePackets.constEnd(); ++it) {
-            if (it.value() > heavyPackets) {
-                heavyPackets = it.value();
-                heavySource = it.key();
+    QVariantList beacons;
+    for (const BeaconDetector::Finding &finding : snapshot.beacons) {
+        const QString responder = finding.port == 0
+            ? finding.responderName
+            : QStringLiteral("%1:%2").arg(finding.responderName).arg(finding.port);
+        addReason(tr("Beaconing from %1 to %2 every %3 s (±%4%, %5 contacts)")
+                      .arg(finding.initiatorName, responder)
+                      .arg(finding.periodSeconds, 0, 'f', 1)
+                      .arg(finding.jitter * 100.0, 0, 'f', 0)
+                      .arg(finding.contacts),
+                  m_threshold + finding.coherence,
+                  QStringLiteral("beacon"),
+                  finding.rows,
+                  finding.initiatorName);
+        QVariantMap record;
+        record.insert(QStringLiteral("initiator"), finding.initiatorName);
+        record.insert(QStringLiteral("responder"), finding.responderName);
+        record.insert(QStringLiteral("port"), finding.port);
+        record.insert(QStringLiteral("periodSeconds"), finding.periodSeconds);
+        record.insert(QStringLiteral("jitter"), finding.jitter);
+        record.insert(QStringLiteral("coherence"), finding.coherence);
+        record.insert(QStringLiteral("contacts"), finding.contacts);
+        beacons.append(record);
+    }
+
+    QVariantList dnsFindings;
+    for (const DnsAnalytics::Finding &finding : snapshot.dns) {
+        QString text;
+        QString tag;
+        if (finding.kind == DnsAnalytics::Kind::Tunnel) {
+            tag = QStringLiteral("dns-tunnel");
+            text = tr("DNS tunnel from %1 through %2: %3 distinct subdomains, %4 bits/char")
+                       .arg(finding.clientName, finding.domain)
+                       .arg(finding.uniqueNames)
+                       .arg(finding.entropy, 0, 'f', 1);
+            if (finding.txtQueries > 0) {
+                text += tr(", %1 TXT queries").arg(finding.txtQueries);
             }
+        } else {
+            tag = QStringLiteral("dga");
+            text = tr("Possible DGA on %1: %2 random domains failed to resolve (%3% NXDOMAIN)")
+                       .arg(finding.clientName)
+                       .arg(finding.uniqueNames)
+                       .arg(finding.nxdomainRatio * 100.0, 0, 'f', 0);
         }
-        const double share = heavyPackets / qMax(totalPackets, 1.0);
-        if (!heavySource.isEmpty() && share >= 0.55 && heavyPackets >= 30) {
-            const QString text = tr("Dominant source %1 (%2% of packets)")
-                                     .arg(heavySource)
-                                     .arg(share * 100.0, 0, 'f', 1);
-            addReason(text,
-                      m_threshold + share * 1.5,
-                      QStringLiteral("top-source"),
-                      snapshot.rowsBySource.value(heavySource));
+        addReason(text, m_threshold + finding.severity, tag, finding.rows, finding.clientName);
+        QVariantMap record;
+        record.insert(QStringLiteral("kind"), tag);
+        record.insert(QStringLiteral("client"), finding.clientName);
+        if (!finding.domain.isEmpty()) {
+            record.insert(QStringLiteral("domain"), finding.domain);
         }
+        record.insert(QStringLiteral("queries"), finding.queries);
+        record.insert(QStringLiteral("uniqueNames"), finding.uniqueNames);
+        record.insert(QStringLiteral("entropy"), finding.entropy);
+        record.insert(QStringLiteral("lengthP90"), finding.lengthP90);
+        record.insert(QStringLiteral("nxdomainRatio"), finding.nxdomainRatio);
+        record.insert(QStringLiteral("txtQueries"), finding.txtQueries);
+        record.insert(QStringLiteral("txtBytes"), finding.txtBytes);
+        dnsFindings.append(record);
     }
 
-    if (!ddosTargets.isEmpty()) {
-        details.insert(QStringLiteral("ddosTargets"), ddosTargets);
+    if (!entityAnomalies.isEmpty()) {
+        details.insert(QStringLiteral("entityAnomalies"), entityAnomalies);
+    }
+    if (!tcpFindings.isEmpty()) {
+        details.insert(QStringLiteral("tcpFindings"), tcpFindings);
+    }
+    if (!beacons.isEmpty()) {
+        details.insert(QStringLiteral("beacons"), beacons);
+    }
+    if (!dnsFindings.isEmpty()) {
+        details.insert(QStringLiteral("dnsFindings"), dnsFindings);
     }
-    if (!aggressiveSources.isEmpty()) {
-        details.insert(QStringLiteral("aggressiveSources"), aggressiveSources);
+    if (!ruleHits.isEmpty()) {
+        details.insert(QStringLiteral("ruleHits"), ruleHits);
     }
 
     if (reasons.isEmpty()) {
@@ -289,9 +495,11 @@ void AnomalyDetector::observe(const FeatureSnapshot &snapshot)
 
     Event event;
     event.second = snapshot.second;
+    event.endSecond = snapshot.second;
     event.score = score;
     event.reasons = reasons;
     event.tags = tags;
+    event.entities = entities;
     event.details = details;
     event.packetRows = collectedRows;
     event.summary = tr("Anomaly at %1s: %2")
@@ -2,15 +2,42 @@
 #define ANOMALYDETECTOR_H
 
 #include <QObject>
+#include <QByteArray>
+#include <QHash>
 #include <QMap>
 #include <QMetaType>
 #include <QStringList>
 #include <QVariantMap>
 #include <QVector>
 
+#include "anomalyrules.h"
+#include "beacondetector.h"
+#include "dnsanalytics.h"
+#include "entitybaselines.h"
+#include "rowrangeset.h"
+#include "seasonalbaselines.h"
+#include "tcpflagdetectors.h"
+
+class QFileSystemWatcher;
+
 class AnomalyDetector : public QObject {
     Q_OBJECT
 public:
+    struct Quantiles {
+        quint64 samples = 0;
+        double p50 = 0.0;
+        double p90 = 0.0;
+        double p99 = 0.0;
+    };
+
+    // Parallel arrays over every entity active in a second. Keys are stable
+    // for the session; names only label reasons.
+    struct EntityCounts {
+        QVector<quint64> keys;
+        QVector<double> packets;
+        QStringList names;
+    };
+
     struct FeatureSnapshot {
         int second = 0;
         double packets = 0.0;
@@ -22,54 +49,85 @@ public:
         int protocolCount = 0;
         QStringList newProtocols;
         QMap<QString, int> protocolCounts;
+        Quantiles packetSize;       // bytes
+        Quantiles interArrivalUs;   // gap to the previous packet
+        Quantiles handshakeRttUs;   // SYN to SYN/ACK
+        // Heavy hitters and fan-in/fan-out candidates only, not every host.
         QMap<QString, int> sourcePackets;
         QMap<QString, int> destinationPackets;
         QMap<QString, int> destinationFanIn;
         QMap<QString, int> sourceFanOut;
-        QMap<QString, QVector<int>> rowsBySource;
-        QMap<QString, QVector<int>> rowsByDestination;
-        QVector<int> packetRows;
+        QMap<QString, RowRangeSet> rowsBySource;
+        QMap<QString, RowRangeSet> rowsByDestination;
+        QHash<quint16, RowRangeSet> rowsByService;
+        RowRangeSet packetRows;
+        // All senders, receivers and service ports, for per-entity baselines.
+        EntityCounts sources;
+        EntityCounts destinations;
+        EntityCounts services;
+        TcpFlagDetectors::Features tcp;
+        // Only on the seconds the conversations are scored.
+        QVector<BeaconDetector::Finding> beacons;
+        // Only on the seconds that close a DNS window.
+        QVector<DnsAnalytics::Finding> dns;
+        int secondOfWeek = -1;      // local time from Monday 00:00, -1 if unknown
     };
 
+    // One second's findings, or an incident folded from several; see
+    // IncidentCoalescer. Summary, reasons and details are the peak second's.
     struct Event {
-        int second = 0;
-        double score = 0.0;
+        quint64 id = 0;             // incident, stable while it grows
+        int second = 0;             // first second
+        int endSecond = 0;          // last second
+        int seconds = 1;            // seconds that raised it
+        double score = 0.0;         // peak
         QString summary;
         QStringList reasons;
         QStringList tags;
+        QStringList entities;       // hosts, ports and domains the reasons name
         QVariantMap details;
-        QVector<int> packetRows;
+        RowRangeSet packetRows;
     };
 
     explicit AnomalyDetector(QObject *parent = nullptr);
 
     void observe(const FeatureSnapshot &snapshot);
 
+    // Loads rules from path and reloads them whenever the file changes. A
+    // missing file means the built-in rules; a broken one is reported and
+    // the rules in use are kept.
+    void setRulesPath(const QString &path);
+    QString rulesPath() const;
+    bool loadRules(const QByteArray &json, QString *error = nullptr);
+
+    // Time-of-week profiles for the seasonal rules. A missing file or an
+    // empty path starts without any. Saving is skipped until a time slot has
+    // closed since the last save, unless forced.
+    bool loadSeasonalBaselines(const QString &path);
+    bool saveSeasonalBaselines(const QString &path, bool force = false);
+
 signals:
     void anomalyDetected(const AnomalyDetector::Event &event);
 
 private:
-    class AdaptiveMetric {
-    public:
-        explicit AdaptiveMetric(double alpha = 0.2);
-
-        double updateAndScore(double value, int warmup);
-        void reset();
-
-    private:
-        double m_alpha;
-        bool m_initialized = false;
-        double m_mean = 0.0;
-        double m_variance = 1.0;
-        int m_count = 0;
-    };
+    void reloadRules();
+
+    AnomalyRules m_rules;
+    QVector<AnomalyRules::Hit> m_hits;
+    QString m_rulesPath;
+    QByteArray m_rulesSource;
+    QFileSystemWatcher *m_rulesWatcher = nullptr;
+
+    SeasonalBaselines m_seasonal;
+    int m_seasonalSlot = -1;
+    bool m_seasonalDirty = false;
 
-    AdaptiveMetric m_packetMetric;
-    AdaptiveMetric m_byteMetric;
-    AdaptiveMetric m_connectionMetric;
-    AdaptiveMetric m_newConnectionMetric;
-    AdaptiveMetric m_entropyMetric;
-    AdaptiveMetric m_avgPacketMetric;
+    EntityBaselines m_sourceBaselines;
+    EntityBaselines m_destinationBaselines;
+    EntityBaselines m_serviceBaselines;
+    QVector<double> m_entityScores;
+    QVector<double> m_entityExpected;
+    TcpFlagDetectors m_tcpDetectors;
 
     double m_threshold;
     int m_warmup;
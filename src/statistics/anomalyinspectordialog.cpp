@@ -154,7 +154,9 @@ void AnomalyInspectorDialog::applyFilter()
         m_filteredEvents.append(event);
 
         auto *item = new QTreeWidgetItem(m_eventTree);
-        item->setText(0, QString::number(event.second));
+        item->setText(0, event.endSecond > event.second
+                             ? QStringLiteral("%1–%2").arg(event.second).arg(event.endSecond)
+                             : QString::number(event.second));
         item->setText(1, QString::number(event.score, 'f', 2));
         item->setText(2, event.tags.join(QStringLiteral(", ")));
         item->setText(3, event.summary);
@@ -193,7 +195,7 @@ void AnomalyInspectorDialog::onFocusRequested()
     if (filteredIndex < 0 || filteredIndex >= m_filteredEvents.size()) {
         return;
     }
-    const QVector<int> rows = m_filteredEvents.at(filteredIndex).packetRows;
+    const RowRangeSet &rows = m_filteredEvents.at(filteredIndex).packetRows;
     if (!rows.isEmpty()) {
         emit requestFocusPackets(rows);
     }
@@ -241,9 +243,18 @@ void AnomalyInspectorDialog::updateDetails(int filteredIndex)
     QStringList sections;
     sections << tr("Summary: %1").arg(event.summary);
     sections << tr("Score: %1").arg(event.score, 0, 'f', 2);
+    if (event.endSecond > event.second) {
+        sections << tr("Lasted: %1 s to %2 s, anomalous in %3 of them")
+                        .arg(event.second)
+                        .arg(event.endSecond)
+                        .arg(event.seconds);
+    }
     if (!event.tags.isEmpty()) {
         sections << tr("Tags: %1").arg(event.tags.join(QStringLiteral(", ")));
     }
+    if (!event.entities.isEmpty()) {
+        sections << tr("Entities: %1").arg(event.entities.join(QStringLiteral(", ")));
+    }
 
     if (!event.reasons.isEmpty()) {
         sections << QString();
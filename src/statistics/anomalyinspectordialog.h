@@ -22,7 +22,7 @@ public:
     void setEvents(const QVector<AnomalyDetector::Event> &events);
 
 signals:
-    void requestFocusPackets(const QVector<int> &rows);
+    void requestFocusPackets(const RowRangeSet &rows);
 
 private slots:
     void applyFilter();
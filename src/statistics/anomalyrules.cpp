@@ -0,0 +1,504 @@
+#include "anomalyrules.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr double kMinVariance = 1e-4;
+constexpr int kMaxWindow = 3600;
+// Label placeholders past the metric indexes.
+constexpr int kEntityField = 1000;
+constexpr int kValueField = 1001;
+constexpr int kScoreField = 1002;
+
+struct MetricName {
+    const char *name;
+    quint8 metric;
+};
+
+const MetricName kSecondMetrics[] = {
+    {"packets", AnomalyRules::Packets},
+    {"bytes", AnomalyRules::Bytes},
+    {"avgPacketSize", AnomalyRules::AvgPacketSize},
+    {"uniqueConnections", AnomalyRules::UniqueConnections},
+    {"newConnections", AnomalyRules::NewConnections},
+    {"connectionChurn", AnomalyRules::ConnectionChurn},
+    {"protocolEntropy", AnomalyRules::ProtocolEntropy},
+    {"protocolCount", AnomalyRules::ProtocolCount},
+    {"packetSizeP50", AnomalyRules::PacketSizeP50},
+    {"packetSizeP90", AnomalyRules::PacketSizeP90},
+    {"packetSizeP99", AnomalyRules::PacketSizeP99},
+    {"interArrivalP50", AnomalyRules::InterArrivalP50},
+    {"interArrivalP90", AnomalyRules::InterArrivalP90},
+    {"interArrivalP99", AnomalyRules::InterArrivalP99},
+    {"handshakeRttP50", AnomalyRules::HandshakeRttP50},
+    {"handshakeRttP90", AnomalyRules::HandshakeRttP90},
+    {"handshakeRttP99", AnomalyRules::HandshakeRttP99},
+    {"tcpSegments", AnomalyRules::TcpSegments},
+    {"tcpSyn", AnomalyRules::TcpSyn},
+    {"tcpSynAck", AnomalyRules::TcpSynAck},
+    {"tcpRst", AnomalyRules::TcpRst},
+    {"tcpFin", AnomalyRules::TcpFin},
+};
+
+const MetricName kEntityMetrics[] = {
+    {"packets", AnomalyRules::EntityPackets},
+    {"share", AnomalyRules::EntityShare},
+    {"peers", AnomalyRules::EntityPeers},
+    {"fanOut", AnomalyRules::EntityPeers},
+    {"fanIn", AnomalyRules::EntityPeers},
+};
+
+int metricIndex(AnomalyRules::Scope scope, const QString &name)
+{
+    auto find = [&name](const auto &table) {
+        for (const MetricName &entry : table) {
+            if (name == QLatin1String(entry.name)) {
+                return int(entry.metric);
+            }
+        }
+        return -1;
+    };
+    return scope == AnomalyRules::Scope::Second ? find(kSecondMetrics) : find(kEntityMetrics);
+}
+
+QString formatNumber(double value, bool percent)
+{
+    if (percent) {
+        return QString::number(value * 100.0, 'f', 1);
+    }
+    return QString::number(value, 'f', value == std::floor(value) ? 0 : 2);
+}
+
+// The checks the detector shipped with before they became configurable; the
+// traffic volumes are judged against their time-of-week profile.
+const char kDefaultRules[] = R"json({
+    "version": 1,
+    "threshold": 2.8,
+    "warmup": 6,
+    "rules": [
+        {"metric": "packets", "statistic": "seasonal", "window": 12, "direction": "either",
+         "tag": "packet-rate", "label": "Packet rate spike ({score}σ)"},
+        {"metric": "bytes", "statistic": "seasonal", "window": 12, "direction": "either",
+         "tag": "byte-throughput", "label": "Byte throughput surge ({score}σ)"},
+        {"metric": "uniqueConnections", "statistic": "seasonal", "window": 16, "direction": "either",
+         "tag": "connection-fanout", "label": "Connection fan-out ({score}σ)"},
+        {"metric": "newConnections", "statistic": "seasonal", "window": 16, "direction": "either",
+         "tag": "new-connections", "label": "Burst of new connections ({score}σ)"},
+        {"metric": "protocolEntropy", "statistic": "zscore", "window": 19, "direction": "either",
+         "tag": "protocol-entropy", "label": "Protocol mix shift ({score}σ)"},
+        {"metric": "avgPacketSize", "statistic": "zscore", "window": 19, "direction": "either",
+         "tag": "packet-size", "label": "Packet size swing ({score}σ)"},
+        {"metric": "handshakeRttP90", "statistic": "zscore", "window": 19, "direction": "either",
+         "tag": "handshake-rtt", "label": "Handshake latency shift ({score}σ)"},
+        {"metric": "connectionChurn", "threshold": 0.6,
+         "require": [{"metric": "newConnections", "min": 6}],
+         "tag": "connection-churn",
+         "label": "High connection churn ({newConnections} new/{uniqueConnections} total)"},
+        {"scope": "destination", "metric": "fanIn", "threshold": 8,
+         "require": [{"metric": "packets", "min": 40}, {"metric": "share", "min": 0.35}],
+         "severity": 1.3, "tag": "ddos-target",
+         "label": "Potential DDoS against {entity} ({fanIn} sources, {packets} packets)"},
+        {"scope": "source", "group": "spread", "metric": "fanOut", "threshold": 15,
+         "require": [{"metric": "packets", "min": 60}, {"metric": "share", "min": 0.25}],
+         "severity": 1.2, "tag": "ddos-source",
+         "label": "Single-source flood from {entity} ({fanOut} destinations, {packets} packets)"},
+        {"scope": "source", "group": "spread", "metric": "fanOut", "threshold": 8,
+         "require": [{"metric": "packets", "min": 40}],
+         "tag": "scan", "label": "Possible scan from {entity} ({fanOut} destinations)"},
+        {"scope": "source", "metric": "share", "threshold": 0.55,
+         "require": [{"metric": "packets", "min": 30}],
+         "tag": "top-source", "label": "Dominant source {entity} ({share%}% of packets)"}
+    ]
+})json";
+}
+
+AnomalyRules::AnomalyRules()
+{
+    load(defaultJson());
+}
+
+QByteArray AnomalyRules::defaultJson()
+{
+    return QByteArray(kDefaultRules);
+}
+
+QString AnomalyRules::secondMetricName(int metric)
+{
+    for (const MetricName &entry : kSecondMetrics) {
+        if (entry.metric == metric) {
+            return QString::fromLatin1(entry.name);
+        }
+    }
+    return QString();
+}
+
+int AnomalyRules::secondMetricIndex(const QString &name)
+{
+    return metricIndex(Scope::Second, name);
+}
+
+bool AnomalyRules::load(const QByteArray &json, QString *error)
+{
+    auto fail = [error](const QString &message) {
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        return fail(QStringLiteral("%1 at offset %2").arg(parseError.errorString()).arg(parseError.offset));
+    }
+    if (!document.isObject()) {
+        return fail(QStringLiteral("expected an object with a \"rules\" array"));
+    }
+    const QJsonObject root = document.object();
+    const double threshold = root.value(QStringLiteral("threshold")).toDouble(2.8);
+    const int warmup = root.value(QStringLiteral("warmup")).toInt(6);
+    if (threshold <= 0.0 || warmup < 0) {
+        return fail(QStringLiteral("threshold must be positive and warmup not negative"));
+    }
+
+    QVector<Rule> rules;
+    QVector<Gate> gates;
+    QVector<LabelPart> parts;
+    QStringList groups;
+    const QJsonArray definitions = root.value(QStringLiteral("rules")).toArray();
+    for (int i = 0; i < definitions.size(); ++i) {
+        const QJsonObject definition = definitions.at(i).toObject();
+        const QString where = QStringLiteral("rule %1: ").arg(i + 1);
+        Rule rule;
+
+        const QString scope = definition.value(QStringLiteral("scope")).toString(QStringLiteral("second"));
+        if (scope == QLatin1String("second")) {
+            rule.scope = Scope::Second;
+        } else if (scope == QLatin1String("source")) {
+            rule.scope = Scope::Source;
+        } else if (scope == QLatin1String("destination")) {
+            rule.scope = Scope::Destination;
+        } else {
+            return fail(where + QStringLiteral("unknown scope \"%1\"").arg(scope));
+        }
+
+        const QString metricName = definition.value(QStringLiteral("metric")).toString();
+        const int metric = metricIndex(rule.scope, metricName);
+        if (metric < 0) {
+            return fail(where + QStringLiteral("unknown %1 metric \"%2\"").arg(scope, metricName));
+        }
+        rule.metric = quint8(metric);
+
+        const QString statistic = definition.value(QStringLiteral("statistic")).toString(QStringLiteral("value"));
+        if (statistic == QLatin1String("value")) {
+            rule.statistic = Statistic::Value;
+        } else if (statistic == QLatin1String("mean")) {
+            rule.statistic = Statistic::Mean;
+        } else if (statistic == QLatin1String("sum")) {
+            rule.statistic = Statistic::Sum;
+        } else if (statistic == QLatin1String("max")) {
+            rule.statistic = Statistic::Max;
+        } else if (statistic == QLatin1String("zscore")) {
+            rule.statistic = Statistic::ZScore;
+        } else if (statistic == QLatin1String("seasonal")) {
+            rule.statistic = Statistic::Seasonal;
+        } else {
+            return fail(where + QStringLiteral("unknown statistic \"%1\"").arg(statistic));
+        }
+        if (rule.scope != Scope::Second && rule.statistic != Statistic::Value) {
+            // Hosts come and go between seconds; their history lives in the baselines.
+            return fail(where + QStringLiteral("%1 rules only support the value statistic").arg(scope));
+        }
+
+        const QString direction = definition.value(QStringLiteral("direction")).toString(QStringLiteral("above"));
+        if (direction == QLatin1String("above")) {
+            rule.direction = Direction::Above;
+        } else if (direction == QLatin1String("below")) {
+            rule.direction = Direction::Below;
+        } else if (direction == QLatin1String("either")) {
+            rule.direction = Direction::Either;
+        } else {
+            return fail(where + QStringLiteral("unknown direction \"%1\"").arg(direction));
+        }
+
+        rule.window = definition.value(QStringLiteral("window")).toInt(1);
+        if (rule.window < 1 || rule.window > kMaxWindow) {
+            return fail(where + QStringLiteral("window must be 1-%1 seconds").arg(kMaxWindow));
+        }
+        rule.alpha = 2.0 / (rule.window + 1.0);
+        rule.threshold = definition.value(QStringLiteral("threshold")).toDouble(threshold);
+        rule.severity = definition.value(QStringLiteral("severity")).toDouble(1.0);
+        if (rule.severity <= 0.0) {
+            return fail(where + QStringLiteral("severity must be positive"));
+        }
+        rule.tag = definition.value(QStringLiteral("tag")).toString();
+        if (rule.tag.isEmpty()) {
+            return fail(where + QStringLiteral("missing tag"));
+        }
+
+        rule.firstGate = int(gates.size());
+        const QJsonArray require = definition.value(QStringLiteral("require")).toArray();
+        for (const QJsonValue &value : require) {
+            const QJsonObject condition = value.toObject();
+            const QString name = condition.value(QStringLiteral("metric")).toString();
+            const int gateMetric = metricIndex(rule.scope, name);
+            if (gateMetric < 0) {
+                return fail(where + QStringLiteral("unknown %1 metric \"%2\"").arg(scope, name));
+            }
+            Gate gate;
+            gate.metric = quint8(gateMetric);
+            gate.min = condition.value(QStringLiteral("min")).toDouble(-std::numeric_limits<double>::infinity());
+            gate.max = condition.value(QStringLiteral("max")).toDouble(std::numeric_limits<double>::infinity());
+            gates.append(gate);
+        }
+        rule.gateCount = int(gates.size()) - rule.firstGate;
+
+        const QString label = definition.value(QStringLiteral("label")).toString(rule.tag);
+        rule.firstPart = int(parts.size());
+        int pos = 0;
+        while (pos < label.size()) {
+            const int open = label.indexOf(QLatin1Char('{'), pos);
+            const int close = open >= 0 ? label.indexOf(QLatin1Char('}'), open) : -1;
+            if (close < 0) {
+                parts.append({label.mid(pos), -1, false});
+                break;
+            }
+            if (open > pos) {
+                parts.append({label.mid(pos, open - pos), -1, false});
+            }
+            LabelPart part;
+            QString name = label.mid(open + 1, close - open - 1);
+            if (name.endsWith(QLatin1Char('%'))) {
+                part.percent = true;
+                name.chop(1);
+            }
+            if (name == QLatin1String("entity")) {
+                part.field = kEntityField;
+            } else if (name == QLatin1String("value")) {
+                part.field = kValueField;
+            } else if (name == QLatin1String("score")) {
+                part.field = kScoreField;
+            } else {
+                part.field = metricIndex(rule.scope, name);
+                if (part.field < 0) {
+                    return fail(where + QStringLiteral("unknown placeholder {%1}").arg(name));
+                }
+            }
+            parts.append(part);
+            pos = close + 1;
+        }
+        rule.partCount = int(parts.size()) - rule.firstPart;
+
+        const QString group = definition.value(QStringLiteral("group")).toString();
+        if (!group.isEmpty()) {
+            rule.group = int(groups.indexOf(group));
+            if (rule.group < 0) {
+                rule.group = int(groups.size());
+                groups.append(group);
+            }
+        }
+        rules.append(rule);
+    }
+
+    std::stable_sort(rules.begin(), rules.end(), [](const Rule &a, const Rule &b) {
+        return a.scope < b.scope;
+    });
+
+    // Lay out the history, carrying over that of rules which kept their
+    // metric, statistic and window so a reload does not restart warm-up.
+    QVector<double> state;
+    QVector<bool> reused(m_rules.size(), false);
+    for (Rule &rule : rules) {
+        int size = 0;
+        if (rule.statistic == Statistic::ZScore || rule.statistic == Statistic::Seasonal) {
+            size = 4;
+        } else if (rule.statistic != Statistic::Value) {
+            size = 2 + rule.window;
+        }
+        if (size == 0) {
+            continue;
+        }
+        rule.state = int(state.size());
+        state.resize(state.size() + size);
+        for (int j = 0; j < m_rules.size(); ++j) {
+            const Rule &old = m_rules.at(j);
+            if (!reused.at(j) && old.state >= 0 && old.scope == rule.scope && old.metric == rule.metric
+                && old.statistic == rule.statistic && old.window == rule.window) {
+                std::copy_n(m_state.constData() + old.state, size, state.data() + rule.state);
+                reused[j] = true;
+                break;
+            }
+        }
+    }
+
+    m_threshold = threshold;
+    m_warmup = warmup;
+    m_rules = rules;
+    m_gates = gates;
+    m_parts = parts;
+    m_state = state;
+    m_groupFired.fill(0, groups.size());
+    m_seasonalMetrics.clear();
+    for (const Rule &rule : std::as_const(m_rules)) {
+        if (rule.statistic == Statistic::Seasonal && !m_seasonalMetrics.contains(rule.metric)) {
+            m_seasonalMetrics.append(rule.metric);
+        }
+    }
+    for (Range &range : m_ranges) {
+        range = Range();
+    }
+    for (int i = 0; i < m_rules.size(); ++i) {
+        Range &range = m_ranges[int(m_rules.at(i).scope)];
+        if (range.first == range.last) {
+            range.first = i;
+        }
+        range.last = i + 1;
+    }
+    return true;
+}
+
+bool AnomalyRules::hasRules(Scope scope) const
+{
+    const Range &range = m_ranges[int(scope)];
+    return range.last > range.first;
+}
+
+void AnomalyRules::evaluate(Scope scope, const double *metrics, const QString &entity, QVector<Hit> &hits,
+                            const double *seasonal)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const Range range = m_ranges[int(scope)];
+    std::fill(m_groupFired.begin(), m_groupFired.end(), quint8(0));
+    for (int i = range.first; i < range.last; ++i) {
+        const Rule &rule = m_rules.at(i);
+        const double value = metrics[rule.metric];
+        if (std::isnan(value)) {
+            continue;
+        }
+        const double statistic = update(rule, value, seasonal ? seasonal[rule.metric] : nan);
+        if (std::isnan(statistic) || (rule.group >= 0 && m_groupFired.at(rule.group))) {
+            continue;
+        }
+
+        bool fires = false;
+        switch (rule.direction) {
+        case Direction::Above:
+            fires = statistic >= rule.threshold;
+            break;
+        case Direction::Below:
+            fires = statistic <= rule.threshold;
+            break;
+        case Direction::Either:
+            fires = std::abs(statistic) >= std::abs(rule.threshold);
+            break;
+        }
+        for (int g = rule.firstGate; fires && g < rule.firstGate + rule.gateCount; ++g) {
+            const Gate &gate = m_gates.at(g);
+            const double gated = metrics[gate.metric];
+            fires = gated >= gate.min && gated <= gate.max;
+        }
+        if (!fires) {
+            continue;
+        }
+
+        // A rule that just fires weighs as much as the global threshold.
+        const double excess = rule.threshold != 0.0 ? std::abs(statistic / rule.threshold) : 1.0;
+        Hit hit;
+        hit.rule = i;
+        hit.statistic = statistic;
+        hit.score = m_threshold * rule.severity * excess;
+        hit.entity = entity;
+        hits.append(hit);
+        if (rule.group >= 0) {
+            m_groupFired[rule.group] = 1;
+        }
+    }
+}
+
+QString AnomalyRules::tag(int rule) const
+{
+    return m_rules.at(rule).tag;
+}
+
+QString AnomalyRules::describe(const Hit &hit, const double *metrics) const
+{
+    const Rule &rule = m_rules.at(hit.rule);
+    QString text;
+    for (int i = rule.firstPart; i < rule.firstPart + rule.partCount; ++i) {
+        const LabelPart &part = m_parts.at(i);
+        switch (part.field) {
+        case -1:
+            text += part.text;
+            break;
+        case kEntityField:
+            text += hit.entity;
+            break;
+        case kScoreField:
+            text += QString::number(hit.statistic, 'f', 2);
+            break;
+        case kValueField:
+            text += formatNumber(metrics[rule.metric], part.percent);
+            break;
+        default:
+            text += formatNumber(metrics[part.field], part.percent);
+            break;
+        }
+    }
+    return text;
+}
+
+double AnomalyRules::update(const Rule &rule, double value, double seasonal)
+{
+    if (rule.statistic == Statistic::Value) {
+        return value;
+    }
+
+    double *state = m_state.data() + rule.state;
+    if (rule.statistic == Statistic::ZScore || rule.statistic == Statistic::Seasonal) {
+        // state: seeded, mean, variance, samples. The first sample seeds the
+        // mean; nothing is scored until warm-up is over. Seasonal rules keep
+        // the EWMA current for the time slots the profile has not seen yet.
+        const bool useSeasonal = rule.statistic == Statistic::Seasonal && !std::isnan(seasonal);
+        if (state[0] == 0.0) {
+            state[0] = 1.0;
+            state[1] = value;
+            state[2] = kMinVariance;
+            state[3] = 1.0;
+            return useSeasonal ? seasonal : std::numeric_limits<double>::quiet_NaN();
+        }
+        const double delta = value - state[1];
+        const double score = delta / std::sqrt(std::max(state[2], kMinVariance));
+        state[1] += rule.alpha * delta;
+        state[2] = (1.0 - rule.alpha) * (state[2] + rule.alpha * delta * delta);
+        state[3] += 1.0;
+        if (useSeasonal) {
+            return seasonal;
+        }
+        return state[3] <= m_warmup ? std::numeric_limits<double>::quiet_NaN() : score;
+    }
+
+    // state: next slot, filled slots, then the window's values.
+    double *values = state + 2;
+    const int next = int(state[0]);
+    values[next] = value;
+    state[0] = double((next + 1) % rule.window);
+    const int filled = std::min(int(state[1]) + 1, rule.window);
+    state[1] = double(filled);
+
+    double result = rule.statistic == Statistic::Max ? values[0] : 0.0;
+    for (int i = 0; i < filled; ++i) {
+        if (rule.statistic == Statistic::Max) {
+            result = std::max(result, values[i]);
+        } else {
+            result += values[i];
+        }
+    }
+    return rule.statistic == Statistic::Mean ? result / filled : result;
+}
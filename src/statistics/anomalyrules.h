@@ -0,0 +1,154 @@
+#ifndef ANOMALYRULES_H
+#define ANOMALYRULES_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// Detection rules read from JSON and compiled once into a flat plan. A rule
+// compares one statistic of one metric with a threshold, optionally gated on
+// the raw values of other metrics, and runs either once per second or once
+// per heavy source/destination:
+//
+//   {"threshold": 2.8, "warmup": 6, "rules": [
+//     {"metric": "packets", "statistic": "zscore", "window": 12,
+//      "direction": "either", "tag": "packet-rate",
+//      "label": "Packet rate spike ({score}σ)"},
+//     {"scope": "destination", "metric": "fanIn", "threshold": 8,
+//      "require": [{"metric": "packets", "min": 40}],
+//      "tag": "ddos-target", "label": "Potential DDoS against {entity}"}]}
+//
+// Statistics are value, mean, sum, max (over window seconds), zscore (an
+// EWMA spanning window seconds) and seasonal (deviations from what the
+// metric usually does at this time of the week, falling back to the zscore
+// until that is known). Rules sharing a group stop at the first one that
+// fires. Labels may name {entity}, {value}, {score} and any metric of
+// the rule's scope; a trailing % prints a share as a percentage.
+class AnomalyRules
+{
+public:
+    enum class Scope : quint8 { Second, Source, Destination };
+
+    // Indexes into the metric arrays handed to evaluate(). A NaN metric is
+    // unavailable that second and skips the rules reading it.
+    enum SecondMetric : quint8 {
+        Packets,
+        Bytes,
+        AvgPacketSize,
+        UniqueConnections,
+        NewConnections,
+        ConnectionChurn,
+        ProtocolEntropy,
+        ProtocolCount,
+        PacketSizeP50,
+        PacketSizeP90,
+        PacketSizeP99,
+        InterArrivalP50,
+        InterArrivalP90,
+        InterArrivalP99,
+        HandshakeRttP50,
+        HandshakeRttP90,
+        HandshakeRttP99,
+        TcpSegments,
+        TcpSyn,
+        TcpSynAck,
+        TcpRst,
+        TcpFin,
+        SecondMetricCount
+    };
+
+    enum EntityMetric : quint8 {
+        EntityPackets,
+        EntityShare,    // of the second's packets
+        EntityPeers,    // fan-out of a source, fan-in of a destination
+        EntityMetricCount
+    };
+
+    struct Hit {
+        int rule = -1;
+        double statistic = 0.0;
+        double score = 0.0;   // contribution to the event's score
+        QString entity;
+    };
+
+    AnomalyRules();
+
+    // Replaces the plan. Rules that keep their metric, statistic and window
+    // keep their history. On error the current plan stays in place.
+    bool load(const QByteArray &json, QString *error = nullptr);
+    static QByteArray defaultJson();
+
+    double threshold() const { return m_threshold; }
+    int warmup() const { return m_warmup; }
+    int size() const { return int(m_rules.size()); }
+    bool hasRules(Scope scope) const;
+
+    // Appends the rules of scope that fire on metrics to hits. seasonal holds
+    // the time-of-week score of each per-second metric, NaN where unknown.
+    // Does not allocate once hits has grown to its working size.
+    void evaluate(Scope scope, const double *metrics, const QString &entity, QVector<Hit> &hits,
+                  const double *seasonal = nullptr);
+    // Per-second metrics read by seasonal rules.
+    const QVector<quint8> &seasonalMetrics() const { return m_seasonalMetrics; }
+
+    static QString secondMetricName(int metric);
+    static int secondMetricIndex(const QString &name);
+
+    QString tag(int rule) const;
+    // The rule's label filled in from the metrics the hit was evaluated on.
+    QString describe(const Hit &hit, const double *metrics) const;
+
+private:
+    enum class Statistic : quint8 { Value, Mean, Sum, Max, ZScore, Seasonal };
+    enum class Direction : quint8 { Above, Below, Either };
+
+    struct Gate {
+        quint8 metric = 0;
+        double min = 0.0;
+        double max = 0.0;
+    };
+
+    // Literal text, or a placeholder when field >= 0.
+    struct LabelPart {
+        QString text;
+        int field = -1;
+        bool percent = false;
+    };
+
+    struct Rule {
+        Scope scope = Scope::Second;
+        quint8 metric = 0;
+        Statistic statistic = Statistic::Value;
+        Direction direction = Direction::Above;
+        int window = 1;
+        double alpha = 1.0;
+        double threshold = 0.0;
+        double severity = 1.0;
+        int state = -1;        // offset into m_state
+        int firstGate = 0;
+        int gateCount = 0;
+        int firstPart = 0;
+        int partCount = 0;
+        int group = -1;
+        QString tag;
+    };
+
+    struct Range {
+        int first = 0;
+        int last = 0;
+    };
+
+    double update(const Rule &rule, double value, double seasonal);
+
+    double m_threshold = 2.8;
+    int m_warmup = 6;
+    QVector<Rule> m_rules;       // grouped by scope
+    Range m_ranges[3];
+    QVector<Gate> m_gates;
+    QVector<LabelPart> m_parts;
+    QVector<double> m_state;
+    QVector<quint8> m_groupFired;
+    QVector<quint8> m_seasonalMetrics;
+};
+
+#endif // ANOMALYRULES_H
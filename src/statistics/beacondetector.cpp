@@ -0,0 +1,239 @@
+#include "beacondetector.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+// Packets of a conversation closer than this belong to one contact.
+constexpr quint32 kContactGapMs = 1000;
+constexpr double kMinPeriodMs = 2000.0;
+constexpr double kMaxPeriodMs = 30 * 60 * 1000.0;
+// Conversations quiet for two of the longest periods are dropped, single
+// contacts sooner since most conversations never get a second one.
+constexpr qint64 kIdleMs = 2 * 30 * 60 * 1000;
+constexpr qint64 kIdleSingleContactMs = 5 * 60 * 1000;
+constexpr qint64 kSweepIntervalMs = 60 * 1000;
+constexpr int kMinContacts = 8;
+// A gap may span this many periods, i.e. two missed beacons in a row.
+constexpr int kMaxMultiple = 3;
+constexpr double kMaxJitter = 0.1;
+constexpr double kMinFittedShare = 0.8;
+constexpr double kMinCoherence = 0.8;
+constexpr int kMaxFindings = 5;
+constexpr double kTwoPi = 6.283185307179586;
+
+template <typename Array>
+double median(Array values, int n)
+{
+    std::nth_element(values.begin(), values.begin() + n / 2, values.begin() + n);
+    return values[n / 2];
+}
+}
+
+BeaconDetector::BeaconDetector(int capacity)
+    : m_capacity(std::max(1, capacity))
+{
+}
+
+void BeaconDetector::add(quint32 src, quint32 dst, quint16 port, qint64 timeMs, int row)
+{
+    if (timeMs < 0) {
+        return;
+    }
+    const Key key{std::min(src, dst), std::max(src, dst), port};
+    const auto it = m_index.constFind(key);
+    int slot = 0;
+    if (it == m_index.constEnd()) {
+        slot = acquire(key);
+        if (slot < 0) {
+            ++m_untracked;
+            return;
+        }
+        m_initiator[slot] = src;
+    } else {
+        slot = it.value();
+    }
+
+    const quint32 now = quint32(timeMs);
+    const quint32 last = m_lastMs.at(slot);
+    // Stragglers and packets right after the last one extend the contact.
+    if (m_count.at(slot) > 0 && (now <= last || now - last < kContactGapMs)) {
+        m_lastMs[slot] = std::max(last, now);
+        return;
+    }
+    m_lastMs[slot] = now;
+    const int position = slot * kRing + m_head.at(slot);
+    m_contactMs[position] = now;
+    m_contactRow[position] = row;
+    m_head[slot] = quint8((m_head.at(slot) + 1) % kRing);
+    m_count[slot] = quint8(std::min(m_count.at(slot) + 1, kRing));
+    m_sinceReport[slot] = quint8(std::min(m_sinceReport.at(slot) + 1, 255));
+    if (!(m_flags.at(slot) & Pending)) {
+        m_flags[slot] |= Pending;
+        m_pending.append(slot);
+    }
+}
+
+QVector<BeaconDetector::Finding> BeaconDetector::score(qint64 nowMs)
+{
+    QVector<Finding> findings;
+    for (const int slot : std::as_const(m_pending)) {
+        m_flags[slot] &= quint8(~Pending);
+        const bool reported = m_flags.at(slot) & Reported;
+        if (m_count.at(slot) < kMinContacts || m_sinceReport.at(slot) < (reported ? kRing : kMinContacts)) {
+            continue;
+        }
+        Finding finding;
+        if (!measure(slot, finding)) {
+            continue;
+        }
+        m_flags[slot] |= Reported;
+        m_sinceReport[slot] = 0;
+        findings.append(finding);
+    }
+    m_pending.clear();
+
+    std::sort(findings.begin(), findings.end(), [](const Finding &a, const Finding &b) {
+        return a.coherence * (1.0 - a.jitter) > b.coherence * (1.0 - b.jitter);
+    });
+    if (findings.size() > kMaxFindings) {
+        findings.resize(kMaxFindings);
+    }
+
+    if (nowMs - m_lastSweepMs >= kSweepIntervalMs) {
+        forgetIdle(nowMs);
+        m_lastSweepMs = nowMs;
+    }
+    return findings;
+}
+
+void BeaconDetector::clear()
+{
+    m_index.clear();
+    m_keys.clear();
+    m_initiator.clear();
+    m_lastMs.clear();
+    m_count.clear();
+    m_head.clear();
+    m_sinceReport.clear();
+    m_flags.clear();
+    m_contactMs.clear();
+    m_contactRow.clear();
+    m_free.clear();
+    m_pending.clear();
+    m_lastSweepMs = 0;
+    m_untracked = 0;
+}
+
+int BeaconDetector::acquire(const Key &key)
+{
+    int slot = -1;
+    if (!m_free.isEmpty()) {
+        slot = m_free.takeLast();
+    } else if (m_keys.size() < m_capacity) {
+        slot = int(m_keys.size());
+        m_keys.append(Key());
+        m_initiator.append(0);
+        m_lastMs.append(0);
+        m_count.append(0);
+        m_head.append(0);
+        m_sinceReport.append(0);
+        m_flags.append(0);
+        m_contactMs.resize(m_contactMs.size() + kRing);
+        m_contactRow.resize(m_contactRow.size() + kRing);
+    } else {
+        return -1;
+    }
+    m_keys[slot] = key;
+    m_count[slot] = 0;
+    m_head[slot] = 0;
+    m_sinceReport[slot] = 0;
+    m_flags[slot] = InUse;
+    m_index.insert(key, slot);
+    return slot;
+}
+
+void BeaconDetector::release(int slot)
+{
+    m_index.remove(m_keys.at(slot));
+    m_flags[slot] = 0;
+    m_free.append(slot);
+}
+
+bool BeaconDetector::measure(int slot, Finding &finding) const
+{
+    const int n = m_count.at(slot);
+    const int base = slot * kRing;
+    const int oldest = (m_head.at(slot) - n + kRing) % kRing;
+    std::array<double, kRing> times{};
+    for (int i = 0; i < n; ++i) {
+        times[i] = m_contactMs.at(base + (oldest + i) % kRing);
+    }
+    const int gapCount = n - 1;
+    std::array<double, kRing> gaps{};
+    for (int i = 0; i < gapCount; ++i) {
+        gaps[i] = times[i + 1] - times[i];
+    }
+    const double typicalGap = median(gaps, gapCount);
+    if (typicalGap < kMinPeriodMs || typicalGap > kMaxPeriodMs) {
+        return false;
+    }
+
+    // The whole span over the number of beats pins the period more finely
+    // than any single gap.
+    const double span = times[n - 1] - times[0];
+    const double period = span / std::max(1.0, std::round(span / typicalGap));
+
+    std::array<double, kRing> misses{};
+    int fitted = 0;
+    for (int i = 0; i < gapCount; ++i) {
+        const double beats = std::round(gaps[i] / period);
+        misses[i] = beats >= 1.0 && beats <= kMaxMultiple
+            ? std::abs(gaps[i] - beats * period) / period
+            : 1.0;
+        fitted += misses[i] <= kMaxJitter ? 1 : 0;
+    }
+    const double jitter = median(misses, gapCount);
+    if (jitter > kMaxJitter || fitted < kMinFittedShare * gapCount) {
+        return false;
+    }
+
+    double re = 0.0;
+    double im = 0.0;
+    for (int i = 0; i < n; ++i) {
+        const double phase = kTwoPi * (times[i] - times[0]) / period;
+        re += std::cos(phase);
+        im += std::sin(phase);
+    }
+    const double coherence = std::hypot(re, im) / n;
+    if (coherence < kMinCoherence) {
+        return false;
+    }
+
+    const Key &key = m_keys.at(slot);
+    finding.initiator = m_initiator.at(slot);
+    finding.responder = finding.initiator == key.low ? key.high : key.low;
+    finding.port = key.port;
+    finding.periodSeconds = period / 1000.0;
+    finding.jitter = jitter;
+    finding.coherence = coherence;
+    finding.contacts = n;
+    for (int i = 0; i < n; ++i) {
+        finding.rows.append(m_contactRow.at(base + (oldest + i) % kRing));
+    }
+    return true;
+}
+
+void BeaconDetector::forgetIdle(qint64 nowMs)
+{
+    for (int slot = 0; slot < m_keys.size(); ++slot) {
+        if (!(m_flags.at(slot) & InUse)) {
+            continue;
+        }
+        const qint64 idle = nowMs - qint64(m_lastMs.at(slot));
+        if (idle > (m_count.at(slot) > 1 ? kIdleMs : kIdleSingleContactMs)) {
+            release(slot);
+        }
+    }
+}
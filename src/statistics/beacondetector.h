@@ -0,0 +1,104 @@
+#ifndef BEACONDETECTOR_H
+#define BEACONDETECTOR_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "rowrangeset.h"
+
+// Finds conversations that recur at a near-fixed interval, as command and
+// control implants do. A conversation is a host pair and service port in
+// either direction; its packets closer together than a second form one
+// contact. Each conversation keeps the start time and first row of its
+// last kRing contacts in flat arrays, so the table stays a fixed cost per
+// conversation however long it lives.
+//
+// Scoring runs in batches over the conversations that gained contacts
+// since the last batch. A conversation beacons when its gaps sit close to
+// whole multiples of one period (a few missed beacons are fine) and its
+// contacts line up in phase at that period, measured as the magnitude of
+// the Fourier term at 1/period over the contact times.
+class BeaconDetector
+{
+public:
+    static constexpr int kRing = 16;
+    static constexpr int kDefaultCapacity = 1 << 18;
+
+    struct Finding {
+        quint32 initiator = 0;     // interned; sent the first packet seen
+        quint32 responder = 0;
+        QString initiatorName;     // left to the caller
+        QString responderName;
+        quint16 port = 0;
+        double periodSeconds = 0.0;
+        double jitter = 0.0;       // median miss of the period, as a share of it
+        double coherence = 0.0;    // 0 for random contacts, 1 for a perfect beat
+        int contacts = 0;
+        RowRangeSet rows;          // first row of each contact
+    };
+
+    explicit BeaconDetector(int capacity = kDefaultCapacity);
+
+    // src and dst are interned hosts, port the service port and timeMs the
+    // time since the session started. Conversations past capacity are not
+    // tracked.
+    void add(quint32 src, quint32 dst, quint16 port, qint64 timeMs, int row);
+    // Scores the conversations with new contacts, strongest first, and
+    // forgets idle ones. A conversation is reported again only after a full
+    // ring of new contacts.
+    QVector<Finding> score(qint64 nowMs);
+
+    int size() const { return int(m_index.size()); }
+    int capacity() const { return m_capacity; }
+    quint64 untracked() const { return m_untracked; }
+    void clear();
+
+private:
+    struct Key {
+        quint32 low = 0;
+        quint32 high = 0;
+        quint16 port = 0;
+
+        bool operator==(const Key &other) const
+        {
+            return low == other.low && high == other.high && port == other.port;
+        }
+        friend size_t qHash(const Key &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.low, key.high, key.port);
+        }
+    };
+
+    enum Flag : quint8 {
+        InUse = 0x01,
+        Pending = 0x02,    // in m_pending
+        Reported = 0x04,
+    };
+
+    int acquire(const Key &key);
+    void release(int slot);
+    bool measure(int slot, Finding &finding) const;
+    void forgetIdle(qint64 nowMs);
+
+    int m_capacity;
+    QHash<Key, int> m_index;
+    // Per conversation, indexed by slot.
+    QVector<Key> m_keys;
+    QVector<quint32> m_initiator;
+    QVector<quint32> m_lastMs;        // last packet
+    QVector<quint8> m_count;          // contacts in the ring
+    QVector<quint8> m_head;           // next ring position
+    QVector<quint8> m_sinceReport;    // contacts, saturating
+    QVector<quint8> m_flags;
+    // kRing entries per slot.
+    QVector<quint32> m_contactMs;
+    QVector<qint32> m_contactRow;
+
+    QVector<int> m_free;
+    QVector<int> m_pending;
+    qint64 m_lastSweepMs = 0;
+    quint64 m_untracked = 0;
+};
+
+#endif // BEACONDETECTOR_H
@@ -4,56 +4,38 @@
 BarChart::BarChart(QWidget *parent)
     : QWidget(parent)
 {
-    m_sessionsDir = QCoreApplication::applicationDirPath()
-                   + "/src/statistics/sessions";
+    m_sessionsDir = m_warehouse.sessionsDirectory();
 
     m_watcher.addPath(m_sessionsDir);
     connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, [this](){
-        loadJson(m_sessionsDir);
+        loadSessions();
         rebuildAggregation();
         update();
     });
 
     setMouseTracking(true);
-    loadJson(m_sessionsDir);
+    loadSessions();
     rebuildAggregation();
 }
 
-void BarChart::loadJson(const QString &dir)
+void BarChart::loadSessions()
 {
     m_sessions.clear();
-    QDir d(dir);
-    QStringList files = d.entryList({"*.json"}, QDir::Files, QDir::Name);
+    m_warehouse.sync();
+    const auto totals = m_warehouse.protocolTotals();
 
     QMap<QDateTime, SessionData> temp;
-    for (const QString &fn : files) {
-        QFile f(d.filePath(fn));
-        if (!f.open(QIODevice::ReadOnly)) {
-            qWarning() << "BarChart: cannot open JSON:" << fn;
-            continue;
-        }
-        auto doc = QJsonDocument::fromJson(f.readAll());
-        f.close();
-        if (!doc.isObject())
-            continue;
-        auto obj = doc.object();
-        QDateTime start = QDateTime::fromString(obj["sessionStart"].toString(),
-                                                Qt::ISODate);
-        QDateTime end   = QDateTime::fromString(obj["sessionEnd"].toString(),
-                                                Qt::ISODate);
-        auto &sd = temp[start];
+    for (const SessionWarehouse::Session &session : m_warehouse.sessions()) {
+        auto &sd = temp[session.start];
         if (sd.protocolCounts.isEmpty()) {
-            sd.sessionStart = start;
-            sd.sessionEnd   = end;
+            sd.sessionStart = session.start;
+            sd.sessionEnd   = session.end;
         } else {
-            sd.sessionEnd = qMax(sd.sessionEnd, end);
-        }
-        auto perSec = obj["perSecond"].toArray();
-        for (auto pv : perSec) {
-            auto counts = pv.toObject()["protocolCounts"].toObject();
-            for (auto key : counts.keys())
-                sd.protocolCounts[key] += counts[key].toInt();
+            sd.sessionEnd = qMax(sd.sessionEnd, session.end);
         }
+        const auto counts = totals.value(session.id);
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it)
+            sd.protocolCounts[it.key()] += it.value();
     }
 
     for (auto sd : temp.values())
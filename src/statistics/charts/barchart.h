@@ -2,6 +2,7 @@
 #define BARCHART_H
 
 #include "ChartConfig.h"
+#include "../sessionwarehouse.h"
 using Mode = chart::Mode;
 
 class BarChart : public QWidget {
@@ -48,10 +49,11 @@ private:
     QVector<QRectF>        m_barRects;
     int                    m_hoverIndex       = -1;
 
+    SessionWarehouse       m_warehouse;
     QFileSystemWatcher     m_watcher;
     QString                m_sessionsDir;
 
-    void loadJson(const QString &dir);
+    void loadSessions();
     void rebuildAggregation();
     void rebuildKeysAndRects(const QRectF &area);
 };
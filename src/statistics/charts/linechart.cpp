@@ -1,59 +1,53 @@
 #include "linechart.h"
 #include "../../theme/theme.h"
+
+#include <QFileInfo>
+
 LineChart::LineChart(QWidget *parent)
     : QWidget(parent)
 {
-    m_sessionsDir = QCoreApplication::applicationDirPath()
-                   + "/src/statistics/sessions";
+    m_sessionsDir = m_warehouse.sessionsDirectory();
 
     m_watcher.addPath(m_sessionsDir);
     connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, [this](){
-        loadJson(m_sessionsDir);
+        loadSessions();
         rebuildData();
         update();
     });
 
-    loadJson(m_sessionsDir);
+    loadSessions();
     rebuildData();
 }
 
-void LineChart::loadJson(const QString &dir)
+void LineChart::loadSessions()
 {
     m_sessions.clear();
-    QDir d(dir);
-    QStringList files = d.entryList({"*.json"}, QDir::Files, QDir::Name);
+    m_warehouse.sync();
 
+    QHash<QString, FileData> previous;
+    previous.swap(m_files);
     QMap<QDateTime, SessionData> temp;
-    for (const QString &fn : files) {
-        QFile f(d.filePath(fn));
-        if (!f.open(QIODevice::ReadOnly)) {
-            qWarning() << "LineChart: cannot open JSON:" << fn;
-            continue;
-        }
-        auto doc = QJsonDocument::fromJson(f.readAll());
-        f.close();
-        if (!doc.isObject())
-            continue;
-        auto obj = doc.object();
-        QDateTime start = QDateTime::fromString(obj["sessionStart"].toString(), Qt::ISODate);
-        QDateTime end   = QDateTime::fromString(obj["sessionEnd"].toString(),   Qt::ISODate);
-        auto &sd = temp[start];
-        if (sd.packetsPerSecond.isEmpty()) {
-            sd.start = start;
-            sd.end   = end;
-        } else {
-            sd.end = qMax(sd.end, end);
+    for (const SessionWarehouse::Session &session : m_warehouse.sessions()) {
+        const QDateTime modified = QFileInfo(session.path).lastModified();
+        FileData data = previous.take(session.path);
+        if (data.modified != modified || data.warehouseId != session.id) {
+            data = FileData();
+            data.warehouseId = session.id;
+            data.modified = modified;
+            // Older sessions have no sidecar; their minute and hour buckets
+            // are summed by the warehouse instead.
+            StatisticsRollup::loadFor(session.path, &data.rollup);
         }
 
-        auto perSec = obj["perSecond"].toArray();
-        for (auto pv : perSec) {
-            auto o   = pv.toObject();
-            int sec  = o["second"].toInt();
-            qint64 p = qRound(o["pps"].toDouble());
-            qint64 b = qRound(o["bps"].toDouble());
-            sd.packetsPerSecond[sec] += p;
-            sd.bytesPerSecond[sec]   += b;
+        auto &sd = temp[session.start];
+        if (sd.files.isEmpty()) {
+            sd.start = session.start;
+            sd.end   = session.end;
+        } else {
+            sd.end = qMax(sd.end, session.end);
         }
+        sd.files.append(session.path);
+        m_files.insert(session.path, data);
     }
 
     for (auto sd : temp.values())
@@ -62,6 +56,56 @@ void LineChart::loadJson(const QString &dir)
               [](auto &a, auto &b){ return a.start < b.start; });
 }
 
+LineChart::FileData &LineChart::loadDetail(const QString &path)
+{
+    FileData &data = m_files[path];
+    if (data.detailLoaded)
+        return data;
+
+    data.detailLoaded = true;
+    const auto seconds = m_warehouse.seconds(data.warehouseId);
+    for (const SessionWarehouse::Second &second : seconds) {
+        data.perSecond.insert(second.second, { qint64(second.bytes), qint64(second.packets) });
+        const bool sampled = std::any_of(second.quantiles.cbegin(), second.quantiles.cend(),
+                                         [](double value) { return value >= 0; });
+        if (sampled)
+            data.quantiles.insert(second.second, second.quantiles);
+    }
+    return data;
+}
+
+LineChart::FileData &LineChart::loadBursts(const QString &path)
+{
+    // Sub-second buckets are not warehoused; they only cover the tail of
+    // the newest save.
+    FileData &data = m_files[path];
+    if (data.burstsLoaded)
+        return data;
+
+    data.burstsLoaded = true;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning() << "LineChart: cannot open JSON:" << path;
+        return data;
+    }
+    auto doc = QJsonDocument::fromJson(f.readAll());
+    f.close();
+
+    auto bursts = doc.object()["bursts"].toObject();
+    auto starts = bursts["startMs"].toArray();
+    if (!starts.isEmpty()) {
+        auto packets = bursts["packets"].toArray();
+        auto bytes   = bursts["bytes"].toArray();
+        data.burstBucketMs = bursts["bucketMs"].toInt();
+        for (int i = 0; i < starts.size(); ++i) {
+            data.bursts.insert(qint64(starts[i].toDouble()),
+                               { qint64(bytes[i].toDouble()),
+                                 qint64(packets[i].toDouble()) });
+        }
+    }
+    return data;
+}
+
 void LineChart::setMode(Mode mode)
 {
     m_mode = mode;
@@ -110,19 +154,46 @@ void LineChart::rebuildData()
             chosen = { m_sessions[m_selectedSession] };
     }
 
+    if (m_resolution == SubSecond) {
+        // Bucket offsets are only meaningful within one session, and the
+        // buckets hold no distributions.
+        if (!chosen.isEmpty() && m_metric < PacketSizeP50)
+            rebuildBurstData(chosen.last());
+        return;
+    }
+
+    const int width = m_resolution == Hours   ? int(StatisticsRollup::Hours)
+                    : m_resolution == Minutes ? int(StatisticsRollup::Minutes)
+                                              : 1;
+    if (m_metric >= PacketSizeP50) {
+        rebuildQuantileData(chosen, width, m_metric - PacketSizeP50);
+        return;
+    }
+
     for (auto &s : chosen) {
-        for (auto it = s.packetsPerSecond.constBegin();
-             it != s.packetsPerSecond.constEnd(); ++it)
-        {
-            int sec = it.key();
-            int bucket;
-            switch (m_resolution) {
-              case Seconds: bucket = sec;        break;
-              case Minutes: bucket = sec/60;     break;
-              case Hours:   bucket = sec/3600;   break;
+        for (const QString &path : s.files) {
+            if (StatisticsRollup::tierFor(width) != StatisticsRollup::Seconds) {
+                const FileData &data = m_files[path];
+                if (data.rollup.isEmpty()) {
+                    const auto totals = m_warehouse.bucketTotals(data.warehouseId, width);
+                    for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+                        agg[it.key()].first  += it.value().first;
+                        agg[it.key()].second += it.value().second;
+                    }
+                    continue;
+                }
+                const auto buckets = data.rollup.query(width);
+                for (const auto &bucket : buckets) {
+                    agg[bucket.start / width].first  += qint64(bucket.bytes);
+                    agg[bucket.start / width].second += qint64(bucket.packets);
+                }
+                continue;
+            }
+            const FileData &data = loadDetail(path);
+            for (auto it = data.perSecond.constBegin(); it != data.perSecond.constEnd(); ++it) {
+                agg[it.key()].first  += it.value().first;
+                agg[it.key()].second += it.value().second;
             }
-            agg[bucket].first  += s.bytesPerSecond.value(sec,0);
-            agg[bucket].second += it.value();
         }
     }
 
@@ -130,21 +201,83 @@ void LineChart::rebuildData()
         int bucket = it.key();
         qint64 bytes   = it.value().first;
         qint64 packets = it.value().second;
-        double val = 0;
-        switch (m_metric) {
-          case PacketsPerSecond: val = packets;                 break;
-          case BytesPerSecond:   val = bytes;                   break;
-          case BitsPerSecond:    val = double(bytes)*8.0;       break;
-          case AvgPacketSize:    val = packets>0
-                                       ? double(bytes)/packets
-                                       : 0.0;                   break;
-        }
+        double val = metricValue(bytes, packets, 1.0);
         m_points.append({ double(bucket), val });
         m_maxX = qMax(m_maxX, double(bucket));
         m_maxY = qMax(m_maxY, val);
     }
 }
 
+void LineChart::rebuildQuantileData(const QVector<SessionData> &sessions, int width, int index)
+{
+    // Rollups carry no distributions, so minute and hour views plot the
+    // worst second in each bucket.
+    QMap<int, double> worst;
+    for (auto &s : sessions) {
+        for (const QString &path : s.files) {
+            const FileData &data = loadDetail(path);
+            for (auto it = data.quantiles.constBegin(); it != data.quantiles.constEnd(); ++it) {
+                const double val = it.value().value(index, -1.0);
+                if (val < 0)
+                    continue;
+                double &w = worst[it.key() / width];
+                w = qMax(w, val);
+            }
+        }
+    }
+
+    for (auto it = worst.constBegin(); it != worst.constEnd(); ++it) {
+        m_points.append({ double(it.key()), it.value() });
+        m_maxX = qMax(m_maxX, double(it.key()));
+        m_maxY = qMax(m_maxY, it.value());
+    }
+}
+
+void LineChart::rebuildBurstData(const SessionData &session)
+{
+    // Sub-second buckets only cover the tail of the session; the newest
+    // file for a session carries the latest window.
+    if (session.files.isEmpty())
+        return;
+    const FileData &data = loadBursts(session.files.last());
+    if (data.bursts.isEmpty() || data.burstBucketMs <= 0)
+        return;
+
+    // Rates are scaled to per-second so a 10 ms spike reads against the
+    // same axis as the 1 s average it was hiding in.
+    const double scale  = 1000.0 / data.burstBucketMs;
+    const qint64 origin = data.bursts.firstKey();
+    qint64 previous = -1;
+    auto addPoint = [&](qint64 startMs, double val) {
+        const double x = double(startMs - origin) / 1000.0;
+        m_points.append({ x, val });
+        m_maxX = qMax(m_maxX, x);
+        m_maxY = qMax(m_maxY, val);
+    };
+
+    for (auto it = data.bursts.constBegin(); it != data.bursts.constEnd(); ++it) {
+        // Empty buckets are not stored; drop to zero across the gap.
+        if (previous >= 0 && it.key() - previous > data.burstBucketMs) {
+            addPoint(previous + data.burstBucketMs, 0.0);
+            addPoint(it.key() - data.burstBucketMs, 0.0);
+        }
+        addPoint(it.key(), metricValue(it.value().first, it.value().second, scale));
+        previous = it.key();
+    }
+}
+
+double LineChart::metricValue(qint64 bytes, qint64 packets, double scale) const
+{
+    switch (m_metric) {
+      case PacketsPerSecond: return packets * scale;
+      case BytesPerSecond:   return bytes * scale;
+      case BitsPerSecond:    return double(bytes) * 8.0 * scale;
+      case AvgPacketSize:    return packets > 0 ? double(bytes) / packets : 0.0;
+      default:               break;
+    }
+    return 0.0;
+}
+
 void LineChart::paintEvent(QPaintEvent *)
 {
     QPainter p(this);
@@ -194,6 +327,7 @@ void LineChart::paintEvent(QPaintEvent *)
               case Seconds: label = QString::number(b);      break;
               case Minutes: label = QString("%1m").arg(b);   break;
               case Hours:   label = QString("%1h").arg(b);   break;
+              case SubSecond: label = QString("+%1s").arg(b); break;
             }
             p.drawText(x-15, area.bottom()+5, 30, bottomM-5,
                        Qt::AlignHCenter|Qt::AlignTop, label);
@@ -255,7 +389,16 @@ QStringList LineChart::availableMetrics() const
         "Packets-per-Second",
         "Bytes-per-Second",
         "Bits-per-Second",
-        "Avg Packet Size"
+        "Avg Packet Size",
+        "Packet Size p50",
+        "Packet Size p90",
+        "Packet Size p99",
+        "Inter-arrival p50 (µs)",
+        "Inter-arrival p90 (µs)",
+        "Inter-arrival p99 (µs)",
+        "Handshake RTT p50 (µs)",
+        "Handshake RTT p90 (µs)",
+        "Handshake RTT p99 (µs)"
     };
 }
 
@@ -2,6 +2,8 @@
 #define LINECHART_H
 
 #include "ChartConfig.h"
+#include "../sessionwarehouse.h"
+#include "../statisticsrollup.h"
 using Mode = chart::Mode;
 
 class LineChart : public QWidget {
@@ -9,8 +11,11 @@ class LineChart : public QWidget {
 
 public:
     // enum Mode { AllTime, CurrentSession, BySession };
-    enum Metric { PacketsPerSecond, BytesPerSecond, BitsPerSecond, AvgPacketSize };
-    enum Resolution { Seconds = 0, Minutes = 1, Hours = 2 };
+    enum Metric { PacketsPerSecond, BytesPerSecond, BitsPerSecond, AvgPacketSize,
+                  PacketSizeP50, PacketSizeP90, PacketSizeP99,
+                  InterArrivalP50, InterArrivalP90, InterArrivalP99,
+                  HandshakeRttP50, HandshakeRttP90, HandshakeRttP99 };
+    enum Resolution { Seconds = 0, Minutes = 1, Hours = 2, SubSecond = 3 };
 
     explicit LineChart(QWidget *parent = nullptr);
 
@@ -31,18 +36,35 @@ protected:
     void leaveEvent(QEvent *event) override;
 
 private:
+    // One statistics file. Minute/hour views use the rollup sidecar when
+    // there is one; per-second detail is queried from the warehouse the
+    // first time a finer view asks for it.
+    struct FileData {
+        qint64 warehouseId = -1;
+        QDateTime modified;
+        StatisticsRollup rollup;
+        bool detailLoaded = false;
+        QMap<int, QPair<qint64,qint64>> perSecond;   // second -> bytes, packets
+        // second -> size, inter-arrival, RTT p50/p90/p99; -1 where unsampled
+        QMap<int, QVector<double>> quantiles;
+        bool burstsLoaded = false;
+        int burstBucketMs = 0;
+        QMap<qint64, QPair<qint64,qint64>> bursts;   // start ms -> bytes, packets
+    };
+
     struct SessionData {
         QDateTime start;
         QDateTime end;
-        QMap<int, qint64> bytesPerSecond;
-        QMap<int, qint64> packetsPerSecond;
+        QStringList files;
     };
 
     QVector<SessionData>   m_sessions;
+    QHash<QString, FileData> m_files;   // survives reloads while unmodified
     Mode                   m_mode             = Mode::AllTime;
     int                    m_selectedSession = -1;
     Metric                 m_metric          = PacketsPerSecond;
     Resolution             m_resolution      = Seconds;     
+    SessionWarehouse       m_warehouse;
     QFileSystemWatcher     m_watcher;
     QString                m_sessionsDir;
     double                 m_zoom            = 1.0;
@@ -51,8 +73,13 @@ private:
     double                 m_maxX            = 0;
     double                 m_maxY            = 0;
 
-    void loadJson(const QString &dir);
+    void loadSessions();
+    FileData &loadDetail(const QString &path);
+    FileData &loadBursts(const QString &path);
     void rebuildData();
+    void rebuildBurstData(const SessionData &session);
+    void rebuildQuantileData(const QVector<SessionData> &sessions, int width, int index);
+    double metricValue(qint64 bytes, qint64 packets, double scale) const;
 };
 
 #endif // LINECHART_H
@@ -0,0 +1,302 @@
+#include "dnsanalytics.h"
+
+#include "packets/sniffing.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+constexpr quint8 kNxDomain = 3;
+constexpr int kMaxRows = 256;
+constexpr int kMaxFindings = 5;
+// Tunnels: distinct subdomains of one domain in a window, and how random
+// and long they are on average. Names answered mostly with TXT records may
+// be less random since the payload travels back in the answers.
+constexpr int kMinTunnelNames = 30;
+constexpr double kMinTunnelEntropy = 3.5;
+constexpr double kMinTunnelLabelLength = 24.0;
+constexpr double kMinTxtTunnelEntropy = 3.0;
+// DGAs: failed lookups of one client in a window.
+constexpr quint32 kMinNxDomains = 10;
+constexpr int kMinDgaDomains = 8;
+constexpr double kMinNxDomainRatio = 0.5;
+constexpr double kMinDgaEntropy = 2.7;
+// Second-level labels under which country codes register domains.
+const char *const kSecondLevels[] = {"ac", "co", "com", "edu", "gov", "ne", "net", "or", "org"};
+
+void appendRow(RowRangeSet &rows, int row)
+{
+    if (row >= 0 && rows.count() < kMaxRows) {
+        rows.append(row);
+    }
+}
+
+QStringView firstLabel(QStringView name)
+{
+    const qsizetype dot = name.indexOf(QLatin1Char('.'));
+    return dot < 0 ? name : name.left(dot);
+}
+}
+
+DnsAnalytics::Message DnsAnalytics::message(const ParsedDns &dns)
+{
+    Message message;
+    if (!dns.valid || dns.questions.isEmpty()) {
+        return message;
+    }
+    message.valid = true;
+    message.response = dns.isResponse;
+    message.rcode = dns.rcode;
+    message.txt = dns.questions.first().type == QLatin1String("TXT");
+    for (const DnsRecord &answer : dns.answers) {
+        if (answer.type == QLatin1String("TXT")) {
+            message.txtBytes += quint32(answer.data.size());
+        }
+    }
+    message.name = dns.questions.first().name.toLower();
+    if (message.name.endsWith(QLatin1Char('.'))) {
+        message.name.chop(1);
+    }
+    return message;
+}
+
+QStringView DnsAnalytics::registeredDomain(QStringView name)
+{
+    const qsizetype last = name.lastIndexOf(QLatin1Char('.'));
+    if (last <= 0) {
+        return name;
+    }
+    qsizetype start = name.lastIndexOf(QLatin1Char('.'), last - 1);
+    if (start < 0) {
+        return name;
+    }
+    const QStringView secondLevel = name.mid(start + 1, last - start - 1);
+    const bool countryCode = name.size() - last - 1 == 2;
+    if (countryCode
+        && std::any_of(std::begin(kSecondLevels), std::end(kSecondLevels), [secondLevel](const char *label) {
+               return secondLevel == QLatin1String(label);
+           })) {
+        start = start > 0 ? name.lastIndexOf(QLatin1Char('.'), start - 1) : -1;
+    }
+    return name.mid(start + 1);
+}
+
+double DnsAnalytics::labelEntropy(QStringView text)
+{
+    std::array<int, 128> counts{};
+    int total = 0;
+    for (const QChar c : text) {
+        if (c == QLatin1Char('.')) {
+            continue;
+        }
+        counts[std::min<int>(c.unicode(), 127)] += 1;
+        ++total;
+    }
+    double entropy = 0.0;
+    for (const int count : counts) {
+        if (count > 0) {
+            const double p = double(count) / total;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+DnsAnalytics::DnsAnalytics(int capacity)
+    : m_capacity(std::max(1, capacity))
+{
+}
+
+void DnsAnalytics::add(int second, quint32 client, const Message &message, int row)
+{
+    if (!message.valid || message.name.isEmpty()) {
+        return;
+    }
+    if (second >= m_windowStart + kWindowSeconds) {
+        closeWindow();
+        m_windowStart = second - second % kWindowSeconds;
+    }
+
+    const QStringView name = message.name;
+    const QStringView domain = registeredDomain(name);
+    ClientState *state = clientState(client);
+    if (message.response) {
+        // Answers only count towards what their query already opened.
+        const auto entry = m_domains.find(domain.toString());
+        if (entry != m_domains.end()) {
+            entry->txtBytes += message.txtBytes;
+        }
+        if (!state) {
+            return;
+        }
+        state->responses += 1;
+        state->txtBytes += message.txtBytes;
+        if (message.rcode == kNxDomain) {
+            state->nxdomain += 1;
+            state->nxDomains.add(HyperLogLog::hash(domain));
+            state->nxEntropy += labelEntropy(firstLabel(domain));
+            appendRow(state->rows, row);
+        }
+        return;
+    }
+
+    if (state) {
+        state->queries += 1;
+        state->txtQueries += message.txt ? 1 : 0;
+        state->lengths.add(int(name.size()));
+    }
+    DomainState *entry = domainState(domain, client);
+    if (!entry) {
+        return;
+    }
+    entry->queries += 1;
+    entry->txtQueries += message.txt ? 1 : 0;
+    entry->lengths.add(int(name.size()));
+    if (name.size() > domain.size()) {
+        const QStringView subdomain = name.left(name.size() - domain.size() - 1);
+        entry->subdomains.add(HyperLogLog::hash(subdomain));
+        entry->subdomainQueries += 1;
+        entry->subdomainChars += quint32(subdomain.size());
+        entry->entropy += labelEntropy(subdomain);
+    }
+    appendRow(entry->rows, row);
+}
+
+QVector<DnsAnalytics::Finding> DnsAnalytics::score(int second)
+{
+    if (second + 1 >= m_windowStart + kWindowSeconds) {
+        closeWindow();
+        m_windowStart = second + 1 - (second + 1) % kWindowSeconds;
+    }
+    if (m_ready.isEmpty()) {
+        return {};
+    }
+    QVector<Finding> findings;
+    findings.swap(m_ready);
+    std::sort(findings.begin(), findings.end(), [](const Finding &a, const Finding &b) {
+        return a.severity > b.severity;
+    });
+    if (findings.size() > kMaxFindings) {
+        findings.resize(kMaxFindings);
+    }
+    return findings;
+}
+
+void DnsAnalytics::clear()
+{
+    m_clients.clear();
+    m_domains.clear();
+    m_ready.clear();
+    m_windowStart = 0;
+    m_untracked = 0;
+}
+
+void DnsAnalytics::Lengths::add(int length)
+{
+    buckets[std::min(length / kLengthBucketWidth, kLengthBuckets - 1)] += 1;
+}
+
+int DnsAnalytics::Lengths::p90() const
+{
+    quint64 total = 0;
+    for (const quint32 count : buckets) {
+        total += count;
+    }
+    quint64 seen = 0;
+    for (int i = 0; i < kLengthBuckets; ++i) {
+        seen += buckets[i];
+        if (seen * 10 >= total * 9) {
+            return (i + 1) * kLengthBucketWidth;
+        }
+    }
+    return 0;
+}
+
+DnsAnalytics::ClientState *DnsAnalytics::clientState(quint32 client)
+{
+    auto it = m_clients.find(client);
+    if (it == m_clients.end()) {
+        if (m_clients.size() >= m_capacity) {
+            ++m_untracked;
+            return nullptr;
+        }
+        it = m_clients.insert(client, ClientState());
+    }
+    return &it.value();
+}
+
+DnsAnalytics::DomainState *DnsAnalytics::domainState(QStringView domain, quint32 client)
+{
+    const QString key = domain.toString();
+    auto it = m_domains.find(key);
+    if (it == m_domains.end()) {
+        if (m_domains.size() >= m_capacity) {
+            ++m_untracked;
+            return nullptr;
+        }
+        it = m_domains.insert(key, DomainState());
+        it->client = client;
+    }
+    return &it.value();
+}
+
+void DnsAnalytics::closeWindow()
+{
+    for (auto it = m_domains.constBegin(); it != m_domains.constEnd(); ++it) {
+        const DomainState &domain = it.value();
+        const int unique = domain.subdomains.count();
+        if (unique < kMinTunnelNames || domain.subdomainQueries == 0) {
+            continue;
+        }
+        const double entropy = domain.entropy / domain.subdomainQueries;
+        const double length = double(domain.subdomainChars) / domain.subdomainQueries;
+        const bool random = entropy >= kMinTunnelEntropy && length >= kMinTunnelLabelLength;
+        const bool txt = domain.txtQueries * 2 >= domain.queries && entropy >= kMinTxtTunnelEntropy;
+        if (!random && !txt) {
+            continue;
+        }
+        Finding finding;
+        finding.kind = Kind::Tunnel;
+        finding.client = domain.client;
+        finding.domain = it.key();
+        finding.queries = domain.queries;
+        finding.uniqueNames = unique;
+        finding.entropy = entropy;
+        finding.lengthP90 = domain.lengths.p90();
+        finding.txtQueries = domain.txtQueries;
+        finding.txtBytes = domain.txtBytes;
+        finding.severity = std::min(3.0, double(unique) / kMinTunnelNames);
+        finding.rows = domain.rows;
+        m_ready.append(finding);
+    }
+
+    for (auto it = m_clients.constBegin(); it != m_clients.constEnd(); ++it) {
+        const ClientState &client = it.value();
+        if (client.nxdomain < kMinNxDomains
+            || client.nxdomain < kMinNxDomainRatio * client.responses) {
+            continue;
+        }
+        const int failed = client.nxDomains.count();
+        const double entropy = client.nxEntropy / client.nxdomain;
+        if (failed < kMinDgaDomains || entropy < kMinDgaEntropy) {
+            continue;
+        }
+        Finding finding;
+        finding.kind = Kind::Dga;
+        finding.client = it.key();
+        finding.queries = client.queries;
+        finding.uniqueNames = failed;
+        finding.entropy = entropy;
+        finding.lengthP90 = client.lengths.p90();
+        finding.nxdomainRatio = double(client.nxdomain) / client.responses;
+        finding.txtQueries = client.txtQueries;
+        finding.txtBytes = client.txtBytes;
+        finding.severity = std::min(3.0, double(failed) / kMinDgaDomains);
+        finding.rows = client.rows;
+        m_ready.append(finding);
+    }
+
+    m_clients.clear();
+    m_domains.clear();
+}
@@ -0,0 +1,128 @@
+#ifndef DNSANALYTICS_H
+#define DNSANALYTICS_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "rowrangeset.h"
+#include "sketches/hyperloglog.h"
+
+struct ParsedDns;
+
+// Looks for DNS tunnels and domain generation algorithms in the queries
+// and answers the packet decoder already parsed. Per window it keeps one
+// entry per client (who queries) and per registered domain (the last two
+// labels, three under country-code second levels such as co.uk), each
+// with label entropy, a query length histogram and a distinct-name sketch.
+// Both tables are capped and emptied when the window closes, so a resolver
+// serving a whole network costs at most the caps.
+//
+// A tunnel packs data into long, random, never-repeating subdomains of one
+// domain, often answered with TXT records. A DGA bot tries many random
+// domains that mostly do not exist.
+class DnsAnalytics
+{
+public:
+    // One DNS message, reduced to what the analytics need.
+    struct Message {
+        bool valid = false;
+        bool response = false;
+        quint8 rcode = 0;
+        bool txt = false;          // the question asks for TXT
+        quint32 txtBytes = 0;      // TXT answer text
+        QString name;              // first question, lower case, no trailing dot
+    };
+
+    enum class Kind {
+        Tunnel,
+        Dga,
+    };
+
+    struct Finding {
+        Kind kind = Kind::Tunnel;
+        quint32 client = 0;        // interned
+        QString clientName;        // left to the caller
+        QString domain;            // tunnels only
+        quint32 queries = 0;
+        int uniqueNames = 0;       // subdomains of a tunnel, failed domains of a DGA
+        double entropy = 0.0;      // mean bits per character of the random labels
+        int lengthP90 = 0;         // query names, upper bucket bound
+        double nxdomainRatio = 0.0;
+        quint32 txtQueries = 0;
+        quint32 txtBytes = 0;
+        double severity = 1.0;     // how far past the trigger, >= 1
+        RowRangeSet rows;          // capped
+    };
+
+    static constexpr int kWindowSeconds = 60;
+    static constexpr int kDefaultCapacity = 4096;
+
+    static Message message(const ParsedDns &dns);
+    static QStringView registeredDomain(QStringView name);
+    // Shannon entropy in bits per character, dots ignored.
+    static double labelEntropy(QStringView text);
+
+    explicit DnsAnalytics(int capacity = kDefaultCapacity);
+
+    // client is the interned host that asked: the sender of a query, the
+    // receiver of a response.
+    void add(int second, quint32 client, const Message &message, int row);
+    // Findings of the window that ended with second, strongest first.
+    QVector<Finding> score(int second);
+
+    int clients() const { return int(m_clients.size()); }
+    int domains() const { return int(m_domains.size()); }
+    quint64 untracked() const { return m_untracked; }
+    void clear();
+
+private:
+    static constexpr int kLengthBuckets = 16;
+    static constexpr int kLengthBucketWidth = 16;
+    static constexpr int kSketchPrecision = 8;
+
+    struct Lengths {
+        quint32 buckets[kLengthBuckets] = {};
+
+        void add(int length);
+        int p90() const;
+    };
+
+    struct ClientState {
+        quint32 queries = 0;
+        quint32 responses = 0;
+        quint32 nxdomain = 0;
+        quint32 txtQueries = 0;
+        quint32 txtBytes = 0;
+        double nxEntropy = 0.0;         // summed over failed domains
+        HyperLogLog nxDomains{kSketchPrecision};
+        Lengths lengths;
+        RowRangeSet rows;
+    };
+
+    struct DomainState {
+        quint32 queries = 0;
+        quint32 client = 0;             // first to ask
+        quint32 txtQueries = 0;
+        quint32 txtBytes = 0;
+        quint32 subdomainQueries = 0;
+        quint32 subdomainChars = 0;
+        double entropy = 0.0;           // summed over subdomains
+        HyperLogLog subdomains{kSketchPrecision};
+        Lengths lengths;
+        RowRangeSet rows;
+    };
+
+    ClientState *clientState(quint32 client);
+    DomainState *domainState(QStringView domain, quint32 client);
+    void closeWindow();
+
+    int m_capacity;
+    int m_windowStart = 0;
+    QHash<quint32, ClientState> m_clients;
+    QHash<QString, DomainState> m_domains;
+    QVector<Finding> m_ready;
+    quint64 m_untracked = 0;
+};
+
+#endif // DNSANALYTICS_H
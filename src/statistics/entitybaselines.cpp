@@ -0,0 +1,145 @@
+#include "entitybaselines.h"
+
+#include <algorithm>
+#include <cmath>
+
+EntityBaselines::EntityBaselines(int capacity, double alpha)
+    : m_capacity(std::max(1, capacity)),
+      m_alpha(alpha)
+{
+}
+
+void EntityBaselines::update(const QVector<quint64> &keys,
+                             const QVector<double> &values,
+                             int warmup,
+                             QVector<double> &scores,
+                             QVector<double> &expected)
+{
+    const int n = int(std::min(keys.size(), values.size()));
+    const int tracked = std::min(n, m_capacity);
+    scores.fill(0.0, n);
+    expected.fill(0.0, n);
+
+    // Resolve slots first so the arithmetic below touches no hash.
+    m_slots.resize(tracked);
+    m_batchMean.resize(tracked);
+    m_batchVariance.resize(tracked);
+    m_batchCount.resize(tracked);
+    for (int i = 0; i < tracked; ++i) {
+        const int slot = acquire(keys.at(i), values.at(i));
+        m_slots[i] = slot;
+        m_batchMean[i] = m_mean.at(slot);
+        m_batchVariance[i] = m_variance.at(slot);
+        m_batchCount[i] = m_count.at(slot);
+    }
+
+    const double alpha = m_alpha;
+    const double *value = values.constData();
+    double *mean = m_batchMean.data();
+    double *variance = m_batchVariance.data();
+    quint32 *count = m_batchCount.data();
+    double *score = scores.data();
+    double *baseline = expected.data();
+    for (int i = 0; i < tracked; ++i) {
+        // Counts are at least Poisson-noisy, so the variance never drops
+        // below the mean; a steady host does not alarm on one extra packet.
+        const double delta = value[i] - mean[i];
+        const double deviation = std::sqrt(std::max(variance[i], mean[i] + 1.0));
+        ++count[i];
+        score[i] = count[i] > quint32(warmup) ? delta / deviation : 0.0;
+        baseline[i] = mean[i];
+        mean[i] += alpha * delta;
+        variance[i] = (1.0 - alpha) * (variance[i] + alpha * delta * delta);
+    }
+
+    for (int i = 0; i < tracked; ++i) {
+        const int slot = m_slots.at(i);
+        m_mean[slot] = mean[i];
+        m_variance[slot] = variance[i];
+        m_count[slot] = count[i];
+    }
+}
+
+double EntityBaselines::mean(quint64 key) const
+{
+    const auto it = m_index.constFind(key);
+    return it == m_index.constEnd() ? 0.0 : m_mean.at(it.value());
+}
+
+void EntityBaselines::clear()
+{
+    m_index.clear();
+    m_keys.clear();
+    m_mean.clear();
+    m_variance.clear();
+    m_count.clear();
+    m_prev.clear();
+    m_next.clear();
+    m_head = -1;
+    m_tail = -1;
+}
+
+int EntityBaselines::acquire(quint64 key, double value)
+{
+    const auto it = m_index.constFind(key);
+    if (it != m_index.constEnd()) {
+        const int slot = it.value();
+        unlink(slot);
+        pushFront(slot);
+        return slot;
+    }
+
+    int slot;
+    if (m_keys.size() < m_capacity) {
+        slot = int(m_keys.size());
+        m_keys.append(key);
+        m_mean.append(0.0);
+        m_variance.append(0.0);
+        m_count.append(0);
+        m_prev.append(-1);
+        m_next.append(-1);
+    } else {
+        slot = m_tail;
+        unlink(slot);
+        m_index.remove(m_keys.at(slot));
+        m_keys[slot] = key;
+    }
+    // The first sample seeds the mean, as the z-score rules do.
+    m_mean[slot] = value;
+    m_variance[slot] = 0.0;
+    m_count[slot] = 0;
+    m_index.insert(key, slot);
+    pushFront(slot);
+    return slot;
+}
+
+void EntityBaselines::unlink(int slot)
+{
+    const int prev = m_prev.at(slot);
+    const int next = m_next.at(slot);
+    if (prev >= 0) {
+        m_next[prev] = next;
+    } else {
+        m_head = next;
+    }
+    if (next >= 0) {
+        m_prev[next] = prev;
+    } else {
+        m_tail = prev;
+    }
+    m_prev[slot] = -1;
+    m_next[slot] = -1;
+}
+
+void EntityBaselines::pushFront(int slot)
+{
+    m_prev[slot] = -1;
+    m_next[slot] = m_head;
+    if (m_head >= 0) {
+        m_prev[m_head] = slot;
+    }
+    m_head = slot;
+    if (m_tail < 0) {
+        m_tail = slot;
+    }
+}
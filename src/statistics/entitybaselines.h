@@ -0,0 +1,61 @@
+#ifndef ENTITYBASELINES_H
+#define ENTITYBASELINES_H
+
+#include <QHash>
+#include <QVector>
+
+// Exponentially weighted mean and variance of a per-second count for many
+// entities (hosts, service ports). State is kept column-wise and a second's
+// active entities are updated together: keys are resolved first, then the
+// arithmetic runs as one pass over contiguous arrays. At capacity the least
+// recently active entity is evicted.
+class EntityBaselines
+{
+public:
+    static constexpr int kDefaultCapacity = 1 << 15;
+
+    explicit EntityBaselines(int capacity = kDefaultCapacity, double alpha = 0.1);
+
+    // keys and values are parallel and keys unique. Writes the z-score of
+    // each value against its baseline before the update, and that baseline
+    // mean, into scores and expected. Entities seen warmup times or fewer
+    // score 0. Keys past capacity in one call are not tracked and score 0.
+    void update(const QVector<quint64> &keys,
+                const QVector<double> &values,
+                int warmup,
+                QVector<double> &scores,
+                QVector<double> &expected);
+
+    bool contains(quint64 key) const { return m_index.contains(key); }
+    double mean(quint64 key) const;
+    int size() const { return int(m_index.size()); }
+    int capacity() const { return m_capacity; }
+    void clear();
+
+private:
+    int acquire(quint64 key, double value);
+    void unlink(int slot);
+    void pushFront(int slot);
+
+    int m_capacity;
+    double m_alpha;
+    QHash<quint64, int> m_index;
+
+    QVector<quint64> m_keys;
+    QVector<double> m_mean;
+    QVector<double> m_variance;
+    QVector<quint32> m_count;
+    // Recency list over slots, most recent at m_head.
+    QVector<int> m_prev;
+    QVector<int> m_next;
+    int m_head = -1;
+    int m_tail = -1;
+
+    // Per-call scratch, kept to avoid reallocating every second.
+    QVector<int> m_slots;
+    QVector<double> m_batchMean;
+    QVector<double> m_batchVariance;
+    QVector<quint32> m_batchCount;
+};
+
+#endif // ENTITYBASELINES_H
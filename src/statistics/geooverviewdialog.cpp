@@ -1,4 +1,6 @@
 #include "geooverviewdialog.h"
+#include "sessionwarehouse.h"
+#include "statistics.h"
 #include "../theme/theme.h"
 
 #include "../../packets/packet_geolocation/GeoMap.h"
@@ -10,19 +12,13 @@
 #include <QComboBox>
 #include <QCoreApplication>
 #include <QDateTimeEdit>
-#include <QDir>
-#include <QFile>
 #include <QGridLayout>
 #include <QHBoxLayout>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QLabel>
 #include <QLineEdit>
 #include <QListWidget>
 #include <QLocale>
 #include <QPushButton>
-#include <QSet>
 #include <QSignalBlocker>
 #include <QSlider>
 #include <QSplitter>
@@ -50,7 +46,7 @@ GeoOverviewDialog::GeoOverviewDialog(GeoLocation *geo, QWidget *parent)
     setWindowTitle(tr("GeoOverview"));
     resize(1000, 720);
 
-    m_sessionsDir = QCoreApplication::applicationDirPath() + "/src/statistics/sessions";
+    m_sessionsDir = Statistics::defaultSessionsDir();
 
 auto *mainLayout = new QVBoxLayout(this);
 
@@ -286,38 +282,13 @@ void GeoOverviewDialog::populateIpDropdown()
     m_ipDropdown->clear();
     m_ipDropdown->addItem(tr("Select stored IP"), QString());
 
-    QDir dir(m_sessionsDir);
-    const QStringList files = dir.entryList({"*.json"}, QDir::Files, QDir::Name);
-
-    QSet<QString> uniqueIps;
-    for (const QString &fileName : files) {
-        QFile file(dir.filePath(fileName));
-        if (!file.open(QIODevice::ReadOnly))
-            continue;
-
-        const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-        file.close();
-        if (!doc.isObject())
-            continue;
-
-        const QJsonObject obj = doc.object();
-        const QJsonArray perSecond = obj.value("perSecond").toArray();
-        for (const QJsonValue &secondValue : perSecond) {
-            const QJsonObject secondObj = secondValue.toObject();
-            const QJsonArray connections = secondObj.value("connections").toArray();
-            for (const QJsonValue &connValue : connections) {
-                const QJsonObject connObj = connValue.toObject();
-                const QString src = connObj.value("src").toString().trimmed();
-                const QString dst = connObj.value("dst").toString().trimmed();
-                if (!src.isEmpty())
-                    uniqueIps.insert(src);
-                if (!dst.isEmpty())
-                    uniqueIps.insert(dst);
-            }
-        }
+    SessionWarehouse warehouse(m_sessionsDir);
+    warehouse.sync();
+    QStringList ipList;
+    for (const SessionWarehouse::Host &host : warehouse.hosts()) {
+        if (!host.ip.trimmed().isEmpty())
+            ipList.append(host.ip);
     }
-
-    QStringList ipList = uniqueIps.values();
     std::sort(ipList.begin(), ipList.end(), [](const QString &lhs, const QString &rhs) {
         return lhs.localeAwareCompare(rhs) < 0;
     });
@@ -372,90 +343,37 @@ void GeoOverviewDialog::loadEventsForIp(const QString &ip,
         return;
     }
 
-    QDir dir(m_sessionsDir);
-    QStringList files = dir.entryList({"*.json"}, QDir::Files, QDir::Name);
-
-    if (files.isEmpty()) {
+    SessionWarehouse warehouse(m_sessionsDir);
+    warehouse.sync();
+    if (warehouse.sessions().isEmpty()) {
         auto *placeholder = new QListWidgetItem(tr("No statistics files available."));
         placeholder->setFlags(Qt::NoItemFlags);
         m_eventList->addItem(placeholder);
         return;
     }
 
+    const QVector<SessionWarehouse::Contact> contacts =
+        warehouse.contacts(ip, start.value_or(QDateTime()), end.value_or(QDateTime()));
     QVector<FlightEvent> collected;
-    collected.reserve(256);
-
-    for (const QString &fileName : files) {
-        QFile file(dir.filePath(fileName));
-        if (!file.open(QIODevice::ReadOnly))
-            continue;
-
-        const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-        file.close();
-        if (!doc.isObject())
-            continue;
-
-        const QJsonObject obj = doc.object();
-        const QDateTime sessionStart = QDateTime::fromString(obj.value("sessionStart").toString(), Qt::ISODate);
-        const QJsonArray perSecond = obj.value("perSecond").toArray();
-
-        for (const QJsonValue &secondValue : perSecond) {
-            const QJsonObject secondObj = secondValue.toObject();
-            const int sec = secondObj.value("second").toInt();
-            QDateTime timestamp = sessionStart.isValid()
-                                ? sessionStart.addSecs(sec)
-                                : QDateTime();
-
-            if (timestamp.isValid()) {
-                if (start && timestamp < *start)
-                    continue;
-                if (end && timestamp > *end)
-                    continue;
-            } else {
-                if (start || end)
-                    continue;
-            }
-
-            const QJsonArray connections = secondObj.value("connections").toArray();
-            QVector<QJsonObject> matches;
-            matches.reserve(connections.size());
-            for (const QJsonValue &connValue : connections) {
-                const QJsonObject connObj = connValue.toObject();
-                const QString src = connObj.value("src").toString();
-                const QString dst = connObj.value("dst").toString();
-                if (src == ip || dst == ip)
-                    matches.append(connObj);
-            }
-
-            if (matches.isEmpty())
-                continue;
-
-            const double pps = secondObj.value("pps").toDouble();
-            const double bps = secondObj.value("bps").toDouble();
-            const double avgPacketSize = secondObj.value("avgPacketSize").toDouble();
-            const QJsonObject protocols = secondObj.value("protocolCounts").toObject();
-
-            for (const QJsonObject &connObj : matches) {
-                FlightEvent event;
-                event.timestamp = timestamp;
-                event.srcIp = connObj.value("src").toString();
-                event.dstIp = connObj.value("dst").toString();
-                event.selectedIp = ip;
-                event.counterpartIp = (event.srcIp == ip) ? event.dstIp : event.srcIp;
-                event.direction = (event.srcIp == ip)
-                    ? tr("Outgoing to %1").arg(event.counterpartIp)
-                    : tr("Incoming from %1").arg(event.counterpartIp);
-                event.packetsPerSecond = pps;
-                event.bytesPerSecond = bps;
-                event.avgPacketSize = avgPacketSize;
-                for (auto it = protocols.constBegin(); it != protocols.constEnd(); ++it)
-                    event.protocolCounts.insert(it.key(), it.value().toDouble());
-                event.connectionsThisSecond = matches.size();
-
-                enrichWithGeo(event);
-                collected.push_back(event);
-            }
-        }
+    collected.reserve(contacts.size());
+    for (const SessionWarehouse::Contact &contact : contacts) {
+        FlightEvent event;
+        event.timestamp = contact.timestamp;
+        event.srcIp = contact.src;
+        event.dstIp = contact.dst;
+        event.selectedIp = ip;
+        event.counterpartIp = (event.srcIp == ip) ? event.dstIp : event.srcIp;
+        event.direction = (event.srcIp == ip)
+            ? tr("Outgoing to %1").arg(event.counterpartIp)
+            : tr("Incoming from %1").arg(event.counterpartIp);
+        event.packetsPerSecond = double(contact.packets);
+        event.bytesPerSecond = double(contact.bytes);
+        event.avgPacketSize = contact.packets > 0 ? double(contact.bytes) / double(contact.packets) : 0.0;
+        event.protocolCounts = contact.protocolCounts;
+        event.connectionsThisSecond = contact.matches;
+
+        enrichWithGeo(event);
+        collected.push_back(event);
     }
 
     if (collected.isEmpty()) {
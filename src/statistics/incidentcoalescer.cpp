@@ -0,0 +1,182 @@
+#include "incidentcoalescer.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+// A growing incident is published again at least this often so its end
+// stays current, without a signal every second.
+constexpr int kRefreshSeconds = 10;
+constexpr int kMaxEntities = 32;
+
+bool intersects(const QStringList &a, const QStringList &b)
+{
+    return std::any_of(a.cbegin(), a.cend(), [&b](const QString &value) { return b.contains(value); });
+}
+
+// Appends what b adds to a, up to limit entries; true if anything was.
+bool unite(QStringList &a, const QStringList &b, int limit)
+{
+    bool grew = false;
+    for (const QString &value : b) {
+        if (a.size() >= limit) {
+            break;
+        }
+        if (!a.contains(value)) {
+            a.append(value);
+            grew = true;
+        }
+    }
+    return grew;
+}
+}
+
+IncidentCoalescer::IncidentCoalescer(int cooldownSeconds, int capacity)
+    : m_cooldown(std::max(0, cooldownSeconds)),
+      m_capacity(std::max(1, capacity))
+{
+}
+
+void IncidentCoalescer::setCooldownSeconds(int seconds)
+{
+    m_cooldown = std::max(0, seconds);
+}
+
+const AnomalyDetector::Event *IncidentCoalescer::add(const AnomalyDetector::Event &event)
+{
+    closeIdle(event.second);
+
+    // Newest first, so a fresh incident wins over an older one it overlaps.
+    for (auto open = m_open.rbegin(); open != m_open.rend(); ++open) {
+        AnomalyDetector::Event *incident = find(open->id);
+        if (!intersects(incident->tags, event.tags)) {
+            continue;
+        }
+        if (!incident->entities.isEmpty() && !event.entities.isEmpty()
+            && !intersects(incident->entities, event.entities)) {
+            continue;
+        }
+        bool changed = unite(incident->tags, event.tags, std::numeric_limits<int>::max());
+        changed = unite(incident->entities, event.entities, kMaxEntities) || changed;
+        if (event.score > incident->score) {
+            incident->score = event.score;
+            incident->summary = event.summary;
+            incident->reasons = event.reasons;
+            incident->details = event.details;
+            changed = true;
+        }
+        incident->endSecond = std::max(incident->endSecond, event.endSecond);
+        incident->seconds += event.seconds;
+        incident->packetRows.unite(event.packetRows);
+        if (!changed && incident->endSecond - open->published < kRefreshSeconds) {
+            open->held = true;
+            return nullptr;
+        }
+        open->published = incident->endSecond;
+        open->held = false;
+        return incident;
+    }
+
+    AnomalyDetector::Event incident = event;
+    incident.id = m_nextId++;
+    m_incidents.append(incident);
+    m_open.append(Open{incident.id, incident.endSecond});
+    evict();
+    return &m_incidents.last();
+}
+
+QVector<AnomalyDetector::Event> IncidentCoalescer::takeFinalUpdates(int second, bool flushOpen)
+{
+    closeIdle(second);
+    QVector<AnomalyDetector::Event> updates;
+    for (quint64 id : std::as_const(m_heldClosed)) {
+        if (const AnomalyDetector::Event *incident = find(id)) {
+            updates.append(*incident);
+        }
+    }
+    m_heldClosed.clear();
+
+    if (flushOpen) {
+        for (Open &open : m_open) {
+            if (open.held) {
+                const AnomalyDetector::Event *incident = find(open.id);
+                updates.append(*incident);
+                open.published = incident->endSecond;
+                open.held = false;
+            }
+        }
+    }
+    return updates;
+}
+
+void IncidentCoalescer::clear()
+{
+    m_incidents.clear();
+    m_open.clear();
+    m_heldClosed.clear();
+}
+
+void IncidentCoalescer::upsert(QVector<AnomalyDetector::Event> &incidents,
+                               const AnomalyDetector::Event &incident,
+                               int capacity)
+{
+    // Updates are for recent incidents, so look from the back.
+    for (qsizetype i = incidents.size() - 1; i >= 0; --i) {
+        if (incidents.at(i).id == incident.id) {
+            incidents[i] = incident;
+            return;
+        }
+    }
+    incidents.append(incident);
+    if (incidents.size() > capacity) {
+        incidents.remove(0, incidents.size() - capacity);
+    }
+}
+
+void IncidentCoalescer::closeIdle(int second)
+{
+    m_open.erase(std::remove_if(m_open.begin(), m_open.end(),
+                                [this, second](const Open &open) {
+                                    const AnomalyDetector::Event *incident = find(open.id);
+                                    if (incident && second - incident->endSecond <= m_cooldown) {
+                                        return false;
+                                    }
+                                    if (incident && open.held) {
+                                        m_heldClosed.append(open.id);
+                                    }
+                                    return true;
+                                }),
+                 m_open.end());
+}
+
+AnomalyDetector::Event *IncidentCoalescer::find(quint64 id)
+{
+    const auto it = std::lower_bound(m_incidents.begin(), m_incidents.end(), id,
+                                     [](const AnomalyDetector::Event &incident, quint64 value) {
+                                         return incident.id < value;
+                                     });
+    return it != m_incidents.end() && it->id == id ? &*it : nullptr;
+}
+
+void IncidentCoalescer::evict()
+{
+    auto isOpen = [this](quint64 id) {
+        return std::any_of(m_open.cbegin(), m_open.cend(), [id](const Open &open) { return open.id == id; });
+    };
+    while (m_incidents.size() > m_capacity) {
+        // The oldest closed incident, else the oldest open one; never the
+        // incident just added.
+        qsizetype victim = 0;
+        while (victim < m_incidents.size() - 1 && isOpen(m_incidents.at(victim).id)) {
+            ++victim;
+        }
+        if (victim == m_incidents.size() - 1) {
+            victim = 0;
+        }
+        const quint64 id = m_incidents.at(victim).id;
+        m_open.erase(std::remove_if(m_open.begin(), m_open.end(),
+                                    [id](const Open &open) { return open.id == id; }),
+                     m_open.end());
+        m_incidents.remove(victim);
+    }
+}
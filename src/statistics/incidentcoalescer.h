@@ -0,0 +1,65 @@
+#ifndef INCIDENTCOALESCER_H
+#define INCIDENTCOALESCER_H
+
+#include <QVector>
+
+#include "anomalydetector.h"
+
+// Folds the detector's per-second events into incidents, so a flood that
+// lasts minutes is one entry rather than one per second. An event joins an
+// open incident when they share a tag and, if both name entities (hosts,
+// ports, domains), an entity; the incident closes once cooldown seconds
+// pass without one. It keeps its first and last second, the peak second's
+// score, summary, reasons and details, and the union of tags, entities and
+// rows. At most capacity incidents are stored, the oldest closed ones
+// making room.
+class IncidentCoalescer
+{
+public:
+    static constexpr int kDefaultCooldownSeconds = 30;
+    static constexpr int kDefaultCapacity = 1000;
+
+    explicit IncidentCoalescer(int cooldownSeconds = kDefaultCooldownSeconds,
+                               int capacity = kDefaultCapacity);
+
+    void setCooldownSeconds(int seconds);
+    int cooldownSeconds() const { return m_cooldown; }
+
+    // Folds event in and returns the incident it opened or grew, or null
+    // when the incident changed too little to publish again yet.
+    const AnomalyDetector::Event *add(const AnomalyDetector::Event &event);
+    // Incidents whose latest state add() held back, once they have closed
+    // by second, so receivers end up with their final end second. With
+    // flushOpen, open ones are included too. Each state is returned once.
+    QVector<AnomalyDetector::Event> takeFinalUpdates(int second, bool flushOpen = false);
+
+    const QVector<AnomalyDetector::Event> &incidents() const { return m_incidents; }
+    void clear();
+
+    // For copies of the published incidents: replaces the one with the same
+    // id or appends, dropping the oldest past capacity.
+    static void upsert(QVector<AnomalyDetector::Event> &incidents,
+                       const AnomalyDetector::Event &incident,
+                       int capacity = kDefaultCapacity);
+
+private:
+    struct Open {
+        quint64 id = 0;
+        int published = 0;   // last second published
+        bool held = false;   // changed since
+    };
+
+    void closeIdle(int second);
+
+    AnomalyDetector::Event *find(quint64 id);
+    void evict();
+
+    int m_cooldown;
+    int m_capacity;
+    QVector<AnomalyDetector::Event> m_incidents;   // by id
+    QVector<Open> m_open;
+    QVector<quint64> m_heldClosed;   // closed before their final update
+    quint64 m_nextId = 1;
+};
+
+#endif // INCIDENTCOALESCER_H
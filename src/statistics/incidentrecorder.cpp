@@ -0,0 +1,243 @@
+#include "incidentrecorder.h"
+
+#include <QDir>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+// A flood can put far more than the window's seconds in memory; past this
+// the oldest packets go first.
+constexpr qint64 kMaxWindowBytes = 256LL * 1024 * 1024;
+// Incidents arrive after their second is finalized and merged; the window
+// reaches this much further back so the seconds before them are whole.
+constexpr qint64 kTriggerDelayMs = 5000;
+constexpr qint64 kFlushBytes = 1024 * 1024;
+constexpr int kCompactPackets = 4096;
+constexpr int kMaxOpenCaptures = 16;
+// A growing incident keeps its capture open at most this long past the
+// end of its first window.
+constexpr qint64 kMaxExtensionMs = 10 * 60 * 1000;
+constexpr int kExpireIntervalMs = 1000;
+
+qint64 packetMs(const CapturedPacket &packet)
+{
+    return packet.timestampSec * 1000 + packet.timestampUsec / 1000;
+}
+}
+
+IncidentRecorder::IncidentRecorder(const QDateTime &sessionStart,
+                                   const QString &dirPath,
+                                   int preSeconds,
+                                   int postSeconds,
+                                   QObject *parent)
+    : QObject(parent),
+      m_sessionStartMs(sessionStart.toMSecsSinceEpoch()),
+      m_sessionTag(sessionStart.toString(Qt::ISODate).replace(QLatin1Char(':'), QLatin1Char('-'))),
+      m_dirPath(dirPath),
+      m_preMs(qint64(std::max(0, preSeconds)) * 1000),
+      m_postMs(qint64(std::max(0, postSeconds)) * 1000)
+{
+    m_thread = new QThread(this);
+    m_thread->setObjectName(QStringLiteral("IncidentRecorder"));
+    m_worker = new QObject;
+    m_worker->moveToThread(m_thread);
+    m_thread->start();
+
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, [this]() {
+        if (m_sinceLastPacket.isValid()) {
+            expire(m_lastPacketMs + m_sinceLastPacket.elapsed());
+        }
+    });
+    m_timer->start(kExpireIntervalMs);
+}
+
+IncidentRecorder::~IncidentRecorder()
+{
+    m_timer->stop();
+    for (Capture &capture : m_captures) {
+        close(capture);
+    }
+    m_captures.clear();
+    // Queued in order, so this returns once every file is closed.
+    QMetaObject::invokeMethod(m_worker, []() {}, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_worker;
+}
+
+void IncidentRecorder::addPacket(const CapturedPacket &packet)
+{
+    const qint64 timeMs = packetMs(packet);
+    m_lastPacketMs = std::max(m_lastPacketMs, timeMs);
+    m_sinceLastPacket.start();
+
+    for (int i = 0; i < m_captures.size();) {
+        Capture &capture = m_captures[i];
+        if (timeMs > capture.endMs) {
+            close(capture);
+            m_captures.remove(i);
+            continue;
+        }
+        if (timeMs >= capture.startMs) {
+            capture.pending.append(packet);
+            capture.pendingBytes += packet.data.size();
+            if (capture.pendingBytes >= kFlushBytes) {
+                flush(capture);
+            }
+        }
+        ++i;
+    }
+
+    m_window.append(packet);
+    m_windowBytes += packet.data.size();
+    const qint64 horizon = timeMs - m_preMs - kTriggerDelayMs;
+    while (m_windowFirst < m_window.size()
+           && (packetMs(m_window.at(m_windowFirst)) < horizon || m_windowBytes > kMaxWindowBytes)) {
+        m_windowBytes -= m_window.at(m_windowFirst).data.size();
+        m_window[m_windowFirst] = CapturedPacket();
+        ++m_windowFirst;
+    }
+    if (m_windowFirst >= kCompactPackets && m_windowFirst * 2 >= m_window.size()) {
+        m_window.remove(0, m_windowFirst);
+        m_windowFirst = 0;
+    }
+}
+
+void IncidentRecorder::trigger(const AnomalyDetector::Event &incident)
+{
+    if (m_closed.contains(incident.id)) {
+        return;
+    }
+    const qint64 endMs = m_sessionStartMs + (qint64(incident.endSecond) + 1) * 1000 + m_postMs;
+    for (Capture &capture : m_captures) {
+        if (capture.id == incident.id) {
+            capture.endMs = std::min(capture.limitMs, std::max(capture.endMs, endMs));
+            return;
+        }
+    }
+    if (m_captures.size() >= kMaxOpenCaptures) {
+        // Not captured later either, rather than from the middle.
+        m_closed.insert(incident.id);
+        ++m_skipped;
+        return;
+    }
+
+    Capture capture;
+    capture.id = incident.id;
+    capture.startMs = m_sessionStartMs + qint64(incident.second) * 1000 - m_preMs;
+    capture.endMs = endMs;
+    capture.limitMs = endMs + kMaxExtensionMs;
+    for (int i = m_windowFirst; i < m_window.size(); ++i) {
+        const CapturedPacket &packet = m_window.at(i);
+        if (packetMs(packet) >= capture.startMs) {
+            capture.pending.append(packet);
+        }
+    }
+    m_captures.append(capture);
+    flush(m_captures.last());
+}
+
+void IncidentRecorder::expire(qint64 nowMs)
+{
+    for (int i = 0; i < m_captures.size();) {
+        Capture &capture = m_captures[i];
+        if (capture.endMs < nowMs) {
+            close(capture);
+            m_captures.remove(i);
+            continue;
+        }
+        flush(capture);
+        ++i;
+    }
+}
+
+QString IncidentRecorder::pathFor(quint64 incidentId) const
+{
+    return QDir(m_dirPath).filePath(QStringLiteral("%1-incident-%2.pcap")
+                                        .arg(m_sessionTag)
+                                        .arg(incidentId));
+}
+
+void IncidentRecorder::flush(Capture &capture)
+{
+    if (capture.pending.isEmpty()) {
+        return;
+    }
+    QVector<CapturedPacket> packets;
+    packets.swap(capture.pending);
+    capture.pendingBytes = 0;
+    const quint64 id = capture.id;
+    QMetaObject::invokeMethod(m_worker, [this, id, packets]() {
+        write(id, packets);
+    }, Qt::QueuedConnection);
+}
+
+void IncidentRecorder::close(Capture &capture)
+{
+    flush(capture);
+    m_closed.insert(capture.id);
+    const quint64 id = capture.id;
+    QMetaObject::invokeMethod(m_worker, [this, id]() {
+        finish(id);
+    }, Qt::QueuedConnection);
+}
+
+void IncidentRecorder::write(quint64 id, const QVector<CapturedPacket> &packets)
+{
+    auto it = m_outputs.find(id);
+    if (it == m_outputs.end()) {
+        // A file that fails to open stays in the table without a dumper, so
+        // later batches of the capture are dropped rather than retried.
+        Output output;
+        output.path = pathFor(id);
+        output.linkType = packets.first().linkType;
+        QDir().mkpath(m_dirPath);
+        output.pcap = pcap_open_dead(output.linkType, 65535);
+        if (!output.pcap) {
+            qWarning("Failed to initialize PCAP writer for incident %llu.", id);
+        } else {
+            output.dumper = pcap_dump_open(output.pcap, output.path.toUtf8().constData());
+            if (!output.dumper) {
+                qWarning("Failed to open incident capture for writing: %s", pcap_geterr(output.pcap));
+            }
+        }
+        it = m_outputs.insert(id, output);
+    }
+
+    Output &output = it.value();
+    if (!output.dumper) {
+        return;
+    }
+    for (const CapturedPacket &packet : packets) {
+        if (packet.linkType != output.linkType) {
+            continue;
+        }
+        pcap_pkthdr hdr{};
+        hdr.ts.tv_sec = packet.timestampSec;
+        hdr.ts.tv_usec = packet.timestampUsec;
+        hdr.caplen = bpf_u_int32(packet.data.size());
+        hdr.len = hdr.caplen;
+        pcap_dump(reinterpret_cast<u_char *>(output.dumper), &hdr,
+                  reinterpret_cast<const u_char *>(packet.data.constData()));
+        ++output.packets;
+    }
+}
+
+void IncidentRecorder::finish(quint64 id)
+{
+    const auto it = m_outputs.find(id);
+    if (it == m_outputs.end()) {
+        return;
+    }
+    const Output output = it.value();
+    m_outputs.erase(it);
+    if (output.dumper) {
+        pcap_dump_close(output.dumper);
+        emit captureWritten(id, output.path, output.packets);
+    }
+    if (output.pcap) {
+        pcap_close(output.pcap);
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef INCIDENTRECORDER_H
+#define INCIDENTRECORDER_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <pcap.h>
+
+#include "anomalydetector.h"
+#include "../../packets/sniffing.h"
+
+class QThread;
+class QTimer;
+
+// Keeps only the packets around incidents. The last preSeconds of traffic
+// stay in memory; when an incident is raised they are written to a pcap
+// named after its id, followed by the packets of the next postSeconds
+// (counted from the incident's last second, so a growing incident keeps
+// its capture open up to a limit). Memory stays at the window and disk use
+// grows with incidents, not traffic. Files are written on a thread of
+// their own.
+class IncidentRecorder : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int kDefaultPreSeconds = 30;
+    static constexpr int kDefaultPostSeconds = 30;
+
+    IncidentRecorder(const QDateTime &sessionStart,
+                     const QString &dirPath,
+                     int preSeconds = kDefaultPreSeconds,
+                     int postSeconds = kDefaultPostSeconds,
+                     QObject *parent = nullptr);
+    // Finishes open captures with what they have and waits for the disk.
+    ~IncidentRecorder();
+
+    // GUI thread only.
+    void addPacket(const CapturedPacket &packet);
+    void trigger(const AnomalyDetector::Event &incident);
+    // Closes captures whose window ended before nowMs (packet clock). Runs
+    // every second by itself so captures finish when traffic stops.
+    void expire(qint64 nowMs);
+
+    QString pathFor(quint64 incidentId) const;
+    int windowPackets() const { return int(m_window.size()) - m_windowFirst; }
+    qint64 windowBytes() const { return m_windowBytes; }
+    int openCaptures() const { return int(m_captures.size()); }
+    // Incidents not captured because too many were open at once.
+    quint64 skipped() const { return m_skipped; }
+
+signals:
+    // From the writer thread once a capture's file is closed.
+    void captureWritten(quint64 incidentId, const QString &path, int packets);
+
+private:
+    struct Capture {
+        quint64 id = 0;
+        qint64 startMs = 0;
+        qint64 endMs = 0;        // last packet time kept
+        qint64 limitMs = 0;      // how far a growing incident may push endMs
+        QVector<CapturedPacket> pending;
+        qint64 pendingBytes = 0;
+    };
+
+    // Writer thread only.
+    struct Output {
+        pcap_t *pcap = nullptr;
+        pcap_dumper_t *dumper = nullptr;
+        int linkType = 0;
+        int packets = 0;
+        QString path;
+    };
+
+    void flush(Capture &capture);
+    void close(Capture &capture);
+    void write(quint64 id, const QVector<CapturedPacket> &packets);
+    void finish(quint64 id);
+
+    qint64 m_sessionStartMs;
+    QString m_sessionTag;
+    QString m_dirPath;
+    qint64 m_preMs;
+    qint64 m_postMs;
+    QVector<CapturedPacket> m_window;   // by time, from m_windowFirst
+    int m_windowFirst = 0;
+    qint64 m_windowBytes = 0;
+    qint64 m_lastPacketMs = 0;
+    QElapsedTimer m_sinceLastPacket;
+    QVector<Capture> m_captures;
+    QSet<quint64> m_closed;
+    quint64 m_skipped = 0;
+    QTimer *m_timer = nullptr;
+    QThread *m_thread = nullptr;
+    QObject *m_worker = nullptr;
+    QHash<quint64, Output> m_outputs;   // writer thread only
+};
+
+#endif // INCIDENTRECORDER_H
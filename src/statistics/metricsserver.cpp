@@ -0,0 +1,235 @@
+#include "metricsserver.h"
+
+#include "statisticsaggregator.h"
+#include "packets/sniffing.h"
+
+#include <QFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr int kMaxRequestBytes = 8192;
+constexpr int kRequestTimeoutMs = 5000;
+const QByteArray kOpenMetricsType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+// Resident set size, or -1 where the platform does not report it cheaply.
+qint64 residentMemoryBytes()
+{
+#if defined(Q_OS_LINUX)
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+
+QByteArray escapeLabel(const QString &value)
+{
+    QByteArray escaped = value.toUtf8();
+    escaped.replace('\\', "\\\\");
+    escaped.replace('"', "\\\"");
+    escaped.replace('\n', "\\n");
+    return escaped;
+}
+
+class Exposition
+{
+public:
+    void family(const char *name, const char *type, const char *help)
+    {
+        m_text += "# TYPE " + QByteArray(name) + ' ' + type + '\n';
+        m_text += "# HELP " + QByteArray(name) + ' ' + help + '\n';
+    }
+
+    void sample(const QByteArray &name, qint64 value, const QByteArray &labels = QByteArray())
+    {
+        m_text += name;
+        if (!labels.isEmpty()) {
+            m_text += '{' + labels + '}';
+        }
+        m_text += ' ' + QByteArray::number(value) + '\n';
+    }
+
+    void counter(const char *name, const char *help, quint64 value)
+    {
+        family(name, "counter", help);
+        sample(QByteArray(name) + "_total", qint64(value));
+    }
+
+    void gauge(const char *name, const char *help, qint64 value)
+    {
+        family(name, "gauge", help);
+        sample(name, value);
+    }
+
+    QByteArray finish()
+    {
+        m_text += "# EOF\n";
+        return m_text;
+    }
+
+private:
+    QByteArray m_text;
+};
+}
+
+MetricsServer::MetricsServer(QObject *parent)
+    : QObject(parent),
+      m_server(new QTcpServer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+MetricsServer::~MetricsServer()
+{
+    close();
+}
+
+bool MetricsServer::listen(const QHostAddress &address, quint16 port)
+{
+    close();
+    return m_server->listen(address, port);
+}
+
+void MetricsServer::close()
+{
+    m_server->close();
+    const auto sockets = m_requests.keys();
+    for (QTcpSocket *socket : sockets) {
+        socket->abort();
+    }
+    m_requests.clear();
+}
+
+bool MetricsServer::isListening() const
+{
+    return m_server->isListening();
+}
+
+QString MetricsServer::errorString() const
+{
+    return m_server->errorString();
+}
+
+void MetricsServer::setAggregator(StatisticsAggregator *aggregator)
+{
+    m_aggregator = aggregator;
+}
+
+QByteArray MetricsServer::render() const
+{
+    Exposition out;
+
+    const Sniffing::CaptureCounters capture = Sniffing::captureCounters();
+    out.counter("foxprobe_capture_packets", "Packets received from libpcap.", capture.packets);
+    out.counter("foxprobe_capture_bytes", "On-wire bytes of the received packets.", capture.bytes);
+    out.family("foxprobe_capture_dropped_packets", "counter",
+               "Packets libpcap reported as dropped.");
+    out.sample("foxprobe_capture_dropped_packets_total", qint64(capture.kernelDrops),
+               "reason=\"kernel\"");
+    out.sample("foxprobe_capture_dropped_packets_total", qint64(capture.interfaceDrops),
+               "reason=\"interface\"");
+    out.gauge("foxprobe_stream_flows", "Flows in the stream table.", capture.activeFlows);
+    out.gauge("foxprobe_stream_reassembly_bytes", "Bytes buffered for TCP reassembly.",
+              capture.reassemblyBytes);
+
+    const StatisticsAggregator *aggregator = m_aggregator.data();
+    out.gauge("foxprobe_session_active", "1 while a capture session is aggregating.",
+              aggregator ? 1 : 0);
+    if (aggregator) {
+        const auto snapshot = aggregator->latestSnapshot();
+        out.counter("foxprobe_packets", "Packets aggregated in the current session.",
+                    snapshot->totalPackets);
+        out.counter("foxprobe_bytes", "Bytes aggregated in the current session.",
+                    snapshot->totalBytes);
+        out.gauge("foxprobe_packets_per_second", "Packets in the last finalized second.",
+                  qint64(snapshot->lastSecond.packets));
+        out.gauge("foxprobe_bytes_per_second", "Bytes in the last finalized second.",
+                  qint64(snapshot->lastSecond.bytes));
+        out.gauge("foxprobe_connections", "Distinct connections in the last finalized second.",
+                  snapshot->lastSecond.connections);
+        out.family("foxprobe_protocol_packets", "counter",
+                   "Packets per protocol in the current session.");
+        for (auto it = snapshot->protocolTotals.constBegin(); it != snapshot->protocolTotals.constEnd(); ++it) {
+            out.sample("foxprobe_protocol_packets_total", qint64(it.value()),
+                       "protocol=\"" + escapeLabel(it.key()) + '"');
+        }
+        out.counter("foxprobe_anomalies", "Anomalies raised in the current session.",
+                    snapshot->anomalyCount);
+    }
+
+    const qint64 resident = residentMemoryBytes();
+    if (resident >= 0) {
+        out.gauge("foxprobe_resident_memory_bytes", "Resident set size of the process.", resident);
+    }
+    return out.finish();
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        m_requests.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_requests.remove(socket);
+            socket->deleteLater();
+        });
+        QTimer::singleShot(kRequestTimeoutMs, socket, [socket]() { socket->abort(); });
+    }
+}
+
+void MetricsServer::onReadyRead(QTcpSocket *socket)
+{
+    auto it = m_requests.find(socket);
+    if (it == m_requests.end()) {
+        return;
+    }
+    QByteArray &request = it.value();
+    request += socket->readAll();
+    const int headerEnd = request.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (request.size() > kMaxRequestBytes) {
+            m_requests.erase(it);
+            respond(socket, "431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+        }
+        return;
+    }
+
+    const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    const QByteArray method = requestLine.value(0);
+    QByteArray target = requestLine.value(1);
+    const int query = target.indexOf('?');
+    if (query >= 0) {
+        target.truncate(query);
+    }
+    m_requests.erase(it);
+
+    if (method != "GET") {
+        respond(socket, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+    } else if (target != "/metrics") {
+        respond(socket, "404 Not Found", "text/plain", "Metrics are served at /metrics\n");
+    } else {
+        respond(socket, "200 OK", kOpenMetricsType, render());
+    }
+}
+
+void MetricsServer::respond(QTcpSocket *socket, const QByteArray &status,
+                            const QByteArray &contentType, const QByteArray &body)
+{
+    QByteArray response = "HTTP/1.1 " + status + "\r\n";
+    response += "Content-Type: " + contentType + "\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
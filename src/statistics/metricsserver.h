@@ -0,0 +1,47 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QPointer>
+
+class QTcpServer;
+class QTcpSocket;
+class StatisticsAggregator;
+
+// Serves live counters as OpenMetrics text on GET /metrics, e.g.
+//   curl http://127.0.0.1:9464/metrics
+// Everything it reports is read from published snapshots and atomics, so a
+// scrape never blocks the capture or aggregation threads.
+class MetricsServer : public QObject {
+    Q_OBJECT
+public:
+    static constexpr quint16 kDefaultPort = 9464;
+
+    explicit MetricsServer(QObject *parent = nullptr);
+    ~MetricsServer();
+
+    bool listen(const QHostAddress &address, quint16 port);
+    void close();
+    bool isListening() const;
+    QString errorString() const;
+
+    // Session whose statistics are exported; null between captures.
+    void setAggregator(StatisticsAggregator *aggregator);
+
+    QByteArray render() const;
+
+private:
+    void onNewConnection();
+    void onReadyRead(QTcpSocket *socket);
+    void respond(QTcpSocket *socket, const QByteArray &status,
+                 const QByteArray &contentType, const QByteArray &body);
+
+    QTcpServer *m_server = nullptr;
+    QPointer<StatisticsAggregator> m_aggregator;
+    QHash<QTcpSocket *, QByteArray> m_requests;
+};
+
+#endif // METRICSSERVER_H
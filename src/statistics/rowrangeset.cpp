@@ -0,0 +1,183 @@
+#include "rowrangeset.h"
+
+#include <algorithm>
+
+namespace {
+void writeVarint(QByteArray &out, quint32 value)
+{
+    while (value >= 0x80) {
+        out.append(char(value | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+quint32 readVarint(const QByteArray &in, int &offset)
+{
+    quint32 value = 0;
+    int shift = 0;
+    while (offset < in.size()) {
+        const quint8 byte = quint8(in.at(offset++));
+        value |= quint32(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
+}
+
+RowRangeSet::const_iterator::const_iterator(const QByteArray *data, int offset)
+    : m_data(data),
+      m_offset(offset),
+      m_next(offset)
+{
+    if (m_offset < m_data->size()) {
+        decode();
+    }
+}
+
+RowRangeSet::const_iterator &RowRangeSet::const_iterator::operator++()
+{
+    m_offset = m_next;
+    if (m_offset < m_data->size()) {
+        decode();
+    }
+    return *this;
+}
+
+void RowRangeSet::const_iterator::decode()
+{
+    // m_range still holds the previous run, if any.
+    const int base = m_offset == 0 ? 0 : m_range.last + 1;
+    m_next = m_offset;
+    m_range.first = base + int(readVarint(*m_data, m_next));
+    m_range.last = m_range.first + int(readVarint(*m_data, m_next));
+}
+
+RowRangeSet::RowRangeSet(int first, int last)
+{
+    appendRange(first, last);
+}
+
+void RowRangeSet::append(int row)
+{
+    appendRange(row, row);
+}
+
+void RowRangeSet::appendRange(int first, int last)
+{
+    first = std::max(first, 0);
+    if (first > last) {
+        return;
+    }
+    if (m_runs > 0 && first < m_lastFirst) {
+        unite(RowRangeSet(first, last));
+        return;
+    }
+    if (m_runs > 0 && first <= m_lastLast + 1) {
+        if (last > m_lastLast) {
+            m_count += last - m_lastLast;
+            m_lastLast = last;
+            writeLastRun();
+        }
+        return;
+    }
+
+    m_lastBase = m_runs > 0 ? m_lastLast + 1 : 0;
+    m_lastOffset = int(m_data.size());
+    m_lastFirst = first;
+    m_lastLast = last;
+    m_count += last - first + 1;
+    ++m_runs;
+    writeLastRun();
+}
+
+void RowRangeSet::unite(const RowRangeSet &other)
+{
+    if (other.isEmpty()) {
+        return;
+    }
+    if (isEmpty()) {
+        *this = other;
+        return;
+    }
+    if (other.first() >= m_lastFirst) {
+        for (const Range &range : other) {
+            appendRange(range.first, range.last);
+        }
+        return;
+    }
+
+    RowRangeSet merged;
+    auto a = begin();
+    auto b = other.begin();
+    while (a != end() || b != other.end()) {
+        if (b == other.end() || (a != end() && a->first <= b->first)) {
+            merged.appendRange(a->first, a->last);
+            ++a;
+        } else {
+            merged.appendRange(b->first, b->last);
+            ++b;
+        }
+    }
+    *this = merged;
+}
+
+RowRangeSet RowRangeSet::intersected(const RowRangeSet &other) const
+{
+    RowRangeSet result;
+    auto a = begin();
+    auto b = other.begin();
+    while (a != end() && b != other.end()) {
+        const int first = std::max(a->first, b->first);
+        const int last = std::min(a->last, b->last);
+        if (first <= last) {
+            result.appendRange(first, last);
+        }
+        if (a->last < b->last) {
+            ++a;
+        } else {
+            ++b;
+        }
+    }
+    return result;
+}
+
+bool RowRangeSet::contains(int row) const
+{
+    for (const Range &range : *this) {
+        if (row < range.first) {
+            return false;
+        }
+        if (row <= range.last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int RowRangeSet::first() const
+{
+    return isEmpty() ? -1 : begin()->first;
+}
+
+QVector<int> RowRangeSet::toVector() const
+{
+    QVector<int> rows;
+    rows.reserve(m_count);
+    for (const Range &range : *this) {
+        for (int row = range.first; row <= range.last; ++row) {
+            rows.append(row);
+        }
+    }
+    return rows;
+}
+
+void RowRangeSet::writeLastRun()
+{
+    m_data.truncate(m_lastOffset);
+    writeVarint(m_data, quint32(m_lastFirst - m_lastBase));
+    writeVarint(m_data, quint32(m_lastLast - m_lastFirst));
+}
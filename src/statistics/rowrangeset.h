@@ -0,0 +1,74 @@
+#ifndef ROWRANGESET_H
+#define ROWRANGESET_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Set of packet-table rows stored as runs of consecutive rows. Each run is
+// two varints: the gap after the previous run and the run length minus
+// one, so a contiguous second costs a few bytes and interleaved rows about
+// two bytes each. Appending ascending rows is O(1); everything else works
+// on whole runs.
+class RowRangeSet
+{
+public:
+    struct Range {
+        int first = 0;
+        int last = 0;   // inclusive
+    };
+
+    class const_iterator
+    {
+    public:
+        const Range &operator*() const { return m_range; }
+        const Range *operator->() const { return &m_range; }
+        const_iterator &operator++();
+        bool operator==(const const_iterator &other) const { return m_offset == other.m_offset; }
+        bool operator!=(const const_iterator &other) const { return m_offset != other.m_offset; }
+
+    private:
+        friend class RowRangeSet;
+        const_iterator(const QByteArray *data, int offset);
+        void decode();
+
+        const QByteArray *m_data = nullptr;
+        int m_offset = 0;
+        int m_next = 0;
+        Range m_range;
+    };
+
+    RowRangeSet() = default;
+    RowRangeSet(int first, int last);
+
+    void append(int row);
+    void appendRange(int first, int last);
+    void unite(const RowRangeSet &other);
+    RowRangeSet intersected(const RowRangeSet &other) const;
+    bool contains(int row) const;
+
+    bool isEmpty() const { return m_count == 0; }
+    int count() const { return m_count; }
+    int rangeCount() const { return m_runs; }
+    int first() const;
+    QVector<int> toVector() const;
+
+    const_iterator begin() const { return const_iterator(&m_data, 0); }
+    const_iterator end() const { return const_iterator(&m_data, int(m_data.size())); }
+
+    bool operator==(const RowRangeSet &other) const { return m_data == other.m_data; }
+    bool operator!=(const RowRangeSet &other) const { return m_data != other.m_data; }
+
+private:
+    void writeLastRun();
+
+    QByteArray m_data;
+    int m_count = 0;
+    int m_runs = 0;
+    // The last run is rewritten in place while it grows.
+    int m_lastOffset = 0;
+    int m_lastBase = 0;   // one past the run before it
+    int m_lastFirst = -1;
+    int m_lastLast = -1;
+};
+
+#endif // ROWRANGESET_H
@@ -0,0 +1,180 @@
+#include "seasonalbaselines.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr int kVersion = 1;
+constexpr int kSecondsPerDay = 24 * 60 * 60;
+constexpr int kSecondsPerWeek = 7 * kSecondsPerDay;
+// A slot is trusted once it has seen five minutes of a metric.
+constexpr double kWarmWeight = 300.0;
+// Seven days of one slot's seconds. A weekday slot sees 4500 of them a
+// week and a weekend slot 1800, so this time constant is about a week and
+// a half of calendar time for weekdays and three and a half for weekends.
+constexpr double kMemory = 7.0 * SeasonalBaselines::kSlotSeconds;
+constexpr double kClipDeviations = 4.0;
+// A flat profile still allows this much relative wobble.
+constexpr double kMinRelativeDeviation = 0.05;
+constexpr double kMinVariance = 1e-4;
+
+double deviation(double mean, double variance)
+{
+    const double relative = kMinRelativeDeviation * mean;
+    return std::sqrt(std::max({variance, kMinVariance, relative * relative}));
+}
+
+QJsonArray toJsonArray(const QVector<double> &values)
+{
+    QJsonArray array;
+    for (double value : values) {
+        array.append(value);
+    }
+    return array;
+}
+
+bool fromJsonArray(const QJsonValue &value, QVector<double> &values)
+{
+    const QJsonArray array = value.toArray();
+    if (array.size() != SeasonalBaselines::kSlots) {
+        return false;
+    }
+    values.resize(array.size());
+    for (int i = 0; i < array.size(); ++i) {
+        values[i] = array.at(i).toDouble();
+    }
+    return true;
+}
+}
+
+int SeasonalBaselines::slotOf(int secondOfWeek)
+{
+    const int second = ((secondOfWeek % kSecondsPerWeek) + kSecondsPerWeek) % kSecondsPerWeek;
+    const int slot = (second % kSecondsPerDay) / kSlotSeconds;
+    return second / kSecondsPerDay >= 5 ? kSlotsPerDay + slot : slot;
+}
+
+double SeasonalBaselines::score(int metric, int slot, double value) const
+{
+    if (!isWarm(metric, slot)) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    const Profile &profile = m_profiles[metric];
+    const double mean = profile.mean.at(slot);
+    return (value - mean) / deviation(mean, profile.variance.at(slot));
+}
+
+void SeasonalBaselines::update(int metric, int slot, double value)
+{
+    if (std::isnan(value) || slot < 0 || slot >= kSlots) {
+        return;
+    }
+    Profile &profile = m_profiles[metric];
+    if (profile.mean.isEmpty()) {
+        profile.mean.fill(0.0, kSlots);
+        profile.variance.fill(0.0, kSlots);
+        profile.weight.fill(0.0, kSlots);
+    }
+    double &mean = profile.mean[slot];
+    double &variance = profile.variance[slot];
+    double &weight = profile.weight[slot];
+    if (weight >= kWarmWeight) {
+        const double limit = kClipDeviations * deviation(mean, variance);
+        value = std::clamp(value, mean - limit, mean + limit);
+    }
+    // 1/n until the memory is full: a plain average of the first seven days
+    // that fall in this slot.
+    weight = std::min(weight + 1.0, kMemory);
+    const double alpha = 1.0 / weight;
+    const double delta = value - mean;
+    mean += alpha * delta;
+    variance = (1.0 - alpha) * (variance + alpha * delta * delta);
+}
+
+bool SeasonalBaselines::isWarm(int metric, int slot) const
+{
+    const Profile &profile = m_profiles[metric];
+    return slot >= 0 && slot < profile.weight.size() && profile.weight.at(slot) >= kWarmWeight;
+}
+
+bool SeasonalBaselines::isEmpty() const
+{
+    return std::all_of(std::begin(m_profiles), std::end(m_profiles),
+                       [](const Profile &profile) { return profile.mean.isEmpty(); });
+}
+
+void SeasonalBaselines::clear()
+{
+    for (Profile &profile : m_profiles) {
+        profile = Profile();
+    }
+}
+
+bool SeasonalBaselines::load(const QString &path)
+{
+    clear();
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    const QJsonObject root = doc.object();
+    if (root.value(QStringLiteral("version")).toInt() != kVersion
+        || root.value(QStringLiteral("slotSeconds")).toInt() != kSlotSeconds) {
+        return false;
+    }
+    const QJsonObject metrics = root.value(QStringLiteral("metrics")).toObject();
+    for (auto it = metrics.constBegin(); it != metrics.constEnd(); ++it) {
+        const int metric = AnomalyRules::secondMetricIndex(it.key());
+        if (metric < 0) {
+            continue;
+        }
+        const QJsonObject object = it.value().toObject();
+        Profile profile;
+        if (fromJsonArray(object.value(QStringLiteral("mean")), profile.mean)
+            && fromJsonArray(object.value(QStringLiteral("variance")), profile.variance)
+            && fromJsonArray(object.value(QStringLiteral("weight")), profile.weight)) {
+            m_profiles[metric] = profile;
+        }
+    }
+    return true;
+}
+
+bool SeasonalBaselines::save(const QString &path) const
+{
+    QJsonObject metrics;
+    for (int metric = 0; metric < AnomalyRules::SecondMetricCount; ++metric) {
+        const Profile &profile = m_profiles[metric];
+        if (profile.mean.isEmpty()) {
+            continue;
+        }
+        QJsonObject object;
+        object.insert(QStringLiteral("mean"), toJsonArray(profile.mean));
+        object.insert(QStringLiteral("variance"), toJsonArray(profile.variance));
+        object.insert(QStringLiteral("weight"), toJsonArray(profile.weight));
+        metrics.insert(AnomalyRules::secondMetricName(metric), object);
+    }
+    QJsonObject root;
+    root.insert(QStringLiteral("version"), kVersion);
+    root.insert(QStringLiteral("slotSeconds"), kSlotSeconds);
+    root.insert(QStringLiteral("metrics"), metrics);
+
+    // The profile outlives every session, so a failed write keeps the old one.
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    const QByteArray payload = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    if (file.write(payload) != payload.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
@@ -0,0 +1,52 @@
+#ifndef SEASONALBASELINES_H
+#define SEASONALBASELINES_H
+
+#include <QString>
+#include <QVector>
+
+#include "anomalyrules.h"
+
+// What each per-second metric usually does at this time of the week: an
+// exponentially weighted mean and variance per quarter hour of local time,
+// weekdays kept apart from weekends. A slot averages everything it sees
+// until it holds seven days' worth of its seconds and then forgets at that
+// rate: over about a week and a half for weekday slots and three and a half
+// weeks for weekend ones. The profile follows slow drift without revisiting
+// old captures. The state is three arrays per metric and is saved with the
+// sessions, so a new capture starts with the profile earlier ones built.
+class SeasonalBaselines
+{
+public:
+    static constexpr int kSlotSeconds = 15 * 60;
+    static constexpr int kSlotsPerDay = 24 * 60 * 60 / kSlotSeconds;
+    static constexpr int kSlots = 2 * kSlotsPerDay;   // weekdays, then weekends
+
+    // secondOfWeek counts from Monday 00:00 local time.
+    static int slotOf(int secondOfWeek);
+
+    // Deviations between value and what metric usually does in slot; NaN
+    // until the slot has seen enough of the metric.
+    double score(int metric, int slot, double value) const;
+    // Folds value into slot. Once the slot is warm, outliers are clipped
+    // first so one incident does not teach the profile to expect the next.
+    void update(int metric, int slot, double value);
+
+    bool isWarm(int metric, int slot) const;
+    bool isEmpty() const;
+    void clear();
+
+    // Leaves the profile empty when path is missing or unreadable.
+    bool load(const QString &path);
+    bool save(const QString &path) const;
+
+private:
+    struct Profile {
+        QVector<double> mean;
+        QVector<double> variance;
+        QVector<double> weight;   // samples, capped at the memory length
+    };
+
+    Profile m_profiles[AnomalyRules::SecondMetricCount];
+};
+
+#endif // SEASONALBASELINES_H
@@ -0,0 +1,686 @@
+#include "sessionwarehouse.h"
+
+#include "statistics.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+namespace {
+// Bump when the schema changes; older stores are dropped and re-synced.
+constexpr int kSchemaVersion = 2;
+
+const char *const kQuantileKeys[] = { "size", "interArrivalUs", "handshakeRttUs" };
+
+bool run(QSqlQuery &query)
+{
+    if (!query.exec()) {
+        qWarning() << "SessionWarehouse:" << query.lastError().text()
+                   << "in" << query.lastQuery();
+        return false;
+    }
+    return true;
+}
+
+bool run(const QSqlDatabase &db, const QString &statement)
+{
+    QSqlQuery query(db);
+    query.prepare(statement);
+    return run(query);
+}
+
+qint64 lowerTs(const QDateTime &from)
+{
+    return from.isValid() ? from.toSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+}
+
+qint64 upperTs(const QDateTime &to)
+{
+    return to.isValid() ? to.toSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+}
+
+qint64 modifiedTime(const QString &path)
+{
+    const QFileInfo info(path);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : 0;
+}
+}
+
+SessionWarehouse::SessionWarehouse(const QString &sessionsDir)
+    : m_sessionsDir(sessionsDir.isEmpty() ? Statistics::defaultSessionsDir() : sessionsDir)
+{
+    static std::atomic<int> nextConnection{0};
+    m_connection = QStringLiteral("SessionWarehouse-%1").arg(nextConnection.fetch_add(1));
+
+    const QString path = databasePath(m_sessionsDir);
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        qWarning() << "SessionWarehouse: cannot create" << QFileInfo(path).absolutePath();
+        return;
+    }
+    m_db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connection);
+    m_db.setDatabaseName(path);
+    // The capture worker writes while the dialogs read.
+    m_db.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=5000"));
+    if (!m_db.open()) {
+        qWarning() << "SessionWarehouse: cannot open" << path << m_db.lastError().text();
+        return;
+    }
+    m_open = createSchema();
+}
+
+SessionWarehouse::~SessionWarehouse()
+{
+    m_db.close();
+    m_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(m_connection);
+}
+
+QString SessionWarehouse::databasePath(const QString &sessionsDir)
+{
+    return QDir(sessionsDir).filePath(QStringLiteral("warehouse/sessions.sqlite"));
+}
+
+bool SessionWarehouse::createSchema()
+{
+    QSqlQuery version(m_db);
+    if (!version.exec(QStringLiteral("PRAGMA user_version")) || !version.next()) {
+        return false;
+    }
+    const int current = version.value(0).toInt();
+    version.finish();
+
+    run(m_db, QStringLiteral("PRAGMA journal_mode=WAL"));
+    if (current == kSchemaVersion) {
+        return true;
+    }
+
+    QStringList statements;
+    if (current != 0) {
+        statements << QStringLiteral("DROP TABLE IF EXISTS sessions")
+                   << QStringLiteral("DROP TABLE IF EXISTS seconds")
+                   << QStringLiteral("DROP TABLE IF EXISTS protocols")
+                   << QStringLiteral("DROP TABLE IF EXISTS contacts")
+                   << QStringLiteral("DROP TABLE IF EXISTS hosts")
+                   << QStringLiteral("DROP TABLE IF EXISTS anomalies");
+    }
+    statements
+        << QStringLiteral("CREATE TABLE sessions ("
+                          "id INTEGER PRIMARY KEY, path TEXT NOT NULL UNIQUE, "
+                          "modified INTEGER NOT NULL, start_time INTEGER NOT NULL, "
+                          "end_time INTEGER NOT NULL, max_second INTEGER NOT NULL)")
+        << QStringLiteral("CREATE TABLE seconds ("
+                          "session INTEGER NOT NULL, second INTEGER NOT NULL, ts INTEGER NOT NULL, "
+                          "packets INTEGER NOT NULL, bytes INTEGER NOT NULL, "
+                          "connections INTEGER NOT NULL, "
+                          "size_p50 REAL, size_p90 REAL, size_p99 REAL, "
+                          "gap_p50 REAL, gap_p90 REAL, gap_p99 REAL, "
+                          "rtt_p50 REAL, rtt_p90 REAL, rtt_p99 REAL, "
+                          "PRIMARY KEY (session, second)) WITHOUT ROWID")
+        << QStringLiteral("CREATE INDEX seconds_ts ON seconds (ts)")
+        << QStringLiteral("CREATE TABLE protocols ("
+                          "session INTEGER NOT NULL, second INTEGER NOT NULL, "
+                          "protocol TEXT NOT NULL, packets INTEGER NOT NULL, "
+                          "PRIMARY KEY (session, second, protocol)) WITHOUT ROWID")
+        << QStringLiteral("CREATE TABLE contacts ("
+                          "session INTEGER NOT NULL, second INTEGER NOT NULL, ts INTEGER NOT NULL, "
+                          "src TEXT NOT NULL, dst TEXT NOT NULL)")
+        << QStringLiteral("CREATE INDEX contacts_src ON contacts (src, ts)")
+        << QStringLiteral("CREATE INDEX contacts_dst ON contacts (dst, ts)")
+        << QStringLiteral("CREATE INDEX contacts_second ON contacts (session, second)")
+        << QStringLiteral("CREATE TABLE hosts ("
+                          "ip TEXT PRIMARY KEY, first_seen INTEGER NOT NULL, "
+                          "last_seen INTEGER NOT NULL) WITHOUT ROWID")
+        << QStringLiteral("CREATE TABLE anomalies ("
+                          "session INTEGER NOT NULL, incident INTEGER NOT NULL, "
+                          "second INTEGER NOT NULL, ts INTEGER NOT NULL, "
+                          "score REAL NOT NULL, summary TEXT NOT NULL, tags TEXT NOT NULL)")
+        << QStringLiteral("CREATE INDEX anomalies_ts ON anomalies (ts)")
+        << QStringLiteral("CREATE UNIQUE INDEX anomalies_incident ON anomalies (session, incident)")
+        << QStringLiteral("PRAGMA user_version = %1").arg(kSchemaVersion);
+
+    m_db.transaction();
+    for (const QString &statement : std::as_const(statements)) {
+        if (!run(m_db, statement)) {
+            m_db.rollback();
+            return false;
+        }
+    }
+    return m_db.commit();
+}
+
+qint64 SessionWarehouse::sessionId(const QString &path) const
+{
+    QSqlQuery query(m_db);
+    query.prepare(QStringLiteral("SELECT id FROM sessions WHERE path = ?"));
+    query.addBindValue(path);
+    if (!run(query) || !query.next()) {
+        return -1;
+    }
+    return query.value(0).toLongLong();
+}
+
+bool SessionWarehouse::eraseSession(qint64 id)
+{
+    for (const char *table : { "seconds", "protocols", "contacts", "anomalies" }) {
+        QSqlQuery erase(m_db);
+        erase.prepare(QStringLiteral("DELETE FROM %1 WHERE session = ?").arg(QLatin1String(table)));
+        erase.addBindValue(id);
+        if (!run(erase)) {
+            return false;
+        }
+    }
+    QSqlQuery erase(m_db);
+    erase.prepare(QStringLiteral("DELETE FROM sessions WHERE id = ?"));
+    erase.addBindValue(id);
+    return run(erase);
+}
+
+bool SessionWarehouse::ingest(const QString &path,
+                              const QJsonObject &session,
+                              const QString &previousPath,
+                              int fromSecond,
+                              const QVector<AnomalyDetector::Event> *anomalies,
+                              int maxSecond)
+{
+    if (!m_open) {
+        return false;
+    }
+    const QDateTime start = QDateTime::fromString(session.value("sessionStart").toString(), Qt::ISODate);
+    if (!start.isValid()) {
+        return false;
+    }
+    QDateTime end = QDateTime::fromString(session.value("sessionEnd").toString(), Qt::ISODate);
+    if (!end.isValid()) {
+        end = start;
+    }
+    const qint64 origin = start.toSecsSinceEpoch();
+    const QJsonArray perSecond = session.value("perSecond").toArray();
+    if (maxSecond < 0) {
+        maxSecond = 0;
+        for (const QJsonValue &value : perSecond) {
+            maxSecond = std::max(maxSecond, value.toObject().value("second").toInt());
+        }
+    }
+
+    if (!m_db.transaction()) {
+        return false;
+    }
+    auto fail = [this]() {
+        m_db.rollback();
+        return false;
+    };
+
+    // A re-saved session arrives under a new file name; keep its id so only
+    // the seconds that changed since the last save are rewritten.
+    qint64 id = sessionId(path);
+    qint64 stale = previousPath.isEmpty() || previousPath == path ? -1 : sessionId(previousPath);
+    if (id < 0) {
+        std::swap(id, stale);
+    }
+    if (stale >= 0 && !eraseSession(stale)) {
+        return fail();
+    }
+
+    QSqlQuery upsert(m_db);
+    if (id < 0) {
+        fromSecond = 0;
+        upsert.prepare(QStringLiteral("INSERT INTO sessions (path, modified, start_time, end_time, max_second) "
+                                      "VALUES (?, ?, ?, ?, ?)"));
+    } else {
+        upsert.prepare(QStringLiteral("UPDATE sessions SET path = ?, modified = ?, start_time = ?, "
+                                      "end_time = ?, max_second = ? WHERE id = ?"));
+    }
+    upsert.addBindValue(path);
+    upsert.addBindValue(modifiedTime(path));
+    upsert.addBindValue(origin);
+    upsert.addBindValue(end.toSecsSinceEpoch());
+    upsert.addBindValue(maxSecond);
+    if (id >= 0) {
+        upsert.addBindValue(id);
+    }
+    if (!run(upsert)) {
+        return fail();
+    }
+    if (id < 0) {
+        id = upsert.lastInsertId().toLongLong();
+    } else {
+        for (const char *table : { "seconds", "protocols", "contacts" }) {
+            QSqlQuery erase(m_db);
+            erase.prepare(QStringLiteral("DELETE FROM %1 WHERE session = ? AND second >= ?")
+                              .arg(QLatin1String(table)));
+            erase.addBindValue(id);
+            erase.addBindValue(fromSecond);
+            if (!run(erase)) {
+                return fail();
+            }
+        }
+    }
+
+    QSqlQuery insertSecond(m_db);
+    insertSecond.prepare(QStringLiteral("INSERT INTO seconds VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"));
+    QSqlQuery insertProtocol(m_db);
+    insertProtocol.prepare(QStringLiteral("INSERT INTO protocols VALUES (?, ?, ?, ?)"));
+    QSqlQuery insertContact(m_db);
+    insertContact.prepare(QStringLiteral("INSERT INTO contacts VALUES (?, ?, ?, ?, ?)"));
+
+    const QVariant unsampled(QMetaType::fromType<double>());
+    QHash<QString, QPair<qint64, qint64>> seen;   // ip -> first, last ts
+    auto noteHost = [&seen](const QString &ip, qint64 ts) {
+        auto it = seen.find(ip);
+        if (it == seen.end()) {
+            seen.insert(ip, qMakePair(ts, ts));
+        } else {
+            it->first = std::min(it->first, ts);
+            it->second = std::max(it->second, ts);
+        }
+    };
+
+    for (const QJsonValue &value : perSecond) {
+        const QJsonObject secondObj = value.toObject();
+        const int second = secondObj.value("second").toInt();
+        if (second < fromSecond) {
+            continue;
+        }
+        const qint64 ts = origin + second;
+        const QJsonArray connections = secondObj.value("connections").toArray();
+        const QJsonObject quantiles = secondObj.value("quantiles").toObject();
+
+        insertSecond.addBindValue(id);
+        insertSecond.addBindValue(second);
+        insertSecond.addBindValue(ts);
+        insertSecond.addBindValue(qint64(secondObj.value("pps").toDouble()));
+        insertSecond.addBindValue(qint64(secondObj.value("bps").toDouble()));
+        insertSecond.addBindValue(secondObj.value("uniqueConnections").toInt(int(connections.size())));
+        for (const char *key : kQuantileKeys) {
+            const QJsonArray values = quantiles.value(QLatin1String(key)).toArray();
+            for (int i = 0; i < 3; ++i) {
+                insertSecond.addBindValue(i < values.size() ? QVariant(values.at(i).toDouble()) : unsampled);
+            }
+        }
+        if (!run(insertSecond)) {
+            return fail();
+        }
+
+        const QJsonObject protocols = secondObj.value("protocolCounts").toObject();
+        for (auto it = protocols.constBegin(); it != protocols.constEnd(); ++it) {
+            insertProtocol.addBindValue(id);
+            insertProtocol.addBindValue(second);
+            insertProtocol.addBindValue(it.key());
+            insertProtocol.addBindValue(it.value().toInteger());
+            if (!run(insertProtocol)) {
+                return fail();
+            }
+        }
+
+        for (const QJsonValue &connValue : connections) {
+            const QJsonObject connObj = connValue.toObject();
+            const QString src = connObj.value("src").toString();
+            const QString dst = connObj.value("dst").toString();
+            insertContact.addBindValue(id);
+            insertContact.addBindValue(second);
+            insertContact.addBindValue(ts);
+            insertContact.addBindValue(src);
+            insertContact.addBindValue(dst);
+            if (!run(insertContact)) {
+                return fail();
+            }
+            noteHost(src, ts);
+            noteHost(dst, ts);
+        }
+    }
+
+    QSqlQuery insertHost(m_db);
+    insertHost.prepare(QStringLiteral("INSERT INTO hosts VALUES (?, ?, ?) ON CONFLICT (ip) DO UPDATE SET "
+                                      "first_seen = MIN(first_seen, excluded.first_seen), "
+                                      "last_seen = MAX(last_seen, excluded.last_seen)"));
+    for (auto it = seen.constBegin(); it != seen.constEnd(); ++it) {
+        insertHost.addBindValue(it.key());
+        insertHost.addBindValue(it.value().first);
+        insertHost.addBindValue(it.value().second);
+        if (!run(insertHost)) {
+            return fail();
+        }
+    }
+
+    if (anomalies) {
+        QSqlQuery insertAnomaly(m_db);
+        insertAnomaly.prepare(QStringLiteral("INSERT INTO anomalies VALUES (?, ?, ?, ?, ?, ?, ?) "
+                                             "ON CONFLICT (session, incident) DO UPDATE SET "
+                                             "second = excluded.second, ts = excluded.ts, "
+                                             "score = excluded.score, summary = excluded.summary, "
+                                             "tags = excluded.tags WHERE score != excluded.score "
+                                             "OR summary != excluded.summary OR tags != excluded.tags "
+                                             "OR second != excluded.second"));
+        for (const AnomalyDetector::Event &event : *anomalies) {
+            // An incident only changes while it grows, so one that ended
+            // before fromSecond is stored as it is.
+            if (event.endSecond < fromSecond) {
+                continue;
+            }
+            insertAnomaly.addBindValue(id);
+            insertAnomaly.addBindValue(qint64(event.id));
+            insertAnomaly.addBindValue(event.second);
+            insertAnomaly.addBindValue(origin + event.second);
+            insertAnomaly.addBindValue(event.score);
+            insertAnomaly.addBindValue(event.summary);
+            insertAnomaly.addBindValue(event.tags.join(QLatin1Char(',')));
+            if (!run(insertAnomaly)) {
+                return fail();
+            }
+        }
+    }
+
+    if (!m_db.commit()) {
+        return fail();
+    }
+    return true;
+}
+
+bool SessionWarehouse::remove(const QString &path)
+{
+    if (!m_open) {
+        return false;
+    }
+    const qint64 id = sessionId(path);
+    if (id < 0) {
+        return true;
+    }
+    if (!m_db.transaction()) {
+        return false;
+    }
+    if (!eraseSession(id) || !rebuildHosts()) {
+        m_db.rollback();
+        return false;
+    }
+    return m_db.commit();
+}
+
+bool SessionWarehouse::rebuildHosts()
+{
+    // Only after removals; ingesting just widens the first/last seen range.
+    return run(m_db, QStringLiteral("DELETE FROM hosts"))
+        && run(m_db, QStringLiteral("INSERT INTO hosts SELECT ip, MIN(ts), MAX(ts) FROM ("
+                                    "SELECT src AS ip, ts FROM contacts "
+                                    "UNION ALL SELECT dst, ts FROM contacts) GROUP BY ip"));
+}
+
+int SessionWarehouse::sync()
+{
+    if (!m_open) {
+        return 0;
+    }
+
+    QHash<QString, qint64> known;
+    QSqlQuery query(m_db);
+    query.prepare(QStringLiteral("SELECT path, modified FROM sessions"));
+    if (!run(query)) {
+        return 0;
+    }
+    while (query.next()) {
+        known.insert(query.value(0).toString(), query.value(1).toLongLong());
+    }
+    query.finish();
+
+    int read = 0;
+    QDir dir(m_sessionsDir);
+    const QStringList files = dir.entryList({QStringLiteral("*.json")}, QDir::Files, QDir::Name);
+    for (const QString &fileName : files) {
+        const QString path = dir.filePath(fileName);
+        const auto it = known.constFind(path);
+        if (it != known.constEnd()) {
+            const bool unchanged = it.value() == modifiedTime(path);
+            known.erase(it);
+            if (unchanged) {
+                continue;
+            }
+        }
+
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+        file.close();
+        if (doc.isObject() && ingest(path, doc.object())) {
+            ++read;
+        }
+    }
+
+    // Whatever is left was deleted from disk.
+    for (auto it = known.constBegin(); it != known.constEnd(); ++it) {
+        remove(it.key());
+    }
+    return read;
+}
+
+QVector<SessionWarehouse::Session> SessionWarehouse::sessions() const
+{
+    QVector<Session> result;
+    if (!m_open) {
+        return result;
+    }
+    QSqlQuery query(m_db);
+    query.prepare(QStringLiteral("SELECT id, path, start_time, end_time, max_second FROM sessions "
+                                 "ORDER BY start_time, path"));
+    if (!run(query)) {
+        return result;
+    }
+    while (query.next()) {
+        Session session;
+        session.id = query.value(0).toLongLong();
+        session.path = query.value(1).toString();
+        session.start = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
+        session.end = QDateTime::fromSecsSinceEpoch(query.value(3).toLongLong());
+        session.maxSecond = query.value(4).toInt();
+        result.append(session);
+    }
+    return result;
+}
+
+QVector<SessionWarehouse::Second> SessionWarehouse::seconds(qint64 session) const
+{
+    QVector<Second> result;
+    if (!m_open) {
+        return result;
+    }
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT second, packets, bytes, connections, "
+                                 "size_p50, size_p90, size_p99, gap_p50, gap_p90, gap_p99, "
+                                 "rtt_p50, rtt_p90, rtt_p99 "
+                                 "FROM seconds WHERE session = ? ORDER BY second"));
+    query.addBindValue(session);
+    if (!run(query)) {
+        return result;
+    }
+    while (query.next()) {
+        Second second;
+        second.second = query.value(0).toInt();
+        second.packets = query.value(1).toULongLong();
+        second.bytes = query.value(2).toULongLong();
+        second.connections = query.value(3).toInt();
+        second.quantiles.fill(-1.0, kQuantileColumns);
+        for (int i = 0; i < kQuantileColumns; ++i) {
+            const QVariant value = query.value(4 + i);
+            if (!value.isNull()) {
+                second.quantiles[i] = value.toDouble();
+            }
+        }
+        result.append(second);
+    }
+    return result;
+}
+
+QMap<int, QPair<qint64, qint64>> SessionWarehouse::bucketTotals(qint64 session, int bucketSeconds) const
+{
+    QMap<int, QPair<qint64, qint64>> result;
+    if (!m_open || bucketSeconds <= 0) {
+        return result;
+    }
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT second / ?, SUM(bytes), SUM(packets) FROM seconds "
+                                 "WHERE session = ? GROUP BY 1"));
+    query.addBindValue(bucketSeconds);
+    query.addBindValue(session);
+    if (!run(query)) {
+        return result;
+    }
+    while (query.next()) {
+        result.insert(query.value(0).toInt(),
+                      qMakePair(query.value(1).toLongLong(), query.value(2).toLongLong()));
+    }
+    return result;
+}
+
+QHash<qint64, QMap<QString, qint64>> SessionWarehouse::protocolTotals() const
+{
+    QHash<qint64, QMap<QString, qint64>> result;
+    if (!m_open) {
+        return result;
+    }
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT session, protocol, SUM(packets) FROM protocols "
+                                 "GROUP BY session, protocol"));
+    if (!run(query)) {
+        return result;
+    }
+    while (query.next()) {
+        result[query.value(0).toLongLong()].insert(query.value(1).toString(),
+                                                   query.value(2).toLongLong());
+    }
+    return result;
+}
+
+QVector<SessionWarehouse::Host> SessionWarehouse::hosts() const
+{
+    QVector<Host> result;
+    if (!m_open) {
+        return result;
+    }
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT ip, first_seen, last_seen FROM hosts ORDER BY ip"));
+    if (!run(query)) {
+        return result;
+    }
+    while (query.next()) {
+        Host host;
+        host.ip = query.value(0).toString();
+        host.firstSeen = QDateTime::fromSecsSinceEpoch(query.value(1).toLongLong());
+        host.lastSeen = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
+        result.append(host);
+    }
+    return result;
+}
+
+QVector<SessionWarehouse::Contact> SessionWarehouse::contacts(const QString &ip,
+                                                              const QDateTime &from,
+                                                              const QDateTime &to) const
+{
+    QVector<Contact> result;
+    if (!m_open || ip.isEmpty()) {
+        return result;
+    }
+
+    // Each side is a range scan on its own (ip, ts) index.
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral(
+        "SELECT c.session, c.second, c.ts, c.src, c.dst, s.packets, s.bytes "
+        "FROM contacts c JOIN seconds s ON s.session = c.session AND s.second = c.second "
+        "WHERE c.src = ? AND c.ts BETWEEN ? AND ? "
+        "UNION ALL "
+        "SELECT c.session, c.second, c.ts, c.src, c.dst, s.packets, s.bytes "
+        "FROM contacts c JOIN seconds s ON s.session = c.session AND s.second = c.second "
+        "WHERE c.dst = ? AND c.src <> ? AND c.ts BETWEEN ? AND ? "
+        "ORDER BY 3, 4, 5"));
+    query.addBindValue(ip);
+    query.addBindValue(lowerTs(from));
+    query.addBindValue(upperTs(to));
+    query.addBindValue(ip);
+    query.addBindValue(ip);
+    query.addBindValue(lowerTs(from));
+    query.addBindValue(upperTs(to));
+    if (!run(query)) {
+        return result;
+    }
+
+    QHash<QPair<qint64, int>, int> matches;
+    while (query.next()) {
+        Contact contact;
+        contact.session = query.value(0).toLongLong();
+        contact.second = query.value(1).toInt();
+        contact.timestamp = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
+        contact.src = query.value(3).toString();
+        contact.dst = query.value(4).toString();
+        contact.packets = query.value(5).toULongLong();
+        contact.bytes = query.value(6).toULongLong();
+        matches[qMakePair(contact.session, contact.second)] += 1;
+        result.append(contact);
+    }
+    query.finish();
+
+    QSqlQuery protocols(m_db);
+    protocols.setForwardOnly(true);
+    protocols.prepare(QStringLiteral("SELECT protocol, packets FROM protocols "
+                                     "WHERE session = ? AND second = ?"));
+    QHash<QPair<qint64, int>, QMap<QString, double>> countsBySecond;
+    for (auto it = matches.constBegin(); it != matches.constEnd(); ++it) {
+        protocols.addBindValue(it.key().first);
+        protocols.addBindValue(it.key().second);
+        if (!run(protocols)) {
+            break;
+        }
+        QMap<QString, double> &counts = countsBySecond[it.key()];
+        while (protocols.next()) {
+            counts.insert(protocols.value(0).toString(), protocols.value(1).toDouble());
+        }
+    }
+
+    for (Contact &contact : result) {
+        const QPair<qint64, int> key(contact.session, contact.second);
+        contact.matches = matches.value(key);
+        contact.protocolCounts = countsBySecond.value(key);
+    }
+    return result;
+}
+
+QVector<SessionWarehouse::Anomaly> SessionWarehouse::anomalies(const QDateTime &from,
+                                                               const QDateTime &to) const
+{
+    QVector<Anomaly> result;
+    if (!m_open) {
+        return result;
+    }
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT session, second, ts, score, summary, tags FROM anomalies "
+                                 "WHERE ts BETWEEN ? AND ? ORDER BY ts, score DESC"));
+    query.addBindValue(lowerTs(from));
+    query.addBindValue(upperTs(to));
+    if (!run(query)) {
+        return result;
+    }
+    while (query.next()) {
+        Anomaly anomaly;
+        anomaly.session = query.value(0).toLongLong();
+        anomaly.second = query.value(1).toInt();
+        anomaly.timestamp = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
+        anomaly.score = query.value(3).toDouble();
+        anomaly.summary = query.value(4).toString();
+        anomaly.tags = query.value(5).toString().split(QLatin1Char(','), Qt::SkipEmptyParts);
+        result.append(anomaly);
+    }
+    return result;
+}
@@ -0,0 +1,127 @@
+#ifndef SESSIONWAREHOUSE_H
+#define SESSIONWAREHOUSE_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QJsonObject>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "anomalydetector.h"
+
+// Indexed SQLite copy of the saved session statistics. Statistics ingests a
+// session every time it is persisted; the historical views query by time
+// range and IP instead of parsing every JSON file in the sessions directory.
+// The database lives in a "warehouse" subdirectory so writing it does not
+// trip the directory watchers on the sessions directory itself.
+//
+// One instance owns one connection and must stay on the thread it was
+// created on.
+class SessionWarehouse
+{
+public:
+    struct Session {
+        qint64 id = -1;
+        QString path;
+        QDateTime start;
+        QDateTime end;
+        int maxSecond = 0;
+    };
+
+    struct Second {
+        int second = 0;
+        quint64 packets = 0;
+        quint64 bytes = 0;
+        int connections = 0;
+        // size, inter-arrival and handshake RTT p50/p90/p99; -1 where unsampled
+        QVector<double> quantiles;
+    };
+
+    // One second in which the queried host exchanged traffic with a peer.
+    struct Contact {
+        qint64 session = -1;
+        int second = 0;
+        QDateTime timestamp;
+        QString src;
+        QString dst;
+        quint64 packets = 0;   // whole second, all connections
+        quint64 bytes = 0;
+        int matches = 0;       // connections of the host in that second
+        QMap<QString, double> protocolCounts;
+    };
+
+    struct Host {
+        QString ip;
+        QDateTime firstSeen;
+        QDateTime lastSeen;
+    };
+
+    struct Anomaly {
+        qint64 session = -1;
+        int second = 0;
+        QDateTime timestamp;
+        double score = 0.0;
+        QString summary;
+        QStringList tags;
+    };
+
+    static constexpr int kQuantileColumns = 9;
+
+    explicit SessionWarehouse(const QString &sessionsDir = QString());
+    ~SessionWarehouse();
+
+    SessionWarehouse(const SessionWarehouse &) = delete;
+    SessionWarehouse &operator=(const SessionWarehouse &) = delete;
+
+    bool isOpen() const { return m_open; }
+    QString sessionsDirectory() const { return m_sessionsDir; }
+    static QString databasePath(const QString &sessionsDir);
+
+    // Stores a saved statistics document. When the session is already known
+    // (under path or previousPath) only seconds >= fromSecond are rewritten.
+    // anomalies are matched to stored ones by incident id: incidents still
+    // open at fromSecond are inserted or updated, older ones are left as
+    // they are, and so are stored incidents missing from the list. Null
+    // leaves the session's anomalies untouched.
+    // A negative maxSecond is read from the document.
+    bool ingest(const QString &path,
+                const QJsonObject &session,
+                const QString &previousPath = QString(),
+                int fromSecond = 0,
+                const QVector<AnomalyDetector::Event> *anomalies = nullptr,
+                int maxSecond = -1);
+    bool remove(const QString &path);
+    // Ingests JSON files that are new or changed since they were last seen and
+    // forgets deleted ones. Returns the number of files read.
+    int sync();
+
+    QVector<Session> sessions() const;
+    QVector<Second> seconds(qint64 session) const;
+    // Per-bucket sums for bucketSeconds wide buckets, keyed by bucket index.
+    QMap<int, QPair<qint64, qint64>> bucketTotals(qint64 session, int bucketSeconds) const;   // bytes, packets
+    QHash<qint64, QMap<QString, qint64>> protocolTotals() const;
+    QVector<Host> hosts() const;
+    // Seconds in which ip was the source or destination of a tracked
+    // connection, oldest first. Invalid from/to leave that end open.
+    QVector<Contact> contacts(const QString &ip,
+                              const QDateTime &from = QDateTime(),
+                              const QDateTime &to = QDateTime()) const;
+    QVector<Anomaly> anomalies(const QDateTime &from = QDateTime(),
+                               const QDateTime &to = QDateTime()) const;
+
+private:
+    bool createSchema();
+    qint64 sessionId(const QString &path) const;
+    bool eraseSession(qint64 id);
+    bool rebuildHosts();
+
+    QString m_sessionsDir;
+    QString m_connection;
+    QSqlDatabase m_db;
+    bool m_open = false;
+};
+
+#endif // SESSIONWAREHOUSE_H
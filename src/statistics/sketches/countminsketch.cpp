@@ -0,0 +1,43 @@
+#include "countminsketch.h"
+
+#include <algorithm>
+#include <limits>
+
+CountMinSketch::CountMinSketch(int width, int depth)
+    : m_depth(qBound(1, depth, 16))
+{
+    int size = 16;
+    while (size < width)
+        size <<= 1;
+    m_width = size;
+    m_counters = QVector<quint64>(m_width * m_depth, 0);
+}
+
+void CountMinSketch::add(quint64 hash, quint64 weight)
+{
+    for (int row = 0; row < m_depth; ++row)
+        m_counters[row * m_width + indexFor(hash, row)] += weight;
+    m_total += weight;
+}
+
+quint64 CountMinSketch::estimate(quint64 hash) const
+{
+    quint64 best = std::numeric_limits<quint64>::max();
+    for (int row = 0; row < m_depth; ++row)
+        best = std::min(best, m_counters.at(row * m_width + indexFor(hash, row)));
+    return best;
+}
+
+void CountMinSketch::clear()
+{
+    std::fill(m_counters.begin(), m_counters.end(), 0);
+    m_total = 0;
+}
+
+int CountMinSketch::indexFor(quint64 hash, int row) const
+{
+    // Double hashing: row i uses h1 + i * h2 over the two hash halves.
+    const quint32 h1 = quint32(hash);
+    const quint32 h2 = quint32(hash >> 32) | 1u;
+    return int((h1 + quint32(row) * h2) & quint32(m_width - 1));
+}
@@ -0,0 +1,29 @@
+#ifndef COUNTMINSKETCH_H
+#define COUNTMINSKETCH_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// Frequency sketch with depth rows of width counters. estimate() never
+// undercounts; with total weight N it overcounts by at most e*N/width with
+// probability 1 - exp(-depth).
+class CountMinSketch
+{
+public:
+    explicit CountMinSketch(int width = 1024, int depth = 4);
+
+    void add(quint64 hash, quint64 weight = 1);
+    quint64 estimate(quint64 hash) const;
+    quint64 total() const { return m_total; }
+    void clear();
+
+private:
+    int indexFor(quint64 hash, int row) const;
+
+    int m_width;
+    int m_depth;
+    quint64 m_total = 0;
+    QVector<quint64> m_counters;
+};
+
+#endif // COUNTMINSKETCH_H
@@ -0,0 +1,101 @@
+#include "heavyhitters.h"
+#include "sketchhash.h"
+
+#include <algorithm>
+
+HeavyHitters::HeavyHitters(int capacity, int sketchWidth, int sketchDepth)
+    : m_capacity(qMax(1, capacity)),
+      m_sketch(sketchWidth, sketchDepth)
+{
+    m_heap.reserve(m_capacity);
+    m_index.reserve(m_capacity);
+}
+
+void HeavyHitters::add(const QString &key, quint64 weight)
+{
+    const quint64 hash = SketchHash::of(key);
+    m_sketch.add(hash, weight);
+
+    auto it = m_index.constFind(key);
+    if (it != m_index.constEnd()) {
+        const int index = it.value();
+        m_heap[index].count += weight;
+        siftDown(index);
+        return;
+    }
+
+    if (m_heap.size() < m_capacity) {
+        // Nothing has been evicted yet, so the count is exact; sift up.
+        int index = m_heap.size();
+        m_heap.append({key, weight, 0});
+        m_index.insert(key, index);
+        while (index > 0) {
+            const int parent = (index - 1) / 2;
+            if (m_heap.at(parent).count <= m_heap.at(index).count)
+                break;
+            swapItems(parent, index);
+            index = parent;
+        }
+        return;
+    }
+
+    Item &root = m_heap[0];
+    const quint64 inherited = std::min(root.count + weight, m_sketch.estimate(hash));
+    m_index.remove(root.key);
+    root.key = key;
+    root.count = inherited;
+    root.error = inherited > weight ? inherited - weight : 0;
+    m_index.insert(key, 0);
+    siftDown(0);
+}
+
+QVector<HeavyHitters::Item> HeavyHitters::top(int k) const
+{
+    QVector<Item> items = m_heap;
+    std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+        return a.count > b.count;
+    });
+    if (k >= 0 && items.size() > k)
+        items.resize(k);
+    return items;
+}
+
+quint64 HeavyHitters::estimate(const QString &key) const
+{
+    auto it = m_index.constFind(key);
+    if (it != m_index.constEnd())
+        return m_heap.at(it.value()).count;
+    return m_sketch.estimate(SketchHash::of(key));
+}
+
+void HeavyHitters::clear()
+{
+    m_sketch.clear();
+    m_heap.clear();
+    m_index.clear();
+}
+
+void HeavyHitters::siftDown(int index)
+{
+    const int size = m_heap.size();
+    for (;;) {
+        const int left = 2 * index + 1;
+        const int right = left + 1;
+        int smallest = index;
+        if (left < size && m_heap.at(left).count < m_heap.at(smallest).count)
+            smallest = left;
+        if (right < size && m_heap.at(right).count < m_heap.at(smallest).count)
+            smallest = right;
+        if (smallest == index)
+            return;
+        swapItems(index, smallest);
+        index = smallest;
+    }
+}
+
+void HeavyHitters::swapItems(int a, int b)
+{
+    std::swap(m_heap[a], m_heap[b]);
+    m_index[m_heap.at(a).key] = a;
+    m_index[m_heap.at(b).key] = b;
+}
@@ -0,0 +1,45 @@
+#ifndef HEAVYHITTERS_H
+#define HEAVYHITTERS_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "countminsketch.h"
+
+// Space-Saving top-K over string keys. Up to capacity keys are monitored;
+// any key whose weight exceeds total/capacity is guaranteed to be among them.
+// A Count-Min sketch over every key bounds the count a newcomer inherits
+// when it replaces the smallest monitored key, which keeps overestimates
+// far below plain Space-Saving on long-tailed traffic.
+class HeavyHitters
+{
+public:
+    struct Item {
+        QString key;
+        quint64 count = 0;
+        quint64 error = 0;   // count may overstate the true weight by this much
+    };
+
+    explicit HeavyHitters(int capacity = 64, int sketchWidth = 1024, int sketchDepth = 4);
+
+    void add(const QString &key, quint64 weight = 1);
+    // Largest monitored keys, heaviest first.
+    QVector<Item> top(int k) const;
+    // Monitored count when tracked, Count-Min estimate otherwise.
+    quint64 estimate(const QString &key) const;
+    quint64 total() const { return m_sketch.total(); }
+    int capacity() const { return m_capacity; }
+    void clear();
+
+private:
+    void siftDown(int index);
+    void swapItems(int a, int b);
+
+    int m_capacity;
+    CountMinSketch m_sketch;
+    QVector<Item> m_heap;          // min-heap on count
+    QHash<QString, int> m_index;   // key -> heap position
+};
+
+#endif // HEAVYHITTERS_H
@@ -0,0 +1,118 @@
+#include "hyperloglog.h"
+#include "sketchhash.h"
+
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+
+HyperLogLog::HyperLogLog(int precision)
+    : m_precision(qBound(4, precision, 16))
+{
+}
+
+void HyperLogLog::add(quint64 hash)
+{
+    if (!m_registers.isEmpty()) {
+        addDense(hash);
+        return;
+    }
+    insertSparse(hash);
+    // Eight bytes per exact hash against one byte per register.
+    if (m_sparse.size() > (1 << m_precision) / 8) {
+        toDense();
+    }
+}
+
+void HyperLogLog::merge(const HyperLogLog &other)
+{
+    Q_ASSERT(other.m_precision == m_precision);
+    if (other.m_registers.isEmpty()) {
+        for (quint64 hash : other.m_sparse) {
+            add(hash);
+        }
+        return;
+    }
+    toDense();
+    for (int i = 0; i < m_registers.size(); ++i) {
+        m_registers[i] = std::max(m_registers.at(i), other.m_registers.at(i));
+    }
+}
+
+double HyperLogLog::estimate() const
+{
+    if (m_registers.isEmpty()) {
+        return m_sparse.size();
+    }
+
+    const double m = m_registers.size();
+    double alpha;
+    switch (m_registers.size()) {
+    case 16: alpha = 0.673; break;
+    case 32: alpha = 0.697; break;
+    case 64: alpha = 0.709; break;
+    default: alpha = 0.7213 / (1.0 + 1.079 / m); break;
+    }
+
+    double sum = 0.0;
+    int zeros = 0;
+    for (quint8 reg : m_registers) {
+        sum += std::ldexp(1.0, -int(reg));
+        if (reg == 0) {
+            ++zeros;
+        }
+    }
+
+    const double raw = alpha * m * m / sum;
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / zeros);
+    }
+    return raw;
+}
+
+void HyperLogLog::clear()
+{
+    m_sparse.clear();
+    m_registers.clear();
+}
+
+quint64 HyperLogLog::hash(quint64 value)
+{
+    return SketchHash::mix(value);
+}
+
+quint64 HyperLogLog::hash(QStringView value)
+{
+    return SketchHash::of(value);
+}
+
+void HyperLogLog::insertSparse(quint64 hash)
+{
+    auto it = std::lower_bound(m_sparse.begin(), m_sparse.end(), hash);
+    if (it == m_sparse.end() || *it != hash) {
+        m_sparse.insert(it, hash);
+    }
+}
+
+void HyperLogLog::addDense(quint64 hash)
+{
+    const int index = int(hash >> (64 - m_precision));
+    // Guard bit keeps the rank bounded when the remaining bits are zero.
+    const quint64 rest = (hash << m_precision) | (quint64(1) << (m_precision - 1));
+    const quint8 rank = quint8(qCountLeadingZeroBits(rest) + 1);
+    if (rank > m_registers.at(index)) {
+        m_registers[index] = rank;
+    }
+}
+
+void HyperLogLog::toDense()
+{
+    if (!m_registers.isEmpty()) {
+        return;
+    }
+    m_registers = QVector<quint8>(1 << m_precision, 0);
+    for (quint64 hash : std::as_const(m_sparse)) {
+        addDense(hash);
+    }
+    m_sparse.clear();
+    m_sparse.squeeze();
+}
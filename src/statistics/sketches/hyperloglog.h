@@ -0,0 +1,42 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include <QStringView>
+#include <QVector>
+#include <QtGlobal>
+
+// Distinct-count sketch. Small sets are kept as exact hashes and switch to
+// 2^precision one-byte registers once that would be smaller, so memory per
+// sketch never exceeds the register array. Relative error is about
+// 1.04 / sqrt(2^precision).
+class HyperLogLog
+{
+public:
+    static constexpr int kDefaultPrecision = 10;
+
+    explicit HyperLogLog(int precision = kDefaultPrecision);
+
+    void add(quint64 hash);
+    // Both sketches must use the same precision.
+    void merge(const HyperLogLog &other);
+    double estimate() const;
+    int count() const { return qRound(estimate()); }
+
+    int precision() const { return m_precision; }
+    bool isEmpty() const { return m_sparse.isEmpty() && m_registers.isEmpty(); }
+    void clear();
+
+    static quint64 hash(quint64 value);
+    static quint64 hash(QStringView value);
+
+private:
+    void insertSparse(quint64 hash);
+    void addDense(quint64 hash);
+    void toDense();
+
+    int m_precision;
+    QVector<quint64> m_sparse;    // sorted, exact while small
+    QVector<quint8> m_registers;  // empty until the sketch goes dense
+};
+
+#endif // HYPERLOGLOG_H
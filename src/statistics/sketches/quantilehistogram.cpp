@@ -0,0 +1,135 @@
+#include "quantilehistogram.h"
+
+#include <QJsonArray>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cmath>
+
+void QuantileHistogram::add(quint64 value, quint64 count)
+{
+    if (count == 0) {
+        return;
+    }
+    const int index = indexFor(value);
+    if (index >= m_counts.size()) {
+        m_counts.resize(index + 1);
+    }
+    m_counts[index] += count;
+    m_min = m_count == 0 ? value : std::min(m_min, value);
+    m_max = std::max(m_max, value);
+    m_count += count;
+}
+
+void QuantileHistogram::merge(const QuantileHistogram &other)
+{
+    if (other.m_count == 0) {
+        return;
+    }
+    if (other.m_counts.size() > m_counts.size()) {
+        m_counts.resize(other.m_counts.size());
+    }
+    for (int i = 0; i < other.m_counts.size(); ++i) {
+        m_counts[i] += other.m_counts.at(i);
+    }
+    m_min = m_count == 0 ? other.m_min : std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+    m_count += other.m_count;
+}
+
+quint64 QuantileHistogram::quantile(double q) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+    q = qBound(0.0, q, 1.0);
+    const quint64 rank = std::max<quint64>(1, quint64(std::ceil(q * double(m_count))));
+    if (rank >= m_count) {
+        return m_max;
+    }
+    quint64 seen = 0;
+    for (int i = 0; i < m_counts.size(); ++i) {
+        seen += m_counts.at(i);
+        if (seen >= rank) {
+            const quint64 low = lowerBound(i);
+            const quint64 middle = low + (upperBound(i) - low) / 2;
+            return qBound(m_min, middle, m_max);
+        }
+    }
+    return m_max;
+}
+
+void QuantileHistogram::clear()
+{
+    m_counts.clear();
+    m_count = 0;
+    m_min = 0;
+    m_max = 0;
+}
+
+QJsonObject QuantileHistogram::toJson() const
+{
+    QJsonArray buckets;
+    for (int i = 0; i < m_counts.size(); ++i) {
+        if (m_counts.at(i) > 0) {
+            buckets.append(i);
+            buckets.append(static_cast<double>(m_counts.at(i)));
+        }
+    }
+
+    QJsonObject object;
+    object.insert("count", static_cast<double>(m_count));
+    object.insert("min", static_cast<double>(min()));
+    object.insert("max", static_cast<double>(m_max));
+    object.insert("buckets", buckets);
+    return object;
+}
+
+QuantileHistogram QuantileHistogram::fromJson(const QJsonObject &object)
+{
+    QuantileHistogram histogram;
+    const QJsonArray buckets = object.value("buckets").toArray();
+    for (int i = 0; i + 1 < buckets.size(); i += 2) {
+        const int index = buckets.at(i).toInt(-1);
+        const double count = buckets.at(i + 1).toDouble();
+        if (index < 0 || index > indexFor(~quint64(0)) || count <= 0) {
+            continue;
+        }
+        histogram.add(lowerBound(index), quint64(count));
+    }
+    if (histogram.m_count > 0) {
+        // Bucket bounds are coarser than the recorded extremes.
+        histogram.m_min = quint64(object.value("min").toDouble(double(histogram.m_min)));
+        histogram.m_max = quint64(object.value("max").toDouble(double(histogram.m_max)));
+    }
+    return histogram;
+}
+
+int QuantileHistogram::indexFor(quint64 value)
+{
+    if (value < quint64(2 * kSubBuckets)) {
+        return int(value);
+    }
+    const int magnitude = 63 - qCountLeadingZeroBits(value);
+    const int shift = magnitude - kSubBucketBits;
+    return shift * kSubBuckets + int(value >> shift);
+}
+
+quint64 QuantileHistogram::lowerBound(int index)
+{
+    if (index < 2 * kSubBuckets) {
+        return quint64(index);
+    }
+    const int shift = index / kSubBuckets - 1;
+    const quint64 mantissa = quint64(index % kSubBuckets + kSubBuckets);
+    return mantissa << shift;
+}
+
+quint64 QuantileHistogram::upperBound(int index)
+{
+    if (index < 2 * kSubBuckets) {
+        return quint64(index);
+    }
+    const int shift = index / kSubBuckets - 1;
+    return lowerBound(index) + ((quint64(1) << shift) - 1);
+}
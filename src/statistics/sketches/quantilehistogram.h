@@ -0,0 +1,46 @@
+#ifndef QUANTILEHISTOGRAM_H
+#define QUANTILEHISTOGRAM_H
+
+#include <QJsonObject>
+#include <QVector>
+#include <QtGlobal>
+
+// Log-linear (HDR style) histogram of non-negative integers. Values below
+// 2 * kSubBuckets are exact; above that every power of two is split into
+// kSubBuckets equal buckets, so quantiles are within 1/(2 * kSubBuckets)
+// (about 3%) of the true value. Counters grow with the largest value seen:
+// a full 16-bit range needs under 200 of them.
+class QuantileHistogram
+{
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+
+    void add(quint64 value, quint64 count = 1);
+    void merge(const QuantileHistogram &other);
+    // Value at rank q in [0, 1]; 0 when empty.
+    quint64 quantile(double q) const;
+
+    quint64 count() const { return m_count; }
+    quint64 min() const { return m_count > 0 ? m_min : 0; }
+    quint64 max() const { return m_max; }
+    bool isEmpty() const { return m_count == 0; }
+    void clear();
+
+    // {"count", "min", "max", "buckets": [index, count, ...]} with empty
+    // buckets left out.
+    QJsonObject toJson() const;
+    static QuantileHistogram fromJson(const QJsonObject &object);
+
+    static int indexFor(quint64 value);
+    static quint64 lowerBound(int index);
+    static quint64 upperBound(int index);
+
+private:
+    QVector<quint64> m_counts;
+    quint64 m_count = 0;
+    quint64 m_min = 0;
+    quint64 m_max = 0;
+};
+
+#endif // QUANTILEHISTOGRAM_H
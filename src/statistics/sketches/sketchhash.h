@@ -0,0 +1,26 @@
+#ifndef SKETCHHASH_H
+#define SKETCHHASH_H
+
+#include <QHash>
+#include <QStringView>
+#include <QtGlobal>
+
+namespace SketchHash {
+
+// splitmix64 finalizer; interned ids are sequential, so they need mixing.
+inline quint64 mix(quint64 value)
+{
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+inline quint64 of(QStringView value)
+{
+    return mix(quint64(qHash(value, 0x5F3759DF)));
+}
+
+}
+
+#endif // SKETCHHASH_H
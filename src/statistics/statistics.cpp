@@ -10,15 +10,53 @@
 #include <QDebug>
 
 #include "../appsettings.h"
+#include "sessionwarehouse.h"
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <QString>
 
 namespace {
-QString connectionKey(const QPair<QString, QString> &connection)
+constexpr quint64 kConnectionIdMask = 0xFFFFFFFFULL;
+// Lowest fan-in/fan-out any flood or scan heuristic reacts to; hosts below
+// it only reach the detector as heavy hitters.
+constexpr int kMinDetectorFanCount = 8;
+constexpr quint8 kTcpFin = 0x01;
+constexpr quint8 kTcpSyn = 0x02;
+constexpr quint8 kTcpRst = 0x04;
+constexpr quint8 kTcpAck = 0x10;
+// Not *.json, so session listings skip it.
+const char kSeasonalBaselinesFile[] = "seasonal.baselines";
+// Start of a session file, up to its first second.
+const char kFileHeader[] = "{\"perSecond\":[";
+const QString kUnknownString;
+// Beacon periods are seconds to minutes, so scoring conversations every
+// few seconds loses nothing.
+constexpr int kBeaconScoreSeconds = 10;
+
+AnomalyDetector::Quantiles quantilesOf(const QuantileHistogram &histogram)
+{
+    AnomalyDetector::Quantiles quantiles;
+    quantiles.samples = histogram.count();
+    quantiles.p50 = double(histogram.quantile(0.5));
+    quantiles.p90 = double(histogram.quantile(0.9));
+    quantiles.p99 = double(histogram.quantile(0.99));
+    return quantiles;
+}
+
+QJsonArray quantilesToJson(const AnomalyDetector::Quantiles &quantiles)
 {
-    return connection.first + QLatin1Char('|') + connection.second;
+    return {quantiles.p50, quantiles.p90, quantiles.p99};
+}
+
+// The lower of the two ports is taken as the service; 0 without ports.
+quint16 servicePort(const Statistics::PacketDetail &detail)
+{
+    if (detail.srcPort == 0 || detail.dstPort == 0) {
+        return std::max(detail.srcPort, detail.dstPort);
+    }
+    return std::min(detail.srcPort, detail.dstPort);
 }
 }
 
@@ -26,6 +64,8 @@ Statistics::Statistics(const QDateTime &sessionStart, QObject *parent)
     : QObject(parent),
       m_sessionStart(sessionStart),
       m_sessionEnd(sessionStart),
+      m_ring(kRingSeconds),
+      m_bursts(kBurstWindowMs / kDefaultBurstBucketMs),
       m_anomalyDetector(std::make_unique<AnomalyDetector>())
 {
     connect(m_anomalyDetector.get(), &AnomalyDetector::anomalyDetected,
@@ -42,7 +82,8 @@ void Statistics::recordPacket(const QDateTime &timestamp,
                               const QString &src,
                               const QString &dst,
                               quint64 packetSize,
-                              int packetRow)
+                              int packetRow,
+                              const PacketDetail &detail)
 {
     const int sec = static_cast<int>(m_sessionStart.secsTo(timestamp));
     if (sec < 0) {
@@ -56,24 +97,554 @@ void Statistics::recordPacket(const QDateTime &timestamp,
     if (m_activeSecond == -1) {
         m_activeSecond = sec;
     } else if (sec > m_activeSecond) {
+        // Close the top-talkers window first so the second's totals carry it.
+        m_topTalkers.advanceTo(sec);
         finalizeSecond(m_activeSecond);
         m_activeSecond = sec;
     }
 
-    statsProtocolPerSecond[sec][protocol] += 1;
-    statsConnectionsPerSecond[sec].insert(qMakePair(src, dst));
-    statsBytesPerSecond[sec] += packetSize;
-    statsPacketsPerSecond[sec] += 1;
-    statsSourcePacketsPerSecond[sec][src] += 1;
-    statsDestinationPacketsPerSecond[sec][dst] += 1;
-    statsSourceFanOutPerSecond[sec][src].insert(dst);
-    statsDestinationFanInPerSecond[sec][dst].insert(src);
+    const quint64 connection = (quint64(intern(src, sec)) << 32) | intern(dst, sec);
+    const qint64 elapsedMs = m_sessionStart.msecsTo(timestamp);
+    const qint64 elapsedUs = elapsedMs * 1000 + detail.microseconds;
+    const BurstSlot *burst = recordBurst(elapsedMs, packetSize);
+    m_topTalkers.add(sec, protocol, src, dst, detail.dstPort, packetSize);
+    const quint16 service = servicePort(detail);
+    m_beacons.add(quint32(connection >> 32), quint32(connection & kConnectionIdMask),
+                  service, elapsedMs, packetRow);
+    if (detail.dns.valid) {
+        // The client is whoever asked.
+        const quint32 client = detail.dns.response ? quint32(connection & kConnectionIdMask)
+                                                   : quint32(connection >> 32);
+        m_dns.add(sec, client, detail.dns, packetRow);
+    }
+    const qint64 rttUs = handshakeRtt(connection, detail, elapsedUs);
+    SecondSlot *slot = slotFor(sec);
+    recordDistributions(slot, protocol, packetSize, elapsedUs, rttUs);
+    if (!slot) {
+        // Straggler for a second that has already been compacted.
+        recordLatePacket(sec, protocol, connection, packetSize);
+        return;
+    }
+
+    slot->protocolCounts[protocol] += 1;
+    const quint64 connectionHash = HyperLogLog::hash(connection);
+    slot->connectionSketch.add(connectionHash);
+    if (slot->connections.size() < kMaxTrackedConnections) {
+        slot->connections.insert(connection);
+    }
+    slot->bytes += packetSize;
+    slot->packets += 1;
+    slot->sourcePackets.add(src);
+    slot->destinationPackets.add(dst);
+    slot->sourceFanOut[src].add(HyperLogLog::hash(connection & kConnectionIdMask));
+    slot->destinationFanIn[dst].add(HyperLogLog::hash(connection >> 32));
+    slot->sourceCounts[quint32(connection >> 32)] += 1;
+    slot->destinationCounts[quint32(connection & kConnectionIdMask)] += 1;
+    if (service != 0) {
+        slot->serviceCounts[service] += 1;
+    }
+    recordTcpFlags(*slot, connection, detail);
+    if (burst) {
+        slot->peakBucketPackets = std::max(slot->peakBucketPackets, burst->packets);
+        slot->peakBucketBytes = std::max(slot->peakBucketBytes, burst->bytes);
+    }
 
     if (packetRow >= 0) {
-        statsPacketRowsPerSecond[sec].append(packetRow);
-        statsRowsBySourcePerSecond[sec][src].append(packetRow);
-        statsRowsByDestinationPerSecond[sec][dst].append(packetRow);
+        slot->packetRows.append(packetRow);
+        slot->rowsBySource[src].append(packetRow);
+        slot->rowsByDestination[dst].append(packetRow);
+        if (service != 0) {
+            slot->rowsByService[service].append(packetRow);
+        }
+    }
+}
+
+void Statistics::setBurstBucketMs(int bucketMs)
+{
+    bucketMs = qBound(1, bucketMs, 1000);
+    while (1000 % bucketMs != 0) {
+        --bucketMs;
+    }
+    m_burstBucketMs = bucketMs;
+    m_bursts = QVector<BurstSlot>(kBurstWindowMs / bucketMs);
+}
+
+int Statistics::burstBucketMs() const
+{
+    return m_burstBucketMs;
+}
+
+QVector<Statistics::BurstBucket> Statistics::recentBursts() const
+{
+    QVector<BurstSlot> live;
+    for (const BurstSlot &slot : m_bursts) {
+        if (slot.tick >= 0) {
+            live.append(slot);
+        }
+    }
+    std::sort(live.begin(), live.end(), [](const BurstSlot &a, const BurstSlot &b) {
+        return a.tick < b.tick;
+    });
+
+    QVector<BurstBucket> buckets;
+    buckets.reserve(live.size());
+    for (const BurstSlot &slot : std::as_const(live)) {
+        buckets.append({slot.tick * m_burstBucketMs, slot.packets, slot.bytes});
     }
+    return buckets;
+}
+
+void Statistics::setTopTalkers(int k, int windowSeconds)
+{
+    m_topTalkers.configure(k, windowSeconds);
+}
+
+const TopTalkers::Report &Statistics::topTalkers() const
+{
+    return m_topTalkers.report();
+}
+
+void Statistics::setAnomalyRulesPath(const QString &path)
+{
+    m_anomalyDetector->setRulesPath(path);
+}
+
+bool Statistics::loadSeasonalBaselines(const QString &path)
+{
+    m_seasonalBaselinesPath = path;
+    return m_anomalyDetector->loadSeasonalBaselines(path);
+}
+
+void Statistics::setIncidentCooldown(int seconds)
+{
+    m_incidents.setCooldownSeconds(seconds);
+}
+
+qint64 Statistics::handshakeRtt(quint64 connection, const PacketDetail &detail, qint64 elapsedUs)
+{
+    const quint8 flags = detail.tcpFlags & (kTcpSyn | kTcpAck);
+    if (flags == kTcpSyn) {
+        const HandshakeKey key(connection, (quint32(detail.srcPort) << 16) | detail.dstPort);
+        auto it = m_pendingHandshakes.find(key);
+        if (it != m_pendingHandshakes.end()) {
+            // Which SYN the answer belongs to is ambiguous; skip the sample.
+            it->retransmitted = true;
+        } else {
+            if (m_pendingHandshakes.size() >= kMaxPendingHandshakes) {
+                pruneHandshakes(elapsedUs);
+            }
+            if (m_pendingHandshakes.size() < kMaxPendingHandshakes) {
+                m_pendingHandshakes.insert(key, {elapsedUs, false});
+            }
+        }
+        return -1;
+    }
+    if (flags != (kTcpSyn | kTcpAck)) {
+        return -1;
+    }
+
+    const quint64 reversed = (connection << 32) | (connection >> 32);
+    auto it = m_pendingHandshakes.find(
+        HandshakeKey(reversed, (quint32(detail.dstPort) << 16) | detail.srcPort));
+    if (it == m_pendingHandshakes.end()) {
+        return -1;
+    }
+    const PendingHandshake pending = it.value();
+    m_pendingHandshakes.erase(it);
+    if (pending.retransmitted || elapsedUs < pending.synUs) {
+        return -1;
+    }
+    return elapsedUs - pending.synUs;
+}
+
+void Statistics::pruneHandshakes(qint64 elapsedUs)
+{
+    for (auto it = m_pendingHandshakes.begin(); it != m_pendingHandshakes.end();) {
+        if (elapsedUs - it->synUs > kHandshakeTimeoutUs) {
+            it = m_pendingHandshakes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Statistics::recordTcpFlags(SecondSlot &slot, quint64 connection, const PacketDetail &detail)
+{
+    if (detail.tcpFlags == 0) {
+        return;
+    }
+
+    TcpFlagDetectors::Features &tcp = slot.tcp;
+    tcp.segments += 1;
+    // Hosts past the cap still count towards the totals.
+    auto host = [&slot](quint32 id) -> TcpHostCounts * {
+        auto it = slot.tcpHosts.find(id);
+        if (it == slot.tcpHosts.end()) {
+            if (slot.tcpHosts.size() >= kMaxTcpHosts) {
+                return nullptr;
+            }
+            it = slot.tcpHosts.insert(id, TcpHostCounts());
+        }
+        return &it.value();
+    };
+    const quint32 src = quint32(connection >> 32);
+    const quint32 dst = quint32(connection & kConnectionIdMask);
+
+    const quint8 handshake = detail.tcpFlags & (kTcpSyn | kTcpAck);
+    if (handshake == kTcpSyn) {
+        tcp.syn += 1;
+        if (TcpHostCounts *sender = host(src)) {
+            sender->syn += 1;
+            if (sender->probes.size() < kMaxProbesPerHost) {
+                sender->probes.insert((quint64(dst) << 16) | detail.dstPort);
+            }
+        }
+        if (TcpHostCounts *target = host(dst)) {
+            target->synReceived += 1;
+        }
+    } else if (handshake == (kTcpSyn | kTcpAck)) {
+        tcp.synAck += 1;
+        if (TcpHostCounts *sender = host(src)) {
+            sender->synAckSent += 1;
+        }
+        if (TcpHostCounts *client = host(dst)) {
+            client->synAckReceived += 1;
+        }
+    }
+    if (detail.tcpFlags & kTcpRst) {
+        tcp.rst += 1;
+        if (TcpHostCounts *sender = host(src)) {
+            sender->rst += 1;
+        }
+    }
+    if (detail.tcpFlags & kTcpFin) {
+        tcp.fin += 1;
+    }
+}
+
+void Statistics::recordDistributions(SecondSlot *slot,
+                                     const QString &protocol,
+                                     quint64 packetSize,
+                                     qint64 elapsedUs,
+                                     qint64 rttUs)
+{
+    // Gaps are measured against the newest packet so far; reordered
+    // packets add no sample.
+    auto gapSince = [elapsedUs](qint64 &last) {
+        const qint64 gap = last >= 0 && elapsedUs >= last ? elapsedUs - last : -1;
+        last = std::max(last, elapsedUs);
+        return gap;
+    };
+    const qint64 gapUs = gapSince(m_lastArrivalUs);
+    auto lastIt = m_lastProtocolArrivalUs.find(protocol);
+    if (lastIt == m_lastProtocolArrivalUs.end()) {
+        lastIt = m_lastProtocolArrivalUs.insert(protocol, -1);
+    }
+    const qint64 protocolGapUs = gapSince(lastIt.value());
+
+    auto add = [packetSize, rttUs](Distributions &distributions, qint64 gap) {
+        distributions.size.add(packetSize);
+        if (gap >= 0) {
+            distributions.interArrival.add(quint64(gap));
+        }
+        if (rttUs >= 0) {
+            distributions.handshakeRtt.add(quint64(rttUs));
+        }
+    };
+    add(m_sessionDistributions, gapUs);
+    add(m_sessionProtocolDistributions[protocol], protocolGapUs);
+    if (slot) {
+        add(slot->distributions, gapUs);
+        add(slot->protocolDistributions[protocol], protocolGapUs);
+    }
+}
+
+const Statistics::BurstSlot *Statistics::recordBurst(qint64 elapsedMs, quint64 packetSize)
+{
+    const qint64 tick = elapsedMs / m_burstBucketMs;
+    BurstSlot &slot = m_bursts[int(tick % m_bursts.size())];
+    if (slot.tick > tick) {
+        // Older than the window; the slot already belongs to a newer bucket.
+        return nullptr;
+    }
+    if (slot.tick != tick) {
+        slot = BurstSlot();
+        slot.tick = tick;
+    }
+    slot.packets += 1;
+    slot.bytes += packetSize;
+    return &slot;
+}
+
+Statistics::SecondSlot *Statistics::slotFor(int second)
+{
+    if (second < m_ringBase) {
+        return nullptr;
+    }
+
+    if (second >= m_ringBase + kRingSeconds) {
+        const int newBase = second - kRingSeconds + 1;
+        const int last = std::min(newBase, m_ringBase + kRingSeconds);
+        for (int s = m_ringBase; s < last; ++s) {
+            SecondSlot &old = m_ring[s % kRingSeconds];
+            if (old.second == s) {
+                compactSlot(old);
+            }
+        }
+        m_ringBase = newBase;
+    }
+
+    SecondSlot &slot = m_ring[second % kRingSeconds];
+    if (slot.second != second) {
+        slot = SecondSlot();
+        slot.second = second;
+    }
+    return &slot;
+}
+
+Statistics::SecondSummary Statistics::summarize(const SecondSlot &slot)
+{
+    SecondSummary summary;
+    summary.second = slot.second;
+    summary.packets = slot.packets;
+    summary.bytes = slot.bytes;
+    summary.protocolCounts.reserve(slot.protocolCounts.size());
+    for (auto it = slot.protocolCounts.constBegin(); it != slot.protocolCounts.constEnd(); ++it) {
+        summary.protocolCounts.append(qMakePair(intern(it.key(), slot.second), quint32(it.value())));
+    }
+    summary.connections = QVector<quint64>(slot.connections.cbegin(), slot.connections.cend());
+    std::sort(summary.connections.begin(), summary.connections.end());
+    summary.uniqueConnections = quint32(std::max(slot.connectionSketch.count(),
+                                                 int(slot.connections.size())));
+    summary.peakBucketPackets = slot.peakBucketPackets;
+    summary.peakBucketBytes = slot.peakBucketBytes;
+
+    auto summarizeDistributions = [](quint32 protocol, const Distributions &distributions) {
+        DistributionSummary entry;
+        entry.protocol = protocol;
+        entry.size = quantilesOf(distributions.size);
+        entry.interArrival = quantilesOf(distributions.interArrival);
+        entry.handshakeRtt = quantilesOf(distributions.handshakeRtt);
+        return entry;
+    };
+    summary.distributions.reserve(slot.protocolDistributions.size() + 1);
+    summary.distributions.append(summarizeDistributions(kAllProtocols, slot.distributions));
+    for (auto it = slot.protocolDistributions.constBegin(); it != slot.protocolDistributions.constEnd(); ++it) {
+        summary.distributions.append(summarizeDistributions(intern(it.key(), slot.second), it.value()));
+    }
+    return summary;
+}
+
+void Statistics::compactSlot(SecondSlot &slot)
+{
+    // Seconds leave the ring oldest first, so appending keeps the list sorted.
+    m_summaries.append(summarize(slot));
+    addToRollup(m_rollup, m_summaries.last());
+    m_warehouseDirtySecond = std::min(m_warehouseDirtySecond, slot.second);
+    slot = SecondSlot();
+}
+
+void Statistics::addToRollup(StatisticsRollup &rollup, const SecondSummary &summary) const
+{
+    QMap<QString, double> protocols;
+    for (const auto &entry : summary.protocolCounts) {
+        protocols.insert(internedString(entry.first), double(entry.second));
+    }
+    QStringList connections;
+    connections.reserve(summary.connections.size());
+    for (quint64 connection : summary.connections) {
+        connections.append(internedString(quint32(connection >> 32)) + QStringLiteral(" -> ")
+                           + internedString(quint32(connection & kConnectionIdMask)));
+    }
+    rollup.addSecond(summary.second, summary.packets, summary.bytes, protocols, connections);
+}
+
+Statistics::SecondSummary &Statistics::summaryFor(int second)
+{
+    auto it = std::lower_bound(m_summaries.begin(), m_summaries.end(), second,
+                               [](const SecondSummary &summary, int value) {
+                                   return summary.second < value;
+                               });
+    if (it == m_summaries.end() || it->second != second) {
+        SecondSummary summary;
+        summary.second = second;
+        it = m_summaries.insert(it, summary);
+    }
+    return *it;
+}
+
+void Statistics::recordLatePacket(int second, const QString &protocol, quint64 connection, quint64 packetSize)
+{
+    if (second <= m_persistedSecond) {
+        // Already written and dropped from memory.
+        return;
+    }
+    SecondSummary &summary = summaryFor(second);
+    m_warehouseDirtySecond = std::min(m_warehouseDirtySecond, second);
+    summary.packets += 1;
+    summary.bytes += packetSize;
+    m_rollup.addLate(second, 1, packetSize, protocol);
+
+    const quint32 protocolId = intern(protocol, second);
+    auto protoIt = std::find_if(summary.protocolCounts.begin(), summary.protocolCounts.end(),
+                                [protocolId](const QPair<quint32, quint32> &entry) {
+                                    return entry.first == protocolId;
+                                });
+    if (protoIt != summary.protocolCounts.end()) {
+        protoIt->second += 1;
+    } else {
+        summary.protocolCounts.append(qMakePair(protocolId, quint32(1)));
+    }
+
+    auto connIt = std::lower_bound(summary.connections.begin(), summary.connections.end(), connection);
+    if (connIt == summary.connections.end() || *connIt != connection) {
+        summary.connections.insert(connIt, connection);
+        summary.uniqueConnections = std::max(summary.uniqueConnections + 1,
+                                             quint32(summary.connections.size()));
+    }
+}
+
+quint32 Statistics::intern(const QString &value, int second)
+{
+    auto it = m_stringIds.find(value);
+    if (it != m_stringIds.end()) {
+        it->lastSecond = std::max(it->lastSecond, second);
+        return it->id;
+    }
+    const quint32 id = m_nextStringId++;
+    m_strings.insert(id, value);
+    m_stringIds.insert(value, InternedString{id, second});
+    return id;
+}
+
+const QString &Statistics::internedString(quint32 id) const
+{
+    const auto it = m_strings.constFind(id);
+    return it != m_strings.constEnd() ? it.value() : kUnknownString;
+}
+
+void Statistics::pruneStrings(int second)
+{
+    // Summaries not written yet still name the strings of their seconds.
+    int horizon = std::min(second - kStringIdleSeconds, m_ringBase);
+    if (!m_summaries.isEmpty()) {
+        horizon = std::min(horizon, m_summaries.first().second);
+    }
+    for (auto it = m_stringIds.begin(); it != m_stringIds.end();) {
+        if (it->lastSecond < horizon) {
+            m_strings.remove(it->id);
+            it = m_stringIds.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QJsonObject Statistics::secondToJson(const SecondSummary &summary) const
+{
+    QJsonObject secondObj;
+    secondObj.insert("second", summary.second);
+
+    QJsonObject protoCountsObj;
+    for (const auto &entry : summary.protocolCounts) {
+        protoCountsObj.insert(internedString(entry.first), int(entry.second));
+    }
+    secondObj.insert("protocolCounts", protoCountsObj);
+
+    QJsonArray connArray;
+    for (quint64 connection : summary.connections) {
+        QJsonObject c;
+        c.insert("src", internedString(quint32(connection >> 32)));
+        c.insert("dst", internedString(quint32(connection & kConnectionIdMask)));
+        connArray.append(c);
+    }
+    secondObj.insert("connections", connArray);
+    secondObj.insert("uniqueConnections", static_cast<double>(summary.uniqueConnections));
+    if (summary.uniqueConnections > quint32(summary.connections.size())) {
+        secondObj.insert("connectionsTruncated", true);
+    }
+
+    const double avgPacketSize = summary.packets > 0
+        ? static_cast<double>(summary.bytes) / static_cast<double>(summary.packets)
+        : 0.0;
+    secondObj.insert("avgPacketSize", avgPacketSize);
+    secondObj.insert("pps", static_cast<double>(summary.packets));
+    secondObj.insert("bps", static_cast<double>(summary.bytes));
+    secondObj.insert("peakBucketPackets", static_cast<double>(summary.peakBucketPackets));
+    secondObj.insert("peakBucketBytes", static_cast<double>(summary.peakBucketBytes));
+
+    // p50/p90/p99 per metric; metrics without samples are left out.
+    auto quantilesObject = [](const DistributionSummary &entry) {
+        QJsonObject object;
+        if (entry.size.samples > 0) {
+            object.insert("size", quantilesToJson(entry.size));
+        }
+        if (entry.interArrival.samples > 0) {
+            object.insert("interArrivalUs", quantilesToJson(entry.interArrival));
+        }
+        if (entry.handshakeRtt.samples > 0) {
+            object.insert("handshakeRttUs", quantilesToJson(entry.handshakeRtt));
+        }
+        return object;
+    };
+    QJsonObject quantiles;
+    QJsonObject protocolQuantiles;
+    for (const DistributionSummary &entry : summary.distributions) {
+        if (entry.protocol == kAllProtocols) {
+            const QJsonObject all = quantilesObject(entry);
+            for (auto it = all.constBegin(); it != all.constEnd(); ++it) {
+                quantiles.insert(it.key(), it.value());
+            }
+        } else {
+            protocolQuantiles.insert(internedString(entry.protocol), quantilesObject(entry));
+        }
+    }
+    if (!quantiles.isEmpty()) {
+        quantiles.insert("protocols", protocolQuantiles);
+        secondObj.insert("quantiles", quantiles);
+    }
+    return secondObj;
+}
+
+QJsonObject Statistics::burstsToJson() const
+{
+    QJsonArray starts;
+    QJsonArray packets;
+    QJsonArray bytes;
+    for (const BurstBucket &bucket : recentBursts()) {
+        starts.append(static_cast<double>(bucket.startMs));
+        packets.append(static_cast<double>(bucket.packets));
+        bytes.append(static_cast<double>(bucket.bytes));
+    }
+
+    QJsonObject bursts;
+    bursts.insert("bucketMs", m_burstBucketMs);
+    bursts.insert("startMs", starts);
+    bursts.insert("packets", packets);
+    bursts.insert("bytes", bytes);
+    return bursts;
+}
+
+QJsonObject Statistics::distributionsToJson() const
+{
+    auto histograms = [](const Distributions &distributions) {
+        QJsonObject object;
+        object.insert("size", distributions.size.toJson());
+        object.insert("interArrivalUs", distributions.interArrival.toJson());
+        object.insert("handshakeRttUs", distributions.handshakeRtt.toJson());
+        return object;
+    };
+
+    QJsonObject protocols;
+    for (auto it = m_sessionProtocolDistributions.constBegin();
+         it != m_sessionProtocolDistributions.constEnd(); ++it) {
+        protocols.insert(it.key(), histograms(it.value()));
+    }
+
+    QJsonObject distributions;
+    distributions.insert("all", histograms(m_sessionDistributions));
+    distributions.insert("protocols", protocols);
+    return distributions;
 }
 
 bool Statistics::SaveStatsToJson(const QString &dirPath, bool finalizePending)
@@ -82,7 +653,9 @@ bool Statistics::SaveStatsToJson(const QString &dirPath, bool finalizePending)
         finalizePendingSecond();
     }
 
-    if (statsProtocolPerSecond.isEmpty()) {
+    const bool ringEmpty = std::none_of(m_ring.cbegin(), m_ring.cend(),
+                                        [](const SecondSlot &slot) { return slot.second >= 0; });
+    if (m_summaries.isEmpty() && ringEmpty && m_lastFilePath.isEmpty()) {
         return true;
     }
 
@@ -97,79 +670,126 @@ bool Statistics::SaveStatsToJson(const QString &dirPath, bool finalizePending)
     endStr.replace(":", "-");
     const QString filePath = QDir(dirPath).filePath(startStr + "-" + endStr + ".json");
 
+    // The file is named after the session's end, so it moves as the session
+    // grows; the seconds already in it stay where they are.
     const QString previousFile = m_lastFilePath;
-
-    QJsonObject sessionObj;
-    sessionObj.insert("sessionStart", m_sessionStart.toString(Qt::ISODate));
-    sessionObj.insert("sessionEnd",   m_sessionEnd.toString(Qt::ISODate));
-
-    QJsonArray perSecondArray;
-    QList<int> seconds = statsProtocolPerSecond.keys();
-    std::sort(seconds.begin(), seconds.end());
-    for (int sec : seconds) {
-        QJsonObject secondObj;
-        secondObj.insert("second", sec);
-
-        QJsonObject protoCountsObj;
-        const auto protoCounts = statsProtocolPerSecond.value(sec);
-        for (auto it = protoCounts.constBegin(); it != protoCounts.constEnd(); ++it) {
-            protoCountsObj.insert(it.key(), it.value());
+    if (!previousFile.isEmpty() && previousFile != filePath && QFile::exists(previousFile)) {
+        QFile::remove(filePath);
+        if (!QFile::rename(previousFile, filePath)) {
+            qWarning() << "Failed to move statistics file" << previousFile << "to" << filePath;
+            return false;
         }
-        secondObj.insert("protocolCounts", protoCountsObj);
-
-        QJsonArray connArray;
-        const auto connections = statsConnectionsPerSecond.value(sec);
-        for (const auto &p : connections) {
-            QJsonObject c;
-            c.insert("src", p.first);
-            c.insert("dst", p.second);
-            connArray.append(c);
-        }
-        secondObj.insert("connections", connArray);
-
-        const quint64 packets = statsPacketsPerSecond.value(sec, 0ULL);
-        const quint64 bytes   = statsBytesPerSecond.value(sec, 0ULL);
-        const double avgPacketSize = packets > 0
-            ? static_cast<double>(bytes) / static_cast<double>(packets)
-            : 0.0;
-        secondObj.insert("avgPacketSize", avgPacketSize);
-        secondObj.insert("pps", static_cast<double>(packets));
-        secondObj.insert("bps", static_cast<double>(bytes));
-
-        perSecondArray.append(secondObj);
+        QFile::remove(StatisticsRollup::sidecarPath(previousFile));
     }
-    sessionObj.insert("perSecond", perSecondArray);
+    m_lastFilePath = filePath;
 
-    QJsonDocument newDoc(sessionObj);
     QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    if (!file.open(QIODevice::ReadWrite)) {
         qWarning() << "Unable to open statistics file for writing" << filePath;
         return false;
     }
+    if (file.size() < m_fileSecondsEnd) {
+        qWarning() << "Statistics file was truncated, starting it again" << filePath;
+        m_fileSecondsEnd = 0;
+    }
 
-    const QByteArray payload = newDoc.toJson();
-    const qint64 written = file.write(payload);
-    if (written != payload.size()) {
-        qWarning() << "Short write while saving statistics" << filePath
-                   << "expected" << payload.size() << "bytes" << "wrote" << written;
-        file.close();
-        file.remove();
-        return false;
+    // perSecond comes first so compacted seconds can be appended in place;
+    // only the ring seconds and the fields after the array are rewritten.
+    QByteArray compacted = m_fileSecondsEnd == 0 ? QByteArray(kFileHeader) : QByteArray();
+    bool separator = m_fileSecondsEnd > qint64(sizeof(kFileHeader) - 1);
+    auto appendSecond = [&separator](QByteArray &out, const QJsonObject &second) {
+        out += separator ? ",\n" : "\n";
+        out += QJsonDocument(second).toJson(QJsonDocument::Compact);
+        separator = true;
+    };
+
+    StatisticsRollup rollup = m_rollup;
+    rollup.setSessionRange(m_sessionStart, m_sessionEnd);
+
+    // Seconds in memory: compacted ones not written yet, then the ring.
+    QJsonArray perSecondArray;
+    int maxSecond = std::max(0, m_persistedSecond);
+    for (const SecondSummary &summary : std::as_const(m_summaries)) {
+        const QJsonObject second = secondToJson(summary);
+        appendSecond(compacted, second);
+        perSecondArray.append(second);
+        maxSecond = std::max(maxSecond, summary.second);
+    }
+    QByteArray tail;
+    for (int sec = m_ringBase; sec < m_ringBase + kRingSeconds; ++sec) {
+        const SecondSlot &slot = m_ring.at(sec % kRingSeconds);
+        if (slot.second == sec) {
+            const SecondSummary summary = summarize(slot);
+            const QJsonObject second = secondToJson(summary);
+            appendSecond(tail, second);
+            perSecondArray.append(second);
+            addToRollup(rollup, summary);
+            maxSecond = std::max(maxSecond, sec);
+        }
     }
 
-    if (!file.flush()) {
-        qWarning() << "Failed to flush statistics file" << filePath;
-        file.close();
-        file.remove();
+    QJsonObject sessionObj;
+    sessionObj.insert("sessionStart", m_sessionStart.toString(Qt::ISODate));
+    sessionObj.insert("sessionEnd",   m_sessionEnd.toString(Qt::ISODate));
+    sessionObj.insert("bursts", burstsToJson());
+    sessionObj.insert("distributions", distributionsToJson());
+    sessionObj.insert("uniqueConnections", static_cast<double>(m_sessionConnections.count()));
+    // The remaining fields, closing brace included.
+    tail += "\n],";
+    tail += QJsonDocument(sessionObj).toJson(QJsonDocument::Compact).mid(1);
+    tail += '\n';
+
+    if (!file.seek(m_fileSecondsEnd) || file.write(compacted) != compacted.size()) {
+        qWarning() << "Short write while saving statistics" << filePath;
+        return false;
+    }
+    const qint64 secondsEnd = file.pos();
+    if (file.write(tail) != tail.size() || !file.resize(file.pos()) || !file.flush()) {
+        qWarning() << "Failed to write statistics file" << filePath;
         return false;
     }
 
+    // Written after the statistics file so a fresh sidecar is never older.
+    if (!rollup.save(StatisticsRollup::sidecarPath(filePath))) {
+        qWarning() << "Failed to write statistics rollup for" << filePath;
+    }
+
+    // Ring seconds may still change, so they are rewritten on every save.
+    if (!m_warehouse || m_warehouse->sessionsDirectory() != dirPath) {
+        m_warehouse = std::make_unique<SessionWarehouse>(dirPath);
+        m_warehouseDirtySecond = 0;
+        m_warehousePath.clear();
+    }
+    const int fromSecond = std::min(m_warehouseDirtySecond, m_ringBase);
+    QJsonObject warehouseObj = sessionObj;
+    if (fromSecond <= m_persistedSecond) {
+        // The warehouse missed seconds that are only on disk by now.
+        file.seek(0);
+        warehouseObj = QJsonDocument::fromJson(file.readAll()).object();
+    } else {
+        warehouseObj.insert("perSecond", perSecondArray);
+    }
     file.close();
 
-    if (!previousFile.isEmpty() && previousFile != filePath) {
-        QFile::remove(previousFile);
+    m_fileSecondsEnd = secondsEnd;
+    if (!m_summaries.isEmpty()) {
+        m_persistedSecond = std::max(m_persistedSecond, m_summaries.last().second);
+        m_summaries.clear();
+    }
+
+    if (m_warehouse->ingest(filePath, warehouseObj, m_warehousePath, fromSecond,
+                            &m_incidents.incidents(), maxSecond)) {
+        m_warehouseDirtySecond = std::numeric_limits<int>::max();
+        m_warehousePath = filePath;
+    } else {
+        qWarning() << "Failed to index statistics in the session warehouse" << filePath;
+    }
+    // The profile changes little within a time slot; a final save keeps the
+    // tail of the session.
+    if (!m_seasonalBaselinesPath.isEmpty()
+        && !m_anomalyDetector->saveSeasonalBaselines(m_seasonalBaselinesPath, finalizePending)) {
+        qWarning() << "Failed to write seasonal baselines to" << m_seasonalBaselinesPath;
     }
-    m_lastFilePath = filePath;
     return true;
 }
 
@@ -185,7 +805,12 @@ void Statistics::finalizePendingData()
 
 const QVector<AnomalyDetector::Event> &Statistics::anomalies() const
 {
-    return m_anomalies;
+    return m_incidents.incidents();
+}
+
+QString Statistics::seasonalBaselinesPath(const QString &sessionsDir)
+{
+    return QDir(sessionsDir).filePath(QLatin1String(kSeasonalBaselinesFile));
 }
 
 QString Statistics::defaultSessionsDir()
@@ -206,28 +831,30 @@ void Statistics::finalizeSecond(int second)
         return;
     }
 
-    const auto protoCounts = statsProtocolPerSecond.value(second);
-    const auto connections = statsConnectionsPerSecond.value(second);
-    const quint64 packets = statsPacketsPerSecond.value(second, 0ULL);
-    const quint64 bytes = statsBytesPerSecond.value(second, 0ULL);
-    const auto sourceCounts = statsSourcePacketsPerSecond.value(second);
-    const auto destinationCounts = statsDestinationPacketsPerSecond.value(second);
-    const auto fanOutMap = statsSourceFanOutPerSecond.value(second);
-    const auto fanInMap = statsDestinationFanInPerSecond.value(second);
-    const auto packetRows = statsPacketRowsPerSecond.value(second);
-    const auto rowsBySource = statsRowsBySourcePerSecond.value(second);
-    const auto rowsByDestination = statsRowsByDestinationPerSecond.value(second);
+    static const SecondSlot emptySlot;
+    const SecondSlot &slot = second >= m_ringBase && m_ring.at(second % kRingSeconds).second == second
+        ? m_ring.at(second % kRingSeconds)
+        : emptySlot;
+    const auto &protoCounts = slot.protocolCounts;
+    const auto &connections = slot.connections;
+    const quint64 packets = slot.packets;
+    const quint64 bytes = slot.bytes;
     const double avgPacketSize = packets > 0
         ? static_cast<double>(bytes) / static_cast<double>(packets)
         : 0.0;
 
+    const int uniqueConnections = std::max(slot.connectionSketch.count(),
+                                           int(connections.size()));
     int newConnections = 0;
-    for (const auto &conn : connections) {
-        const QString key = connectionKey(conn);
-        if (!m_recentConnectionUsage.contains(key)) {
+    for (quint64 conn : connections) {
+        if (!m_recentConnectionUsage.contains(conn)) {
             ++newConnections;
         }
     }
+    if (uniqueConnections > connections.size() && !connections.isEmpty()) {
+        // Only the first pairs are tracked exactly; scale their novelty rate.
+        newConnections = qRound(double(newConnections) * uniqueConnections / connections.size());
+    }
 
     QStringList newProtocols;
     for (auto it = protoCounts.constBegin(); it != protoCounts.constEnd(); ++it) {
@@ -249,64 +876,172 @@ void Statistics::finalizeSecond(int second)
 
     AnomalyDetector::FeatureSnapshot snapshot;
     snapshot.second = second;
+    const QDateTime local = m_sessionStart.addSecs(second).toLocalTime();
+    snapshot.secondOfWeek = (local.date().dayOfWeek() - 1) * 86400 + local.time().msecsSinceStartOfDay() / 1000;
     snapshot.packets = static_cast<double>(packets);
     snapshot.bytes = static_cast<double>(bytes);
     snapshot.avgPacketSize = avgPacketSize;
-    snapshot.uniqueConnections = connections.size();
+    snapshot.uniqueConnections = uniqueConnections;
     snapshot.newConnections = newConnections;
     snapshot.protocolEntropy = entropy;
     snapshot.protocolCount = protoCounts.size();
     snapshot.newProtocols = newProtocols;
     snapshot.protocolCounts = protoCounts;
-    snapshot.sourcePackets = sourceCounts;
-    snapshot.destinationPackets = destinationCounts;
+    snapshot.packetSize = quantilesOf(slot.distributions.size);
+    snapshot.interArrivalUs = quantilesOf(slot.distributions.interArrival);
+    snapshot.handshakeRttUs = quantilesOf(slot.distributions.handshakeRtt);
 
-    QMap<QString, int> fanOutCounts;
-    for (auto it = fanOutMap.constBegin(); it != fanOutMap.constEnd(); ++it) {
-        fanOutCounts.insert(it.key(), it.value().size());
+    // The detector sees the heavy hitters plus every host wide enough to
+    // trip a fan-in/fan-out heuristic, with sketch estimates for the rest.
+    for (const HeavyHitters::Item &item : slot.sourcePackets.top(-1)) {
+        snapshot.sourcePackets.insert(item.key, int(item.count));
+    }
+    for (auto it = slot.sourceFanOut.constBegin(); it != slot.sourceFanOut.constEnd(); ++it) {
+        const int fanOut = it.value().count();
+        if (fanOut < kMinDetectorFanCount) {
+            continue;
+        }
+        snapshot.sourceFanOut.insert(it.key(), fanOut);
+        if (!snapshot.sourcePackets.contains(it.key())) {
+            snapshot.sourcePackets.insert(it.key(), int(slot.sourcePackets.estimate(it.key())));
+        }
     }
-    snapshot.sourceFanOut = fanOutCounts;
 
-    QMap<QString, int> fanInCounts;
-    for (auto it = fanInMap.constBegin(); it != fanInMap.constEnd(); ++it) {
-        fanInCounts.insert(it.key(), it.value().size());
+    for (const HeavyHitters::Item &item : slot.destinationPackets.top(-1)) {
+        snapshot.destinationPackets.insert(item.key, int(item.count));
+    }
+    for (auto it = slot.destinationFanIn.constBegin(); it != slot.destinationFanIn.constEnd(); ++it) {
+        const int fanIn = it.value().count();
+        if (fanIn < kMinDetectorFanCount) {
+            continue;
+        }
+        snapshot.destinationFanIn.insert(it.key(), fanIn);
+        if (!snapshot.destinationPackets.contains(it.key())) {
+            snapshot.destinationPackets.insert(it.key(), int(slot.destinationPackets.estimate(it.key())));
+        }
     }
-    snapshot.destinationFanIn = fanInCounts;
 
-    snapshot.packetRows = packetRows;
-    snapshot.rowsBySource = rowsBySource;
-    snapshot.rowsByDestination = rowsByDestination;
+    snapshot.packetRows = slot.packetRows;
+    snapshot.rowsBySource = slot.rowsBySource;
+    snapshot.rowsByDestination = slot.rowsByDestination;
+    snapshot.rowsByService = slot.rowsByService;
+
+    auto hostCounts = [this](const QHash<quint32, quint32> &counts) {
+        AnomalyDetector::EntityCounts entities;
+        entities.keys.reserve(counts.size());
+        entities.packets.reserve(counts.size());
+        entities.names.reserve(counts.size());
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            entities.keys.append(it.key());
+            entities.packets.append(double(it.value()));
+            entities.names.append(internedString(it.key()));
+        }
+        return entities;
+    };
+    snapshot.sources = hostCounts(slot.sourceCounts);
+    snapshot.destinations = hostCounts(slot.destinationCounts);
+    snapshot.services.keys.reserve(slot.serviceCounts.size());
+    snapshot.services.packets.reserve(slot.serviceCounts.size());
+    for (auto it = slot.serviceCounts.constBegin(); it != slot.serviceCounts.constEnd(); ++it) {
+        snapshot.services.keys.append(it.key());
+        snapshot.services.packets.append(double(it.value()));
+        snapshot.services.names.append(QString::number(it.key()));
+    }
+
+    snapshot.tcp = slot.tcp;
+    snapshot.tcp.hosts.reserve(slot.tcpHosts.size());
+    for (auto it = slot.tcpHosts.constBegin(); it != slot.tcpHosts.constEnd(); ++it) {
+        const TcpHostCounts &counts = it.value();
+        TcpFlagDetectors::Host host;
+        host.key = it.key();
+        host.name = internedString(it.key());
+        host.syn = counts.syn;
+        host.synAckReceived = counts.synAckReceived;
+        host.synReceived = counts.synReceived;
+        host.synAckSent = counts.synAckSent;
+        host.rst = counts.rst;
+        // Many ports on one host is a vertical scan, one port on many hosts
+        // a horizontal one.
+        QHash<quint32, quint32> portsPerHost;
+        QHash<quint16, quint32> hostsPerPort;
+        for (quint64 probe : counts.probes) {
+            portsPerHost[quint32(probe >> 16)] += 1;
+            hostsPerPort[quint16(probe & 0xFFFF)] += 1;
+        }
+        for (auto probed = portsPerHost.constBegin(); probed != portsPerHost.constEnd(); ++probed) {
+            if (probed.value() > host.probedPorts) {
+                host.probedPorts = probed.value();
+                host.probedHost = internedString(probed.key());
+            }
+        }
+        for (auto probed = hostsPerPort.constBegin(); probed != hostsPerPort.constEnd(); ++probed) {
+            if (probed.value() > host.probedHosts) {
+                host.probedHosts = probed.value();
+                host.probedPort = probed.key();
+            }
+        }
+        snapshot.tcp.hosts.append(host);
+    }
+
+    if ((second + 1) % kBeaconScoreSeconds == 0) {
+        snapshot.beacons = m_beacons.score((second + 1) * 1000LL);
+        for (BeaconDetector::Finding &finding : snapshot.beacons) {
+            finding.initiatorName = internedString(finding.initiator);
+            finding.responderName = internedString(finding.responder);
+        }
+    }
+
+    snapshot.dns = m_dns.score(second);
+    for (DnsAnalytics::Finding &finding : snapshot.dns) {
+        finding.clientName = internedString(finding.client);
+    }
 
     m_anomalyDetector->observe(snapshot);
+    publishFinalUpdates(second, false);
+
+    SecondTotals totals;
+    totals.second = second;
+    totals.packets = packets;
+    totals.bytes = bytes;
+    totals.connections = uniqueConnections;
+    m_sessionConnections.merge(slot.connectionSketch);
+    totals.protocolCounts = protoCounts;
+    emit secondFinalized(totals);
 
-    m_recentHistorySeconds.enqueue(second);
-    for (const auto &conn : connections) {
-        const QString key = connectionKey(conn);
-        m_recentConnectionUsage[key] += 1;
+    HistoryEntry history;
+    history.connections = QVector<quint64>(connections.cbegin(), connections.cend());
+    history.protocols = protoCounts.keys();
+    for (quint64 conn : std::as_const(history.connections)) {
+        m_recentConnectionUsage[conn] += 1;
     }
-    for (auto it = protoCounts.constBegin(); it != protoCounts.constEnd(); ++it) {
-        m_recentProtocolUsage[it.key()] += 1;
+    for (const QString &protocol : std::as_const(history.protocols)) {
+        m_recentProtocolUsage[protocol] += 1;
     }
+    m_recentHistory.enqueue(std::move(history));
     pruneHistory();
+    if (second % kStringSweepSeconds == 0) {
+        pruneStrings(second);
+    }
 }
 
 void Statistics::finalizePendingSecond()
 {
     if (m_activeSecond >= 0) {
+        m_topTalkers.flush();
         finalizeSecond(m_activeSecond);
+        // Nothing may follow, so receivers get every incident's latest state.
+        publishFinalUpdates(m_activeSecond, true);
         m_activeSecond = -1;
     }
 }
 
 void Statistics::pruneHistory()
 {
-    while (m_recentHistorySeconds.size() > m_historyWindow) {
-        const int oldSecond = m_recentHistorySeconds.dequeue();
+    while (m_recentHistory.size() > m_historyWindow) {
+        const HistoryEntry old = m_recentHistory.dequeue();
 
-        const auto oldConnections = statsConnectionsPerSecond.value(oldSecond);
-        for (const auto &conn : oldConnections) {
-            const QString key = connectionKey(conn);
-            auto it = m_recentConnectionUsage.find(key);
+        for (quint64 conn : old.connections) {
+            auto it = m_recentConnectionUsage.find(conn);
             if (it != m_recentConnectionUsage.end()) {
                 if (--(it.value()) <= 0) {
                     m_recentConnectionUsage.erase(it);
@@ -314,9 +1049,8 @@ void Statistics::pruneHistory()
             }
         }
 
-        const auto oldProtoCounts = statsProtocolPerSecond.value(oldSecond);
-        for (auto it = oldProtoCounts.constBegin(); it != oldProtoCounts.constEnd(); ++it) {
-            auto usageIt = m_recentProtocolUsage.find(it.key());
+        for (const QString &protocol : old.protocols) {
+            auto usageIt = m_recentProtocolUsage.find(protocol);
             if (usageIt != m_recentProtocolUsage.end()) {
                 if (--(usageIt.value()) <= 0) {
                     m_recentProtocolUsage.erase(usageIt);
@@ -328,6 +1062,15 @@ void Statistics::pruneHistory()
 
 void Statistics::onAnomalyEvent(const AnomalyDetector::Event &event)
 {
-    m_anomalies.append(event);
-    emit anomalyDetected(event);
+    // Floods raise an event every second; publish the incident instead.
+    if (const AnomalyDetector::Event *incident = m_incidents.add(event)) {
+        emit anomalyDetected(*incident);
+    }
+}
+
+void Statistics::publishFinalUpdates(int second, bool flushOpen)
+{
+    for (const AnomalyDetector::Event &incident : m_incidents.takeFinalUpdates(second, flushOpen)) {
+        emit anomalyDetected(incident);
+    }
 }
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QDateTime>
 #include <QHash>
+#include <QJsonObject>
 #include <QMap>
 #include <QPair>
 #include <QQueue>
@@ -15,10 +16,46 @@
 
 #include "charts/ChartConfig.h"
 #include "anomalydetector.h"
+#include "beacondetector.h"
+#include "dnsanalytics.h"
+#include "incidentcoalescer.h"
+#include "rowrangeset.h"
+#include "sketches/heavyhitters.h"
+#include "sketches/hyperloglog.h"
+#include "sketches/quantilehistogram.h"
+#include "statisticsrollup.h"
+#include "toptalkers.h"
+
+class SessionWarehouse;
 
 class Statistics : public QObject {
     Q_OBJECT
 public:
+    struct SecondTotals {
+        int second = -1;
+        quint64 packets = 0;
+        quint64 bytes = 0;
+        int connections = 0;
+        QMap<QString, int> protocolCounts;
+    };
+
+    struct BurstBucket {
+        qint64 startMs = 0;   // since session start
+        quint32 packets = 0;
+        quint64 bytes = 0;
+    };
+
+    // Transport fields and timing finer than the packet's QDateTime.
+    struct PacketDetail {
+        quint16 srcPort = 0;
+        quint16 dstPort = 0;
+        quint8 tcpFlags = 0;        // TH_* bits, TCP segments only
+        quint16 microseconds = 0;   // below the timestamp's millisecond
+        DnsAnalytics::Message dns;  // from the decode the Info column already did
+    };
+
+    static constexpr int kDefaultBurstBucketMs = 10;
+
     explicit Statistics(const QDateTime &sessionStart, QObject *parent = nullptr);
     ~Statistics();
 
@@ -27,7 +64,8 @@ public:
                       const QString &src,
                       const QString &dst,
                       quint64 packetSize,
-                      int packetRow);
+                      int packetRow,
+                      const PacketDetail &detail = PacketDetail());
 
     bool SaveStatsToJson(const QString &dirPath, bool finalizePending = false);
     QString lastFilePath() const;
@@ -35,39 +73,211 @@ public:
 
     const QVector<AnomalyDetector::Event> &anomalies() const;
 
+    // Width of the sub-second buckets, 1-1000 ms, rounded down to a divisor
+    // of 1000 so buckets never straddle a second. Clears the burst window.
+    void setBurstBucketMs(int bucketMs);
+    int burstBucketMs() const;
+    // Non-empty buckets of the last kBurstWindowMs, oldest first.
+    QVector<BurstBucket> recentBursts() const;
+
+    // Restarts the open top-talkers window with a new K and length.
+    void setTopTalkers(int k, int windowSeconds);
+    const TopTalkers::Report &topTalkers() const;
+
+    // Rules file for the detector; empty, the default, for the built-in
+    // rules.
+    void setAnomalyRulesPath(const QString &path);
+    // Replaces the detector's time-of-week profiles with those saved at
+    // path; an empty path starts without any. Saves write them back to
+    // path, so without one the profile is not kept.
+    bool loadSeasonalBaselines(const QString &path);
+    // Seconds without a matching event before an incident closes; 0 keeps
+    // every second apart. Defaults to IncidentCoalescer's.
+    void setIncidentCooldown(int seconds);
+
     static QString defaultSessionsDir();
+    // Where the time-of-week profiles live alongside the sessions.
+    static QString seasonalBaselinesPath(const QString &sessionsDir);
 
 signals:
+    // A new incident, or a later state of one already sent (same id).
     void anomalyDetected(const AnomalyDetector::Event &event);
+    void secondFinalized(const Statistics::SecondTotals &totals);
 
 private:
+    struct Distributions {
+        QuantileHistogram size;           // bytes
+        QuantileHistogram interArrival;   // µs since the previous packet
+        QuantileHistogram handshakeRtt;   // µs from SYN to SYN/ACK
+    };
+
+    // TCP control flags one host sent and received in a second.
+    struct TcpHostCounts {
+        quint32 syn = 0;
+        quint32 synAckReceived = 0;
+        quint32 synReceived = 0;
+        quint32 synAckSent = 0;
+        quint32 rst = 0;
+        QSet<quint64> probes;   // (interned destination << 16) | port, capped
+    };
+
+    // Full detail for one second. Only the most recent kRingSeconds seconds
+    // live here; older ones are compacted into a SecondSummary.
+    struct SecondSlot {
+        int second = -1;
+        quint64 packets = 0;
+        quint64 bytes = 0;
+        QMap<QString, int> protocolCounts;
+        QSet<quint64> connections;   // interned (src << 32) | dst, capped
+        HyperLogLog connectionSketch{kConnectionPrecision};
+        HeavyHitters sourcePackets{kHeavyHitterCapacity, kHeavyHitterSketchWidth};
+        HeavyHitters destinationPackets{kHeavyHitterCapacity, kHeavyHitterSketchWidth};
+        QHash<QString, HyperLogLog> sourceFanOut;
+        QHash<QString, HyperLogLog> destinationFanIn;
+        RowRangeSet packetRows;
+        QMap<QString, RowRangeSet> rowsBySource;
+        QMap<QString, RowRangeSet> rowsByDestination;
+        QHash<quint16, RowRangeSet> rowsByService;
+        // Exact per-entity packets for the detector's baselines.
+        QHash<quint32, quint32> sourceCounts;        // interned address
+        QHash<quint32, quint32> destinationCounts;
+        QHash<quint16, quint32> serviceCounts;       // service port
+        TcpFlagDetectors::Features tcp;              // hosts are filled on finalize
+        QHash<quint32, TcpHostCounts> tcpHosts;      // interned address, capped
+        quint32 peakBucketPackets = 0;
+        quint64 peakBucketBytes = 0;
+        Distributions distributions;
+        QHash<QString, Distributions> protocolDistributions;
+    };
+
+    struct DistributionSummary {
+        quint32 protocol = kAllProtocols;   // interned id
+        AnomalyDetector::Quantiles size;
+        AnomalyDetector::Quantiles interArrival;
+        AnomalyDetector::Quantiles handshakeRtt;
+    };
+
+    // What persistence needs from a second, with strings replaced by ids
+    // into m_strings.
+    struct SecondSummary {
+        int second = 0;
+        quint64 packets = 0;
+        quint64 bytes = 0;
+        QVector<QPair<quint32, quint32>> protocolCounts;
+        QVector<quint64> connections;
+        quint32 uniqueConnections = 0;   // estimate once connections is capped
+        quint32 peakBucketPackets = 0;
+        quint64 peakBucketBytes = 0;
+        QVector<DistributionSummary> distributions;   // all traffic first
+    };
+
+    struct BurstSlot {
+        qint64 tick = -1;
+        quint32 packets = 0;
+        quint64 bytes = 0;
+    };
+
+    struct PendingHandshake {
+        qint64 synUs = 0;
+        bool retransmitted = false;
+    };
+    // Interned (src << 32) | dst and (srcPort << 16) | dstPort of the SYN.
+    using HandshakeKey = QPair<quint64, quint32>;
+
+    struct HistoryEntry {
+        QVector<quint64> connections;
+        QStringList protocols;
+    };
+
+    struct InternedString {
+        quint32 id = 0;
+        int lastSecond = 0;
+    };
+
+    static constexpr int kRingSeconds = 8;
+    // Past this many pairs a second only keeps the distinct-count sketch.
+    static constexpr int kMaxTrackedConnections = 4096;
+    static constexpr int kConnectionPrecision = 12;
+    static constexpr int kBurstWindowMs = 60000;
+    static constexpr int kHeavyHitterCapacity = 64;
+    static constexpr int kHeavyHitterSketchWidth = 512;
+    static constexpr quint32 kAllProtocols = 0xFFFFFFFFu;
+    static constexpr int kMaxPendingHandshakes = 4096;
+    static constexpr qint64 kHandshakeTimeoutUs = 30 * 1000 * 1000;
+    static constexpr int kMaxTcpHosts = 1024;
+    static constexpr int kMaxProbesPerHost = 256;
+    // Strings unused this long are forgotten. Ids are never reused, so
+    // anything still holding an old one just stops matching.
+    static constexpr int kStringIdleSeconds = 60 * 60;
+    static constexpr int kStringSweepSeconds = 60;
+
+    const BurstSlot *recordBurst(qint64 elapsedMs, quint64 packetSize);
+    qint64 handshakeRtt(quint64 connection, const PacketDetail &detail, qint64 elapsedUs);
+    void pruneHandshakes(qint64 elapsedUs);
+    void recordTcpFlags(SecondSlot &slot, quint64 connection, const PacketDetail &detail);
+    void recordDistributions(SecondSlot *slot,
+                             const QString &protocol,
+                             quint64 packetSize,
+                             qint64 elapsedUs,
+                             qint64 rttUs);
+    SecondSlot *slotFor(int second);
+    SecondSummary summarize(const SecondSlot &slot);
+    void compactSlot(SecondSlot &slot);
+    void addToRollup(StatisticsRollup &rollup, const SecondSummary &summary) const;
+    SecondSummary &summaryFor(int second);
+    void recordLatePacket(int second, const QString &protocol, quint64 connection, quint64 packetSize);
+    quint32 intern(const QString &value, int second);
+    const QString &internedString(quint32 id) const;
+    void pruneStrings(int second);
+    QJsonObject secondToJson(const SecondSummary &summary) const;
+    QJsonObject burstsToJson() const;
+    QJsonObject distributionsToJson() const;
     void finalizeSecond(int second);
     void finalizePendingSecond();
     void pruneHistory();
     void onAnomalyEvent(const AnomalyDetector::Event &event);
+    void publishFinalUpdates(int second, bool flushOpen);
 
     QDateTime m_sessionStart;
     QDateTime m_sessionEnd;
-    QMap<int, QMap<QString,int>> statsProtocolPerSecond;
-    QMap<int, QSet<QPair<QString,QString>>> statsConnectionsPerSecond;
-    QMap<int, quint64> statsBytesPerSecond;
-    QMap<int, quint64> statsPacketsPerSecond;
-    QMap<int, QMap<QString,int>> statsSourcePacketsPerSecond;
-    QMap<int, QMap<QString,int>> statsDestinationPacketsPerSecond;
-    QMap<int, QMap<QString,QSet<QString>>> statsSourceFanOutPerSecond;
-    QMap<int, QMap<QString,QSet<QString>>> statsDestinationFanInPerSecond;
-    QMap<int, QVector<int>> statsPacketRowsPerSecond;
-    QMap<int, QMap<QString, QVector<int>>> statsRowsBySourcePerSecond;
-    QMap<int, QMap<QString, QVector<int>>> statsRowsByDestinationPerSecond;
+    QVector<SecondSlot> m_ring;
+    int m_ringBase = 0;
+    // Compacted seconds not written to the session file yet.
+    QVector<SecondSummary> m_summaries;
+    QVector<BurstSlot> m_bursts;
+    int m_burstBucketMs = kDefaultBurstBucketMs;
+    HyperLogLog m_sessionConnections{kConnectionPrecision};
+    TopTalkers m_topTalkers;
+    BeaconDetector m_beacons;
+    DnsAnalytics m_dns;
+    StatisticsRollup m_rollup;   // compacted seconds only
+    Distributions m_sessionDistributions;
+    QHash<QString, Distributions> m_sessionProtocolDistributions;
+    qint64 m_lastArrivalUs = -1;
+    QHash<QString, qint64> m_lastProtocolArrivalUs;
+    QHash<HandshakeKey, PendingHandshake> m_pendingHandshakes;
+    QHash<QString, InternedString> m_stringIds;
+    QHash<quint32, QString> m_strings;
+    quint32 m_nextStringId = 0;
     QString m_lastFilePath;
+    // Offset just past the last compacted second in the session file, and
+    // that second; nothing up to it is kept in memory.
+    qint64 m_fileSecondsEnd = 0;
+    int m_persistedSecond = -1;
+    QString m_seasonalBaselinesPath;
+    // Opened on the first save and again when the directory changes.
+    std::unique_ptr<SessionWarehouse> m_warehouse;
+    QString m_warehousePath;   // file the warehouse last stored the session as
+    // Lowest second changed since the last warehouse ingest.
+    int m_warehouseDirtySecond = 0;
 
     std::unique_ptr<AnomalyDetector> m_anomalyDetector;
     int m_activeSecond = -1;
-    QQueue<int> m_recentHistorySeconds;
-    QHash<QString, int> m_recentConnectionUsage;
+    QQueue<HistoryEntry> m_recentHistory;
+    QHash<quint64, int> m_recentConnectionUsage;
     QHash<QString, int> m_recentProtocolUsage;
     int m_historyWindow = 30;
-    QVector<AnomalyDetector::Event> m_anomalies;
+    IncidentCoalescer m_incidents;
 };
 
 #endif // STATISTICS_H
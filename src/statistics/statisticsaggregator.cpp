@@ -0,0 +1,242 @@
+#include "statisticsaggregator.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QThread>
+#include <QTimer>
+
+namespace {
+constexpr std::size_t kQueueCapacity = 1 << 16;
+constexpr int kDrainIntervalMs = 10;
+// Set on StatisticsAggregator::m_middle while the GUI thread has not read it.
+constexpr int kSnapshotFresh = 4;
+constexpr int kSnapshotIndexMask = 3;
+}
+
+StatisticsAggregator::StatisticsAggregator(const QDateTime &sessionStart,
+                                           int burstBucketMs,
+                                           QObject *parent)
+    : QObject(parent),
+      m_queue(kQueueCapacity)
+{
+    qRegisterMetaType<AnomalyDetector::Event>();
+    m_published = std::make_shared<const Snapshot>();
+    for (auto &slot : m_snapshots)
+        slot = m_published;
+    connect(this, &StatisticsAggregator::anomalyDetected,
+            this, [this](const AnomalyDetector::Event &event) {
+                IncidentCoalescer::upsert(m_anomalies, event);
+            });
+
+    m_thread = new QThread(this);
+    m_thread->setObjectName(QStringLiteral("StatisticsAggregator"));
+    m_worker = new QObject;
+    m_worker->moveToThread(m_thread);
+    m_thread->start();
+
+    QMetaObject::invokeMethod(m_worker, [this, sessionStart, burstBucketMs]() {
+        m_statistics = std::make_unique<Statistics>(sessionStart);
+        m_statistics->setBurstBucketMs(burstBucketMs);
+        // Cross-thread, so this is queued and re-emitted on the GUI thread.
+        connect(m_statistics.get(), &Statistics::anomalyDetected,
+                this, &StatisticsAggregator::anomalyDetected);
+        connect(m_statistics.get(), &Statistics::secondFinalized,
+                m_worker, [this](const Statistics::SecondTotals &totals) {
+                    publishSecond(totals);
+                });
+
+        auto *timer = new QTimer(m_worker);
+        connect(timer, &QTimer::timeout, m_worker, [this]() { drain(); });
+        timer->start(kDrainIntervalMs);
+    }, Qt::BlockingQueuedConnection);
+}
+
+StatisticsAggregator::~StatisticsAggregator()
+{
+    QMetaObject::invokeMethod(m_worker, [this]() {
+        drain();
+        m_statistics.reset();
+    }, Qt::BlockingQueuedConnection);
+    deliverPendingAnomalies();
+    m_thread->quit();
+    m_thread->wait();
+    delete m_worker;
+}
+
+void StatisticsAggregator::recordPacket(const QDateTime &timestamp,
+                                        const QString &protocol,
+                                        const QString &src,
+                                        const QString &dst,
+                                        quint64 packetSize,
+                                        int packetRow,
+                                        const Statistics::PacketDetail &detail)
+{
+    PacketRecord record{timestamp, protocol, src, dst, packetSize, packetRow, detail};
+    // Only a replay can outrun the aggregation thread; wait for it rather
+    // than dropping counts.
+    while (!m_queue.push(record)) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+void StatisticsAggregator::requestSave(const QString &dirPath)
+{
+    if (m_saveQueued.exchange(true)) {
+        return;
+    }
+    QMetaObject::invokeMethod(m_worker, [this, dirPath]() {
+        m_saveQueued = false;
+        drain();
+        save(dirPath, false);
+    }, Qt::QueuedConnection);
+}
+
+bool StatisticsAggregator::saveNow(const QString &dirPath, bool finalizePending)
+{
+    bool ok = false;
+    QMetaObject::invokeMethod(m_worker, [this, &dirPath, finalizePending, &ok]() {
+        drain();
+        ok = save(dirPath, finalizePending);
+    }, Qt::BlockingQueuedConnection);
+    deliverPendingAnomalies();
+    return ok;
+}
+
+void StatisticsAggregator::finalizePendingData()
+{
+    QMetaObject::invokeMethod(m_worker, [this]() {
+        drain();
+        if (m_statistics) {
+            m_statistics->finalizePendingData();
+        }
+    }, Qt::BlockingQueuedConnection);
+    deliverPendingAnomalies();
+}
+
+void StatisticsAggregator::setTopTalkers(int k, int windowSeconds)
+{
+    QMetaObject::invokeMethod(m_worker, [this, k, windowSeconds]() {
+        drain();
+        if (m_statistics) {
+            m_statistics->setTopTalkers(k, windowSeconds);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void StatisticsAggregator::setAnomalyRulesPath(const QString &path)
+{
+    QMetaObject::invokeMethod(m_worker, [this, path]() {
+        drain();
+        if (m_statistics) {
+            m_statistics->setAnomalyRulesPath(path);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void StatisticsAggregator::setIncidentCooldown(int seconds)
+{
+    QMetaObject::invokeMethod(m_worker, [this, seconds]() {
+        drain();
+        if (m_statistics) {
+            m_statistics->setIncidentCooldown(seconds);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void StatisticsAggregator::loadSeasonalBaselines(const QString &path)
+{
+    QMetaObject::invokeMethod(m_worker, [this, path]() {
+        drain();
+        if (m_statistics) {
+            m_statistics->loadSeasonalBaselines(path);
+        }
+    }, Qt::QueuedConnection);
+}
+
+std::shared_ptr<const StatisticsAggregator::Snapshot> StatisticsAggregator::latestSnapshot() const
+{
+    if (m_middle.load(std::memory_order_acquire) & kSnapshotFresh)
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & kSnapshotIndexMask;
+    return m_snapshots[m_front];
+}
+
+QString StatisticsAggregator::lastFilePath() const
+{
+    return latestSnapshot()->lastFilePath;
+}
+
+const QVector<AnomalyDetector::Event> &StatisticsAggregator::anomalies() const
+{
+    return m_anomalies;
+}
+
+void StatisticsAggregator::deliverPendingAnomalies()
+{
+    // Anomalies raised by a blocking call are already queued for this
+    // object; hand them out now so callers see them when the call returns.
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
+
+void StatisticsAggregator::drain()
+{
+    if (!m_statistics) {
+        return;
+    }
+    PacketRecord record;
+    while (m_queue.pop(record)) {
+        m_statistics->recordPacket(record.timestamp,
+                                   record.protocol,
+                                   record.src,
+                                   record.dst,
+                                   record.packetSize,
+                                   record.packetRow,
+                                   record.detail);
+    }
+}
+
+bool StatisticsAggregator::save(const QString &dirPath, bool finalizePending)
+{
+    if (!m_statistics) {
+        return false;
+    }
+    const bool ok = m_statistics->SaveStatsToJson(dirPath, finalizePending);
+    Snapshot next = *m_published;
+    next.saveOk = ok;
+    next.lastFilePath = m_statistics->lastFilePath();
+    refreshTopTalkers(next);
+    publish(next);
+    return ok;
+}
+
+void StatisticsAggregator::publishSecond(const Statistics::SecondTotals &totals)
+{
+    Snapshot next = *m_published;
+    next.lastSecond = totals;
+    next.totalPackets += totals.packets;
+    next.totalBytes += totals.bytes;
+    for (auto it = totals.protocolCounts.constBegin(); it != totals.protocolCounts.constEnd(); ++it) {
+        next.protocolTotals[it.key()] += quint64(it.value());
+    }
+    next.anomalyCount = quint64(m_statistics->anomalies().size());
+    refreshTopTalkers(next);
+    publish(next);
+}
+
+void StatisticsAggregator::refreshTopTalkers(Snapshot &snapshot) const
+{
+    const TopTalkers::Report &report = m_statistics->topTalkers();
+    if (report.revision == 0
+        || (snapshot.topTalkers && snapshot.topTalkers->revision == report.revision)) {
+        return;
+    }
+    snapshot.topTalkers = std::make_shared<const TopTalkers::Report>(report);
+}
+
+void StatisticsAggregator::publish(const Snapshot &snapshot)
+{
+    // Only the aggregation thread publishes, so read-modify-publish is safe.
+    m_published = std::make_shared<const Snapshot>(snapshot);
+    m_snapshots[m_back] = m_published;
+    m_back = m_middle.exchange(m_back | kSnapshotFresh, std::memory_order_acq_rel)
+             & kSnapshotIndexMask;
+}
@@ -0,0 +1,102 @@
+#ifndef STATISTICSAGGREGATOR_H
+#define STATISTICSAGGREGATOR_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+#include "statistics.h"
+#include "spscqueue.h"
+
+class QThread;
+
+// Runs Statistics on its own thread. The GUI thread hands packet metadata
+// over through a lock-free queue and reads back immutable snapshots that the
+// aggregation thread publishes once per finalized second and after each save.
+class StatisticsAggregator : public QObject {
+    Q_OBJECT
+public:
+    struct Snapshot {
+        Statistics::SecondTotals lastSecond;
+        quint64 totalPackets = 0;
+        quint64 totalBytes = 0;
+        QMap<QString, quint64> protocolTotals;
+        quint64 anomalyCount = 0;
+        bool saveOk = true;
+        QString lastFilePath;
+        std::shared_ptr<const TopTalkers::Report> topTalkers;
+    };
+
+    explicit StatisticsAggregator(const QDateTime &sessionStart,
+                                  int burstBucketMs = Statistics::kDefaultBurstBucketMs,
+                                  QObject *parent = nullptr);
+    ~StatisticsAggregator();
+
+    // GUI thread only.
+    void recordPacket(const QDateTime &timestamp,
+                      const QString &protocol,
+                      const QString &src,
+                      const QString &dst,
+                      quint64 packetSize,
+                      int packetRow,
+                      const Statistics::PacketDetail &detail = Statistics::PacketDetail());
+
+    // Queues a save behind the packets recorded so far; the outcome shows up
+    // in the next snapshot.
+    void requestSave(const QString &dirPath);
+    // Blocks until every queued packet is aggregated and the file is written.
+    bool saveNow(const QString &dirPath, bool finalizePending);
+    void finalizePendingData();
+    void setTopTalkers(int k, int windowSeconds);
+    void setAnomalyRulesPath(const QString &path);
+    void setIncidentCooldown(int seconds);
+    void loadSeasonalBaselines(const QString &path);
+
+    // GUI thread only: the snapshot slots have a single reader.
+    std::shared_ptr<const Snapshot> latestSnapshot() const;
+    QString lastFilePath() const;
+    const QVector<AnomalyDetector::Event> &anomalies() const;
+
+signals:
+    // A new incident, or a later state of one already sent (same id).
+    void anomalyDetected(const AnomalyDetector::Event &event);
+
+private:
+    struct PacketRecord {
+        QDateTime timestamp;
+        QString protocol;
+        QString src;
+        QString dst;
+        quint64 packetSize = 0;
+        int packetRow = -1;
+        Statistics::PacketDetail detail;
+    };
+
+    void drain();
+    void deliverPendingAnomalies();
+    bool save(const QString &dirPath, bool finalizePending);
+    void publishSecond(const Statistics::SecondTotals &totals);
+    void refreshTopTalkers(Snapshot &snapshot) const;
+    void publish(const Snapshot &snapshot);
+
+    SpscQueue<PacketRecord> m_queue;
+    QThread *m_thread = nullptr;
+    QObject *m_worker = nullptr;
+    std::unique_ptr<Statistics> m_statistics;   // lives on m_thread
+    // Triple buffer. The aggregation thread fills m_snapshots[m_back] and
+    // swaps it with the middle slot; latestSnapshot() swaps a fresh middle
+    // slot with m_front. Each slot belongs to one thread at a time, so
+    // neither side takes a lock.
+    std::shared_ptr<const Snapshot> m_snapshots[3];
+    mutable std::atomic_int m_middle{1};
+    mutable int m_front = 0;                     // GUI thread
+    int m_back = 2;                              // aggregation thread
+    std::shared_ptr<const Snapshot> m_published; // aggregation thread
+    std::atomic_bool m_saveQueued{false};
+    QVector<AnomalyDetector::Event> m_anomalies;  // GUI thread copy
+};
+
+#endif // STATISTICSAGGREGATOR_H
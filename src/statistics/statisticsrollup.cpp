@@ -0,0 +1,383 @@
+#include "statisticsrollup.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+
+namespace {
+constexpr int kRollupVersion = 1;
+
+QJsonArray toArray(const QVector<double> &values)
+{
+    QJsonArray array;
+    for (double value : values) {
+        array.append(value);
+    }
+    return array;
+}
+
+QJsonObject tierToJson(int seconds, const QVector<StatisticsRollup::Bucket> &buckets)
+{
+    QVector<double> start, first, last, samples;
+    QVector<double> packets, minPackets, maxPackets, bytes, minBytes, maxBytes;
+    QJsonArray protocols;
+    QJsonArray connections;
+    for (const StatisticsRollup::Bucket &bucket : buckets) {
+        start.append(bucket.start);
+        first.append(bucket.firstSecond);
+        last.append(bucket.lastSecond);
+        samples.append(bucket.samples);
+        packets.append(double(bucket.packets));
+        minPackets.append(double(bucket.minPackets));
+        maxPackets.append(double(bucket.maxPackets));
+        bytes.append(double(bucket.bytes));
+        minBytes.append(double(bucket.minBytes));
+        maxBytes.append(double(bucket.maxBytes));
+
+        QJsonObject protocolObj;
+        for (auto it = bucket.protocols.constBegin(); it != bucket.protocols.constEnd(); ++it) {
+            protocolObj.insert(it.key(), it.value());
+        }
+        protocols.append(protocolObj);
+
+        QJsonObject connectionObj;
+        for (auto it = bucket.connections.constBegin(); it != bucket.connections.constEnd(); ++it) {
+            connectionObj.insert(it.key(), it.value());
+        }
+        connections.append(connectionObj);
+    }
+
+    // Columnar so a month of minutes stays a handful of flat arrays.
+    QJsonObject tier;
+    tier.insert("seconds", seconds);
+    tier.insert("start", toArray(start));
+    tier.insert("first", toArray(first));
+    tier.insert("last", toArray(last));
+    tier.insert("samples", toArray(samples));
+    tier.insert("packets", toArray(packets));
+    tier.insert("packetsMin", toArray(minPackets));
+    tier.insert("packetsMax", toArray(maxPackets));
+    tier.insert("bytes", toArray(bytes));
+    tier.insert("bytesMin", toArray(minBytes));
+    tier.insert("bytesMax", toArray(maxBytes));
+    tier.insert("protocols", protocols);
+    tier.insert("connections", connections);
+    return tier;
+}
+}
+
+void StatisticsRollup::addSecond(int second,
+                                 quint64 packets,
+                                 quint64 bytes,
+                                 const QMap<QString, double> &protocols,
+                                 const QStringList &connections)
+{
+    if (second < 0) {
+        return;
+    }
+    const int start = second - second % Minutes;
+    if (!m_minutes.isEmpty() && m_minutes.lastKey() < start) {
+        // The previous minute is complete; bound what it keeps.
+        trimConnections(m_minutes.last());
+    }
+
+    Bucket &bucket = m_minutes[start];
+    bucket.start = start;
+    if (bucket.samples == 0) {
+        bucket.firstSecond = second;
+        bucket.minPackets = packets;
+        bucket.maxPackets = packets;
+        bucket.minBytes = bytes;
+        bucket.maxBytes = bytes;
+    } else {
+        bucket.minPackets = std::min(bucket.minPackets, packets);
+        bucket.maxPackets = std::max(bucket.maxPackets, packets);
+        bucket.minBytes = std::min(bucket.minBytes, bytes);
+        bucket.maxBytes = std::max(bucket.maxBytes, bytes);
+    }
+    bucket.lastSecond = std::max(bucket.lastSecond, second);
+    bucket.samples += 1;
+    bucket.packets += packets;
+    bucket.bytes += bytes;
+    for (auto it = protocols.constBegin(); it != protocols.constEnd(); ++it) {
+        bucket.protocols[it.key()] += it.value();
+    }
+    for (const QString &connection : connections) {
+        bucket.connections[connection] += 1.0;
+    }
+}
+
+void StatisticsRollup::addLate(int second, quint64 packets, quint64 bytes, const QString &protocol)
+{
+    auto it = m_minutes.find(second - second % Minutes);
+    if (it == m_minutes.end()) {
+        return;
+    }
+    it->packets += packets;
+    it->bytes += bytes;
+    it->protocols[protocol] += double(packets);
+}
+
+void StatisticsRollup::merge(const StatisticsRollup &other)
+{
+    for (const Bucket &bucket : other.m_minutes) {
+        auto it = m_minutes.find(bucket.start);
+        if (it == m_minutes.end()) {
+            m_minutes.insert(bucket.start, bucket);
+        } else {
+            fold(*it, bucket);
+            trimConnections(*it);
+        }
+    }
+    if (!m_sessionStart.isValid()
+        || (other.m_sessionStart.isValid() && other.m_sessionStart < m_sessionStart)) {
+        m_sessionStart = other.m_sessionStart;
+    }
+    if (other.m_sessionEnd > m_sessionEnd) {
+        m_sessionEnd = other.m_sessionEnd;
+    }
+}
+
+void StatisticsRollup::setSessionRange(const QDateTime &start, const QDateTime &end)
+{
+    m_sessionStart = start;
+    m_sessionEnd = end;
+}
+
+QVector<StatisticsRollup::Bucket> StatisticsRollup::buckets(Tier tier) const
+{
+    return query(tier);
+}
+
+QVector<StatisticsRollup::Bucket> StatisticsRollup::query(int bucketSeconds, int from, int to) const
+{
+    QVector<Bucket> result;
+    if (tierFor(bucketSeconds) == Seconds) {
+        return result;
+    }
+
+    for (const Bucket &minute : m_minutes) {
+        if (minute.lastSecond < from || (to >= 0 && minute.firstSecond > to)) {
+            continue;
+        }
+        const int start = minute.start - minute.start % bucketSeconds;
+        if (result.isEmpty() || result.last().start != start) {
+            if (!result.isEmpty()) {
+                trimConnections(result.last());
+            }
+            Bucket bucket = minute;
+            bucket.start = start;
+            result.append(bucket);
+        } else {
+            fold(result.last(), minute);
+        }
+    }
+    if (!result.isEmpty()) {
+        trimConnections(result.last());
+    }
+    return result;
+}
+
+StatisticsRollup::Tier StatisticsRollup::tierFor(int bucketSeconds)
+{
+    if (bucketSeconds >= Hours && bucketSeconds % Hours == 0) {
+        return Hours;
+    }
+    if (bucketSeconds >= Minutes && bucketSeconds % Minutes == 0) {
+        return Minutes;
+    }
+    return Seconds;
+}
+
+QJsonObject StatisticsRollup::toJson() const
+{
+    QJsonArray tiers;
+    tiers.append(tierToJson(Minutes, buckets(Minutes)));
+    tiers.append(tierToJson(Hours, buckets(Hours)));
+
+    QJsonObject root;
+    root.insert("version", kRollupVersion);
+    root.insert("sessionStart", m_sessionStart.toString(Qt::ISODate));
+    root.insert("sessionEnd", m_sessionEnd.toString(Qt::ISODate));
+    root.insert("tiers", tiers);
+    return root;
+}
+
+StatisticsRollup StatisticsRollup::fromJson(const QJsonObject &root)
+{
+    StatisticsRollup rollup;
+    if (root.value("version").toInt() != kRollupVersion) {
+        return rollup;
+    }
+    rollup.setSessionRange(QDateTime::fromString(root.value("sessionStart").toString(), Qt::ISODate),
+                           QDateTime::fromString(root.value("sessionEnd").toString(), Qt::ISODate));
+
+    // Hours fold back out of minutes, so only the minute tier is read.
+    const QJsonArray tiers = root.value("tiers").toArray();
+    for (const QJsonValue &tierValue : tiers) {
+        const QJsonObject tier = tierValue.toObject();
+        if (tier.value("seconds").toInt() != Minutes) {
+            continue;
+        }
+        const QJsonArray start = tier.value("start").toArray();
+        const QJsonArray first = tier.value("first").toArray();
+        const QJsonArray last = tier.value("last").toArray();
+        const QJsonArray samples = tier.value("samples").toArray();
+        const QJsonArray packets = tier.value("packets").toArray();
+        const QJsonArray minPackets = tier.value("packetsMin").toArray();
+        const QJsonArray maxPackets = tier.value("packetsMax").toArray();
+        const QJsonArray bytes = tier.value("bytes").toArray();
+        const QJsonArray minBytes = tier.value("bytesMin").toArray();
+        const QJsonArray maxBytes = tier.value("bytesMax").toArray();
+        const QJsonArray protocols = tier.value("protocols").toArray();
+        const QJsonArray connections = tier.value("connections").toArray();
+        for (int i = 0; i < start.size(); ++i) {
+            Bucket bucket;
+            bucket.start = start.at(i).toInt();
+            bucket.firstSecond = first.at(i).toInt();
+            bucket.lastSecond = last.at(i).toInt();
+            bucket.samples = samples.at(i).toInt();
+            bucket.packets = quint64(packets.at(i).toDouble());
+            bucket.minPackets = quint64(minPackets.at(i).toDouble());
+            bucket.maxPackets = quint64(maxPackets.at(i).toDouble());
+            bucket.bytes = quint64(bytes.at(i).toDouble());
+            bucket.minBytes = quint64(minBytes.at(i).toDouble());
+            bucket.maxBytes = quint64(maxBytes.at(i).toDouble());
+            const QJsonObject protocolObj = protocols.at(i).toObject();
+            for (auto it = protocolObj.constBegin(); it != protocolObj.constEnd(); ++it) {
+                bucket.protocols.insert(it.key(), it.value().toDouble());
+            }
+            const QJsonObject connectionObj = connections.at(i).toObject();
+            for (auto it = connectionObj.constBegin(); it != connectionObj.constEnd(); ++it) {
+                bucket.connections.insert(it.key(), it.value().toDouble());
+            }
+            rollup.m_minutes.insert(bucket.start, bucket);
+        }
+    }
+    return rollup;
+}
+
+StatisticsRollup StatisticsRollup::fromStatistics(const QJsonObject &session)
+{
+    StatisticsRollup rollup;
+    rollup.setSessionRange(QDateTime::fromString(session.value("sessionStart").toString(), Qt::ISODate),
+                           QDateTime::fromString(session.value("sessionEnd").toString(), Qt::ISODate));
+
+    QVector<QJsonObject> seconds;
+    const QJsonArray perSecond = session.value("perSecond").toArray();
+    seconds.reserve(perSecond.size());
+    for (const QJsonValue &value : perSecond) {
+        seconds.append(value.toObject());
+    }
+    std::stable_sort(seconds.begin(), seconds.end(), [](const QJsonObject &a, const QJsonObject &b) {
+        return a.value("second").toInt() < b.value("second").toInt();
+    });
+
+    for (const QJsonObject &secondObj : std::as_const(seconds)) {
+        QMap<QString, double> protocols;
+        const QJsonObject protoCounts = secondObj.value("protocolCounts").toObject();
+        for (auto it = protoCounts.constBegin(); it != protoCounts.constEnd(); ++it) {
+            protocols.insert(it.key(), it.value().toDouble());
+        }
+        QStringList connections;
+        const QJsonArray connArray = secondObj.value("connections").toArray();
+        for (const QJsonValue &connValue : connArray) {
+            const QJsonObject conn = connValue.toObject();
+            connections.append(conn.value("src").toString() + QStringLiteral(" -> ")
+                               + conn.value("dst").toString());
+        }
+        rollup.addSecond(secondObj.value("second").toInt(),
+                         quint64(qRound64(secondObj.value("pps").toDouble())),
+                         quint64(qRound64(secondObj.value("bps").toDouble())),
+                         protocols,
+                         connections);
+    }
+    if (!rollup.m_minutes.isEmpty()) {
+        trimConnections(rollup.m_minutes.last());
+    }
+    return rollup;
+}
+
+QString StatisticsRollup::sidecarPath(const QString &statisticsFile)
+{
+    const QFileInfo info(statisticsFile);
+    return info.absolutePath() + QLatin1Char('/') + info.completeBaseName()
+           + QStringLiteral(".rollup");
+}
+
+bool StatisticsRollup::save(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    const QByteArray payload = QJsonDocument(toJson()).toJson(QJsonDocument::Compact);
+    if (file.write(payload) != payload.size() || !file.flush()) {
+        file.close();
+        file.remove();
+        return false;
+    }
+    return true;
+}
+
+bool StatisticsRollup::loadFor(const QString &statisticsFile, StatisticsRollup *rollup)
+{
+    const QFileInfo source(statisticsFile);
+    const QFileInfo sidecar(sidecarPath(statisticsFile));
+    if (!sidecar.exists() || sidecar.lastModified() < source.lastModified()) {
+        return false;
+    }
+    QFile file(sidecar.absoluteFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (!doc.isObject() || doc.object().value("version").toInt() != kRollupVersion) {
+        return false;
+    }
+    *rollup = fromJson(doc.object());
+    return true;
+}
+
+void StatisticsRollup::fold(Bucket &into, const Bucket &from)
+{
+    // Every stored bucket has at least one sample.
+    into.firstSecond = std::min(into.firstSecond, from.firstSecond);
+    into.lastSecond = std::max(into.lastSecond, from.lastSecond);
+    into.samples += from.samples;
+    into.packets += from.packets;
+    into.bytes += from.bytes;
+    into.minPackets = std::min(into.minPackets, from.minPackets);
+    into.maxPackets = std::max(into.maxPackets, from.maxPackets);
+    into.minBytes = std::min(into.minBytes, from.minBytes);
+    into.maxBytes = std::max(into.maxBytes, from.maxBytes);
+    for (auto it = from.protocols.constBegin(); it != from.protocols.constEnd(); ++it) {
+        into.protocols[it.key()] += it.value();
+    }
+    for (auto it = from.connections.constBegin(); it != from.connections.constEnd(); ++it) {
+        into.connections[it.key()] += it.value();
+    }
+}
+
+void StatisticsRollup::trimConnections(Bucket &bucket)
+{
+    if (bucket.connections.size() <= kMaxBucketConnections) {
+        return;
+    }
+    QVector<QPair<double, QString>> ranked;
+    ranked.reserve(bucket.connections.size());
+    for (auto it = bucket.connections.constBegin(); it != bucket.connections.constEnd(); ++it) {
+        ranked.append(qMakePair(it.value(), it.key()));
+    }
+    std::partial_sort(ranked.begin(), ranked.begin() + kMaxBucketConnections, ranked.end(),
+                      [](const QPair<double, QString> &a, const QPair<double, QString> &b) {
+                          return a.first > b.first || (a.first == b.first && a.second < b.second);
+                      });
+    bucket.connections.clear();
+    for (int i = 0; i < kMaxBucketConnections; ++i) {
+        bucket.connections.insert(ranked.at(i).second, ranked.at(i).first);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef STATISTICSROLLUP_H
+#define STATISTICSROLLUP_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QJsonObject>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+// Minute and hour aggregates of a session's per-second samples. Statistics
+// writes them next to the session JSON as "<name>.rollup" so charts and
+// reports over long captures read a few hundred buckets instead of parsing
+// every second.
+class StatisticsRollup
+{
+public:
+    enum Tier {
+        Seconds = 1,   // not stored; callers fall back to the session JSON
+        Minutes = 60,
+        Hours = 3600
+    };
+
+    struct Bucket {
+        int start = 0;          // first second the bucket covers
+        int firstSecond = -1;   // first and last second that had traffic
+        int lastSecond = -1;
+        int samples = 0;        // seconds with traffic
+        quint64 packets = 0;
+        quint64 minPackets = 0;
+        quint64 maxPackets = 0;
+        quint64 bytes = 0;
+        quint64 minBytes = 0;
+        quint64 maxBytes = 0;
+        QMap<QString, double> protocols;
+        // "src -> dst" to seconds seen; only the busiest pairs survive.
+        QHash<QString, double> connections;
+
+        double avgPackets() const { return samples > 0 ? double(packets) / samples : 0.0; }
+        double avgBytes() const { return samples > 0 ? double(bytes) / samples : 0.0; }
+    };
+
+    static constexpr int kMaxBucketConnections = 32;
+
+    StatisticsRollup() = default;
+
+    // Seconds must arrive in ascending order.
+    void addSecond(int second,
+                   quint64 packets,
+                   quint64 bytes,
+                   const QMap<QString, double> &protocols,
+                   const QStringList &connections);
+    // Traffic for a second that was already added; updates sums only.
+    void addLate(int second, quint64 packets, quint64 bytes, const QString &protocol);
+    void merge(const StatisticsRollup &other);
+
+    bool isEmpty() const { return m_minutes.isEmpty(); }
+    QVector<Bucket> buckets(Tier tier) const;
+    // Buckets of bucketSeconds width that saw traffic in [from, to] (to < 0:
+    // open ended). Buckets are whole, so align from/to to the width for exact
+    // edges. Empty when tierFor(bucketSeconds) is Seconds.
+    QVector<Bucket> query(int bucketSeconds, int from = 0, int to = -1) const;
+    static Tier tierFor(int bucketSeconds);
+
+    void setSessionRange(const QDateTime &start, const QDateTime &end);
+    QDateTime sessionStart() const { return m_sessionStart; }
+    QDateTime sessionEnd() const { return m_sessionEnd; }
+
+    QJsonObject toJson() const;
+    static StatisticsRollup fromJson(const QJsonObject &root);
+    // Rebuilds the rollup from a saved statistics document.
+    static StatisticsRollup fromStatistics(const QJsonObject &session);
+
+    static QString sidecarPath(const QString &statisticsFile);
+    bool save(const QString &path) const;
+    // Reads the sidecar of statisticsFile when it is at least as new as the
+    // statistics file itself.
+    static bool loadFor(const QString &statisticsFile, StatisticsRollup *rollup);
+
+private:
+    static void fold(Bucket &into, const Bucket &from);
+    static void trimConnections(Bucket &bucket);
+
+    QDateTime m_sessionStart;
+    QDateTime m_sessionEnd;
+    QMap<int, Bucket> m_minutes;   // keyed by start second
+};
+
+#endif // STATISTICSROLLUP_H
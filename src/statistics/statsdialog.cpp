@@ -247,7 +247,7 @@ void StatsDialog::updateOptionsBar(int index)
         // Resolution selector
         {
             QComboBox *resCombo = new QComboBox(this);
-            resCombo->addItems({ "Seconds", "Minutes", "Hours" });
+            resCombo->addItems({ "Seconds", "Minutes", "Hours", "Sub-second" });
             optionsBar->addWidget(resCombo);
             connect(resCombo,
                     QOverload<int>::of(&QComboBox::currentIndexChanged),
@@ -0,0 +1,216 @@
+#include "tcpflagdetectors.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Source counters keep this much of their value per second.
+constexpr double kDecay = 0.8;
+constexpr double kForgetLevel = 1.0;
+// Answer ratios are only trusted once the capture has shown some SYN/ACKs.
+constexpr quint64 kMinSynAcks = 8;
+constexpr double kMinFloodSyns = 100.0;   // unanswered, in one second
+constexpr double kMinRsts = 50.0;
+constexpr double kMinRstShare = 0.2;      // of TCP segments
+constexpr double kHalfOpenTrigger = 64.0;
+constexpr double kVerticalScanTrigger = 32.0;
+constexpr double kHorizontalScanTrigger = 32.0;
+// Before any SYN/ACK shows up, ordinary clients look unanswered too; their
+// spread over hosts counts this much, so a one-way tap needs a far wider
+// sweep before it calls a horizontal scan.
+constexpr double kOneWayHostProbeWeight = 0.125;
+constexpr int kMaxFindingsPerKind = 3;
+constexpr quint64 kUnansweredKey = 0;
+constexpr quint64 kRstKey = 1;
+}
+
+TcpFlagDetectors::TcpFlagDetectors(int maxTrackedSources)
+    : m_maxSources(std::max(1, maxTrackedSources))
+{
+}
+
+QVector<TcpFlagDetectors::Finding> TcpFlagDetectors::observe(int second,
+                                                            const Features &features,
+                                                            double threshold,
+                                                            int warmup)
+{
+    m_synAcksSeen += features.synAck;
+    const bool answersVisible = m_synAcksSeen >= kMinSynAcks;
+
+    const double unanswered = features.syn > features.synAck
+        ? double(features.syn - features.synAck)
+        : 0.0;
+    m_totals.update({kUnansweredKey, kRstKey}, {unanswered, double(features.rst)}, warmup,
+                    m_scores, m_expected);
+    const double unansweredScore = m_scores.at(0);
+    const double rstScore = m_scores.at(1);
+
+    QVector<Finding> findings;
+    auto keepStrongest = [&findings](QVector<Finding> &candidates) {
+        std::sort(candidates.begin(), candidates.end(), [](const Finding &a, const Finding &b) {
+            return a.severity > b.severity;
+        });
+        if (candidates.size() > kMaxFindingsPerKind) {
+            candidates.resize(kMaxFindingsPerKind);
+        }
+        findings += candidates;
+    };
+
+    // SYN floods by target. Where answers are visible the target's own
+    // answer ratio decides; on one-way captures only a jump in the overall
+    // unanswered rate does.
+    const bool unansweredSurge = unansweredScore > threshold;
+    QVector<Finding> floods;
+    for (const Host &host : features.hosts) {
+        const double open = host.synReceived > host.synAckSent
+            ? double(host.synReceived - host.synAckSent)
+            : 0.0;
+        if (open < kMinFloodSyns) {
+            continue;
+        }
+        const bool mostlyUnanswered = answersVisible && host.synAckSent * 3 < host.synReceived;
+        if (!mostlyUnanswered && !unansweredSurge) {
+            continue;
+        }
+        Finding finding;
+        finding.kind = Kind::SynFlood;
+        finding.host = host.name;
+        finding.value = host.synReceived;
+        finding.expected = kMinFloodSyns;
+        finding.answered = host.synAckSent;
+        finding.severity = open / kMinFloodSyns;
+        floods.append(finding);
+    }
+    if (floods.isEmpty() && unansweredSurge && unanswered >= kMinFloodSyns) {
+        // The target did not make it into the bounded host table.
+        Finding finding;
+        finding.kind = Kind::SynFlood;
+        finding.value = features.syn;
+        finding.expected = m_expected.at(0);
+        finding.answered = features.synAck;
+        finding.severity = unanswered / kMinFloodSyns;
+        floods.append(finding);
+    }
+    keepStrongest(floods);
+
+    const double rsts = features.rst;
+    if (rsts >= kMinRsts && rsts >= kMinRstShare * features.segments && rstScore > threshold) {
+        Finding finding;
+        finding.kind = Kind::RstStorm;
+        finding.value = rsts;
+        finding.expected = m_expected.at(1);
+        finding.severity = rstScore / threshold;
+        quint32 loudest = 0;
+        for (const Host &host : features.hosts) {
+            if (host.rst > loudest) {
+                loudest = host.rst;
+                finding.host = host.name;
+            }
+        }
+        findings.append(finding);
+    }
+
+    QVector<Finding> halfOpen;
+    QVector<Finding> verticalScans;
+    QVector<Finding> horizontalScans;
+    for (const Host &host : features.hosts) {
+        if (host.syn == 0) {
+            continue;
+        }
+        SourceState *state = sourceState(host.key, second);
+        if (!state) {
+            continue;
+        }
+        const double open = double(host.syn - std::min(host.synAckReceived, host.syn));
+        // Answered probes are ordinary connections, not scanning.
+        const double weight = answersVisible ? open / host.syn : 1.0;
+        state->halfOpen += open;
+        state->verticalProbes += host.probedPorts * weight;
+        state->horizontalProbes += host.probedHosts * (answersVisible ? weight : kOneWayHostProbeWeight);
+
+        Finding finding;
+        finding.host = host.name;
+        bool scanning = false;
+        if (state->verticalProbes >= kVerticalScanTrigger && host.probedPorts > 1) {
+            finding.kind = Kind::VerticalScan;
+            finding.peer = host.probedHost;
+            finding.value = state->verticalProbes;
+            finding.expected = kVerticalScanTrigger;
+            finding.severity = state->verticalProbes / kVerticalScanTrigger;
+            verticalScans.append(finding);
+            scanning = true;
+        }
+        if (state->horizontalProbes >= kHorizontalScanTrigger && host.probedHosts > 1) {
+            finding.kind = Kind::HorizontalScan;
+            finding.peer = QString::number(host.probedPort);
+            finding.value = state->horizontalProbes;
+            finding.expected = kHorizontalScanTrigger;
+            finding.severity = state->horizontalProbes / kHorizontalScanTrigger;
+            horizontalScans.append(finding);
+            scanning = true;
+        }
+        // A SYN scan leaves half-open attempts too; report it once, as a scan.
+        if (!scanning && answersVisible && state->halfOpen >= kHalfOpenTrigger) {
+            finding.kind = Kind::HalfOpen;
+            finding.peer.clear();
+            finding.value = state->halfOpen;
+            finding.expected = kHalfOpenTrigger;
+            finding.answered = host.synAckReceived;
+            finding.severity = state->halfOpen / kHalfOpenTrigger;
+            halfOpen.append(finding);
+        }
+    }
+    keepStrongest(halfOpen);
+    keepStrongest(verticalScans);
+    keepStrongest(horizontalScans);
+    return findings;
+}
+
+void TcpFlagDetectors::clear()
+{
+    m_sources.clear();
+    m_lastSweep = -1;
+    m_synAcksSeen = 0;
+    m_totals.clear();
+}
+
+TcpFlagDetectors::SourceState *TcpFlagDetectors::sourceState(quint64 key, int second)
+{
+    auto it = m_sources.find(key);
+    if (it == m_sources.end()) {
+        if (m_sources.size() >= m_maxSources) {
+            forgetIdleSources(second);
+            if (m_sources.size() >= m_maxSources) {
+                return nullptr;
+            }
+        }
+        it = m_sources.insert(key, SourceState());
+        it->lastSecond = second;
+        return &it.value();
+    }
+
+    const double decay = std::pow(kDecay, std::max(0, second - it->lastSecond));
+    it->lastSecond = second;
+    it->halfOpen *= decay;
+    it->verticalProbes *= decay;
+    it->horizontalProbes *= decay;
+    return &it.value();
+}
+
+void TcpFlagDetectors::forgetIdleSources(int second)
+{
+    // At most one pass a second, however many newcomers find the table full.
+    if (second == m_lastSweep) {
+        return;
+    }
+    m_lastSweep = second;
+    for (auto it = m_sources.begin(); it != m_sources.end();) {
+        const double decay = std::pow(kDecay, std::max(0, second - it->lastSecond));
+        const double level = decay * std::max({it->halfOpen, it->verticalProbes, it->horizontalProbes});
+        if (level < kForgetLevel) {
+            it = m_sources.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
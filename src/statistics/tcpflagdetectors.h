@@ -0,0 +1,89 @@
+#ifndef TCPFLAGDETECTORS_H
+#define TCPFLAGDETECTORS_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "entitybaselines.h"
+
+// Streaming SYN flood, RST storm, half-open and port scan detectors over a
+// per-second TCP flag summary. Per-source state is a bounded table whose
+// counters decay each second, so a flood of spoofed one-packet sources ages
+// out instead of growing the table.
+class TcpFlagDetectors
+{
+public:
+    // What one host sent and received in a second. Probes are SYNs without
+    // ACK, grouped by destination host and by destination port.
+    struct Host {
+        quint64 key = 0;             // stable for the session
+        QString name;
+        quint32 syn = 0;
+        quint32 synAckReceived = 0;
+        quint32 synReceived = 0;
+        quint32 synAckSent = 0;
+        quint32 rst = 0;
+        quint32 probedPorts = 0;     // distinct ports on probedHost
+        QString probedHost;
+        quint32 probedHosts = 0;     // distinct hosts on probedPort
+        quint16 probedPort = 0;
+    };
+
+    struct Features {
+        quint32 segments = 0;
+        quint32 syn = 0;             // SYN without ACK
+        quint32 synAck = 0;
+        quint32 rst = 0;
+        quint32 fin = 0;
+        QVector<Host> hosts;         // bounded; totals above count everything
+    };
+
+    enum class Kind {
+        SynFlood,
+        RstStorm,
+        HalfOpen,
+        VerticalScan,
+        HorizontalScan,
+    };
+
+    struct Finding {
+        Kind kind = Kind::SynFlood;
+        QString host;       // target for SYN floods, sender otherwise; may be empty
+        QString peer;       // scanned host or port
+        double value = 0.0;
+        double expected = 0.0;   // baseline, or the level that triggers
+        quint32 answered = 0;    // SYN/ACKs, for floods and half-open
+        double severity = 1.0;   // how far past the trigger, >= 1
+    };
+
+    static constexpr int kDefaultTrackedSources = 4096;
+
+    explicit TcpFlagDetectors(int maxTrackedSources = kDefaultTrackedSources);
+
+    QVector<Finding> observe(int second, const Features &features, double threshold, int warmup);
+    int trackedSources() const { return int(m_sources.size()); }
+    void clear();
+
+private:
+    struct SourceState {
+        int lastSecond = 0;
+        double halfOpen = 0.0;
+        double verticalProbes = 0.0;
+        double horizontalProbes = 0.0;
+    };
+
+    SourceState *sourceState(quint64 key, int second);
+    void forgetIdleSources(int second);
+
+    int m_maxSources;
+    QHash<quint64, SourceState> m_sources;
+    int m_lastSweep = -1;
+    // Whether the capture sees answers at all; one-way taps never do.
+    quint64 m_synAcksSeen = 0;
+    EntityBaselines m_totals{2};   // unanswered SYNs, RSTs
+    QVector<double> m_scores;
+    QVector<double> m_expected;
+};
+
+#endif // TCPFLAGDETECTORS_H
@@ -0,0 +1,131 @@
+#include "toptalkers.h"
+
+#include <QObject>
+
+namespace {
+// Space-Saving only guarantees keys above total/capacity, so monitor a few
+// times more keys than are reported.
+constexpr int kCapacityFactor = 4;
+constexpr int kMinCapacity = 32;
+constexpr int kSketchWidth = 2048;
+constexpr int kSketchDepth = 4;
+}
+
+TopTalkers::TopTalkers(int k, int windowSeconds)
+{
+    configure(k, windowSeconds);
+}
+
+void TopTalkers::configure(int k, int windowSeconds)
+{
+    m_k = qBound(1, k, 1000);
+    m_windowSeconds = qBound(1, windowSeconds, 3600);
+    m_windowStart = -1;
+    m_packets = 0;
+    m_bytes = 0;
+
+    const int capacity = qMax(kMinCapacity, m_k * kCapacityFactor);
+    m_hitters.clear();
+    for (int i = 0; i < DimensionCount * WeightCount; ++i) {
+        m_hitters.append(HeavyHitters(capacity, kSketchWidth, kSketchDepth));
+    }
+}
+
+void TopTalkers::add(int second,
+                     const QString &protocol,
+                     const QString &src,
+                     const QString &dst,
+                     quint16 dstPort,
+                     quint64 bytes)
+{
+    advanceTo(second);
+    if (m_windowStart < 0) {
+        m_windowStart = second - second % m_windowSeconds;
+    }
+
+    const QString keys[DimensionCount] = {
+        src,
+        dst,
+        src + QStringLiteral(" → ") + dst,
+        dstPort ? protocol + QLatin1Char('/') + QString::number(dstPort) : protocol,
+    };
+    for (int dimension = 0; dimension < DimensionCount; ++dimension) {
+        m_hitters[dimension * WeightCount + Packets].add(keys[dimension], 1);
+        m_hitters[dimension * WeightCount + Bytes].add(keys[dimension], bytes);
+    }
+    m_packets += 1;
+    m_bytes += bytes;
+}
+
+void TopTalkers::advanceTo(int second)
+{
+    if (m_windowStart >= 0 && second >= m_windowStart + m_windowSeconds) {
+        closeWindow();
+    }
+}
+
+void TopTalkers::flush()
+{
+    if (m_windowStart >= 0) {
+        closeWindow();
+    }
+}
+
+QString TopTalkers::dimensionName(Dimension dimension)
+{
+    switch (dimension) {
+    case Source:
+        return QObject::tr("Source");
+    case Destination:
+        return QObject::tr("Destination");
+    case Flow:
+        return QObject::tr("Flow");
+    case Port:
+        return QObject::tr("Port");
+    default:
+        return QString();
+    }
+}
+
+void TopTalkers::closeWindow()
+{
+    Report next;
+    next.revision = m_report.revision + 1;
+    next.windowStart = m_windowStart;
+    next.windowSeconds = m_windowSeconds;
+    next.totalPackets = m_packets;
+    next.totalBytes = m_bytes;
+
+    for (int dimension = 0; dimension < DimensionCount; ++dimension) {
+        const HeavyHitters &byPackets = m_hitters.at(dimension * WeightCount + Packets);
+        const HeavyHitters &byBytes = m_hitters.at(dimension * WeightCount + Bytes);
+        for (int weight = 0; weight < WeightCount; ++weight) {
+            const HeavyHitters &ranked = weight == Packets ? byPackets : byBytes;
+            const HeavyHitters &other = weight == Packets ? byBytes : byPackets;
+            QVector<Entry> &entries = next.entries[dimension][weight];
+            const QVector<HeavyHitters::Item> items = ranked.top(m_k);
+            entries.reserve(items.size());
+            for (const HeavyHitters::Item &item : items) {
+                Entry entry;
+                entry.key = item.key;
+                entry.error = item.error;
+                if (weight == Packets) {
+                    entry.packets = item.count;
+                    entry.bytes = other.estimate(item.key);
+                } else {
+                    entry.bytes = item.count;
+                    entry.packets = other.estimate(item.key);
+                }
+                entries.append(entry);
+            }
+        }
+    }
+
+    for (HeavyHitters &hitters : m_hitters) {
+        hitters.clear();
+    }
+    m_windowStart = -1;
+    m_packets = 0;
+    m_bytes = 0;
+    m_report = std::move(next);
+}
@@ -0,0 +1,91 @@
+#ifndef TOPTALKERS_H
+#define TOPTALKERS_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include "sketches/heavyhitters.h"
+
+// Streaming top-K over tumbling windows of whole seconds. Every dimension is
+// ranked twice, by packets and by bytes, with a Space-Saving sketch each, so
+// memory depends on K and never on how many hosts the capture sees.
+class TopTalkers
+{
+public:
+    enum Dimension {
+        Source,
+        Destination,
+        Flow,        // "src → dst"
+        Port,        // "proto/dstPort"
+        DimensionCount
+    };
+
+    enum Weight {
+        Packets,
+        Bytes,
+        WeightCount
+    };
+
+    struct Entry {
+        QString key;
+        quint64 packets = 0;
+        quint64 bytes = 0;
+        quint64 error = 0;   // upper bound on the overcount of the ranked weight
+    };
+
+    struct Report {
+        quint64 revision = 0;   // 0 until the first window closes
+        int windowStart = -1;   // session second
+        int windowSeconds = 0;
+        quint64 totalPackets = 0;
+        quint64 totalBytes = 0;
+        QVector<Entry> entries[DimensionCount][WeightCount];
+
+        const QVector<Entry> &top(Dimension dimension, Weight weight) const
+        {
+            return entries[dimension][weight];
+        }
+    };
+
+    static constexpr int kDefaultK = 10;
+    static constexpr int kDefaultWindowSeconds = 10;
+
+    explicit TopTalkers(int k = kDefaultK, int windowSeconds = kDefaultWindowSeconds);
+
+    // Packets must arrive with non-decreasing seconds; the few stragglers a
+    // live capture produces are counted in the current window.
+    void add(int second,
+             const QString &protocol,
+             const QString &src,
+             const QString &dst,
+             quint16 dstPort,
+             quint64 bytes);
+    // Drops the open window and restarts with new limits. The last report
+    // and its revision are kept.
+    void configure(int k, int windowSeconds);
+    // Closes the current window if second lies past it.
+    void advanceTo(int second);
+    // Closes the current window early, e.g. when the session ends.
+    void flush();
+
+    int k() const { return m_k; }
+    int windowSeconds() const { return m_windowSeconds; }
+    // The last completed window.
+    const Report &report() const { return m_report; }
+
+    static QString dimensionName(Dimension dimension);
+
+private:
+    void closeWindow();
+
+    int m_k = kDefaultK;
+    int m_windowSeconds = kDefaultWindowSeconds;
+    int m_windowStart = -1;
+    quint64 m_packets = 0;
+    quint64 m_bytes = 0;
+    QVector<HeavyHitters> m_hitters;   // [dimension * WeightCount + weight]
+    Report m_report;
+};
+
+#endif // TOPTALKERS_H
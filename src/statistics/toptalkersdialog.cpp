@@ -0,0 +1,107 @@
+#include "toptalkersdialog.h"
+
+#include <QComboBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+QString percentOf(quint64 value, quint64 total)
+{
+    if (total == 0) {
+        return QStringLiteral("-");
+    }
+    return QString::number(100.0 * double(value) / double(total), 'f', 1) + QLatin1Char('%');
+}
+} // namespace
+
+TopTalkersDialog::TopTalkersDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Top Talkers"));
+    resize(640, 420);
+
+    auto *mainLayout = new QVBoxLayout(this);
+
+    auto *filterLayout = new QHBoxLayout;
+    m_dimensionCombo = new QComboBox;
+    for (int dimension = 0; dimension < TopTalkers::DimensionCount; ++dimension) {
+        m_dimensionCombo->addItem(TopTalkers::dimensionName(TopTalkers::Dimension(dimension)),
+                                  dimension);
+    }
+    m_weightCombo = new QComboBox;
+    m_weightCombo->addItem(tr("By packets"), int(TopTalkers::Packets));
+    m_weightCombo->addItem(tr("By bytes"), int(TopTalkers::Bytes));
+    m_windowLabel = new QLabel(tr("Waiting for the first window…"));
+    filterLayout->addWidget(new QLabel(tr("Group by:")));
+    filterLayout->addWidget(m_dimensionCombo);
+    filterLayout->addWidget(m_weightCombo);
+    filterLayout->addStretch();
+    filterLayout->addWidget(m_windowLabel);
+    mainLayout->addLayout(filterLayout);
+
+    m_table = new QTreeWidget;
+    m_table->setColumnCount(5);
+    m_table->setHeaderLabels({tr("Key"), tr("Packets"), tr("Bytes"), tr("Share"), tr("± Error")});
+    m_table->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    for (int column = 1; column < 5; ++column) {
+        m_table->header()->setSectionResizeMode(column, QHeaderView::ResizeToContents);
+    }
+    m_table->setRootIsDecorated(false);
+    m_table->setSelectionMode(QAbstractItemView::SingleSelection);
+    mainLayout->addWidget(m_table);
+
+    auto *buttonLayout = new QHBoxLayout;
+    auto *closeButton = new QPushButton(tr("Close"));
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(closeButton);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(closeButton, &QPushButton::clicked,
+            this, &QDialog::close);
+    connect(m_dimensionCombo, &QComboBox::currentIndexChanged,
+            this, &TopTalkersDialog::rebuild);
+    connect(m_weightCombo, &QComboBox::currentIndexChanged,
+            this, &TopTalkersDialog::rebuild);
+}
+
+void TopTalkersDialog::setReport(const std::shared_ptr<const TopTalkers::Report> &report)
+{
+    if (!report || report == m_report) {
+        return;
+    }
+    m_report = report;
+    rebuild();
+}
+
+void TopTalkersDialog::rebuild()
+{
+    m_table->clear();
+    if (!m_report) {
+        return;
+    }
+
+    m_windowLabel->setText(tr("Seconds %1–%2")
+                               .arg(m_report->windowStart)
+                               .arg(m_report->windowStart + m_report->windowSeconds));
+
+    const auto dimension = TopTalkers::Dimension(m_dimensionCombo->currentData().toInt());
+    const auto weight = TopTalkers::Weight(m_weightCombo->currentData().toInt());
+    for (const TopTalkers::Entry &entry : m_report->top(dimension, weight)) {
+        const quint64 ranked = weight == TopTalkers::Packets ? entry.packets : entry.bytes;
+        const quint64 total = weight == TopTalkers::Packets ? m_report->totalPackets
+                                                             : m_report->totalBytes;
+        auto *item = new QTreeWidgetItem(m_table);
+        item->setText(0, entry.key);
+        item->setText(1, QString::number(entry.packets));
+        item->setText(2, QString::number(entry.bytes));
+        item->setText(3, percentOf(ranked, total));
+        item->setText(4, entry.error ? QString::number(entry.error) : QString());
+        for (int column = 1; column < 5; ++column) {
+            item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+        }
+    }
+}
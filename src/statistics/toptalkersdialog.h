@@ -0,0 +1,33 @@
+#ifndef TOPTALKERSDIALOG_H
+#define TOPTALKERSDIALOG_H
+
+#include <QDialog>
+#include <memory>
+
+#include "toptalkers.h"
+
+class QComboBox;
+class QLabel;
+class QTreeWidget;
+
+class TopTalkersDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit TopTalkersDialog(QWidget *parent = nullptr);
+
+    // Cheap to call every tick; the table is rebuilt only for a new window.
+    void setReport(const std::shared_ptr<const TopTalkers::Report> &report);
+
+private:
+    void rebuild();
+
+    QComboBox *m_dimensionCombo = nullptr;
+    QComboBox *m_weightCombo = nullptr;
+    QLabel *m_windowLabel = nullptr;
+    QTreeWidget *m_table = nullptr;
+
+    std::shared_ptr<const TopTalkers::Report> m_report;
+};
+
+#endif // TOPTALKERSDIALOG_H
@@ -1,17 +1,48 @@
-QT += core testlib
+QT += core gui widgets sql testlib
 CONFIG += console c++17
 TEMPLATE = app
 TARGET = SniffingTests
 
 SOURCES += ../packets/sniffing.cpp \
+           ../packets/tcpreassembly.cpp \
            ../src/appsettings.cpp \
+           ../src/statistics/sessionstorage.cpp \
+           ../src/statistics/sessionwarehouse.cpp \
+           ../src/statistics/statistics.cpp \
+           ../src/statistics/statisticsaggregator.cpp \
+           ../src/statistics/rowrangeset.cpp \
+           ../src/statistics/statisticsrollup.cpp \
+           ../src/statistics/sketches/countminsketch.cpp \
+           ../src/statistics/sketches/heavyhitters.cpp \
+           ../src/statistics/sketches/hyperloglog.cpp \
+           ../src/statistics/sketches/quantilehistogram.cpp \
+           ../src/statistics/toptalkers.cpp \
+           ../src/statistics/anomalydetector.cpp \
+           ../src/statistics/anomalyrules.cpp \
+           ../src/statistics/beacondetector.cpp \
+           ../src/statistics/dnsanalytics.cpp \
+           ../src/statistics/entitybaselines.cpp \
+           ../src/statistics/incidentcoalescer.cpp \
+           ../src/statistics/incidentrecorder.cpp \
+           ../src/statistics/seasonalbaselines.cpp \
+           ../src/statistics/tcpflagdetectors.cpp \
+           ../src/PacketTableModel.cpp \
            tst_sniffing.cpp \
            tst_appsettings.cpp \
+           tst_statistics.cpp \
+           tst_packettablemodel.cpp \
            test_main.cpp
 
 
-HEADERS += tst_sniffing.h \
-           tst_appsettings.h
+HEADERS += ../src/statistics/statistics.h \
+           ../src/statistics/statisticsaggregator.h \
+           ../src/statistics/anomalydetector.h \
+           ../src/statistics/incidentrecorder.h \
+           ../src/PacketTableModel.h \
+           tst_sniffing.h \
+           tst_appsettings.h \
+           tst_statistics.h \
+           tst_packettablemodel.h
 
 INCLUDEPATH += .. \
                ../protocols \
@@ -1,10 +1,15 @@
+#include <QCoreApplication>
 #include <QTest>
 
 #include "tst_sniffing.h"
 #include "tst_appsettings.h"
+#include "tst_statistics.h"
+#include "tst_packettablemodel.h"
 
 int main(int argc, char **argv)
 {
+    // The aggregator and recorder tests run threads and timers.
+    QCoreApplication app(argc, argv);
     int status = 0;
 
     {
@@ -17,5 +22,15 @@ int main(int argc, char **argv)
         status |= QTest::qExec(&appSettings, argc, argv);
     }
 
+    {
+        StatisticsTest statistics;
+        status |= QTest::qExec(&statistics, argc, argv);
+    }
+
+    {
+        PacketTableModelTest packetTableModel;
+        status |= QTest::qExec(&packetTableModel, argc, argv);
+    }
+
     return status;
 }
\ No newline at end of file
@@ -16,6 +16,7 @@ void AppSettingsTest::defaults() {
     QCOMPARE(app.defaultFilter(), QString());
     QVERIFY(!app.autoStartCapture());
     QVERIFY(app.promiscuousMode());
+    QCOMPARE(app.streamClosedTimeout(), 30);
 }
 
 void AppSettingsTest::roundTrip() {
@@ -32,6 +33,7 @@ void AppSettingsTest::roundTrip() {
     app.setPromiscuousMode(false);
     app.setReportsDirectory("/tmp/reports");
     app.setTheme("Dark");
+    app.setStreamClosedTimeout(5);
 
     QCOMPARE(app.defaultInterface(), QStringLiteral("eth0"));
     QCOMPARE(app.defaultFilter(), QStringLiteral("tcp port 80"));
@@ -39,4 +41,5 @@ void AppSettingsTest::roundTrip() {
     QVERIFY(!app.promiscuousMode());
     QCOMPARE(app.reportsDirectory(), QStringLiteral("/tmp/reports"));
     QCOMPARE(app.theme(), QStringLiteral("Dark"));
+    QCOMPARE(app.streamClosedTimeout(), 5);
 }
@@ -0,0 +1,182 @@
+#include <QtTest/QtTest>
+#include <QSignalSpy>
+
+#include "PacketTableModel.h"
+#include "tst_packettablemodel.h"
+
+static PacketTableRow row(qint64 timeMs, const QString &source, const QString &destination,
+                          const QString &protocol, int length, const QString &info)
+{
+    PacketTableRow row;
+    row.timeMs = timeMs;
+    row.source = source;
+    row.destination = destination;
+    row.protocol = protocol;
+    row.length = length;
+    row.info = info;
+    row.rawData = QByteArray(length, '\0');
+    return row;
+}
+
+static void fill(PacketTableModel &model)
+{
+    model.addPacket(row(0, "192.0.2.1", "192.0.2.2", "TCP", 60, "1234 -> 80 [SYN]"));
+    model.addPacket(row(1500, "192.0.2.2", "192.0.2.1", "TCP", 60, "80 -> 1234 [SYN, ACK]"));
+    model.addPacket(row(2250, "192.0.2.1", "198.51.100.53", "DNS", 74, "Standard query A example.com"));
+}
+
+void PacketTableModelTest::readsFieldsAcrossRows()
+{
+    PacketTableModel model;
+    fill(model);
+
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(model.columnCount(), int(ColumnCount));
+    QCOMPARE(model.text(0, ColumnNumber), QString("1"));
+    QCOMPARE(model.text(2, ColumnNumber), QString("3"));
+    QCOMPARE(model.text(1, ColumnTime), QString("1.500"));
+    QCOMPARE(model.text(2, ColumnDestination), QString("198.51.100.53"));
+    QCOMPARE(model.text(2, ColumnProtocol), QString("DNS"));
+    QCOMPARE(model.text(2, ColumnLength), QString("74"));
+    QCOMPARE(model.data(model.index(1, ColumnSource)).toString(), QString("192.0.2.2"));
+
+    // Info texts share one buffer; each row reads back only its own.
+    QCOMPARE(model.info(0).toString(), QString("1234 -> 80 [SYN]"));
+    QCOMPARE(model.info(1).toString(), QString("80 -> 1234 [SYN, ACK]"));
+    QCOMPARE(model.info(2).toString(), QString("Standard query A example.com"));
+    QCOMPARE(model.text(1, ColumnInfo), QString("80 -> 1234 [SYN, ACK]"));
+    QCOMPARE(model.rawData(2).size(), 74);
+
+    QCOMPARE(model.text(3, ColumnSource), QString());
+    QVERIFY(model.info(-1).isEmpty());
+    QCOMPARE(model.length(3), 0);
+    QVERIFY(model.rawData(3).isEmpty());
+}
+
+void PacketTableModelTest::internsAddresses()
+{
+    PacketTableModel model;
+    fill(model);
+
+    QCOMPARE(model.sourceId(0), model.sourceId(2));
+    QCOMPARE(model.sourceId(0), model.destinationId(1));
+    QCOMPARE(model.sourceId(1), model.destinationId(0));
+    QVERIFY(model.sourceId(0) != model.sourceId(1));
+    QVERIFY(model.destinationId(2) != model.destinationId(0));
+    QCOMPARE(model.source(2), QString("192.0.2.1"));
+}
+
+void PacketTableModelTest::findRowWraps()
+{
+    PacketTableModel model;
+    fill(model);
+
+    QCOMPARE(model.findRow("SYN", 0), 0);
+    QCOMPARE(model.findRow("SYN", 1), 1);
+    // Past the last match the search wraps to the start.
+    QCOMPARE(model.findRow("SYN", 2), 0);
+    QCOMPARE(model.findRow("dns", 0), 2);
+    QCOMPARE(model.findRow("198.51", 1), 2);
+    QCOMPARE(model.findRow("example", 5), 2);
+    QCOMPARE(model.findRow("absent", 0), -1);
+    // Numeric columns compare values, not digits.
+    QCOMPARE(model.findRow("74", 0), 2);
+    QCOMPARE(model.findRow("1.5", 0), 1);
+    QCOMPARE(model.findRow("2.25", 0), 2);
+    QCOMPARE(model.findRow("2.251", 0), -1);
+    QCOMPARE(model.findRow(QString(), 0), -1);
+    QCOMPARE(PacketTableModel().findRow("SYN", 0), -1);
+}
+
+void PacketTableModelTest::setRowBackground()
+{
+    PacketTableModel model;
+    fill(model);
+    QSignalSpy spy(&model, &QAbstractItemModel::dataChanged);
+
+    QVERIFY(!model.background(1).isValid());
+    QVERIFY(!model.data(model.index(1, ColumnInfo), Qt::BackgroundRole).isValid());
+
+    model.setRowBackground(1, QColor(Qt::red));
+    QCOMPARE(spy.count(), 1);
+    const QList<QVariant> arguments = spy.takeFirst();
+    QCOMPARE(arguments.at(0).toModelIndex(), model.index(1, 0));
+    QCOMPARE(arguments.at(1).toModelIndex(), model.index(1, ColumnCount - 1));
+    QCOMPARE(arguments.at(2).value<QList<int>>(), QList<int>{Qt::BackgroundRole});
+    QCOMPARE(model.background(1), QColor(Qt::red));
+    QCOMPARE(model.data(model.index(1, ColumnInfo), Qt::BackgroundRole).value<QColor>(), QColor(Qt::red));
+    QVERIFY(!model.background(0).isValid());
+
+    // The same colour again changes nothing.
+    model.setRowBackground(1, QColor(Qt::red));
+    QCOMPARE(spy.count(), 0);
+
+    model.setRowBackground(1, QColor());
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(!model.background(1).isValid());
+
+    model.setRowBackground(3, QColor(Qt::red));
+    QCOMPARE(spy.count(), 1);
+}
+
+void PacketTableModelTest::clear()
+{
+    PacketTableModel model;
+    fill(model);
+    model.setRowBackground(0, QColor(Qt::blue));
+    QSignalSpy reset(&model, &QAbstractItemModel::modelReset);
+
+    model.clear();
+    QCOMPARE(reset.count(), 1);
+    QCOMPARE(model.rowCount(), 0);
+    QCOMPARE(model.text(0, ColumnSource), QString());
+    QCOMPARE(model.findRow("SYN", 0), -1);
+
+    // Interned tables start over, so ids restart from the first address.
+    model.addPacket(row(0, "203.0.113.9", "192.0.2.1", "UDP", 42, "53 -> 5353"));
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(model.sourceId(0), quint32(0));
+    QCOMPARE(model.destinationId(0), quint32(1));
+    QCOMPARE(model.info(0).toString(), QString("53 -> 5353"));
+    QVERIFY(!model.background(0).isValid());
+}
+
+void PacketTableModelTest::rowLimitDropsOldestRows()
+{
+    PacketTableModel model;
+    model.setRowLimit(8);
+    QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+    for (int i = 0; i < 20; ++i) {
+        model.addPacket(row(i * 10, QString("10.0.%1.1").arg(i), "192.0.2.1", "UDP", 100 + i,
+                            QString("packet %1").arg(i)));
+        QVERIFY(model.rowCount() <= 8);
+    }
+    QVERIFY(removed.count() > 0);
+    QCOMPARE(model.rowCount(), 8);
+    QCOMPARE(model.firstPacket(), 12);
+    // Numbers keep counting packets, not rows.
+    QCOMPARE(model.text(0, ColumnNumber), QString("13"));
+    QCOMPARE(model.info(0).toString(), QString("packet 12"));
+    QCOMPARE(model.info(7).toString(), QString("packet 19"));
+    QCOMPARE(model.source(0), QString("10.0.12.1"));
+    QCOMPARE(model.length(7), 119);
+    QCOMPARE(model.findRow("13", 0), 0);
+
+    // Addresses of dropped rows are forgotten once they outnumber the rest.
+    for (int i = 20; i < 3000; ++i) {
+        model.addPacket(row(i * 10, QString("10.%1.%2.1").arg(i / 256).arg(i % 256), "192.0.2.1",
+                            "UDP", 100, QString()));
+    }
+    QCOMPARE(model.firstPacket() + model.rowCount(), 3000);
+    QCOMPARE(model.source(model.rowCount() - 1), QString("10.11.183.1"));
+    QCOMPARE(model.destinationId(0), model.destinationId(model.rowCount() - 1));
+    QVERIFY(model.sourceId(0) < 2000);
+
+    model.clear();
+    QCOMPARE(model.firstPacket(), 0);
+    QCOMPARE(model.rowLimit(), 8);
+    model.setRowLimit(0);
+    for (int i = 0; i < 20; ++i)
+        model.addPacket(row(i, "192.0.2.1", "192.0.2.2", "TCP", 60, QString()));
+    QCOMPARE(model.rowCount(), 20);
+}
@@ -0,0 +1,18 @@
+#ifndef TST_PACKETTABLEMODEL_H
+#define TST_PACKETTABLEMODEL_H
+
+#include <QObject>
+
+class PacketTableModelTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void readsFieldsAcrossRows();
+    void internsAddresses();
+    void findRowWraps();
+    void setRowBackground();
+    void clear();
+    void rowLimitDropsOldestRows();
+};
+
+#endif // TST_PACKETTABLEMODEL_H
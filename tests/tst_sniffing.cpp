@@ -1,6 +1,7 @@
 #include <QtTest/QtTest>
 #include "packets/sniffing.h"
 #include "packets/packethelpers.h"
+#include "packets/flowtable.h"
 #include "tst_sniffing.h"
 #include <netinet/in.h>
 
@@ -464,6 +465,41 @@ static QByteArray tlsClientHelloPacket()
     return pkt;
 }
 
+static QByteArray tcpDataPacket(quint32 seq,
+                                quint8 flags,
+                                const QByteArray &payload,
+                                quint16 srcPort = 40000)
+{
+    sniff_ethernet eth{};
+    memcpy(eth.ether_dhost, "\x00\x11\x22\x33\x44\x55", 6);
+    memcpy(eth.ether_shost, "\x66\x77\x88\x99\xAA\xBB", 6);
+    eth.ether_type = htons(ETHERTYPE_IP);
+
+    sniff_ip ip{};
+    ip.ip_vhl = (4 << 4) | 5;
+    ip.ip_len = htons(sizeof(sniff_ip) + sizeof(sniff_tcp) + payload.size());
+    ip.ip_ttl = 64;
+    ip.ip_p = IPPROTO_TCP;
+    ip.ip_src.s_addr = inet_addr("192.0.2.10");
+    ip.ip_dst.s_addr = inet_addr("192.0.2.20");
+
+    sniff_tcp tcp{};
+    tcp.th_sport = htons(srcPort);
+    tcp.th_dport = htons(80);
+    tcp.th_seq = htonl(seq);
+    tcp.th_ack = htonl(1);
+    tcp.th_offx2 = (5 << 4);
+    tcp.th_flags = flags;
+    tcp.th_win = htons(8192);
+
+    QByteArray pkt;
+    pkt.append(reinterpret_cast<const char*>(&eth), sizeof(eth));
+    pkt.append(reinterpret_cast<const char*>(&ip), sizeof(ip));
+    pkt.append(reinterpret_cast<const char*>(&tcp), sizeof(tcp));
+    pkt.append(payload);
+    return pkt;
+}
+
 void SniffingTest::parseTcpIpv4()
 {
     Sniffing s;
@@ -609,4 +645,178 @@ void SniffingTest::parseGre()
     QCOMPARE(vals.at(0), QStringLiteral("0X2001"));
     QCOMPARE(vals.at(1), QStringLiteral("1"));
     QCOMPARE(vals.at(2), QStringLiteral("0X0800"));
-}
\ No newline at end of file
+}
+
+void SniffingTest::reassembleTcpStream()
+{
+    Sniffing s;
+    s.resetStreams();
+
+    Sniffing::recordStreamSegment(tcpDataPacket(100, TH_SYN, QByteArray()), DLT_EN10MB, 1, 0);
+    Sniffing::recordStreamSegment(tcpDataPacket(107, TH_ACK, QByteArray("World")), DLT_EN10MB, 1, 10);
+    Sniffing::recordStreamSegment(tcpDataPacket(101, TH_ACK, QByteArray("Hello ")), DLT_EN10MB, 1, 20);
+    Sniffing::recordStreamSegment(tcpDataPacket(101, TH_ACK, QByteArray("Hello ")), DLT_EN10MB, 1, 30);
+
+    const auto streams = s.getStreamConversations();
+    QCOMPARE(streams.size(), 1);
+    const auto &conv = streams.first();
+    QCOMPARE(conv.aggregatedAToB.toByteArray(), QByteArray("Hello World"));
+    QCOMPARE(conv.segments.size(), 4);
+    QVERIFY(conv.segments.at(1).outOfOrder);
+    QVERIFY(conv.segments.at(3).retransmission);
+    QCOMPARE(conv.reassemblyAToB.retransmittedBytes(), quint64(6));
+    QVERIFY(conv.reassemblyAToB.holes().isEmpty());
+    QCOMPARE(Sniffing::reassemblyBufferedBytes(), qint64(0));
+
+    s.resetStreams();
+}
+
+void SniffingTest::reassemblyBudgetDropsLargestFlow()
+{
+    Sniffing s;
+    s.resetStreams();
+    const qint64 defaultBudget = Sniffing::reassemblyMemoryBudget();
+    const quint64 evictionsBefore = Sniffing::reassemblyEvictedFlows();
+    Sniffing::setReassemblyMemoryBudget(20);
+
+    // Both flows queue data behind a ten-byte hole; together they exceed
+    // the budget, so the larger one drops its queue.
+    Sniffing::recordStreamSegment(tcpDataPacket(100, TH_SYN, QByteArray(), 42000), DLT_EN10MB, 1, 0);
+    Sniffing::recordStreamSegment(tcpDataPacket(111, TH_ACK, QByteArray("0123456789"), 42000), DLT_EN10MB, 1, 10);
+    Sniffing::recordStreamSegment(tcpDataPacket(100, TH_SYN, QByteArray(), 42001), DLT_EN10MB, 1, 20);
+    Sniffing::recordStreamSegment(tcpDataPacket(111, TH_ACK, QByteArray("abcdefghijklmno"), 42001), DLT_EN10MB, 1, 30);
+    QCOMPARE(Sniffing::reassemblyBufferedBytes(), qint64(10));
+    QCOMPARE(Sniffing::reassemblyEvictedFlows(), evictionsBefore + 1);
+
+    // The evicted flow carries on after the dropped bytes.
+    Sniffing::recordStreamSegment(tcpDataPacket(126, TH_ACK, QByteArray("xy"), 42001), DLT_EN10MB, 1, 40);
+    for (const auto &conv : s.getStreamConversations()) {
+        if (conv.endpointA.port == 42001) {
+            QCOMPARE(conv.aggregatedAToB.toByteArray(), QByteArray("xy"));
+            QCOMPARE(conv.reassemblyAToB.skippedBytes(), quint64(25));
+            QCOMPARE(conv.reassemblyAToB.bufferedBytes(), qint64(0));
+        } else {
+            QCOMPARE(conv.reassemblyAToB.bufferedBytes(), qint64(10));
+        }
+    }
+
+    // Closing a flow releases what it still queues.
+    Sniffing::recordStreamSegment(tcpDataPacket(121, TH_RST, QByteArray(), 42000), DLT_EN10MB, 1, 50);
+    QCOMPARE(Sniffing::reassemblyBufferedBytes(), qint64(0));
+
+    Sniffing::setReassemblyMemoryBudget(defaultBudget);
+    s.resetStreams();
+}
+
+void SniffingTest::flowTableLookup()
+{
+    const quint8 a[4] = {192, 0, 2, 1};
+    const quint8 b[4] = {192, 0, 2, 2};
+    bool forwardIsA = false;
+    bool reverseIsA = true;
+    const FlowKey forward = FlowKey::make(4, IPPROTO_TCP, a, 1234, b, 80, 4, &forwardIsA);
+    const FlowKey reverse = FlowKey::make(4, IPPROTO_TCP, b, 80, a, 1234, 4, &reverseIsA);
+    QVERIFY(forward == reverse);
+    QVERIFY(forwardIsA);
+    QVERIFY(!reverseIsA);
+    QCOMPARE(forward.shardIndex(4), reverse.shardIndex(4));
+
+    FlowTable<int> table;
+    for (quint16 port = 1; port <= 500; ++port)
+        table.findOrInsert(FlowKey::make(4, IPPROTO_UDP, a, port, b, 53, 4)) = port;
+    QCOMPARE(table.size(), 500);
+    QVERIFY(table.remove(FlowKey::make(4, IPPROTO_UDP, a, 250, b, 53, 4)));
+    QVERIFY(!table.find(FlowKey::make(4, IPPROTO_UDP, a, 250, b, 53, 4)));
+    QCOMPARE(*table.find(FlowKey::make(4, IPPROTO_UDP, b, 53, a, 500, 4)), 500);
+    QCOMPARE(table.size(), 499);
+}
+
+void SniffingTest::expireStreams()
+{
+    Sniffing s;
+    s.resetStreams();
+    const Sniffing::StreamLimits defaults = Sniffing::streamLimits();
+
+    Sniffing::StreamLimits limits;
+    limits.idleTimeoutSec = 10;
+    limits.activeTimeoutSec = 0;
+    limits.closedTimeoutSec = 5;
+    limits.memoryBudgetBytes = 0;
+    Sniffing::setStreamLimits(limits);
+
+    Sniffing::recordStreamSegment(tcpDataPacket(1, TH_SYN, QByteArray(), 40000), DLT_EN10MB, 100, 0);
+    Sniffing::recordStreamSegment(tcpDataPacket(2, TH_RST, QByteArray(), 40000), DLT_EN10MB, 101, 0);
+    Sniffing::recordStreamSegment(tcpDataPacket(1, TH_ACK, QByteArray("data"), 40001), DLT_EN10MB, 100, 0);
+    QCOMPARE(s.getStreamConversations().size(), 2);
+
+    Sniffing::recordStreamSegment(tcpDataPacket(1, TH_ACK, QByteArray("more data"), 40002), DLT_EN10MB, 107, 0);
+    auto stats = Sniffing::streamTableStats();
+    QCOMPARE(stats.activeFlows, 2);
+    QCOMPARE(stats.expiredFlows, quint64(1));
+
+    Sniffing::recordStreamSegment(tcpDataPacket(10, TH_ACK, QByteArray(), 40002), DLT_EN10MB, 111, 0);
+    stats = Sniffing::streamTableStats();
+    QCOMPARE(stats.activeFlows, 1);
+    QCOMPARE(stats.expiredFlows, quint64(2));
+    QVERIFY(stats.expiredBytes > 0);
+
+    limits.memoryBudgetBytes = stats.bytesInUse + 1;
+    Sniffing::setStreamLimits(limits);
+    Sniffing::recordStreamSegment(tcpDataPacket(1, TH_SYN, QByteArray(), 40003), DLT_EN10MB, 111, 0);
+    stats = Sniffing::streamTableStats();
+    QCOMPARE(stats.evictedFlows, quint64(1));
+    const auto streams = s.getStreamConversations();
+    QCOMPARE(streams.size(), 1);
+    QCOMPARE(streams.first().endpointA.port, quint16(40003));
+    QCOMPARE(stats.bytesInUse, streams.first().memoryBytes);
+
+    Sniffing::setStreamLimits(defaults);
+    s.resetStreams();
+}
+
+void SniffingTest::streamDeltas()
+{
+    Sniffing s;
+    s.resetStreams();
+
+    Sniffing::recordStreamSegment(tcpDataPacket(1, TH_SYN, QByteArray(), 41000), DLT_EN10MB, 200, 0);
+    Sniffing::recordStreamSegment(tcpDataPacket(1, TH_SYN, QByteArray(), 41001), DLT_EN10MB, 200, 5);
+
+    auto delta = Sniffing::streamChangesSince(0);
+    QVERIFY(delta.reset);
+    QCOMPARE(delta.changed.size(), 2);
+    const quint64 firstId = delta.changed.at(0).endpointA.port == 41000
+        ? delta.changed.at(0).id : delta.changed.at(1).id;
+
+    delta = Sniffing::streamChangesSince(delta.revision);
+    QVERIFY(!delta.reset);
+    QVERIFY(delta.changed.isEmpty());
+
+    for (int i = 0; i < 3; ++i)
+        Sniffing::recordStreamSegment(tcpDataPacket(2 + i, TH_ACK, QByteArray("x"), 41000), DLT_EN10MB, 201, i);
+    delta = Sniffing::streamChangesSince(delta.revision);
+    QCOMPARE(delta.changed.size(), 1);
+    QCOMPARE(delta.changed.first().id, firstId);
+    QCOMPARE(delta.changed.first().packetCount, 4);
+
+    Sniffing::StreamConversation conversation;
+    QVERIFY(Sniffing::streamConversation(firstId, &conversation));
+    QCOMPARE(conversation.aggregatedAToB.toByteArray(), QByteArray("xxx"));
+
+    // A copy keeps its bytes while the flow grows past a buffer chunk.
+    Sniffing::recordStreamSegment(tcpDataPacket(5, TH_ACK, QByteArray(40000, 'y'), 41000), DLT_EN10MB, 202, 0);
+    Sniffing::recordStreamSegment(tcpDataPacket(40005, TH_ACK, QByteArray(40000, 'z'), 41000), DLT_EN10MB, 202, 1);
+    QCOMPARE(conversation.aggregatedAToB.toByteArray(), QByteArray("xxx"));
+    Sniffing::StreamConversation grown;
+    QVERIFY(Sniffing::streamConversation(firstId, &grown));
+    QCOMPARE(grown.aggregatedAToB.size(), qint64(80003));
+    QCOMPARE(grown.aggregatedAToB.toByteArray(),
+             QByteArray("xxx") + QByteArray(40000, 'y') + QByteArray(40000, 'z'));
+
+    const quint64 cursor = delta.revision;
+    s.resetStreams();
+    delta = Sniffing::streamChangesSince(cursor);
+    QVERIFY(delta.reset);
+    QVERIFY(delta.changed.isEmpty());
+    QVERIFY(!Sniffing::streamConversation(firstId, nullptr));
+}
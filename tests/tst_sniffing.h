@@ -20,6 +20,11 @@ private slots:
     void parseSctp();
     void parseUdplite();
     void parseGre();
+    void reassembleTcpStream();
+    void reassemblyBudgetDropsLargestFlow();
+    void flowTableLookup();
+    void expireStreams();
+    void streamDeltas();
 };
 
 #endif // TST_SNIFFING_H
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <QDate>
 #include <QDateTime>
+#include <QDir>
 #include <QTime>
 #include <QFile>
 #include <QFileInfo>
@@ -13,8 +14,28 @@
 #include <QTest>
 
 #include "../src/statistics/statistics.h"
+#include "../src/statistics/statisticsaggregator.h"
+#include "../src/statistics/statisticsrollup.h"
 #include "../src/statistics/sessionstorage.h"
+#include "../src/statistics/sessionwarehouse.h"
 #include "../src/statistics/anomalydetector.h"
+#include "../src/statistics/anomalyrules.h"
+#include "../src/statistics/beacondetector.h"
+#include "../src/statistics/dnsanalytics.h"
+#include "../src/statistics/entitybaselines.h"
+#include "../src/statistics/incidentcoalescer.h"
+#include "../src/statistics/incidentrecorder.h"
+#include "../src/statistics/tcpflagdetectors.h"
+#include "../src/statistics/rowrangeset.h"
+#include "../src/statistics/seasonalbaselines.h"
+#include "../src/statistics/sketches/heavyhitters.h"
+#include "../src/statistics/sketches/hyperloglog.h"
+#include "../src/statistics/sketches/quantilehistogram.h"
+#include "../src/statistics/toptalkers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 void StatisticsTest::aggregatesAndSaves()
 {
@@ -169,4 +190,1060 @@ void StatisticsTest::loadSessionRoundTrip()
     QVERIFY(loaded.has_value());
     QVERIFY(loaded->statsDocument.isObject());
     QVERIFY(!loaded->packets.isEmpty());
-}
\ No newline at end of file
+}
+
+void StatisticsTest::compactsOldSeconds()
+{
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    Statistics stats(start);
+
+    const int seconds = 120;
+    for (int i = 0; i < seconds; ++i) {
+        stats.recordPacket(start.addSecs(i),
+                           QStringLiteral("TCP"),
+                           QStringLiteral("10.0.0.1"),
+                           QStringLiteral("10.0.0.%1").arg(2 + i % 3),
+                           100,
+                           i);
+    }
+    // Straggler for a second that has long left the live window.
+    stats.recordPacket(start.addSecs(5),
+                       QStringLiteral("UDP"),
+                       QStringLiteral("10.0.0.9"),
+                       QStringLiteral("10.0.0.1"),
+                       40,
+                       seconds);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(stats.SaveStatsToJson(dir.path(), true));
+
+    QFile file(stats.lastFilePath());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonArray perSecond = QJsonDocument::fromJson(file.readAll())
+        .object().value(QStringLiteral("perSecond")).toArray();
+    QCOMPARE(perSecond.size(), seconds);
+
+    for (int i = 0; i < seconds; ++i) {
+        const QJsonObject entry = perSecond.at(i).toObject();
+        QCOMPARE(entry.value(QStringLiteral("second")).toInt(), i);
+        const QJsonArray connections = entry.value(QStringLiteral("connections")).toArray();
+        if (i == 5) {
+            QCOMPARE(entry.value(QStringLiteral("pps")).toDouble(), 2.0);
+            QCOMPARE(entry.value(QStringLiteral("bps")).toDouble(), 140.0);
+            QCOMPARE(entry.value(QStringLiteral("protocolCounts")).toObject()
+                         .value(QStringLiteral("UDP")).toInt(), 1);
+            QCOMPARE(connections.size(), 2);
+        } else {
+            QCOMPARE(entry.value(QStringLiteral("pps")).toDouble(), 1.0);
+            QCOMPARE(connections.size(), 1);
+            const QJsonObject conn = connections.at(0).toObject();
+            QCOMPARE(conn.value(QStringLiteral("src")).toString(), QStringLiteral("10.0.0.1"));
+            QCOMPARE(conn.value(QStringLiteral("dst")).toString(),
+                     QStringLiteral("10.0.0.%1").arg(2 + i % 3));
+        }
+    }
+    file.close();
+
+    // Later saves append to the same file; a straggler for a second that is
+    // already written is dropped.
+    const int more = 20;
+    for (int i = seconds; i < seconds + more; ++i) {
+        stats.recordPacket(start.addSecs(i),
+                           QStringLiteral("TCP"),
+                           QStringLiteral("10.0.0.1"),
+                           QStringLiteral("10.0.0.2"),
+                           100,
+                           i + 1);
+        if (i % 5 == 0) {
+            QVERIFY(stats.SaveStatsToJson(dir.path()));
+        }
+    }
+    stats.recordPacket(start.addSecs(6),
+                       QStringLiteral("UDP"),
+                       QStringLiteral("10.0.0.9"),
+                       QStringLiteral("10.0.0.1"),
+                       40,
+                       seconds + more + 1);
+    QVERIFY(stats.SaveStatsToJson(dir.path(), true));
+
+    QCOMPARE(QDir(dir.path()).entryList({QStringLiteral("*.json")}, QDir::Files).size(), 1);
+    QFile appended(stats.lastFilePath());
+    QVERIFY(appended.open(QIODevice::ReadOnly));
+    const QJsonArray allSeconds = QJsonDocument::fromJson(appended.readAll())
+        .object().value(QStringLiteral("perSecond")).toArray();
+    QCOMPARE(allSeconds.size(), seconds + more);
+    for (int i = 0; i < seconds + more; ++i) {
+        QCOMPARE(allSeconds.at(i).toObject().value(QStringLiteral("second")).toInt(), i);
+    }
+    QCOMPARE(allSeconds.at(5).toObject().value(QStringLiteral("pps")).toDouble(), 2.0);
+    QCOMPARE(allSeconds.at(6).toObject().value(QStringLiteral("pps")).toDouble(), 1.0);
+}
+
+void StatisticsTest::aggregatorPublishesSnapshots()
+{
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    StatisticsAggregator aggregator(start);
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            aggregator.recordPacket(start.addSecs(i),
+                                    QStringLiteral("TCP"),
+                                    QStringLiteral("10.0.0.1"),
+                                    QStringLiteral("10.0.0.2"),
+                                    100,
+                                    i * 10 + j);
+        }
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(aggregator.saveNow(dir.path(), true));
+
+    const auto snapshot = aggregator.latestSnapshot();
+    QVERIFY(snapshot);
+    QVERIFY(snapshot->saveOk);
+    QCOMPARE(snapshot->lastSecond.second, 2);
+    QCOMPARE(snapshot->lastSecond.packets, quint64(3));
+    QCOMPARE(snapshot->totalPackets, quint64(6));
+    QCOMPARE(snapshot->totalBytes, quint64(600));
+    QCOMPARE(aggregator.lastFilePath(), snapshot->lastFilePath);
+    QVERIFY(QFile::exists(aggregator.lastFilePath()));
+}
+
+void StatisticsTest::tracksSubSecondBursts()
+{
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    Statistics stats(start);
+    stats.setBurstBucketMs(3);
+    QCOMPARE(stats.burstBucketMs(), 2);
+    stats.setBurstBucketMs(10);
+
+    // Five packets inside one 10 ms bucket, then a lone one later on.
+    for (int i = 0; i < 5; ++i) {
+        stats.recordPacket(start.addMSecs(500 + i),
+                           QStringLiteral("UDP"),
+                           QStringLiteral("10.0.0.1"),
+                           QStringLiteral("10.0.0.2"),
+                           1000,
+                           i);
+    }
+    stats.recordPacket(start.addMSecs(900),
+                       QStringLiteral("UDP"),
+                       QStringLiteral("10.0.0.1"),
+                       QStringLiteral("10.0.0.2"),
+                       1000,
+                       5);
+
+    const auto bursts = stats.recentBursts();
+    QCOMPARE(bursts.size(), 2);
+    QCOMPARE(bursts.at(0).startMs, qint64(500));
+    QCOMPARE(bursts.at(0).packets, quint32(5));
+    QCOMPARE(bursts.at(1).startMs, qint64(900));
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(stats.SaveStatsToJson(dir.path(), true));
+
+    QFile file(stats.lastFilePath());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    const QJsonObject first = root.value(QStringLiteral("perSecond")).toArray().at(0).toObject();
+    QCOMPARE(first.value(QStringLiteral("pps")).toDouble(), 6.0);
+    QCOMPARE(first.value(QStringLiteral("peakBucketPackets")).toDouble(), 5.0);
+    QCOMPARE(first.value(QStringLiteral("peakBucketBytes")).toDouble(), 5000.0);
+    const QJsonObject burstObj = root.value(QStringLiteral("bursts")).toObject();
+    QCOMPARE(burstObj.value(QStringLiteral("bucketMs")).toInt(), 10);
+    QCOMPARE(burstObj.value(QStringLiteral("packets")).toArray().size(), 2);
+}
+
+void StatisticsTest::hyperLogLogEstimates()
+{
+    HyperLogLog small;
+    for (int i = 0; i < 20; ++i) {
+        small.add(HyperLogLog::hash(quint64(i)));
+        small.add(HyperLogLog::hash(quint64(i)));
+    }
+    QCOMPARE(small.count(), 20);
+
+    HyperLogLog first(12);
+    HyperLogLog second(12);
+    for (quint64 i = 0; i < 60000; ++i) {
+        first.add(HyperLogLog::hash(i));
+    }
+    for (quint64 i = 30000; i < 100000; ++i) {
+        second.add(HyperLogLog::hash(i));
+    }
+    QVERIFY(qAbs(first.estimate() - 60000.0) / 60000.0 < 0.05);
+
+    first.merge(second);
+    QVERIFY(qAbs(first.estimate() - 100000.0) / 100000.0 < 0.05);
+}
+
+void StatisticsTest::sketchesBoundConnectionTracking()
+{
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    Statistics stats(start);
+
+    // A scan that touches far more peers than one second tracks exactly.
+    const int peers = 20000;
+    for (int i = 0; i < peers; ++i) {
+        stats.recordPacket(start,
+                           QStringLiteral("TCP"),
+                           QStringLiteral("192.0.2.1"),
+                           QStringLiteral("10.%1.%2.1").arg(i / 256).arg(i % 256),
+                           60,
+                           -1);
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(stats.SaveStatsToJson(dir.path(), true));
+
+    QFile file(stats.lastFilePath());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    const QJsonObject first = root.value(QStringLiteral("perSecond")).toArray().at(0).toObject();
+    QVERIFY(first.value(QStringLiteral("connectionsTruncated")).toBool());
+    QVERIFY(first.value(QStringLiteral("connections")).toArray().size() < peers);
+    const double estimate = first.value(QStringLiteral("uniqueConnections")).toDouble();
+    QVERIFY(qAbs(estimate - peers) / peers < 0.05);
+}
+
+void StatisticsTest::heavyHittersFindTopKeys()
+{
+    HeavyHitters hitters(16, 256);
+    // Five heavy keys inside a long tail of one-off keys.
+    for (int round = 0; round < 200; ++round) {
+        for (int heavy = 0; heavy < 5; ++heavy) {
+            hitters.add(QStringLiteral("heavy-%1").arg(heavy), quint64(heavy + 1));
+        }
+        for (int tail = 0; tail < 10; ++tail) {
+            hitters.add(QStringLiteral("tail-%1-%2").arg(round).arg(tail));
+        }
+    }
+    QCOMPARE(hitters.total(), quint64(200 * (15 + 10)));
+
+    const QVector<HeavyHitters::Item> top = hitters.top(5);
+    QCOMPARE(top.size(), 5);
+    for (int i = 0; i < top.size(); ++i) {
+        QCOMPARE(top.at(i).key, QStringLiteral("heavy-%1").arg(4 - i));
+        const quint64 exact = quint64(200 * (5 - i));
+        QVERIFY(top.at(i).count >= exact);
+        QVERIFY(top.at(i).count - top.at(i).error <= exact);
+    }
+    QVERIFY(hitters.estimate(QStringLiteral("tail-0-0")) >= 1);
+}
+
+void StatisticsTest::topTalkersReportWindows()
+{
+    TopTalkers talkers(2, 5);
+    for (int second = 0; second < 5; ++second) {
+        talkers.add(second, QStringLiteral("TCP"), QStringLiteral("10.0.0.1"),
+                    QStringLiteral("10.0.0.9"), 443, 1500);
+        talkers.add(second, QStringLiteral("TCP"), QStringLiteral("10.0.0.1"),
+                    QStringLiteral("10.0.0.9"), 443, 1500);
+        talkers.add(second, QStringLiteral("UDP"), QStringLiteral("10.0.0.2"),
+                    QStringLiteral("10.0.0.8"), 53, 80);
+        talkers.add(second, QStringLiteral("UDP"), QStringLiteral("10.0.0.3"),
+                    QStringLiteral("10.0.0.8"), 5353, 9000);
+    }
+    QCOMPARE(talkers.report().revision, quint64(0));
+
+    talkers.advanceTo(5);
+    const TopTalkers::Report &report = talkers.report();
+    QCOMPARE(report.revision, quint64(1));
+    QCOMPARE(report.windowStart, 0);
+    QCOMPARE(report.totalPackets, quint64(20));
+
+    const auto &byPackets = report.top(TopTalkers::Source, TopTalkers::Packets);
+    QCOMPARE(byPackets.size(), 2);
+    QCOMPARE(byPackets.first().key, QStringLiteral("10.0.0.1"));
+    QCOMPARE(byPackets.first().packets, quint64(10));
+    QCOMPARE(byPackets.first().bytes, quint64(15000));
+
+    const auto &byBytes = report.top(TopTalkers::Source, TopTalkers::Bytes);
+    QCOMPARE(byBytes.first().key, QStringLiteral("10.0.0.3"));
+    QCOMPARE(byBytes.first().bytes, quint64(45000));
+
+    QCOMPARE(report.top(TopTalkers::Port, TopTalkers::Packets).first().key,
+             QStringLiteral("TCP/443"));
+    QCOMPARE(report.top(TopTalkers::Port, TopTalkers::Bytes).first().key,
+             QStringLiteral("UDP/5353"));
+    QCOMPARE(report.top(TopTalkers::Flow, TopTalkers::Packets).first().key,
+             QStringLiteral("10.0.0.1 → 10.0.0.9"));
+
+    // The next window starts empty.
+    talkers.add(6, QStringLiteral("TCP"), QStringLiteral("10.0.0.4"),
+                QStringLiteral("10.0.0.9"), 80, 60);
+    talkers.flush();
+    QCOMPARE(talkers.report().revision, quint64(2));
+    QCOMPARE(talkers.report().windowStart, 5);
+    QCOMPARE(talkers.report().totalPackets, quint64(1));
+}
+
+void StatisticsTest::writesRollupSidecar()
+{
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    Statistics stats(start);
+
+    // Two packets every second for two and a half minutes, a burst of ten
+    // in second 70.
+    for (int second = 0; second < 150; ++second) {
+        const int packets = second == 70 ? 10 : 2;
+        for (int i = 0; i < packets; ++i) {
+            stats.recordPacket(start.addSecs(second),
+                               second % 2 ? QStringLiteral("UDP") : QStringLiteral("TCP"),
+                               QStringLiteral("10.0.0.1"),
+                               QStringLiteral("10.0.0.2"),
+                               100,
+                               -1);
+        }
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(stats.SaveStatsToJson(dir.path(), true));
+
+    StatisticsRollup rollup;
+    QVERIFY(StatisticsRollup::loadFor(stats.lastFilePath(), &rollup));
+    QCOMPARE(rollup.sessionStart(), start);
+
+    const QVector<StatisticsRollup::Bucket> minutes = rollup.buckets(StatisticsRollup::Minutes);
+    QCOMPARE(minutes.size(), 3);
+    QCOMPARE(minutes.at(0).samples, 60);
+    QCOMPARE(minutes.at(0).packets, quint64(120));
+    QCOMPARE(minutes.at(1).packets, quint64(128));
+    QCOMPARE(minutes.at(1).minPackets, quint64(2));
+    QCOMPARE(minutes.at(1).maxPackets, quint64(10));
+    QCOMPARE(minutes.at(1).maxBytes, quint64(1000));
+    QCOMPARE(minutes.at(2).samples, 30);
+    QCOMPARE(minutes.at(2).lastSecond, 149);
+    QCOMPARE(minutes.at(0).connections.value(QStringLiteral("10.0.0.1 -> 10.0.0.2")), 60.0);
+
+    const QVector<StatisticsRollup::Bucket> hours = rollup.buckets(StatisticsRollup::Hours);
+    QCOMPARE(hours.size(), 1);
+    QCOMPARE(hours.first().packets, quint64(308));
+    QCOMPARE(hours.first().samples, 150);
+    QCOMPARE(hours.first().protocols.value(QStringLiteral("TCP")), 75.0 * 2 + 8);
+
+    QCOMPARE(rollup.query(120, 60, 119).size(), 1);
+    QVERIFY(rollup.query(30).isEmpty());
+    QCOMPARE(StatisticsRollup::tierFor(7200), StatisticsRollup::Hours);
+}
+
+void StatisticsTest::tracksDistributionQuantiles()
+{
+    QuantileHistogram histogram;
+    for (quint64 value = 1; value <= 10000; ++value) {
+        histogram.add(value);
+    }
+    QCOMPARE(histogram.count(), quint64(10000));
+    QVERIFY(qAbs(double(histogram.quantile(0.5)) - 5000.0) / 5000.0 < 0.035);
+    QVERIFY(qAbs(double(histogram.quantile(0.99)) - 9900.0) / 9900.0 < 0.035);
+    QCOMPARE(histogram.quantile(1.0), quint64(10000));
+    const QuantileHistogram restored = QuantileHistogram::fromJson(histogram.toJson());
+    QCOMPARE(restored.count(), histogram.count());
+    QCOMPARE(restored.quantile(0.9), histogram.quantile(0.9));
+
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    Statistics stats(start);
+    Statistics::PacketDetail syn;
+    syn.srcPort = 40000;
+    syn.dstPort = 443;
+    syn.tcpFlags = 0x02;
+    Statistics::PacketDetail synAck;
+    synAck.srcPort = 443;
+    synAck.dstPort = 40000;
+    synAck.tcpFlags = 0x12;
+    synAck.microseconds = 500;
+    Statistics::PacketDetail ack = syn;
+    ack.tcpFlags = 0x10;
+    stats.recordPacket(start.addMSecs(100), QStringLiteral("TCP"), QStringLiteral("10.0.0.1"),
+                       QStringLiteral("10.0.0.2"), 74, -1, syn);
+    stats.recordPacket(start.addMSecs(125), QStringLiteral("TCP"), QStringLiteral("10.0.0.2"),
+                       QStringLiteral("10.0.0.1"), 74, -1, synAck);
+    stats.recordPacket(start.addMSecs(126), QStringLiteral("TCP"), QStringLiteral("10.0.0.1"),
+                       QStringLiteral("10.0.0.2"), 66, -1, ack);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(stats.SaveStatsToJson(dir.path(), true));
+
+    QFile file(stats.lastFilePath());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    const QJsonObject quantiles = root.value(QStringLiteral("perSecond")).toArray().at(0).toObject()
+                                      .value(QStringLiteral("quantiles")).toObject();
+    const QJsonArray rtt = quantiles.value(QStringLiteral("handshakeRttUs")).toArray();
+    QCOMPARE(rtt.size(), 3);
+    QCOMPARE(rtt.at(0).toDouble(), 25500.0);
+    QVERIFY(qAbs(quantiles.value(QStringLiteral("size")).toArray().at(2).toDouble() - 74.0) < 3.0);
+    QVERIFY(quantiles.value(QStringLiteral("protocols")).toObject().contains(QStringLiteral("TCP")));
+
+    const QJsonObject sizes = root.value(QStringLiteral("distributions")).toObject()
+                                  .value(QStringLiteral("all")).toObject()
+                                  .value(QStringLiteral("size")).toObject();
+    QCOMPARE(sizes.value(QStringLiteral("count")).toDouble(), 3.0);
+    QCOMPARE(QuantileHistogram::fromJson(sizes).min(), quint64(66));
+}
+
+void StatisticsTest::rowRangeSetKeepsRuns()
+{
+    RowRangeSet contiguous;
+    for (int row = 100; row < 100100; ++row) {
+        contiguous.append(row);
+    }
+    QCOMPARE(contiguous.count(), 100000);
+    QCOMPARE(contiguous.rangeCount(), 1);
+
+    RowRangeSet everyOther;
+    for (int row = 0; row < 200; row += 2) {
+        everyOther.append(row);
+    }
+    everyOther.append(51);   // out of order, joins 50 and 52
+    QCOMPARE(everyOther.count(), 101);
+    QCOMPARE(everyOther.rangeCount(), 99);
+    QVERIFY(everyOther.contains(51));
+    QVERIFY(!everyOther.contains(53));
+
+    const RowRangeSet overlap = everyOther.intersected(RowRangeSet(40, 60));
+    QCOMPARE(overlap.first(), 40);
+    QCOMPARE(overlap.count(), 12);
+
+    RowRangeSet merged = overlap;
+    merged.unite(RowRangeSet(0, 45));
+    QCOMPARE(merged.count(), 55);
+    QCOMPARE(merged.toVector().first(), 0);
+    QCOMPARE(merged.toVector().last(), 60);
+}
+
+void StatisticsTest::warehouseAnswersHostQueries()
+{
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    Statistics stats(start);
+    for (int second = 0; second < 10; ++second) {
+        stats.recordPacket(start.addSecs(second), QStringLiteral("TCP"), QStringLiteral("10.1.2.3"),
+                           QStringLiteral("10.0.0.9"), 100, 2 * second);
+        stats.recordPacket(start.addSecs(second), QStringLiteral("DNS"), QStringLiteral("10.0.0.53"),
+                           QStringLiteral("10.0.0.9"), 80, 2 * second + 1);
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(stats.SaveStatsToJson(dir.path(), true));
+    const QString firstFile = stats.lastFilePath();
+
+    // A later save renames the file; the session keeps its rows.
+    stats.recordPacket(start.addSecs(20), QStringLiteral("TCP"), QStringLiteral("10.0.0.9"),
+                       QStringLiteral("10.1.2.3"), 60, 20);
+    QVERIFY(stats.SaveStatsToJson(dir.path(), true));
+    QVERIFY(stats.lastFilePath() != firstFile);
+
+    SessionWarehouse warehouse(dir.path());
+    QVERIFY(warehouse.isOpen());
+    QCOMPARE(warehouse.sync(), 0);
+    const QVector<SessionWarehouse::Session> sessions = warehouse.sessions();
+    QCOMPARE(sessions.size(), 1);
+    QCOMPARE(sessions.first().path, stats.lastFilePath());
+    QCOMPARE(sessions.first().maxSecond, 20);
+
+    const auto window = warehouse.contacts(QStringLiteral("10.1.2.3"), start.addSecs(2), start.addSecs(4));
+    QCOMPARE(window.size(), 3);
+    QCOMPARE(window.first().second, 2);
+    QCOMPARE(window.first().packets, quint64(2));
+    QCOMPARE(window.first().matches, 1);
+    QCOMPARE(window.first().protocolCounts.value(QStringLiteral("DNS")), 1.0);
+
+    const auto all = warehouse.contacts(QStringLiteral("10.1.2.3"));
+    QCOMPARE(all.size(), 11);
+    QCOMPARE(all.last().src, QStringLiteral("10.0.0.9"));
+    QCOMPARE(warehouse.protocolTotals().value(sessions.first().id).value(QStringLiteral("TCP")), qint64(11));
+    QCOMPARE(warehouse.seconds(sessions.first().id).size(), 11);
+
+    const QVector<SessionWarehouse::Host> hosts = warehouse.hosts();
+    QCOMPARE(hosts.size(), 3);
+    QCOMPARE(hosts.at(1).ip, QStringLiteral("10.0.0.9"));
+    QCOMPARE(hosts.at(2).lastSeen, start.addSecs(20));
+
+    QVERIFY(QFile::remove(stats.lastFilePath()));
+    QCOMPARE(warehouse.sync(), 0);
+    QVERIFY(warehouse.sessions().isEmpty());
+    QVERIFY(warehouse.hosts().isEmpty());
+}
+
+void StatisticsTest::warehouseUpdatesChangedAnomalies()
+{
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    QJsonObject session;
+    session.insert("sessionStart", start.toString(Qt::ISODate));
+
+    QVector<AnomalyDetector::Event> incidents(2);
+    incidents[0].id = 1;
+    incidents[0].second = 1;
+    incidents[0].endSecond = 2;
+    incidents[0].score = 3.0;
+    incidents[0].summary = QStringLiteral("first");
+    incidents[1].id = 2;
+    incidents[1].second = 5;
+    incidents[1].endSecond = 6;
+    incidents[1].score = 4.0;
+    incidents[1].summary = QStringLiteral("second");
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = QDir(dir.path()).filePath(QStringLiteral("session.json"));
+    SessionWarehouse warehouse(dir.path());
+    QVERIFY(warehouse.isOpen());
+    QVERIFY(warehouse.ingest(path, session, QString(), 0, &incidents, 10));
+    QCOMPARE(warehouse.anomalies().size(), 2);
+
+    // The second incident grew, a third one opened and the first one is no
+    // longer in memory; it stays stored.
+    incidents.removeFirst();
+    incidents[0].endSecond = 8;
+    incidents[0].score = 9.0;
+    AnomalyDetector::Event third;
+    third.id = 3;
+    third.second = third.endSecond = 9;
+    third.score = 1.0;
+    third.summary = QStringLiteral("third");
+    incidents.append(third);
+    QVERIFY(warehouse.ingest(path, session, QString(), 7, &incidents, 10));
+
+    const QVector<SessionWarehouse::Anomaly> stored = warehouse.anomalies();
+    QCOMPARE(stored.size(), 3);
+    QCOMPARE(stored.at(0).summary, QStringLiteral("first"));
+    QCOMPARE(stored.at(1).summary, QStringLiteral("second"));
+    QCOMPARE(stored.at(1).score, 9.0);
+    QCOMPARE(stored.at(2).timestamp, start.addSecs(9));
+}
+
+void StatisticsTest::entityBaselinesFlagQuietHosts()
+{
+    EntityBaselines baselines(2, 0.1);
+    QVector<double> scores;
+    QVector<double> expected;
+    for (int second = 0; second < 20; ++second) {
+        baselines.update({1, 2}, {1000.0 + (second % 3) * 20.0, 5.0}, 6, scores, expected);
+    }
+    baselines.update({1, 2}, {1010.0, 80.0}, 6, scores, expected);
+    QVERIFY(qAbs(scores.at(0)) < 2.0);
+    QVERIFY(scores.at(1) > 10.0);
+    QCOMPARE(expected.at(1), 5.0);
+
+    // Full: the entity updated longest ago makes room.
+    baselines.update({3}, {1.0}, 6, scores, expected);
+    QCOMPARE(baselines.size(), 2);
+    QVERIFY(!baselines.contains(1));
+    QVERIFY(baselines.contains(2));
+
+    AnomalyDetector detector;
+    QSignalSpy spy(&detector, &AnomalyDetector::anomalyDetected);
+    for (int second = 0; second < 20; ++second) {
+        const bool spike = second == 19;
+        AnomalyDetector::FeatureSnapshot snapshot;
+        snapshot.second = second;
+        snapshot.packets = spike ? 1080.0 : 1005.0;
+        snapshot.sources.keys = {1, 2};
+        snapshot.sources.names = QStringList{QStringLiteral("10.0.0.1"), QStringLiteral("10.0.0.5")};
+        snapshot.sources.packets = {1000.0, spike ? 80.0 : 5.0};
+        detector.observe(snapshot);
+    }
+    QCOMPARE(spy.count(), 1);
+    const auto event = spy.at(0).at(0).value<AnomalyDetector::Event>();
+    QVERIFY(event.tags.contains(QStringLiteral("host-source")));
+    const QVariantList entities = event.details.value(QStringLiteral("entityAnomalies")).toList();
+    QCOMPARE(entities.size(), 1);
+    QCOMPARE(entities.first().toMap().value(QStringLiteral("entity")).toString(), QStringLiteral("10.0.0.5"));
+}
+
+void StatisticsTest::tcpFlagDetectorsSeparateScansFromClients()
+{
+    using Kind = TcpFlagDetectors::Kind;
+    auto host = [](quint64 key, const QString &name) {
+        TcpFlagDetectors::Host entry;
+        entry.key = key;
+        entry.name = name;
+        return entry;
+    };
+    auto kinds = [](const QVector<TcpFlagDetectors::Finding> &findings, const QString &name) {
+        QList<Kind> result;
+        for (const TcpFlagDetectors::Finding &finding : findings) {
+            if (finding.host == name) {
+                result.append(finding.kind);
+            }
+        }
+        return result;
+    };
+
+    TcpFlagDetectors detectors;
+    QVector<TcpFlagDetectors::Finding> findings;
+    for (int second = 0; second < 4; ++second) {
+        TcpFlagDetectors::Features features;
+        // A browser whose connections are all answered.
+        TcpFlagDetectors::Host client = host(1, QStringLiteral("10.0.0.2"));
+        client.syn = 20;
+        client.synAckReceived = 20;
+        client.probedHosts = 20;
+        client.probedPort = 443;
+        // Unanswered SYNs across the ports of one host.
+        TcpFlagDetectors::Host scanner = host(2, QStringLiteral("10.0.0.66"));
+        scanner.syn = 40;
+        scanner.probedPorts = 40;
+        scanner.probedHost = QStringLiteral("10.0.0.9");
+        scanner.probedHosts = 1;
+        scanner.probedPort = 22;
+        // Unanswered SYNs to a single service.
+        TcpFlagDetectors::Host stuck = host(3, QStringLiteral("10.0.0.7"));
+        stuck.syn = 30;
+        stuck.probedPorts = 1;
+        stuck.probedHosts = 1;
+        features.syn = client.syn + scanner.syn + stuck.syn;
+        features.synAck = client.synAckReceived;
+        features.segments = 400;
+        features.hosts = {client, scanner, stuck};
+        findings = detectors.observe(second, features, 2.8, 6);
+    }
+    QVERIFY(kinds(findings, QStringLiteral("10.0.0.2")).isEmpty());
+    QVERIFY(kinds(findings, QStringLiteral("10.0.0.66")) == QList<Kind>{Kind::VerticalScan});
+    QVERIFY(kinds(findings, QStringLiteral("10.0.0.7")) == QList<Kind>{Kind::HalfOpen});
+
+    // On a one-way tap no SYN/ACK ever shows up; a busy client is still not
+    // a sweep, a wide one is.
+    TcpFlagDetectors oneWay;
+    for (int second = 0; second < 4; ++second) {
+        TcpFlagDetectors::Features features;
+        TcpFlagDetectors::Host client = host(1, QStringLiteral("10.0.0.2"));
+        client.syn = 40;
+        client.probedHosts = 40;
+        client.probedPort = 443;
+        TcpFlagDetectors::Host sweeper = host(4, QStringLiteral("10.0.0.99"));
+        sweeper.syn = second < 2 ? 0 : 400;
+        sweeper.probedHosts = sweeper.syn;
+        sweeper.probedPort = 445;
+        features.syn = client.syn + sweeper.syn;
+        features.segments = features.syn;
+        features.hosts = {client, sweeper};
+        findings = oneWay.observe(second, features, 2.8, 6);
+    }
+    QVERIFY(kinds(findings, QStringLiteral("10.0.0.2")).isEmpty());
+    QVERIFY(kinds(findings, QStringLiteral("10.0.0.99")) == QList<Kind>{Kind::HorizontalScan});
+
+    TcpFlagDetectors::Features flood;
+    TcpFlagDetectors::Host target = host(5, QStringLiteral("10.0.0.80"));
+    target.synReceived = 1500;
+    target.synAckSent = 10;
+    flood.syn = 1500;
+    flood.synAck = 10;
+    flood.segments = 1600;
+    flood.hosts = {target};
+    findings = detectors.observe(4, flood, 2.8, 6);
+    QVERIFY(kinds(findings, QStringLiteral("10.0.0.80")) == QList<Kind>{Kind::SynFlood});
+
+    // Spoofed one-SYN sources never grow the table past its bound.
+    TcpFlagDetectors bounded(4);
+    for (int second = 0; second < 3; ++second) {
+        TcpFlagDetectors::Features features;
+        for (int i = 0; i < 10; ++i) {
+            TcpFlagDetectors::Host spoofed = host(100 + second * 10 + i, QStringLiteral("192.0.2.%1").arg(i));
+            spoofed.syn = 1;
+            features.hosts.append(spoofed);
+        }
+        bounded.observe(second, features, 2.8, 6);
+        QVERIFY(bounded.trackedSources() <= 4);
+    }
+}
+
+void StatisticsTest::anomalyRulesCompileAndReload()
+{
+    using Scope = AnomalyRules::Scope;
+    AnomalyRules rules;
+    QVERIFY(rules.size() > 0);
+    QVERIFY(rules.hasRules(Scope::Destination));
+
+    QString error;
+    QVERIFY2(rules.load(R"({"threshold": 3, "rules": [
+        {"metric": "tcpRst", "threshold": 10, "tag": "rst-burst", "label": "{value} resets"},
+        {"metric": "packets", "statistic": "zscore", "window": 8, "tag": "rate"}]})", &error),
+             qPrintable(error));
+    QCOMPARE(rules.size(), 2);
+    QVERIFY(!rules.hasRules(Scope::Source));
+
+    double metrics[AnomalyRules::SecondMetricCount] = {};
+    QVector<AnomalyRules::Hit> hits;
+    for (int second = 0; second < 30; ++second) {
+        metrics[AnomalyRules::Packets] = 100 + second % 3;
+        hits.clear();
+        rules.evaluate(Scope::Second, metrics, QString(), hits);
+        QVERIFY(hits.isEmpty());
+    }
+    metrics[AnomalyRules::TcpRst] = 12;
+    hits.clear();
+    rules.evaluate(Scope::Second, metrics, QString(), hits);
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(rules.tag(hits.first().rule), QStringLiteral("rst-burst"));
+    QCOMPARE(rules.describe(hits.first(), metrics), QStringLiteral("12 resets"));
+
+    // Broken files keep the running plan.
+    QVERIFY(!rules.load("{\"rules\": [", &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(!rules.load(R"({"rules": [{"metric": "nope"}]})", &error));
+    QCOMPARE(rules.size(), 2);
+
+    // Retuning a threshold keeps the rule's baseline, so it fires straight away.
+    QVERIFY(rules.load(R"({"rules": [
+        {"metric": "packets", "statistic": "zscore", "window": 8, "threshold": 2, "tag": "rate"}]})", &error));
+    metrics[AnomalyRules::Packets] = 2000;
+    hits.clear();
+    rules.evaluate(Scope::Second, metrics, QString(), hits);
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(rules.tag(hits.first().rule), QStringLiteral("rate"));
+}
+
+void StatisticsTest::seasonalBaselinesPersistTimeOfDay()
+{
+    const int night = SeasonalBaselines::slotOf(3 * 3600);
+    const int morning = SeasonalBaselines::slotOf(9 * 3600);
+    QCOMPARE(morning, 36);
+    QCOMPARE(SeasonalBaselines::slotOf(5 * 86400 + 9 * 3600), SeasonalBaselines::kSlotsPerDay + 36);
+
+    // Quiet nights, busy mornings, for a few days.
+    SeasonalBaselines baselines;
+    for (int day = 0; day < 3; ++day) {
+        for (int second = 0; second < SeasonalBaselines::kSlotSeconds; ++second) {
+            baselines.update(AnomalyRules::Packets, night, 100 + second % 10);
+            baselines.update(AnomalyRules::Packets, morning, 1000 + second % 50);
+        }
+    }
+    QVERIFY(std::abs(baselines.score(AnomalyRules::Packets, morning, 1020)) < 1.0);
+    QVERIFY(baselines.score(AnomalyRules::Packets, night, 1020) > 10.0);
+    QVERIFY(std::isnan(baselines.score(AnomalyRules::Packets, morning + 1, 1020)));
+    QVERIFY(std::isnan(baselines.score(AnomalyRules::Bytes, morning, 1020)));
+
+    // An incident is clipped rather than learned.
+    for (int second = 0; second < 300; ++second) {
+        baselines.update(AnomalyRules::Packets, night, 100000);
+    }
+    QVERIFY(std::abs(baselines.score(AnomalyRules::Packets, night, 105)) < 1.0);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("seasonal.baselines"));
+    QVERIFY(baselines.save(path));
+    SeasonalBaselines restored;
+    QVERIFY(restored.load(path));
+    QCOMPARE(restored.score(AnomalyRules::Packets, morning, 1500),
+             baselines.score(AnomalyRules::Packets, morning, 1500));
+
+    // A warm profile decides for seasonal rules from the first second.
+    AnomalyRules rules;
+    QVERIFY(rules.load(R"({"rules": [
+        {"metric": "packets", "statistic": "seasonal", "window": 12, "tag": "packet-rate"}]})"));
+    QCOMPARE(rules.seasonalMetrics(), QVector<quint8>{AnomalyRules::Packets});
+    double metrics[AnomalyRules::SecondMetricCount] = {};
+    double seasonal[AnomalyRules::SecondMetricCount];
+    std::fill(std::begin(seasonal), std::end(seasonal), std::numeric_limits<double>::quiet_NaN());
+    metrics[AnomalyRules::Packets] = 1020;
+    seasonal[AnomalyRules::Packets] = restored.score(AnomalyRules::Packets, night, 1020);
+    QVector<AnomalyRules::Hit> hits;
+    rules.evaluate(AnomalyRules::Scope::Second, metrics, QString(), hits, seasonal);
+    QCOMPARE(hits.size(), 1);
+}
+
+void StatisticsTest::beaconDetectorFindsPeriodicContacts()
+{
+    BeaconDetector detector;
+    int row = 0;
+    // A 30 s beacon answered by its server, a few hundred ms of jitter and
+    // one missed check-in.
+    const int jitterMs[] = {120, -250, 40, 300, -80, 0, 210, -300, 90, -150};
+    QVector<int> beaconRows;
+    for (int i = 0; i < 20; ++i) {
+        if (i == 7) {
+            continue;
+        }
+        const qint64 sent = i * 30000LL + jitterMs[i % 10];
+        beaconRows.append(row);
+        detector.add(1, 2, 443, sent, row++);
+        detector.add(2, 1, 443, sent + 40, row++);
+    }
+    // A browsing client with irregular gaps.
+    const int gapsMs[] = {4000, 61000, 9000, 27000, 2500, 120000, 15000, 33000, 7000, 48000};
+    qint64 browsed = 0;
+    for (int i = 0; i < 20; ++i) {
+        browsed += gapsMs[i % 10] + i * 700;
+        detector.add(3, 4, 80, browsed, row++);
+    }
+    // A stream is one long contact, not a beacon.
+    for (qint64 time = 0; time < 600000; time += 100) {
+        detector.add(5, 6, 1935, time, row++);
+    }
+
+    const QVector<BeaconDetector::Finding> findings = detector.score(600000);
+    QCOMPARE(findings.size(), 1);
+    const BeaconDetector::Finding &beacon = findings.first();
+    QCOMPARE(beacon.initiator, quint32(1));
+    QCOMPARE(beacon.responder, quint32(2));
+    QCOMPARE(beacon.port, quint16(443));
+    QVERIFY(std::abs(beacon.periodSeconds - 30.0) < 0.5);
+    QVERIFY(beacon.jitter < 0.02);
+    QVERIFY(beacon.coherence > 0.95);
+    // The ring holds the latest contacts, one row each.
+    QCOMPARE(beacon.contacts, BeaconDetector::kRing);
+    QCOMPARE(beacon.rows.toVector(), beaconRows.mid(beaconRows.size() - BeaconDetector::kRing));
+
+    // Reported again only after a ring of new contacts.
+    detector.add(1, 2, 443, 600000, row++);
+    QVERIFY(detector.score(610000).isEmpty());
+
+    // Conversations past capacity are counted, not tracked, and idle ones
+    // make room again.
+    BeaconDetector small(4);
+    for (quint32 host = 0; host < 10; ++host) {
+        small.add(10 + host, 99, 53, 0, -1);
+    }
+    QCOMPARE(small.size(), 4);
+    QCOMPARE(small.untracked(), quint64(6));
+    small.score(10 * 60 * 1000);
+    QCOMPARE(small.size(), 0);
+    small.add(50, 99, 53, 10 * 60 * 1000 + 1, -1);
+    QCOMPARE(small.size(), 1);
+}
+
+void StatisticsTest::dnsAnalyticsFlagTunnelsAndDga()
+{
+    QCOMPARE(DnsAnalytics::registeredDomain(u"a.b.example.com"), QStringView(u"example.com"));
+    QCOMPARE(DnsAnalytics::registeredDomain(u"www.bbc.co.uk"), QStringView(u"bbc.co.uk"));
+    QCOMPARE(DnsAnalytics::registeredDomain(u"localhost"), QStringView(u"localhost"));
+    QVERIFY(DnsAnalytics::labelEntropy(u"aaaa") == 0.0);
+
+    auto message = [](const QString &name, bool response = false, quint8 rcode = 0, bool txt = false) {
+        DnsAnalytics::Message message;
+        message.valid = true;
+        message.name = name;
+        message.response = response;
+        message.rcode = rcode;
+        message.txt = txt;
+        message.txtBytes = response && txt ? 200 : 0;
+        return message;
+    };
+    quint32 seed = 1;
+    auto randomLabel = [&seed](int length) {
+        static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz234567";
+        QString label;
+        for (int i = 0; i < length; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            label += QLatin1Char(alphabet[(seed >> 16) % 32]);
+        }
+        return label;
+    };
+    const QStringList browsing = {QStringLiteral("www.google.com"), QStringLiteral("mail.google.com"),
+                                  QStringLiteral("api.github.com"), QStringLiteral("www.bbc.co.uk")};
+
+    DnsAnalytics dns;
+    int row = 0;
+    int tunnelRow = -1;
+    for (int second = 0; second < DnsAnalytics::kWindowSeconds; ++second) {
+        // Client 1 tunnels base32 through TXT lookups.
+        for (int i = 0; i < 5; ++i) {
+            const QString name = randomLabel(40) + QLatin1Char('.') + randomLabel(20) + QStringLiteral(".t.tunnel.net");
+            if (tunnelRow < 0) {
+                tunnelRow = row;
+            }
+            dns.add(second, 1, message(name, false, 0, true), row++);
+            dns.add(second, 1, message(name, true, 0, true), row++);
+        }
+        // Client 2 browses, client 3 keeps mistyping one name.
+        const QString &site = browsing.at(second % browsing.size());
+        dns.add(second, 2, message(site), row++);
+        dns.add(second, 2, message(site, true), row++);
+        dns.add(second, 3, message(QStringLiteral("gogle.com")), row++);
+        dns.add(second, 3, message(QStringLiteral("gogle.com"), true, 3), row++);
+        // Client 4 hunts for its controller among random domains.
+        if (second % 3 == 0) {
+            const QString name = randomLabel(12) + QStringLiteral(".com");
+            dns.add(second, 4, message(name), row++);
+            dns.add(second, 4, message(name, true, 3), row++);
+        }
+        if (second + 1 < DnsAnalytics::kWindowSeconds) {
+            QVERIFY(dns.score(second).isEmpty());
+        }
+    }
+
+    const QVector<DnsAnalytics::Finding> findings = dns.score(DnsAnalytics::kWindowSeconds - 1);
+    QCOMPARE(findings.size(), 2);
+    const auto tunnel = std::find_if(findings.cbegin(), findings.cend(), [](const DnsAnalytics::Finding &finding) {
+        return finding.kind == DnsAnalytics::Kind::Tunnel;
+    });
+    QVERIFY(tunnel != findings.cend());
+    QCOMPARE(tunnel->client, quint32(1));
+    QCOMPARE(tunnel->domain, QStringLiteral("tunnel.net"));
+    QVERIFY(tunnel->uniqueNames > 250);
+    QVERIFY(tunnel->entropy > 4.0);
+    QCOMPARE(tunnel->txtQueries, quint32(300));
+    QCOMPARE(tunnel->rows.first(), tunnelRow);
+    const auto dga = std::find_if(findings.cbegin(), findings.cend(), [](const DnsAnalytics::Finding &finding) {
+        return finding.kind == DnsAnalytics::Kind::Dga;
+    });
+    QVERIFY(dga != findings.cend());
+    QCOMPARE(dga->client, quint32(4));
+    QCOMPARE(dga->uniqueNames, 20);
+    QCOMPARE(dga->nxdomainRatio, 1.0);
+    QCOMPARE(dns.clients(), 0);
+
+    // A resolver's worth of clients is capped.
+    DnsAnalytics small(2);
+    for (quint32 client = 0; client < 5; ++client) {
+        small.add(0, client, message(QStringLiteral("x.example.com")), -1);
+    }
+    QCOMPARE(small.clients(), 2);
+    QCOMPARE(small.domains(), 1);
+    QCOMPARE(small.untracked(), quint64(3));
+}
+
+void StatisticsTest::incidentCoalescerMergesFloods()
+{
+    auto event = [](int second, double score, const QStringList &tags, const QStringList &entities, int row) {
+        AnomalyDetector::Event event;
+        event.second = second;
+        event.endSecond = second;
+        event.score = score;
+        event.summary = QString::number(second);
+        event.tags = tags;
+        event.entities = entities;
+        event.packetRows.append(row);
+        return event;
+    };
+
+    IncidentCoalescer coalescer;
+    int published = 0;
+    for (int second = 10; second < 70; ++second) {
+        const double score = second == 40 ? 15.0 : 5.0;
+        if (coalescer.add(event(second, score, {QStringLiteral("syn-flood")}, {QStringLiteral("10.0.0.1")}, second))) {
+            ++published;
+        }
+        if (second % 7 == 0 && coalescer.add(event(second, 4.0, {QStringLiteral("packet-rate")}, {}, 1000 + second))) {
+            ++published;
+        }
+    }
+    // Same tag, another target.
+    QVERIFY(coalescer.add(event(20, 6.0, {QStringLiteral("syn-flood")}, {QStringLiteral("10.0.0.2")}, 2000)));
+
+    QCOMPARE(coalescer.incidents().size(), 3);
+    const AnomalyDetector::Event &flood = coalescer.incidents().first();
+    QCOMPARE(flood.second, 10);
+    QCOMPARE(flood.endSecond, 69);
+    QCOMPARE(flood.seconds, 60);
+    QCOMPARE(flood.score, 15.0);
+    QCOMPARE(flood.summary, QStringLiteral("40"));
+    QCOMPARE(flood.packetRows.count(), 60);
+    QCOMPARE(flood.packetRows.rangeCount(), 1);
+    QVERIFY(published < 20);
+
+    // Seconds held back from publishing are sent once the incident closes,
+    // or when flushed.
+    IncidentCoalescer closing;
+    for (int second = 0; second < 5; ++second) {
+        closing.add(event(second, 5.0, {QStringLiteral("syn-flood")}, {}, second));
+    }
+    QVERIFY(closing.takeFinalUpdates(4).isEmpty());
+    const int closedBy = 4 + IncidentCoalescer::kDefaultCooldownSeconds + 1;
+    const QVector<AnomalyDetector::Event> finals = closing.takeFinalUpdates(closedBy);
+    QCOMPARE(finals.size(), 1);
+    QCOMPARE(finals.first().endSecond, 4);
+    QVERIFY(closing.takeFinalUpdates(closedBy).isEmpty());
+    closing.add(event(200, 5.0, {QStringLiteral("syn-flood")}, {}, 200));
+    closing.add(event(201, 5.0, {QStringLiteral("syn-flood")}, {}, 201));
+    const QVector<AnomalyDetector::Event> flushed = closing.takeFinalUpdates(201, true);
+    QCOMPARE(flushed.size(), 1);
+    QCOMPARE(flushed.first().endSecond, 201);
+
+    // An event without entities joins by tag; after the cooldown a new
+    // incident opens.
+    QVERIFY(coalescer.add(event(70, 3.0, {QStringLiteral("syn-flood"), QStringLiteral("rst-storm")}, {}, 70)));
+    QCOMPARE(coalescer.incidents().size(), 3);
+    QVERIFY(coalescer.incidents().first().tags.contains(QStringLiteral("rst-storm")));
+    coalescer.add(event(70 + IncidentCoalescer::kDefaultCooldownSeconds + 1, 5.0,
+                        {QStringLiteral("syn-flood")}, {QStringLiteral("10.0.0.1")}, 101));
+    QCOMPARE(coalescer.incidents().size(), 4);
+    QCOMPARE(coalescer.incidents().last().id, quint64(4));
+
+    // Without a cooldown every second stands alone, and capacity holds.
+    IncidentCoalescer small(0, 3);
+    for (int second = 0; second < 5; ++second) {
+        small.add(event(second, 5.0, {QStringLiteral("x")}, {}, second));
+    }
+    QCOMPARE(small.incidents().size(), 3);
+    QCOMPARE(small.incidents().first().id, quint64(3));
+
+    // Receivers replace updates by id.
+    QVector<AnomalyDetector::Event> copy;
+    for (const AnomalyDetector::Event &incident : coalescer.incidents()) {
+        IncidentCoalescer::upsert(copy, incident, 3);
+    }
+    QCOMPARE(copy.size(), 3);
+    AnomalyDetector::Event update = coalescer.incidents().last();
+    update.score = 99.0;
+    IncidentCoalescer::upsert(copy, update, 3);
+    QCOMPARE(copy.size(), 3);
+    QCOMPARE(copy.last().score, 99.0);
+}
+
+void StatisticsTest::incidentRecorderKeepsPacketsAroundIncidents()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QDateTime start = QDateTime::fromMSecsSinceEpoch(qint64(1700000000) * 1000);
+    const qint64 startMs = start.toMSecsSinceEpoch();
+
+    AnomalyDetector::Event incident;
+    incident.id = 7;
+    incident.second = 100;
+    incident.endSecond = 100;
+    QString path;
+    {
+        IncidentRecorder recorder(start, dir.path(), 10, 5);
+        path = recorder.pathFor(incident.id);
+        // Ten packets a second for 200 s; the incident is raised a second
+        // late and grows by three seconds before it ends.
+        for (qint64 ms = 0; ms < 200 * 1000; ms += 100) {
+            const qint64 timeMs = startMs + ms;
+            recorder.addPacket(CapturedPacket{QByteArray(60, char(ms / 1000)), DLT_EN10MB,
+                                              timeMs / 1000, (timeMs % 1000) * 1000});
+            if (ms == 101 * 1000) {
+                recorder.trigger(incident);
+                QCOMPARE(recorder.openCaptures(), 1);
+            } else if (ms == 104 * 1000) {
+                incident.endSecond = 103;
+                recorder.trigger(incident);
+            }
+        }
+        QCOMPARE(recorder.openCaptures(), 0);
+        QCOMPARE(recorder.windowPackets(), 151);
+        // A closed incident is not captured again.
+        recorder.trigger(incident);
+        QCOMPARE(recorder.openCaptures(), 0);
+    }
+
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *pcap = pcap_open_offline(path.toUtf8().constData(), errbuf);
+    QVERIFY(pcap);
+    QCOMPARE(pcap_datalink(pcap), DLT_EN10MB);
+    pcap_pkthdr *header = nullptr;
+    const u_char *data = nullptr;
+    int packets = 0;
+    qint64 firstMs = -1;
+    qint64 lastMs = -1;
+    while (pcap_next_ex(pcap, &header, &data) == 1) {
+        const qint64 timeMs = qint64(header->ts.tv_sec) * 1000 + header->ts.tv_usec / 1000 - startMs;
+        firstMs = firstMs < 0 ? timeMs : firstMs;
+        lastMs = timeMs;
+        ++packets;
+    }
+    pcap_close(pcap);
+    // 10 s before the incident's first second, 5 s after its last.
+    QCOMPARE(firstMs, qint64(90 * 1000));
+    QCOMPARE(lastMs, qint64(109 * 1000));
+    QCOMPARE(packets, 191);
+}
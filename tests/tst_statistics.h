@@ -10,6 +10,26 @@ private slots:
     void aggregatesAndSaves();
     void emitsAnomalies();
     void loadSessionRoundTrip();
+    void compactsOldSeconds();
+    void aggregatorPublishesSnapshots();
+    void tracksSubSecondBursts();
+    void hyperLogLogEstimates();
+    void sketchesBoundConnectionTracking();
+    void heavyHittersFindTopKeys();
+    void topTalkersReportWindows();
+    void writesRollupSidecar();
+    void tracksDistributionQuantiles();
+    void rowRangeSetKeepsRuns();
+    void warehouseAnswersHostQueries();
+    void warehouseUpdatesChangedAnomalies();
+    void entityBaselinesFlagQuietHosts();
+    void tcpFlagDetectorsSeparateScansFromClients();
+    void anomalyRulesCompileAndReload();
+    void seasonalBaselinesPersistTimeOfDay();
+    void beaconDetectorFindsPeriodicContacts();
+    void dnsAnalyticsFlagTunnelsAndDga();
+    void incidentCoalescerMergesFloods();
+    void incidentRecorderKeepsPacketsAroundIncidents();
 };
 
 #endif // TST_STATISTICS_H
\ No newline at end of file